@@ -27,8 +27,109 @@
  */
 
 #include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
 #include "H264Nalu.h"
 
+// Start code scanners.
+// All scanners look for the first position p in [pStart, pEnd) where p[0..2] == 00 00 01.
+// They may read up to pEnd + 2 and return pEnd when no start code was found.
+typedef const uint8_t* (*TFindStartCode)(const uint8_t* pStart, const uint8_t* pEnd);
+
+const uint8_t* FindStartCodeC(const uint8_t* p, const uint8_t* pEnd)
+{
+    while (p < pEnd)
+    {
+        if ((*((uint32_t*)(p)) & 0x00FFFFFF) == 0x00010000) // == 00 00 01
+        {
+            return p;
+        }
+
+        ++p;
+    }
+
+    return pEnd;
+}
+
+// SSE2 scanner - checks 16 positions per iteration
+const uint8_t* FindStartCodeSSE2(const uint8_t* p, const uint8_t* pEnd)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi8(1);
+
+    while (p + 16 <= pEnd)
+    {
+        // Compare 16 consecutive positions for the 00 00 01 pattern
+        __m128i b0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p)), zero);
+        __m128i b1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 1)), zero);
+        __m128i b2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 2)), one);
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(b0, b1), b2));
+        if (mask)
+        {
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return p + index;
+        }
+
+        p += 16;
+    }
+
+    // Tail
+    return FindStartCodeC(p, pEnd);
+}
+
+// AVX2 scanner - checks 32 positions per iteration
+// Available since Haswell (4th Generation Core architecture).
+#if _MSC_VER >= 1700  // VS2012 provides AVX2 intrinsics
+const uint8_t* FindStartCodeAVX2(const uint8_t* p, const uint8_t* pEnd)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one  = _mm256_set1_epi8(1);
+
+    while (p + 32 <= pEnd)
+    {
+        // Compare 32 consecutive positions for the 00 00 01 pattern
+        __m256i b0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p)), zero);
+        __m256i b1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 1)), zero);
+        __m256i b2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 2)), one);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(b0, b1), b2));
+        if (mask)
+        {
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return p + index;
+        }
+
+        p += 32;
+    }
+
+    // Avoid AVX-SSE transition penalties in the SSE2 tail
+    _mm256_zeroupper();
+    return FindStartCodeSSE2(p, pEnd);
+}
+#endif
+
+static TFindStartCode SelectFindStartCode()
+{
+#if _MSC_VER >= 1700
+    if (IsAVX2Enabled())
+        return FindStartCodeAVX2;
+#endif
+
+    return FindStartCodeSSE2;
+}
+
+static const TFindStartCode s_FindStartCode = SelectFindStartCode();
+
+const uint8_t* FindStartCode(const uint8_t* pStart, const uint8_t* pEnd)
+{
+    const uint8_t* pStartCode = s_FindStartCode(pStart, pEnd);
+
+    // Debug builds verify the SIMD scanner against the scalar version
+    ASSERT(pStartCode == FindStartCodeC(pStart, pEnd));
+    return pStartCode;
+}
+
 H264_NaluIterator::H264_NaluIterator(const uint8_t* pBuffer, size_t bufSize, int nalSize) :
     m_NalSize(nalSize),
     m_pBuffer(pBuffer),
@@ -52,19 +153,20 @@ bool H264_NaluIterator::FindNextStartCode()
 {
     //ASSERT(m_StreamType == AnnexB); // Sanity check
 
+    if (m_BufSize < 4 || m_CurPos >= m_BufSize - 4)
+    {
+        m_CurPos = m_BufSize;
+        return false;
+    }
+
     const uint8_t* p = m_pBuffer + m_CurPos;
     const uint8_t* pEnd = m_pBuffer + m_BufSize - 4;
-
-    while (p < pEnd)
+    const uint8_t* pStartCode = FindStartCode(p, pEnd);
+    if (pStartCode < pEnd)
     {
-        if ((*((uint32_t*)(p)) & 0x00FFFFFF) == 0x00010000) // == 00 00 01
-        {
-            // Find next AnnexB NAL
-            m_CurPos = p - m_pBuffer;
-            return true;
-        }
-
-        ++p;
+        // Find next AnnexB NAL
+        m_CurPos = pStartCode - m_pBuffer;
+        return true;
     }
 
     m_CurPos = m_BufSize;
@@ -80,6 +80,17 @@ enum H264_NAL_RC
 
 #define IS_VALID_NALU(n) (n > 0 && n <= NALU_TYPE_MAX_VALID)
 
+// Returns the first 00 00 01 start code in [pStart, pEnd) or pEnd if there is none.
+// Note: may read up to pEnd + 2.
+const uint8_t* FindStartCode(const uint8_t* pStart, const uint8_t* pEnd);
+
+// Scanners FindStartCode picks from (exposed for tests). FindStartCodeAVX2 requires IsAVX2Enabled().
+const uint8_t* FindStartCodeC(const uint8_t* pStart, const uint8_t* pEnd);
+const uint8_t* FindStartCodeSSE2(const uint8_t* pStart, const uint8_t* pEnd);
+#if _MSC_VER >= 1700
+const uint8_t* FindStartCodeAVX2(const uint8_t* pStart, const uint8_t* pEnd);
+#endif
+
 class H264_NaluIterator
 {
 public:
@@ -92,6 +103,7 @@ public:
     const uint8_t* GetDataBuffer() const { return m_pBuffer + m_NalDataPos; }
     size_t         GetNalLength() const { return m_CurPos - m_NalPos; }
     const uint8_t* GetNALBuffer() const { return m_pBuffer + m_NalPos; }
+    size_t         GetPosition() const { return m_CurPos; }
     bool IsEOF() const { return m_CurPos >= m_BufSize; }
     H264_NAL_RC Next();
 
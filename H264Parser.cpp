@@ -0,0 +1,629 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "H264Parser.h"
+
+CH264Parser::CH264Parser()
+{
+    Reset();
+}
+
+void CH264Parser::Reset()
+{
+    MSDK_ZERO_VAR(m_SPS);
+    MSDK_ZERO_VAR(m_PPS);
+    m_nLatestSPS = H264_MAX_SPS_COUNT;
+    m_PrevPocMsb = 0;
+    m_PrevPocLsb = 0;
+    m_PrevFrameNumOffset = 0;
+    m_PrevFrameNum = 0;
+}
+
+void CH264Parser::SkipScalingList(CH264BitReader& bs, int nSize)
+{
+    int lastScale = 8, nextScale = 8;
+    for (int j = 0; j < nSize && !bs.Error(); ++j)
+    {
+        if (nextScale != 0)
+        {
+            int delta = bs.GetSE();
+            nextScale = (lastScale + delta + 256) % 256;
+        }
+
+        lastScale = (nextScale == 0) ? lastScale : nextScale;
+    }
+}
+
+bool CH264Parser::ParseSPS(const uint8_t* pData, size_t nSize)
+{
+    CH264BitReader bs(pData, nSize);
+    H264_SPS sps;
+    MSDK_ZERO_VAR(sps);
+
+    sps.profile_idc = bs.GetBits(8);
+    sps.constraint_set_flags = bs.GetBits(8) >> 2; // constraint_set0..5_flag + reserved_zero_2bits
+    sps.level_idc = bs.GetBits(8);
+    uint32_t id = bs.GetUE();
+    if (id >= H264_MAX_SPS_COUNT)
+        return false;
+
+    sps.chroma_format_idc = 1;
+    switch (sps.profile_idc)
+    {
+    case 100: case 110: case 122: case 244: case 44:
+    case 83:  case 86:  case 118: case 128: case 138:
+    case 139: case 134: case 135:
+        sps.chroma_format_idc = bs.GetUE();
+        if (sps.chroma_format_idc == 3)
+            sps.separate_colour_plane_flag = bs.GetBit();
+
+        bs.GetUE(); // bit_depth_luma_minus8
+        bs.GetUE(); // bit_depth_chroma_minus8
+        bs.GetBit(); // qpprime_y_zero_transform_bypass_flag
+        if (bs.GetBit()) // seq_scaling_matrix_present_flag
+        {
+            int count = (sps.chroma_format_idc != 3) ? 8 : 12;
+            for (int i = 0; i < count; ++i)
+            {
+                if (bs.GetBit()) // seq_scaling_list_present_flag
+                    SkipScalingList(bs, (i < 6) ? 16 : 64);
+            }
+        }
+        break;
+    }
+
+    sps.log2_max_frame_num = bs.GetUE() + 4;
+    sps.pic_order_cnt_type = bs.GetUE();
+    if (sps.pic_order_cnt_type == 0)
+    {
+        sps.log2_max_pic_order_cnt_lsb = bs.GetUE() + 4;
+    }
+    else if (sps.pic_order_cnt_type == 1)
+    {
+        sps.delta_pic_order_always_zero_flag = bs.GetBit();
+        sps.offset_for_non_ref_pic = bs.GetSE();
+        sps.offset_for_top_to_bottom_field = bs.GetSE();
+        sps.num_ref_frames_in_pic_order_cnt_cycle = bs.GetUE();
+        if (sps.num_ref_frames_in_pic_order_cnt_cycle > 255)
+            return false;
+
+        for (uint32_t i = 0; i < sps.num_ref_frames_in_pic_order_cnt_cycle; ++i)
+            sps.offset_for_ref_frame[i] = bs.GetSE();
+    }
+
+    sps.max_num_ref_frames = bs.GetUE();
+    bs.GetBit(); // gaps_in_frame_num_value_allowed_flag
+    sps.pic_width_in_mbs = bs.GetUE() + 1;
+    sps.pic_height_in_map_units = bs.GetUE() + 1;
+    sps.frame_mbs_only_flag = bs.GetBit();
+    if (!sps.frame_mbs_only_flag)
+        bs.GetBit(); // mb_adaptive_frame_field_flag
+
+    bs.GetBit(); // direct_8x8_inference_flag
+    if (bs.GetBit()) // frame_cropping_flag
+    {
+        bs.GetUE(); bs.GetUE(); bs.GetUE(); bs.GetUE(); // frame_crop_left/right/top/bottom_offset
+    }
+
+    sps.vui_parameters_present_flag = bs.GetBit();
+    if (bs.Error() || sps.log2_max_frame_num > 16 || sps.log2_max_pic_order_cnt_lsb > 16)
+        return false;
+
+    if (sps.vui_parameters_present_flag && !ParseVUI(bs, sps))
+        return false;
+
+    // Infer the reordering parameters (E.2.1)
+    if (!sps.bitstream_restriction_flag)
+    {
+        sps.max_dec_frame_buffering = GetMaxDpbFrames(sps);
+
+        // Intra profiles don't reorder
+        bool bIntraProfile = (sps.constraint_set_flags & 0x04) != 0; // constraint_set3_flag
+        switch (sps.profile_idc)
+        {
+        case 44: case 86: case 100: case 110: case 122: case 244:
+            break;
+        default:
+            bIntraProfile = false;
+        }
+
+        sps.max_num_reorder_frames = (bIntraProfile) ? 0 : sps.max_dec_frame_buffering;
+    }
+
+    sps.valid = true;
+    m_SPS[id] = sps;
+    m_nLatestSPS = id;
+    return true;
+}
+
+bool CH264Parser::ParseVUI(CH264BitReader& bs, H264_SPS& sps)
+{
+    if (bs.GetBit()) // aspect_ratio_info_present_flag
+    {
+        if (255 == bs.GetBits(8)) // aspect_ratio_idc == Extended_SAR
+        {
+            bs.GetBits(16); // sar_width
+            bs.GetBits(16); // sar_height
+        }
+    }
+
+    if (bs.GetBit()) // overscan_info_present_flag
+        bs.GetBit(); // overscan_appropriate_flag
+
+    sps.video_signal_type_present_flag = bs.GetBit();
+    if (sps.video_signal_type_present_flag)
+    {
+        bs.GetBits(3); // video_format
+        sps.video_full_range_flag = bs.GetBit();
+        sps.colour_description_present_flag = bs.GetBit();
+        if (sps.colour_description_present_flag)
+        {
+            bs.GetBits(16); // colour_primaries, transfer_characteristics
+            sps.matrix_coefficients = bs.GetBits(8);
+        }
+    }
+
+    if (bs.GetBit()) // chroma_loc_info_present_flag
+    {
+        bs.GetUE(); // chroma_sample_loc_type_top_field
+        bs.GetUE(); // chroma_sample_loc_type_bottom_field
+    }
+
+    sps.timing_info_present_flag = bs.GetBit();
+    if (sps.timing_info_present_flag)
+    {
+        sps.num_units_in_tick = bs.GetBits(32);
+        sps.time_scale = bs.GetBits(32);
+        sps.fixed_frame_rate_flag = bs.GetBit();
+    }
+
+    bool bNalHrd = bs.GetBit(); // nal_hrd_parameters_present_flag
+    if (bNalHrd)
+        SkipHrdParameters(bs);
+
+    bool bVclHrd = bs.GetBit(); // vcl_hrd_parameters_present_flag
+    if (bVclHrd)
+        SkipHrdParameters(bs);
+
+    if (bNalHrd || bVclHrd)
+        bs.GetBit(); // low_delay_hrd_flag
+
+    sps.pic_struct_present_flag = bs.GetBit();
+    sps.bitstream_restriction_flag = bs.GetBit();
+    if (sps.bitstream_restriction_flag)
+    {
+        bs.GetBit(); // motion_vectors_over_pic_boundaries_flag
+        bs.GetUE();  // max_bytes_per_pic_denom
+        bs.GetUE();  // max_bits_per_mb_denom
+        bs.GetUE();  // log2_max_mv_length_horizontal
+        bs.GetUE();  // log2_max_mv_length_vertical
+        sps.max_num_reorder_frames = bs.GetUE();
+        sps.max_dec_frame_buffering = bs.GetUE();
+
+        // Both are limited to MaxDpbFrames (16)
+        if (sps.max_dec_frame_buffering > 16 || sps.max_num_reorder_frames > sps.max_dec_frame_buffering)
+            return false;
+    }
+
+    return !bs.Error();
+}
+
+void CH264Parser::SkipHrdParameters(CH264BitReader& bs)
+{
+    uint32_t cpbCount = bs.GetUE() + 1; // cpb_cnt_minus1
+    bs.GetBits(8); // bit_rate_scale, cpb_size_scale
+    for (uint32_t i = 0; i < cpbCount && i < 32 && !bs.Error(); ++i)
+    {
+        bs.GetUE();  // bit_rate_value_minus1
+        bs.GetUE();  // cpb_size_value_minus1
+        bs.GetBit(); // cbr_flag
+    }
+
+    // initial_cpb_removal_delay_length_minus1, cpb_removal_delay_length_minus1,
+    // dpb_output_delay_length_minus1, time_offset_length
+    bs.GetBits(20);
+}
+
+uint32_t CH264Parser::GetMaxDpbFrames(const H264_SPS& sps)
+{
+    // MaxDpbMbs (table A-1)
+    uint32_t maxDpbMbs;
+    switch (sps.level_idc)
+    {
+    case 9:  case 10:           maxDpbMbs = 396;    break;
+    case 11:                    maxDpbMbs = 900;    break;
+    case 12: case 13: case 20:  maxDpbMbs = 2376;   break;
+    case 21:                    maxDpbMbs = 4752;   break;
+    case 22: case 30:           maxDpbMbs = 8100;   break;
+    case 31:                    maxDpbMbs = 18000;  break;
+    case 32:                    maxDpbMbs = 20480;  break;
+    case 40: case 41:           maxDpbMbs = 32768;  break;
+    case 42:                    maxDpbMbs = 34816;  break;
+    case 50:                    maxDpbMbs = 110400; break;
+    case 51: case 52:           maxDpbMbs = 184320; break;
+    default:                    return 16; // Unknown level (or level 6.x) - assume the worst
+    }
+
+    uint32_t frameHeightInMbs = (2 - (uint32_t)sps.frame_mbs_only_flag) * sps.pic_height_in_map_units;
+    uint32_t frameSizeInMbs = sps.pic_width_in_mbs * frameHeightInMbs;
+    return (frameSizeInMbs) ? min(maxDpbMbs / frameSizeInMbs, 16u) : 16;
+}
+
+bool CH264Parser::ParsePPS(const uint8_t* pData, size_t nSize)
+{
+    CH264BitReader bs(pData, nSize);
+    H264_PPS pps;
+    MSDK_ZERO_VAR(pps);
+
+    uint32_t id = bs.GetUE();
+    pps.seq_parameter_set_id = bs.GetUE();
+    pps.entropy_coding_mode_flag = bs.GetBit();
+    pps.bottom_field_pic_order_in_frame_present_flag = bs.GetBit();
+    if (bs.Error() || id >= H264_MAX_PPS_COUNT || pps.seq_parameter_set_id >= H264_MAX_SPS_COUNT)
+        return false;
+
+    uint32_t numSliceGroups = bs.GetUE() + 1;
+    if (numSliceGroups > 8)
+        return false;
+
+    if (numSliceGroups > 1)
+    {
+        uint32_t sliceGroupMapType = bs.GetUE();
+        if (0 == sliceGroupMapType)
+        {
+            for (uint32_t i = 0; i < numSliceGroups; ++i)
+                bs.GetUE(); // run_length_minus1
+        }
+        else if (2 == sliceGroupMapType)
+        {
+            for (uint32_t i = 0; i < numSliceGroups - 1; ++i)
+            {
+                bs.GetUE(); // top_left
+                bs.GetUE(); // bottom_right
+            }
+        }
+        else if (sliceGroupMapType >= 3 && sliceGroupMapType <= 5)
+        {
+            bs.GetBit(); // slice_group_change_direction_flag
+            bs.GetUE();  // slice_group_change_rate_minus1
+        }
+        else if (6 == sliceGroupMapType)
+        {
+            // slice_group_id is Ceil(Log2(num_slice_groups)) bits
+            int nBits = 0;
+            while ((1u << nBits) < numSliceGroups)
+                ++nBits;
+
+            uint32_t picSizeInMapUnits = bs.GetUE() + 1;
+            for (uint32_t i = 0; i < picSizeInMapUnits && !bs.Error(); ++i)
+                bs.GetBits(nBits);
+        }
+    }
+
+    pps.num_ref_idx_l0_default_active_minus1 = bs.GetUE();
+    pps.num_ref_idx_l1_default_active_minus1 = bs.GetUE();
+    pps.weighted_pred_flag = bs.GetBit();
+    pps.weighted_bipred_idc = bs.GetBits(2);
+    bs.GetSE();  // pic_init_qp_minus26
+    bs.GetSE();  // pic_init_qs_minus26
+    bs.GetSE();  // chroma_qp_index_offset
+    bs.GetBit(); // deblocking_filter_control_present_flag
+    bs.GetBit(); // constrained_intra_pred_flag
+    pps.redundant_pic_cnt_present_flag = bs.GetBit();
+    if (bs.Error() || pps.num_ref_idx_l0_default_active_minus1 > 31 || pps.num_ref_idx_l1_default_active_minus1 > 31)
+        return false;
+
+    pps.valid = true;
+    m_PPS[id] = pps;
+    return true;
+}
+
+bool CH264Parser::ParseSliceHeader(uint8_t nalHeader, const uint8_t* pData, size_t nSize, H264_SliceHeader& header)
+{
+    CH264BitReader bs(pData, nSize);
+    MSDK_ZERO_VAR(header);
+
+    header.nal_unit_type = nalHeader & 0x1F;
+    header.nal_ref_idc = (nalHeader >> 5) & 3;
+    header.first_mb_in_slice = bs.GetUE();
+    header.slice_type = bs.GetUE();
+    header.pic_parameter_set_id = bs.GetUE();
+    if (bs.Error())
+        return false;
+
+    // Can't go on without the parameter sets
+    const H264_PPS* pPPS = GetPPS(header.pic_parameter_set_id);
+    const H264_SPS* pSPS = (pPPS) ? GetSPS(pPPS->seq_parameter_set_id) : NULL;
+    if (NULL == pSPS)
+        return true;
+
+    if (pSPS->separate_colour_plane_flag)
+        bs.GetBits(2); // colour_plane_id
+
+    header.frame_num = bs.GetBits(pSPS->log2_max_frame_num);
+    if (!pSPS->frame_mbs_only_flag)
+    {
+        header.field_pic_flag = bs.GetBit();
+        if (header.field_pic_flag)
+            header.bottom_field_flag = bs.GetBit();
+    }
+
+    if (5 == header.nal_unit_type) // IDR
+        header.idr_pic_id = bs.GetUE();
+
+    if (pSPS->pic_order_cnt_type == 0)
+    {
+        header.pic_order_cnt_lsb = bs.GetBits(pSPS->log2_max_pic_order_cnt_lsb);
+        if (pPPS->bottom_field_pic_order_in_frame_present_flag && !header.field_pic_flag)
+            header.delta_pic_order_cnt_bottom = bs.GetSE();
+    }
+    else if (pSPS->pic_order_cnt_type == 1 && !pSPS->delta_pic_order_always_zero_flag)
+    {
+        header.delta_pic_order_cnt[0] = bs.GetSE();
+        if (pPPS->bottom_field_pic_order_in_frame_present_flag && !header.field_pic_flag)
+            header.delta_pic_order_cnt[1] = bs.GetSE();
+    }
+
+    if (pPPS->redundant_pic_cnt_present_flag)
+        bs.GetUE(); // redundant_pic_cnt
+
+    // Skip the rest of the header up to dec_ref_pic_marking (7.3.3) - MMCO 5 resets the POC
+    const uint32_t sliceType = header.slice_type % 5;
+    const bool bB = (H264_SLICE_B == sliceType);
+    const bool bP = (H264_SLICE_P == sliceType || H264_SLICE_SP == sliceType);
+    const int nRefLists = (bB) ? 2 : ((bP) ? 1 : 0);
+    if (bB)
+        bs.GetBit(); // direct_spatial_mv_pred_flag
+
+    uint32_t numRefIdxActive[2] =
+    {
+        pPPS->num_ref_idx_l0_default_active_minus1 + 1,
+        pPPS->num_ref_idx_l1_default_active_minus1 + 1
+    };
+
+    if (nRefLists > 0 && bs.GetBit()) // num_ref_idx_active_override_flag
+    {
+        for (int list = 0; list < nRefLists; ++list)
+            numRefIdxActive[list] = bs.GetUE() + 1;
+
+        if (numRefIdxActive[0] > 32 || numRefIdxActive[1] > 32)
+            return false;
+    }
+
+    // ref_pic_list_modification
+    for (int list = 0; list < nRefLists; ++list)
+    {
+        if (!bs.GetBit()) // ref_pic_list_modification_flag
+            continue;
+
+        uint32_t modificationOfPicNumsIdc;
+        do
+        {
+            modificationOfPicNumsIdc = bs.GetUE();
+            if (modificationOfPicNumsIdc > 3)
+                return false;
+
+            if (modificationOfPicNumsIdc != 3)
+                bs.GetUE(); // abs_diff_pic_num_minus1 or long_term_pic_num
+        } while (modificationOfPicNumsIdc != 3 && !bs.Error());
+    }
+
+    // pred_weight_table
+    if ((bP && pPPS->weighted_pred_flag) || (bB && 1 == pPPS->weighted_bipred_idc))
+    {
+        const bool bChroma = !pSPS->separate_colour_plane_flag && pSPS->chroma_format_idc != 0;
+        bs.GetUE(); // luma_log2_weight_denom
+        if (bChroma)
+            bs.GetUE(); // chroma_log2_weight_denom
+
+        for (int list = 0; list < nRefLists; ++list)
+        {
+            for (uint32_t i = 0; i < numRefIdxActive[list] && !bs.Error(); ++i)
+            {
+                if (bs.GetBit()) // luma_weight_flag
+                {
+                    bs.GetSE(); // luma_weight
+                    bs.GetSE(); // luma_offset
+                }
+
+                if (bChroma && bs.GetBit()) // chroma_weight_flag
+                {
+                    for (int j = 0; j < 4; ++j)
+                        bs.GetSE(); // chroma_weight and chroma_offset of Cb and Cr
+                }
+            }
+        }
+    }
+
+    // dec_ref_pic_marking
+    if (header.nal_ref_idc != 0)
+    {
+        if (5 == header.nal_unit_type) // IDR
+        {
+            bs.GetBits(2); // no_output_of_prior_pics_flag, long_term_reference_flag
+        }
+        else if (bs.GetBit()) // adaptive_ref_pic_marking_mode_flag
+        {
+            uint32_t mmco;
+            while ((mmco = bs.GetUE()) != 0 && !bs.Error())
+            {
+                if (mmco > 6)
+                    return false;
+
+                if (5 == mmco)
+                    header.has_mmco5 = true;
+
+                if (1 == mmco || 3 == mmco)
+                    bs.GetUE(); // difference_of_pic_nums_minus1
+
+                if (2 == mmco)
+                    bs.GetUE(); // long_term_pic_num
+
+                if (3 == mmco || 6 == mmco)
+                    bs.GetUE(); // long_term_frame_idx
+
+                if (4 == mmco)
+                    bs.GetUE(); // max_long_term_frame_idx_plus1
+            }
+        }
+    }
+
+    if (bs.Error())
+        return false;
+
+    header.has_picture_info = true;
+    return true;
+}
+
+bool CH264Parser::DecodePOC(const H264_SliceHeader& header, int32_t& poc)
+{
+    if (!header.has_picture_info)
+        return false;
+
+    const H264_SPS* pSPS = GetSPS(GetPPS(header.pic_parameter_set_id)->seq_parameter_set_id);
+    if (pSPS->pic_order_cnt_type > 2)
+        return false;
+
+    const bool bIDR = (5 == header.nal_unit_type);
+    const bool bRef = (header.nal_ref_idc != 0);
+    int32_t topPoc, bottomPoc;
+
+    if (pSPS->pic_order_cnt_type == 0)
+    {
+        if (bIDR)
+        {
+            m_PrevPocMsb = 0;
+            m_PrevPocLsb = 0;
+        }
+
+        // Detect wrap around of pic_order_cnt_lsb (8.2.1.1)
+        const int32_t maxPocLsb = 1 << pSPS->log2_max_pic_order_cnt_lsb;
+        const int32_t lsb = (int32_t)header.pic_order_cnt_lsb;
+        const int32_t prevLsb = (int32_t)m_PrevPocLsb;
+        int32_t pocMsb = m_PrevPocMsb;
+        if (lsb < prevLsb && (prevLsb - lsb) >= maxPocLsb / 2)
+            pocMsb += maxPocLsb;
+        else if (lsb > prevLsb && (lsb - prevLsb) > maxPocLsb / 2)
+            pocMsb -= maxPocLsb;
+
+        topPoc = pocMsb + lsb;
+        bottomPoc = (header.field_pic_flag) ? topPoc : topPoc + header.delta_pic_order_cnt_bottom;
+        if (bRef)
+        {
+            m_PrevPocMsb = pocMsb;
+            m_PrevPocLsb = header.pic_order_cnt_lsb;
+        }
+    }
+    else
+    {
+        // FrameNumOffset is shared by types 1 and 2 (8.2.1.2, 8.2.1.3)
+        uint32_t frameNumOffset = 0;
+        if (!bIDR)
+        {
+            frameNumOffset = m_PrevFrameNumOffset;
+            if (m_PrevFrameNum > header.frame_num)
+                frameNumOffset += 1 << pSPS->log2_max_frame_num;
+        }
+
+        if (pSPS->pic_order_cnt_type == 1)
+        {
+            const uint32_t cycleLength = pSPS->num_ref_frames_in_pic_order_cnt_cycle;
+            uint32_t absFrameNum = (cycleLength) ? frameNumOffset + header.frame_num : 0;
+            if (!bRef && absFrameNum > 0)
+                --absFrameNum;
+
+            int32_t expectedPoc = 0;
+            if (absFrameNum > 0)
+            {
+                int32_t expectedDeltaPerCycle = 0;
+                for (uint32_t i = 0; i < cycleLength; ++i)
+                    expectedDeltaPerCycle += pSPS->offset_for_ref_frame[i];
+
+                const uint32_t cycleCount = (absFrameNum - 1) / cycleLength;
+                const uint32_t frameNumInCycle = (absFrameNum - 1) % cycleLength;
+                expectedPoc = (int32_t)cycleCount * expectedDeltaPerCycle;
+                for (uint32_t i = 0; i <= frameNumInCycle; ++i)
+                    expectedPoc += pSPS->offset_for_ref_frame[i];
+            }
+
+            if (!bRef)
+                expectedPoc += pSPS->offset_for_non_ref_pic;
+
+            if (!header.field_pic_flag)
+            {
+                topPoc = expectedPoc + header.delta_pic_order_cnt[0];
+                bottomPoc = topPoc + pSPS->offset_for_top_to_bottom_field + header.delta_pic_order_cnt[1];
+            }
+            else
+            {
+                topPoc = expectedPoc + header.delta_pic_order_cnt[0];
+                bottomPoc = expectedPoc + pSPS->offset_for_top_to_bottom_field + header.delta_pic_order_cnt[0];
+            }
+        }
+        else
+        {
+            int32_t tempPoc = 0;
+            if (!bIDR)
+                tempPoc = 2 * (int32_t)(frameNumOffset + header.frame_num) - ((bRef) ? 0 : 1);
+
+            topPoc = bottomPoc = tempPoc;
+        }
+
+        m_PrevFrameNumOffset = frameNumOffset;
+        m_PrevFrameNum = header.frame_num;
+    }
+
+    // After MMCO 5 the picture's POC is relative to tempPicOrderCnt and the following pictures
+    // continue as after an IDR with frame_num 0 (8.2.1)
+    if (header.has_mmco5)
+    {
+        int32_t tempPoc;
+        if (!header.field_pic_flag)
+            tempPoc = min(topPoc, bottomPoc);
+        else
+            tempPoc = (header.bottom_field_flag) ? bottomPoc : topPoc;
+
+        topPoc -= tempPoc;
+        bottomPoc -= tempPoc;
+
+        m_PrevPocMsb = 0;
+        m_PrevPocLsb = (header.field_pic_flag && header.bottom_field_flag) ? 0 : (uint32_t)topPoc;
+        m_PrevFrameNumOffset = 0;
+        m_PrevFrameNum = 0;
+    }
+
+    if (!header.field_pic_flag)
+        poc = min(topPoc, bottomPoc);
+    else
+        poc = (header.bottom_field_flag) ? bottomPoc : topPoc;
+
+    return true;
+}
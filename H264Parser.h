@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Reads bits from an H264 RBSP. Emulation prevention bytes (00 00 03) are removed on the fly.
+class CH264BitReader
+{
+public:
+    CH264BitReader(const uint8_t* pData, size_t nSize) :
+        m_pData(pData),
+        m_pEnd(pData + nSize),
+        m_Cache(0),
+        m_nCachedBits(0),
+        m_nZeroCount(0),
+        m_bError(false)
+    {
+    }
+
+    // Reads up to 32 bits
+    uint32_t GetBits(int nBits)
+    {
+        ASSERT(nBits > 0 && nBits <= 32);
+        while (m_nCachedBits < nBits)
+        {
+            m_Cache = (m_Cache << 8) | NextByte();
+            m_nCachedBits += 8;
+        }
+
+        m_nCachedBits -= nBits;
+        return (uint32_t)((m_Cache >> m_nCachedBits) & ((1ULL << nBits) - 1));
+    }
+
+    bool GetBit() { return GetBits(1) != 0; }
+
+    // Exp-Golomb codes
+    uint32_t GetUE()
+    {
+        int nLeadingZeros = 0;
+        while (!GetBit())
+        {
+            if (++nLeadingZeros > 31 || m_bError)
+            {
+                m_bError = true;
+                return 0;
+            }
+        }
+
+        return (nLeadingZeros) ? ((1u << nLeadingZeros) - 1) + GetBits(nLeadingZeros) : 0;
+    }
+
+    int32_t GetSE()
+    {
+        uint32_t k = GetUE();
+        return (k & 1) ? (int32_t)((k + 1) >> 1) : -(int32_t)(k >> 1);
+    }
+
+    // True when the reader ran out of data
+    bool Error() const { return m_bError; }
+
+private:
+    uint8_t NextByte()
+    {
+        if (m_pData >= m_pEnd)
+        {
+            m_bError = true;
+            return 0;
+        }
+
+        uint8_t b = *m_pData++;
+
+        // Skip emulation prevention byte
+        if (m_nZeroCount >= 2 && b == 3)
+        {
+            m_nZeroCount = 0;
+            if (m_pData >= m_pEnd)
+            {
+                m_bError = true;
+                return 0;
+            }
+
+            b = *m_pData++;
+        }
+
+        m_nZeroCount = (b == 0) ? m_nZeroCount + 1 : 0;
+        return b;
+    }
+
+    const uint8_t* m_pData;
+    const uint8_t* m_pEnd;
+    uint64_t       m_Cache;
+    int            m_nCachedBits;
+    int            m_nZeroCount;
+    bool           m_bError;
+};
+
+// Sequence parameter set - only the fields needed by the decoder wrapper
+struct H264_SPS
+{
+    bool     valid;
+    uint32_t profile_idc;
+    uint32_t constraint_set_flags;  // constraint_set0_flag is the MSB
+    uint32_t level_idc;
+    uint32_t chroma_format_idc;
+    bool     separate_colour_plane_flag;
+    uint32_t log2_max_frame_num;
+    uint32_t pic_order_cnt_type;
+    uint32_t log2_max_pic_order_cnt_lsb;
+    bool     delta_pic_order_always_zero_flag;
+    int32_t  offset_for_non_ref_pic;
+    int32_t  offset_for_top_to_bottom_field;
+    uint32_t num_ref_frames_in_pic_order_cnt_cycle;
+    int32_t  offset_for_ref_frame[256];
+    uint32_t max_num_ref_frames;
+    uint32_t pic_width_in_mbs;
+    uint32_t pic_height_in_map_units;
+    bool     frame_mbs_only_flag;
+    bool     vui_parameters_present_flag;
+
+    // VUI
+    bool     video_signal_type_present_flag;
+    bool     video_full_range_flag;
+    bool     colour_description_present_flag;
+    uint32_t matrix_coefficients;      // Table E-5: 1 - BT.709, 5/6 - BT.601
+    bool     timing_info_present_flag;
+    uint32_t num_units_in_tick;
+    uint32_t time_scale;
+    bool     fixed_frame_rate_flag;
+    bool     pic_struct_present_flag;
+    bool     bitstream_restriction_flag;
+    uint32_t max_num_reorder_frames;   // Inferred (E.2.1) when bitstream_restriction_flag is off
+    uint32_t max_dec_frame_buffering;  // Inferred (E.2.1) when bitstream_restriction_flag is off
+};
+
+// Picture parameter set - only the fields needed by the decoder wrapper
+struct H264_PPS
+{
+    bool     valid;
+    uint32_t seq_parameter_set_id;
+    bool     entropy_coding_mode_flag;
+    bool     bottom_field_pic_order_in_frame_present_flag;
+    uint32_t num_ref_idx_l0_default_active_minus1;
+    uint32_t num_ref_idx_l1_default_active_minus1;
+    bool     weighted_pred_flag;
+    uint32_t weighted_bipred_idc;
+    bool     redundant_pic_cnt_present_flag;
+};
+
+// Slice header up to dec_ref_pic_marking
+struct H264_SliceHeader
+{
+    uint32_t nal_unit_type;
+    uint32_t nal_ref_idc;
+    uint32_t first_mb_in_slice;
+    uint32_t slice_type;
+    uint32_t pic_parameter_set_id;
+    bool     has_picture_info;  // False when the parameter sets are unknown - fields below are not valid
+    uint32_t frame_num;
+    bool     field_pic_flag;
+    bool     bottom_field_flag;
+    uint32_t idr_pic_id;
+    uint32_t pic_order_cnt_lsb;
+    int32_t  delta_pic_order_cnt_bottom;
+    int32_t  delta_pic_order_cnt[2];
+    bool     has_mmco5;         // dec_ref_pic_marking has memory_management_control_operation 5
+};
+
+// slice_type values (7.4.3). Values 5-9 mean that all slices of the picture have the same type.
+enum H264_SLICE_TYPE
+{
+    H264_SLICE_P  = 0,
+    H264_SLICE_B  = 1,
+    H264_SLICE_I  = 2,
+    H264_SLICE_SP = 3,
+    H264_SLICE_SI = 4
+};
+
+#define H264_MAX_SPS_COUNT 32
+#define H264_MAX_PPS_COUNT 256
+
+// Keeps the active parameter sets of a stream and parses slice headers
+class CH264Parser
+{
+public:
+    CH264Parser();
+    void Reset();
+
+    // All functions receive the NALU payload (after the 1 byte NALU header).
+    // They fail when the data is truncated or corrupted.
+    bool ParseSPS(const uint8_t* pData, size_t nSize);
+    bool ParsePPS(const uint8_t* pData, size_t nSize);
+    bool ParseSliceHeader(uint8_t nalHeader, const uint8_t* pData, size_t nSize, H264_SliceHeader& header);
+
+    // Picture order count (8.2.1) of a new picture (or field). Must be called once per picture
+    // with the header of its first slice, in decoding order. Returns false when the parameter sets are unknown.
+    // A picture with MMCO 5 gets its POC after the reset - 0 for frames - and restarts the count like an IDR.
+    bool DecodePOC(const H264_SliceHeader& header, int32_t& poc);
+
+    const H264_SPS* GetSPS(uint32_t id) const { return (id < H264_MAX_SPS_COUNT && m_SPS[id].valid) ? &m_SPS[id] : NULL; }
+    const H264_PPS* GetPPS(uint32_t id) const { return (id < H264_MAX_PPS_COUNT && m_PPS[id].valid) ? &m_PPS[id] : NULL; }
+
+    // Most recently parsed SPS or NULL
+    const H264_SPS* GetLatestSPS() const { return GetSPS(m_nLatestSPS); }
+
+    // Reordering parameters of the most recently parsed SPS. Returns false when there is none.
+    bool GetReorderInfo(uint32_t& nNumReorderFrames, uint32_t& nMaxDecFrameBuffering) const
+    {
+        const H264_SPS* pSPS = GetLatestSPS();
+        if (NULL == pSPS)
+            return false;
+
+        nNumReorderFrames = pSPS->max_num_reorder_frames;
+        nMaxDecFrameBuffering = pSPS->max_dec_frame_buffering;
+        return true;
+    }
+
+    // Video signal type of the most recently parsed SPS. Returns false when the VUI doesn't have it.
+    // nMatrixCoefficients is 2 (unspecified) without a colour description.
+    bool GetVideoSignalInfo(bool& bFullRange, uint32_t& nMatrixCoefficients) const
+    {
+        const H264_SPS* pSPS = GetLatestSPS();
+        if (NULL == pSPS || !pSPS->video_signal_type_present_flag)
+            return false;
+
+        bFullRange = pSPS->video_full_range_flag;
+        nMatrixCoefficients = (pSPS->colour_description_present_flag) ? pSPS->matrix_coefficients : 2;
+        return true;
+    }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CH264Parser);
+
+    static void SkipScalingList(CH264BitReader& bs, int nSize);
+    static bool ParseVUI(CH264BitReader& bs, H264_SPS& sps);
+    static void SkipHrdParameters(CH264BitReader& bs);
+    static uint32_t GetMaxDpbFrames(const H264_SPS& sps);
+
+    H264_SPS m_SPS[H264_MAX_SPS_COUNT];
+    H264_PPS m_PPS[H264_MAX_PPS_COUNT];
+    uint32_t m_nLatestSPS;
+
+    // Picture order count state of the previous (reference) picture
+    int32_t  m_PrevPocMsb;
+    uint32_t m_PrevPocLsb;
+    uint32_t m_PrevFrameNumOffset;
+    uint32_t m_PrevFrameNum;
+};
+
+// Converts a slice header to MFX_FRAMETYPE_* flags
+inline mfxU16 GetH264FrameType(const H264_SliceHeader& header)
+{
+    mfxU16 frameType;
+    switch (header.slice_type % 5)
+    {
+    case H264_SLICE_B:
+        frameType = MFX_FRAMETYPE_B;
+        break;
+    case H264_SLICE_P:
+    case H264_SLICE_SP:
+        frameType = MFX_FRAMETYPE_P;
+        break;
+    default:
+        frameType = MFX_FRAMETYPE_I;
+    }
+
+    if (header.nal_ref_idc != 0)
+        frameType |= MFX_FRAMETYPE_REF;
+
+    if (5 == header.nal_unit_type) // IDR
+        frameType |= MFX_FRAMETYPE_IDR;
+
+    return frameType;
+}
+
+// True for the first slice of the second field of a complementary field pair
+inline bool IsSecondField(const H264_SliceHeader& header, const H264_SliceHeader& firstField)
+{
+    return header.has_picture_info &&
+        header.field_pic_flag &&
+        header.bottom_field_flag != firstField.bottom_field_flag &&
+        header.frame_num == firstField.frame_num;
+}
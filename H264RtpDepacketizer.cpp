@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "MPEG2PsDemux.h"
+#include "H264RtpDepacketizer.h"
+
+// NALU types used by the RTP payload format (RFC 6184 table 1)
+enum
+{
+    RTP_NALU_STAP_A = 24,
+    RTP_NALU_FU_A   = 28
+};
+
+CH264RtpDepacketizer::CH264RtpDepacketizer()
+{
+    static const uint8_t startCode[] = {0, 0, 0, 1, 0};
+    memcpy(m_StartCode, startCode, sizeof(m_StartCode));
+    Reset();
+}
+
+void CH264RtpDepacketizer::Reset()
+{
+    m_pData = m_pEnd = NULL;
+    m_nNaluSize = 0;
+    m_NextPiece = PIECE_START_CODE;
+    m_nNaluType = 0;
+    m_bHasInput = false;
+    m_bSynced = false;
+    m_nNextSeq = 0;
+    m_bHasTimeStamp = false;
+    m_LastTimeStamp = 0;
+    m_TimeStamp = 0;
+    m_PendingPts = -1;
+    Resync(0);
+}
+
+void CH264RtpDepacketizer::Resync(uint16_t nSeq)
+{
+    for (int i = 0; i < JITTER_WINDOW; ++i)
+    {
+        m_Slots[i].bValid = false;
+    }
+
+    m_nBuffered = 0;
+    m_nNextSeq = nSeq;
+    m_bInFragment = false;
+}
+
+bool CH264RtpDepacketizer::ParseHeader(const uint8_t* pData, size_t nSize, TPacket& packet)
+{
+    // Version 2 only
+    if (nSize < RTP_HEADER_SIZE || (pData[0] >> 6) != 2)
+        return false;
+
+    // Skip the CSRC list and the header extension
+    size_t nHeaderSize = RTP_HEADER_SIZE + 4 * (pData[0] & 0x0f);
+    if (pData[0] & 0x10)
+    {
+        if (nHeaderSize + 4 > nSize)
+            return false;
+
+        nHeaderSize += 4 + 4 * ((pData[nHeaderSize + 2] << 8) | pData[nHeaderSize + 3]);
+    }
+
+    // The last byte of the padding holds its size
+    size_t nPadding = (pData[0] & 0x20) ? pData[nSize - 1] : 0;
+    if (nHeaderSize + nPadding >= nSize)
+        return false;
+
+    packet.nSeq = (uint16_t)((pData[2] << 8) | pData[3]);
+    packet.TimeStamp = ((uint32_t)pData[4] << 24) | ((uint32_t)pData[5] << 16) | ((uint32_t)pData[6] << 8) | pData[7];
+    packet.pPayload = pData + nHeaderSize;
+    packet.nSize = nSize - nHeaderSize - nPadding;
+    return true;
+}
+
+void CH264RtpDepacketizer::SetData(const uint8_t* pData, size_t nSize)
+{
+    ASSERT(!m_bHasInput && m_pData == m_pEnd);
+    m_bHasInput = ParseHeader(pData, nSize, m_Input);
+    if (!m_bHasInput)
+    {
+        MSDK_VTRACE("QsDecoder: invalid RTP packet (%u bytes)\n", (unsigned)nSize);
+    }
+}
+
+bool CH264RtpDepacketizer::NextPacket(TPacket& packet)
+{
+    for (;;)
+    {
+        // Buffered packets are returned as soon as the packets before them arrived
+        TSlot& next = m_Slots[m_nNextSeq % JITTER_WINDOW];
+        if (next.bValid)
+        {
+            ASSERT(next.Packet.nSeq == m_nNextSeq);
+            next.bValid = false;
+            --m_nBuffered;
+            packet = next.Packet;
+            ++m_nNextSeq;
+            return true;
+        }
+
+        if (!m_bHasInput)
+            return false;
+
+        if (!m_bSynced)
+        {
+            Resync(m_Input.nSeq);
+            m_bSynced = true;
+        }
+
+        int delta = (int16_t)(m_Input.nSeq - m_nNextSeq);
+
+        // In order - used in place
+        if (0 == delta)
+        {
+            m_bHasInput = false;
+            packet = m_Input;
+            ++m_nNextSeq;
+            return true;
+        }
+
+        // Late or duplicate packet. Packets far behind mean that the sender restarted.
+        if (delta < 0)
+        {
+            if (delta >= -MAX_MISORDER)
+            {
+                MSDK_VTRACE("QsDecoder: dropped late RTP packet %u\n", m_Input.nSeq);
+                m_bHasInput = false;
+                return false;
+            }
+
+            MSDK_TRACE("QsDecoder: RTP sequence restarted at %u\n", m_Input.nSeq);
+            Resync(m_Input.nSeq);
+            continue;
+        }
+
+        // Ahead of a missing packet - wait for it while the window isn't full
+        if (delta < JITTER_WINDOW)
+        {
+            TSlot& slot = m_Slots[m_Input.nSeq % JITTER_WINDOW];
+            if (!slot.bValid)
+            {
+                slot.Data.assign(m_Input.pPayload, m_Input.pPayload + m_Input.nSize);
+                slot.Packet = m_Input;
+                slot.Packet.pPayload = &slot.Data[0];
+                slot.bValid = true;
+                ++m_nBuffered;
+            }
+
+            m_bHasInput = false;
+            return false;
+        }
+
+        // The missing packet is lost. A NALU being fragmented is truncated.
+        MSDK_TRACE("QsDecoder: lost RTP packet %u\n", m_nNextSeq);
+        m_bInFragment = false;
+        if (0 == m_nBuffered)
+        {
+            Resync(m_Input.nSeq);
+        }
+        else
+        {
+            ++m_nNextSeq;
+        }
+    }
+}
+
+void CH264RtpDepacketizer::StartPacket(const TPacket& packet)
+{
+    // A new time stamp starts a new access unit. The unwrapped time stamp starts one wrap around
+    // above 0 so time stamps of reordered pictures before the first one stay positive.
+    if (!m_bHasTimeStamp)
+    {
+        m_TimeStamp = (1LL << 32) + packet.TimeStamp;
+        m_PendingPts = m_TimeStamp;
+        m_bHasTimeStamp = true;
+    }
+    else if (packet.TimeStamp != m_LastTimeStamp)
+    {
+        m_TimeStamp += (int32_t)(packet.TimeStamp - m_LastTimeStamp);
+        m_PendingPts = m_TimeStamp;
+    }
+
+    m_LastTimeStamp = packet.TimeStamp;
+
+    m_pData = packet.pPayload;
+    m_pEnd = packet.pPayload + packet.nSize;
+    m_nNaluType = m_pData[0] & 0x1f;
+    m_NextPiece = PIECE_START_CODE;
+
+    if (RTP_NALU_FU_A == m_nNaluType)
+    {
+        if (packet.nSize < 2)
+        {
+            m_pData = m_pEnd;
+            return;
+        }
+
+        // The NALU header is rebuilt from the FU indicator and the FU header
+        uint8_t fuHeader = m_pData[1];
+        if (fuHeader & 0x80)
+        {
+            m_StartCode[4] = (m_pData[0] & 0xe0) | (fuHeader & 0x1f);
+            m_bInFragment = true;
+        }
+        else if (m_bInFragment)
+        {
+            m_NextPiece = PIECE_NALU;
+        }
+        else
+        {
+            // The start of the NALU was lost
+            m_pData = m_pEnd;
+            return;
+        }
+
+        m_pData += 2;
+        m_nNaluSize = m_pEnd - m_pData;
+        if (fuHeader & 0x40)
+        {
+            m_bInFragment = false;
+        }
+
+        return;
+    }
+
+    m_bInFragment = false;
+    if (RTP_NALU_STAP_A == m_nNaluType)
+    {
+        // Sizes of the aggregated NALUs are read in NextNaluPiece
+        ++m_pData;
+        m_nNaluSize = 0;
+    }
+    else if (m_nNaluType >= 1 && m_nNaluType <= 23)
+    {
+        // Single NALU packet
+        m_nNaluSize = packet.nSize;
+    }
+    else
+    {
+        // STAP-B, MTAP and FU-B are used by the interleaved mode only
+        MSDK_VTRACE("QsDecoder: unsupported RTP packet type %d\n", m_nNaluType);
+        m_pData = m_pEnd;
+    }
+}
+
+bool CH264RtpDepacketizer::NextNaluPiece(const uint8_t*& pPayload, size_t& nSize)
+{
+    if (m_pData >= m_pEnd)
+        return false;
+
+    if (PIECE_START_CODE == m_NextPiece)
+    {
+        // Each aggregated NALU is preceded by its 16 bit size
+        if (RTP_NALU_STAP_A == m_nNaluType)
+        {
+            if (m_pEnd - m_pData < 2)
+            {
+                m_pData = m_pEnd;
+                return false;
+            }
+
+            m_nNaluSize = (m_pData[0] << 8) | m_pData[1];
+            m_pData += 2;
+            if (0 == m_nNaluSize || m_nNaluSize > (size_t)(m_pEnd - m_pData))
+            {
+                MSDK_VTRACE("QsDecoder: invalid STAP-A packet\n");
+                m_pData = m_pEnd;
+                return false;
+            }
+        }
+
+        pPayload = m_StartCode;
+        nSize = (RTP_NALU_FU_A == m_nNaluType) ? 5 : 4;
+        m_NextPiece = PIECE_NALU;
+        return true;
+    }
+
+    pPayload = m_pData;
+    nSize = m_nNaluSize;
+    m_pData += m_nNaluSize;
+    m_NextPiece = PIECE_START_CODE;
+    return true;
+}
+
+bool CH264RtpDepacketizer::GetNextPayload(const uint8_t*& pPayload, size_t& nSize, int64_t& pts)
+{
+    for (;;)
+    {
+        if (NextNaluPiece(pPayload, nSize))
+        {
+            pts = m_PendingPts;
+            m_PendingPts = -1;
+            return true;
+        }
+
+        TPacket packet;
+        if (!NextPacket(packet))
+            return false;
+
+        StartPacket(packet);
+    }
+}
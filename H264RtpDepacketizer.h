@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Converts RTP packets carrying H264 (RFC 6184, non-interleaved mode) into an AnnexB stream.
+// Each sample holds a single RTP packet (including the 12 byte RTP header). Packets are put back in
+// sequence number order within a small jitter window. Supports single NAL unit packets, STAP-A and FU-A.
+// Payloads are returned as pointers into the sample - only packets waiting for a missing one are copied.
+class CH264RtpDepacketizer : public IStreamDemuxer
+{
+public:
+    CH264RtpDepacketizer();
+    void Reset();
+    void SetData(const uint8_t* pData, size_t nSize);
+
+    // pts is the unwrapped RTP time stamp (90KHz) of the packet starting with this piece, -1 when it's
+    // the same as the previous packet's. The first time stamp doesn't start at 0.
+    bool GetNextPayload(const uint8_t*& pPayload, size_t& nSize, int64_t& pts);
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CH264RtpDepacketizer);
+
+    enum
+    {
+        RTP_HEADER_SIZE = 12,
+        JITTER_WINDOW   = 16, // Packets held back while waiting for a missing packet
+        MAX_MISORDER    = 100 // Packets further behind mean that the sender restarted (RFC 3550 A.1)
+    };
+
+    struct TPacket
+    {
+        uint16_t       nSeq;
+        uint32_t       TimeStamp;
+        const uint8_t* pPayload;
+        size_t         nSize;
+    };
+
+    struct TSlot
+    {
+        bool                 bValid;
+        TPacket              Packet;
+        std::vector<uint8_t> Data;  // Payload copy - the sample is gone when the packet is used
+    };
+
+    // Parses the RTP header. Returns false for invalid packets.
+    static bool ParseHeader(const uint8_t* pData, size_t nSize, TPacket& packet);
+
+    // Returns the next packet in sequence number order or false when there is none
+    bool NextPacket(TPacket& packet);
+
+    // Drops the buffered packets - nSeq is the next expected packet
+    void Resync(uint16_t nSeq);
+
+    // Sets up the NALU parsing of a packet
+    void StartPacket(const TPacket& packet);
+
+    // Splits the payload of the current packet into NALU pieces
+    bool NextNaluPiece(const uint8_t*& pPayload, size_t& nSize);
+
+    // Payload pieces
+    enum TPiece
+    {
+        PIECE_START_CODE,   // Start code (and FU-A NALU header) of the next NALU
+        PIECE_NALU          // NALU data
+    };
+
+    const uint8_t* m_pData;        // Unconsumed payload of the current packet
+    const uint8_t* m_pEnd;
+    size_t   m_nNaluSize;          // Rest of the NALU being returned
+    TPiece   m_NextPiece;
+    int      m_nNaluType;          // NALU type of the current packet
+    bool     m_bHasInput;          // m_Input wasn't processed yet
+    TPacket  m_Input;              // Packet of the current sample
+    TSlot    m_Slots[JITTER_WINDOW];  // Packets received ahead of a missing one (indexed by sequence number)
+    size_t   m_nBuffered;          // Valid slots
+    bool     m_bSynced;            // m_nNextSeq is valid
+    uint16_t m_nNextSeq;           // Sequence number of the next packet to return
+    bool     m_bInFragment;        // FU-A fragments continue the NALU started by the last FU-A start fragment
+    bool     m_bHasTimeStamp;      // m_LastTimeStamp is valid
+    uint32_t m_LastTimeStamp;
+    int64_t  m_TimeStamp;          // Unwrapped m_LastTimeStamp
+    int64_t  m_PendingPts;         // Returned with the first piece of the current packet
+    uint8_t  m_StartCode[5];       // 00 00 00 01 + FU-A NALU header
+};
@@ -1,267 +1,454 @@
-/*
- * Copyright (c) 2013, INTEL CORPORATION
- * All rights reserved.
- * 
- * Redistribution and use in source and binary forms, with or without modification,
- * are permitted provided that the following conditions are met:
- * 
- * Redistributions of source code must retain the above copyright notice,
- * this list of conditions and the following disclaimer.
- * Redistributions in binary form must reproduce the above copyright notice,
- * this list of conditions and the following disclaimer in the documentation and/or
- * other materials provided with the distribution.
- * Neither the name of INTEL CORPORATION nor the names of its contributors may
- * be used to endorse or promote products derived from this software without specific
- * prior written permission.
- *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
- * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
- * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
- * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
- * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
- * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
- * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
- * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- * POSSIBILITY OF SUCH DAMAGE.
- */
-
-#pragma once
-
-#define QS_DEC_DLL_NAME "IntelQuickSyncDecoder.dll"
-#define QS_DEC_VERSION  "v0.45"
-
-// Forward declarations
-struct IDirect3DDeviceManager9;
-struct IMediaSample;
-
-// Return value of the check function.
-// Caps are bitwise OR of the following values
-enum QsCaps
-{
-    QS_CAP_UNSUPPORTED      = 0,
-    QS_CAP_HW_ACCELERATION  = 1,
-    QS_CAP_SW_EMULATION     = 2,
-    QS_CAP_DEINTERLACING    = 4,
-    QS_CAP_DETAIL           = 8,
-    QS_CAP_DENOISE          = 16,
-    QS_CAP_PROCAMP          = 32,
-    QS_CAP_SCALING          = 64,
-    QS_CAP_DX11
-};
-
-enum QsFieldOrder
-{
-    QS_FIELD_AUTO = 0,
-    QS_FIELD_TFF  = 1,
-    QS_FIELD_BFF  = 2
-};
-
-enum QsOutputSurfaceType
-{
-    QS_SURFACE_SYSTEM              = 0, // surface is pointers to yuv in system memory
-    QS_SURFACE_GPU                 = 1, // surface is pointers to yuv in GPU memory, must use gpu_memcpy
-    //QS_SURFACE_DXVA_MEDIA_SAMPLE   = 2, // pMediaSample pointer is active, uv pointers are NULL.
-};
-
-// This struct holds an output frame + meta data
-struct QsFrameData
-{
-    QsFrameData() { memset(this, 0, sizeof(QsFrameData)); }
-
-    enum QsFrameType
-    {
-        Invalid = 0,
-        I       = 1,
-        P       = 2,
-        B       = 3
-    };
-
-    // QsFrameStructure affects how color information is stored within a frame
-    // 4:2:0 example:
-    // fsProgressiveFrame: uv[0][0] affects y[0-1][0-1]
-    // fsInterlacedFrame   uv[0][0] affects y[0][0-1] and y[2][0-1]
-    enum QsFrameStructure
-    {
-        fsProgressiveFrame = 0,  // Note: a progressive frame can hold interlaced content
-        fsInterlacedFrame  = 1,  // Two fields
-        fsField            = 2   // Single field
-    };
-
-    // Pointers to data buffer
-    // Memory should not be freed externally!
-    // Packed UV surfaces (NV12) should use the 'u' pointer.
-    union { unsigned char* y; unsigned char* red; IMediaSample* pMediaSample; };
-    union { unsigned char* u; unsigned char* green; };
-    union { unsigned char* v; unsigned char* blue;  };
-    union { unsigned char* a; unsigned char* alpha; };
-
-    DWORD            fourCC;             // Standard fourCC codes. Limited to NV12 in this version.
-    RECT             rcFull;             // Note: these RECTs are according to WIN32 API standard (not DirectShow)
-    RECT             rcClip;             // They hold the coordinates of the top-left and bottom right pixels
-                                         // So expect values like {0, 0, 1919, 1079} for 1080p.
-    DWORD            dwStride;           // Line width + padding (in bytes). Distance between lines. Always modulu 16.
-    REFERENCE_TIME   rtStart, rtStop;    // Start and stop time stamps. Ther latter is always rtStart+1
-    DWORD            dwInterlaceFlags;   // Same as dwTypeSpecificFlags (in AM_SAMPLE2_PROPERTIES)
-    bool             bFilm;              // true only when a frame has a double field attribute (AM_VIDEO_FLAG_REPEAT_FIELD)
-    DWORD            dwPictAspectRatioX; // Display aspect ratio (NOT pixel aspect ratio)
-    DWORD            dwPictAspectRatioY;
-    QsFrameType      frameType;          // Mainly used for future capability. Will always return I.
-    QsFrameStructure frameStructure;     // See QsFrameStructure enum comments
-    bool             bReadOnly;          // If true, the frame's content can be overwritten (most likely bReadOnly will remain false forever)
-    bool             bCorrupted;         // If true, the HW decoder reported corruption in this frame
-    unsigned reserved[20];
-};
-
-// config for QuickSync component
-struct CQsConfig
-{
-    CQsConfig()
-    {
-        memset(this, 0, sizeof(CQsConfig));
-    }
-
-    // misc
-    union
-    {
-        unsigned misc;
-        struct
-        {
-            unsigned nOutputQueueLength       :  6; // use a minimum of 8 frame for more accurate frame rate calculations
-            bool     bMod16Width              :  1; // deprecated
-            bool     bEnableMultithreading    :  1; // enable worker threads for low latency decode (better performance, more power)
-            bool     bTimeStampCorrection     :  1; // True: time stamp will be generated.
-                                                    // False: DS filter may do this.
-            bool     bEnableMtCopy            :  1; // enables MT frame copy
-            bool     depr_bEnableMtDecode     :  1; // deprecated
-            bool     depr_bEnableMtProcessing :  1; // deprecated
-            bool     bEnableVideoProcessing   :  1; // Master switch for DI, denoise, detail, etc.
-            bool     bEnableSwEmulation       :  1; // When true, a SW version of the decoder will be used (if possible) if HW fails
-            bool     bForceFieldOrder         :  1; // When true decoder interlacing flags are overwriten
-            unsigned eFieldOrder              :  2; // When forced DI is used, this will mark if the progressive frames as TFF or BFF
-            bool     bDropDuplicateFrames     :  1; // True: duplicated frames will be dropped
-                                                    // False: when a frame is marked as duplicated it will be sent out with a modified time
-                                                    //        stamp based on the first frame and frame rate. Useful for transcoding.
-            bool     bEnableD3D11             :  1; // Enable use of Direct3D 11.1 for HW acceleration (Windows 8 and newer OS)
-            bool     bDefaultToD3D11          :  1; // Prefare D3D11 over D3D9.
-            unsigned reserved1                : 12;
-        };
-    };
-
-    // Codec support
-    union
-    {
-        unsigned codecs;
-        struct
-        {
-            bool  bEnableDvdDecoding :  1;
-            bool  bEnableH264        :  1;
-            bool  bEnableMPEG2       :  1;
-            bool  bEnableVC1         :  1;
-            bool  bEnableWMV9        :  1;
-            unsigned reserved2       : 27;
-        };
-    };
-
-    // Video post processing options
-    union
-    {
-        unsigned vpp;
-        struct
-        {
-            bool     bVppEnableDeinterlacing             :  1; // When true, DI will be used on interlaced content
-            bool     bVppEnableFullRateDI                :  1; // true-> double frame rate
-            unsigned nVppDetailStrength                  :  7; // Values are [0-64], 0 - disabled, 64 - full.
-            unsigned nVppDenoiseStrength                 :  7; // Values are [0-64], 0 - disabled, 64 - full.
-            bool     bVppEnableDITimeStampsInterpolation :  1; // Make sure deinterlaced frames have proper time stamps.
-                                                               // MSDK will not produce time stamps for interpolated frames by default.
-            bool     bVppEnableForcedDeinterlacing       :  1; // DI will always work - forces interlacing flags on decoded progressive frames and deinterlaces them,
-                                                               // uses eFieldOrder as hint:
-                                                               // QS_FIELD_AUTO - turn progressive frames' flags to the last encountered interlaced flag. Default to TFF
-                                                               // QS_FIELD_TFF - deinterlace progressive frames using TFF flags
-                                                               // QS_FIELD_BFF - deinterlace progressive frames using BFF flags
-
-            unsigned reserved3                           : 14;
-        };
-    };
-};
-
-// Interafce to QuickSync component
-struct IQuickSyncDecoder
-{
-    typedef HRESULT (*TQS_DeliverSurfaceCallback) (void* obj, QsFrameData* data);
-
-    // Useless constructor to keep several compilers happy...
-    IQuickSyncDecoder() {}
-
-    // Object is OK
-    virtual bool getOK() = 0;
-    
-    // Test if the decoder supports the media type
-    // Return codes are:
-    // S_OK - support with HW acceleration.
-    // S_FALSE - support with SW implementation
-    // E_FAIL - no support
-    // Other errors indicate bad parameters.
-    virtual HRESULT TestMediaType(const AM_MEDIA_TYPE* mtIn, FOURCC fourCC) = 0;
-
-    // Initialize decoder
-    virtual HRESULT InitDecoder(const AM_MEDIA_TYPE* mtIn, FOURCC fourCC) = 0;
-
-    // Decode a sample. Decoded frames are delivered via a callback.
-    // Call SetDeliverSurfaceCallback to specify the callback
-    virtual HRESULT Decode(IMediaSample* pIn) = 0;
-
-    // Flush decoder
-    // When deliverFrames == true, the frames will be delivered via a callback (same as Decode).
-    virtual HRESULT Flush(bool deliverFrames = true) = 0;
-
-    // OnSeek/NewSegment - marks the decoding of a new segment.
-    // Resets the decoder discarding old data.
-    virtual HRESULT OnSeek(REFERENCE_TIME segmentStart) = 0;
-
-    // Marks the start of a flush. All calls to Decode will be ignored.
-    // Usually called asynchroniously from the application thread.
-    virtual HRESULT BeginFlush() = 0;
-    
-    // Marks the end of a flush. All calls to Decode after this function is called will be accepted.
-    // Usually called asynchroniously from the application thread.
-    // An implicit OnSeek call will be generated after the next Decode call.
-    virtual HRESULT EndFlush() = 0;
-
-    // Call this function to pass a D3D device manager to the decoder from the EVR
-    // Must be used in full screen exlusive mode
-    virtual void SetD3DDeviceManager(IDirect3DDeviceManager9* pDeviceManager) = 0;
-
-    // Sets the callback funtion for a DeliverSurface event. This the only method for frame delivery.
-    virtual void SetDeliverSurfaceCallback(void* obj, TQS_DeliverSurfaceCallback func) = 0;
-
-    // Fills the pConfig struct with current config.
-    // If called after construction will contain the defaults.
-    virtual void GetConfig(CQsConfig* pConfig) = 0;
-
-    // Call this function to modify the decoder config.
-    // Must be called before calling the InitDecoder method.
-    virtual void SetConfig(CQsConfig* pConfig) = 0;
-
-    // Change output surface type dynamically
-    virtual void SetOutputSurfaceType(QsOutputSurfaceType surfaceType) = 0;
-
-    virtual const char* GetCodecName() const = 0;
-    virtual bool IsHwAccelerated() const = 0;
-protected:
-    // Ban copying!
-    IQuickSyncDecoder& operator=(const IQuickSyncDecoder&);
-    IQuickSyncDecoder(const IQuickSyncDecoder&);
-    // Ban destruction of interface
-    ~IQuickSyncDecoder() {}
-};
-
-// exported functions
-extern "C" 
-{
-    IQuickSyncDecoder* __stdcall createQuickSync();
-    void               __stdcall destroyQuickSync(IQuickSyncDecoder*);
-    void               __stdcall getVersion(char* ver, const char** license);
-    DWORD              __stdcall check();
-}
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#define QS_DEC_DLL_NAME "IntelQuickSyncDecoder.dll"
+#define QS_DEC_VERSION  "v0.45"
+
+// Forward declarations
+struct IDirect3DDeviceManager9;
+struct IMediaSample;
+
+// Return value of the check function.
+// Caps are bitwise OR of the following values
+enum QsCaps
+{
+    QS_CAP_UNSUPPORTED      = 0,
+    QS_CAP_HW_ACCELERATION  = 1,
+    QS_CAP_SW_EMULATION     = 2,
+    QS_CAP_DEINTERLACING    = 4,
+    QS_CAP_DETAIL           = 8,
+    QS_CAP_DENOISE          = 16,
+    QS_CAP_PROCAMP          = 32,
+    QS_CAP_SCALING          = 64,
+    QS_CAP_DX11
+};
+
+enum QsFieldOrder
+{
+    QS_FIELD_AUTO = 0,
+    QS_FIELD_TFF  = 1,
+    QS_FIELD_BFF  = 2
+};
+
+enum QsOutputSurfaceType
+{
+    QS_SURFACE_SYSTEM              = 0, // surface is pointers to yuv in system memory
+    QS_SURFACE_GPU                 = 1, // surface is pointers to yuv in GPU memory, must use gpu_memcpy
+    //QS_SURFACE_DXVA_MEDIA_SAMPLE   = 2, // pMediaSample pointer is active, uv pointers are NULL.
+};
+
+// Kernels for copying frames out of video memory (see CQsConfig::nCopyKernel).
+// All kernels read with streaming loads (MOVNTDQA). "store" kernels write through the cache,
+// "stream" kernels use non-temporal stores. xN is the number of registers copied per loop iteration.
+enum QsCopyKernel
+{
+    QS_COPY_AUTO              = 0,  // the fastest kernel for the CPU, measured on the first frames
+    QS_COPY_MEMCPY            = 1,  // plain memcpy - very slow on video memory
+    QS_COPY_SSE41_LEGACY      = 2,  // gpu_memcpy_sse41
+    QS_COPY_SSE41_STORE_X2    = 3,
+    QS_COPY_SSE41_STORE_X4    = 4,
+    QS_COPY_SSE41_STORE_X8    = 5,
+    QS_COPY_SSE41_STREAM_X4   = 6,
+    QS_COPY_SSE41_STREAM_X8   = 7,
+    QS_COPY_AVX2_STORE_X2     = 8,
+    QS_COPY_AVX2_STORE_X4     = 9,
+    QS_COPY_AVX2_STREAM_X4    = 10,
+    QS_COPY_AVX512_STORE_X2   = 11,
+    QS_COPY_AVX512_STORE_X4   = 12,
+    QS_COPY_AVX512_STREAM_X4  = 13,
+    QS_COPY_KERNEL_COUNT
+};
+
+// Pixel format of the frames copied to system memory (see CQsConfig::nOutputFormat).
+// Formats other than NV12 are converted while the frame is copied out of video memory.
+enum QsOutputFormat
+{
+    QS_OUTPUT_NV12  = 0, // 'y' and 'u' (packed UV) pointers
+    QS_OUTPUT_I420  = 1, // 'y', 'u' and 'v' pointers. Chroma planes have half the stride.
+    QS_OUTPUT_YV12  = 2, // Like I420 with the V plane before the U plane
+    QS_OUTPUT_YUY2  = 3, // Packed 4:2:2, 'y' pointer only. The chroma of 4:2:0 rows is repeated.
+    QS_OUTPUT_RGB32 = 4  // Packed B, G, R, A bytes with an opaque alpha. 'blue' points to the frame, 'green', 'red'
+                         // and 'alpha' to the other bytes of the first pixel. BT.601/BT.709 and the range follow
+                         // the stream's VUI (H264) - otherwise BT.709 for HD and BT.601 for SD, limited range.
+};
+
+// This struct holds an output frame + meta data
+struct QsFrameData
+{
+    QsFrameData() { memset(this, 0, sizeof(QsFrameData)); }
+
+    enum QsFrameType
+    {
+        Invalid = 0,
+        I       = 1,
+        P       = 2,
+        B       = 3
+    };
+
+    // QsFrameStructure affects how color information is stored within a frame
+    // 4:2:0 example:
+    // fsProgressiveFrame: uv[0][0] affects y[0-1][0-1]
+    // fsInterlacedFrame   uv[0][0] affects y[0][0-1] and y[2][0-1]
+    enum QsFrameStructure
+    {
+        fsProgressiveFrame = 0,  // Note: a progressive frame can hold interlaced content
+        fsInterlacedFrame  = 1,  // Two fields
+        fsField            = 2   // Single field
+    };
+
+    // Pointers to data buffer
+    // Memory should not be freed externally!
+    // Packed UV surfaces (NV12) should use the 'u' pointer.
+    union { unsigned char* y; unsigned char* red; IMediaSample* pMediaSample; };
+    union { unsigned char* u; unsigned char* green; };
+    union { unsigned char* v; unsigned char* blue;  };
+    union { unsigned char* a; unsigned char* alpha; };
+
+    DWORD            fourCC;             // Standard fourCC codes. NV12 unless CQsConfig::nOutputFormat selects another format.
+    RECT             rcFull;             // Note: these RECTs are according to WIN32 API standard (not DirectShow)
+    RECT             rcClip;             // They hold the coordinates of the top-left and bottom right pixels
+                                         // So expect values like {0, 0, 1919, 1079} for 1080p.
+    DWORD            dwStride;           // Line width + padding (in bytes). Distance between lines. Always modulu 16.
+    REFERENCE_TIME   rtStart, rtStop;    // Start and stop time stamps. Ther latter is always rtStart+1
+    DWORD            dwInterlaceFlags;   // Same as dwTypeSpecificFlags (in AM_SAMPLE2_PROPERTIES)
+    bool             bFilm;              // true only when a frame has a double field attribute (AM_VIDEO_FLAG_REPEAT_FIELD)
+    DWORD            dwPictAspectRatioX; // Display aspect ratio (NOT pixel aspect ratio)
+    DWORD            dwPictAspectRatioY;
+    QsFrameType      frameType;          // Picture type (H264 and MPEG2). Other codecs always return I.
+    QsFrameStructure frameStructure;     // See QsFrameStructure enum comments
+    bool             bReadOnly;          // If true, the frame's content can be overwritten (most likely bReadOnly will remain false forever)
+    bool             bCorrupted;         // If true, the HW decoder reported corruption in this frame
+    unsigned reserved[20];
+};
+
+// config for QuickSync component
+// Layout version of CQsConfig, stored in CQsConfig::nConfigVersion.
+// 0 - misc, codecs and vpp only (applications built before the version field existed).
+// 1 - surfaces, surfaceCount and copy were added.
+// 2 - output was added. nOutputStride moved there from copy (its 14 bits couldn't hold 4K RGB32 rows).
+// The decoder only reads and writes the fields known to the caller's version.
+#define QS_CONFIG_VERSION 2
+
+struct CQsConfig
+{
+    CQsConfig()
+    {
+        memset(this, 0, sizeof(CQsConfig));
+        nConfigVersion = QS_CONFIG_VERSION;
+    }
+
+    // misc
+    union
+    {
+        unsigned misc;
+        struct
+        {
+            unsigned nOutputQueueLength       :  6; // use a minimum of 8 frame for more accurate frame rate calculations
+                                                    // H264 streams use less when the SPS limits frame reordering
+                                                    // Not used for H264/MPEG2 when time stamps follow the display order (POC)
+            bool     bMod16Width              :  1; // deprecated
+            bool     bEnableMultithreading    :  1; // enable worker threads for low latency decode (better performance, more power)
+            bool     bTimeStampCorrection     :  1; // True: time stamp will be generated.
+                                                    // False: DS filter may do this.
+            bool     bEnableMtCopy            :  1; // enables MT frame copy
+            bool     depr_bEnableMtDecode     :  1; // deprecated
+            bool     depr_bEnableMtProcessing :  1; // deprecated
+            bool     bEnableVideoProcessing   :  1; // Master switch for DI, denoise, detail, etc.
+            bool     bEnableSwEmulation       :  1; // When true, a SW version of the decoder will be used (if possible) if HW fails
+            bool     bForceFieldOrder         :  1; // When true decoder interlacing flags are overwriten
+            unsigned eFieldOrder              :  2; // When forced DI is used, this will mark if the progressive frames as TFF or BFF
+            bool     bDropDuplicateFrames     :  1; // True: duplicated frames will be dropped
+                                                    // False: when a frame is marked as duplicated it will be sent out with a modified time
+                                                    //        stamp based on the first frame and frame rate. Useful for transcoding.
+            bool     bEnableD3D11             :  1; // Enable use of Direct3D 11.1 for HW acceleration (Windows 8 and newer OS)
+            bool     bDefaultToD3D11          :  1; // Prefare D3D11 over D3D9.
+            bool     bSkipNonRefFrames        :  1; // Non-reference frames are dropped before decoding (H264 and MPEG2).
+                                                    // Lowers the decoding load. Time stamp correction is disabled.
+            unsigned nAsyncDepth              :  4; // Frames decoded ahead before waiting for the oldest one.
+                                                    // 0 - MSDK default with synchronous decoding (old drivers misbehave with 1)
+            unsigned nConfigVersion           :  3; // QS_CONFIG_VERSION the application was built with. Set by the constructor.
+            unsigned reserved1                :  4;
+        };
+    };
+
+    // Codec support
+    union
+    {
+        unsigned codecs;
+        struct
+        {
+            bool     bEnableDvdDecoding   :  1;
+            bool     bEnableH264          :  1;
+            bool     bEnableMPEG2         :  1;
+            bool     bEnableVC1           :  1;
+            bool     bEnableWMV9          :  1;
+            unsigned nH264MaxFragmentSize :  6; // Max size (MB) of an H264 NALU split over several samples, 0 - default (16MB)
+            bool     bTransportStreamInput:  1; // Samples hold MPEG2 transport stream packets (MPEG2 and AnnexB H264).
+                                                // The video PID is taken from the PAT/PMT.
+            bool     bRtpInput            :  1; // Samples hold single RTP packets with H264 (RFC 6184, AnnexB media types only)
+            unsigned reserved2            : 19;
+        };
+    };
+
+    // Video post processing options
+    union
+    {
+        unsigned vpp;
+        struct
+        {
+            bool     bVppEnableDeinterlacing             :  1; // When true, DI will be used on interlaced content
+            bool     bVppEnableFullRateDI                :  1; // true-> double frame rate
+            unsigned nVppDetailStrength                  :  7; // Values are [0-64], 0 - disabled, 64 - full.
+            unsigned nVppDenoiseStrength                 :  7; // Values are [0-64], 0 - disabled, 64 - full.
+            bool     bVppEnableDITimeStampsInterpolation :  1; // Make sure deinterlaced frames have proper time stamps.
+                                                               // MSDK will not produce time stamps for interpolated frames by default.
+            bool     bVppEnableForcedDeinterlacing       :  1; // DI will always work - forces interlacing flags on decoded progressive frames and deinterlaces them,
+                                                               // uses eFieldOrder as hint:
+                                                               // QS_FIELD_AUTO - turn progressive frames' flags to the last encountered interlaced flag. Default to TFF
+                                                               // QS_FIELD_TFF - deinterlace progressive frames using TFF flags
+                                                               // QS_FIELD_BFF - deinterlace progressive frames using BFF flags
+
+            unsigned reserved3                           : 14;
+        };
+    };
+
+    // Surface allocation
+    union
+    {
+        unsigned surfaces;
+        struct
+        {
+            unsigned nMaxWidth            : 14; // Adaptive bitrate streams: surfaces are allocated for this size (pixels) and
+            unsigned nMaxHeight           : 14; // reused by every smaller rendition - a resolution change is a decoder reset.
+                                                // 0 - surfaces are allocated for the current resolution.
+            unsigned reserved4            :  4;
+        };
+    };
+
+    // Surface count
+    union
+    {
+        unsigned surfaceCount;
+        struct
+        {
+            bool     bAutoSurfaceCount    :  1; // Resize the surface pool on seeks to the most surfaces used at once (plus some headroom).
+                                                // Grows when the decoder had to wait for a free surface.
+            unsigned nMinSurfaces         :  8; // Limits of the total surface count when bAutoSurfaceCount is on. 0 - no limit.
+            unsigned nMaxSurfaces         :  8; // The decoder's own minimum (QueryIOSurf) always applies.
+            unsigned reserved5            : 15;
+        };
+    };
+
+    // Frame copy
+    union
+    {
+        unsigned copy;
+        struct
+        {
+            unsigned nCopyKernel          :  5; // QsCopyKernel used for copying frames out of video memory.
+                                                // Kernels the CPU doesn't support fall back to QS_COPY_AUTO.
+            bool     bCompactStride       :  1; // Copies only the visible width (CropX to CropX+CropW, widened to 64 byte boundaries)
+                                                // instead of whole surface rows. rcFull, rcClip and dwStride describe the compacted frame.
+            unsigned depr_nOutputStride   : 14; // Version 1 only - replaced by nOutputStride
+            unsigned nOutputFormat        :  3; // QsOutputFormat of frames in system memory (QS_SURFACE_SYSTEM).
+                                                // Other formats are always compacted (see bCompactStride).
+            unsigned reserved6            :  9;
+        };
+    };
+
+    // Output frames
+    union
+    {
+        unsigned output;
+        struct
+        {
+            unsigned nOutputStride        : 20; // Stride (bytes) of compacted or converted frames. Values that aren't a multiple
+                                                // of 16 are rounded up - QsFrameData::dwStride is the stride used.
+                                                // 0 or too small - the row size aligned to 64 bytes.
+            unsigned reserved7            : 12;
+        };
+    };
+};
+
+// Counters collected since the decoder was created
+struct QsStatistics
+{
+    unsigned           nSurfaceWaits;       // Times the decoder or VPP had to wait for a free surface (all surfaces in use)
+    unsigned           nDeviceBusy;         // Times the decoder or VPP returned MFX_WRN_DEVICE_BUSY
+    unsigned long long nDeviceBusyWaitTime; // Time spent waiting for a busy device (microseconds)
+    unsigned           nTimeToFirstFrame;   // Time from the decoder's creation to the first delivered frame (microseconds, 0 - none yet)
+    unsigned           bWarmStart;          // 1 when the decoder was taken over from the warm decoder cache
+    unsigned           nSurfaceCount;       // Decoder surfaces currently allocated (see CQsConfig::bAutoSurfaceCount)
+    unsigned           reserved[9];
+};
+
+// Decides how long to wait when the device is busy (MFX_WRN_DEVICE_BUSY) before an operation is retried.
+// The decoder first waits for its oldest frame in flight - the policy is used when there's none.
+// Called from the decoding threads. The default policy spins, yields and finally sleeps, doubling the spins each time.
+struct IQsDeviceBusyPolicy
+{
+    // nAttempt counts the consecutive busy returns of the current operation (starting at 1).
+    // Return false to give up - the operation fails.
+    virtual bool Wait(unsigned nAttempt) = 0;
+
+protected:
+    ~IQsDeviceBusyPolicy() {}
+};
+
+// Interafce to QuickSync component
+struct IQuickSyncDecoder
+{
+    typedef HRESULT (*TQS_DeliverSurfaceCallback) (void* obj, QsFrameData* data);
+
+    // Useless constructor to keep several compilers happy...
+    IQuickSyncDecoder() {}
+
+    // Object is OK
+    virtual bool getOK() = 0;
+    
+    // Test if the decoder supports the media type
+    // Return codes are:
+    // S_OK - support with HW acceleration.
+    // S_FALSE - support with SW implementation
+    // E_FAIL - no support
+    // Other errors indicate bad parameters.
+    virtual HRESULT TestMediaType(const AM_MEDIA_TYPE* mtIn, FOURCC fourCC) = 0;
+
+    // Initialize decoder
+    virtual HRESULT InitDecoder(const AM_MEDIA_TYPE* mtIn, FOURCC fourCC) = 0;
+
+    // Decode a sample. Decoded frames are delivered via a callback.
+    // Call SetDeliverSurfaceCallback to specify the callback
+    virtual HRESULT Decode(IMediaSample* pIn) = 0;
+
+    // Flush decoder
+    // When deliverFrames == true, the frames will be delivered via a callback (same as Decode).
+    virtual HRESULT Flush(bool deliverFrames = true) = 0;
+
+    // OnSeek/NewSegment - marks the decoding of a new segment.
+    // Resets the decoder discarding old data.
+    virtual HRESULT OnSeek(REFERENCE_TIME segmentStart) = 0;
+
+    // Marks the start of a flush. All calls to Decode will be ignored.
+    // Usually called asynchroniously from the application thread.
+    virtual HRESULT BeginFlush() = 0;
+    
+    // Marks the end of a flush. All calls to Decode after this function is called will be accepted.
+    // Usually called asynchroniously from the application thread.
+    // An implicit OnSeek call will be generated after the next Decode call.
+    virtual HRESULT EndFlush() = 0;
+
+    // Call this function to pass a D3D device manager to the decoder from the EVR
+    // Must be used in full screen exlusive mode
+    virtual void SetD3DDeviceManager(IDirect3DDeviceManager9* pDeviceManager) = 0;
+
+    // Sets the callback funtion for a DeliverSurface event. This the only method for frame delivery.
+    virtual void SetDeliverSurfaceCallback(void* obj, TQS_DeliverSurfaceCallback func) = 0;
+
+    // Fills the pConfig struct with current config.
+    // If called after construction will contain the defaults.
+    virtual void GetConfig(CQsConfig* pConfig) = 0;
+
+    // Call this function to modify the decoder config.
+    // Must be called before calling the InitDecoder method.
+    virtual void SetConfig(CQsConfig* pConfig) = 0;
+
+    // Change output surface type dynamically
+    virtual void SetOutputSurfaceType(QsOutputSurfaceType surfaceType) = 0;
+
+    virtual const char* GetCodecName() const = 0;
+    virtual bool IsHwAccelerated() const = 0;
+
+    // Fills the pStats struct with the current counters
+    virtual void GetStatistics(QsStatistics* pStats) = 0;
+
+    // Replaces the MFX_WRN_DEVICE_BUSY policy. NULL restores the default.
+    // The policy object must outlive the decoder.
+    virtual void SetDeviceBusyPolicy(IQsDeviceBusyPolicy* pPolicy) = 0;
+protected:
+    // Ban copying!
+    IQuickSyncDecoder& operator=(const IQuickSyncDecoder&);
+    IQuickSyncDecoder(const IQuickSyncDecoder&);
+    // Ban destruction of interface
+    ~IQuickSyncDecoder() {}
+};
+
+// Offline (batch) decoding of H264 AnnexB streams - for throughput, latency doesn't matter.
+// The stream is split at IDR pictures and the groups of pictures are decoded at once by independent
+// decoders. Frames are delivered in presentation order from the thread that calls Decode.
+struct IQsOfflineDecoder
+{
+    typedef IQuickSyncDecoder::TQS_DeliverSurfaceCallback TQS_DeliverSurfaceCallback;
+
+    // Number of decoders working at once (default 2)
+    virtual void SetParallelism(unsigned nDecoders) = 0;
+
+    // Adds input in decoding order. Samples hold whole NALUs with start codes.
+    // A time stamp belongs to the first picture of the sample (INVALID_REFTIME - none). Without time stamps
+    // a sample may hold a whole elementary stream and the frames are stamped from the stream's frame rate.
+    virtual HRESULT AddSample(const BYTE* pData, size_t nSize, REFERENCE_TIME rtStart) = 0;
+
+    // Decodes all input added so far. Returns after the last frame was delivered.
+    virtual HRESULT Decode(void* obj, TQS_DeliverSurfaceCallback func) = 0;
+
+protected:
+    ~IQsOfflineDecoder() {}
+};
+
+// exported functions
+extern "C" 
+{
+    IQuickSyncDecoder* __stdcall createQuickSync();
+    void               __stdcall destroyQuickSync(IQuickSyncDecoder*);
+
+    // Decoders opened as streams share one MSDK scheduler, HW device and frame allocator
+    // (joined sessions). Meant for applications that decode many streams at once.
+    // The renderer's D3D device manager (SetD3DDeviceManager) isn't used.
+    IQuickSyncDecoder* __stdcall openQuickSyncStream();
+    void               __stdcall closeQuickSyncStream(IQuickSyncDecoder*);
+
+    // Warm decoder cache for fast channel switching. Idle decoders keep their session, HW device,
+    // surfaces and initialized MSDK decoder - a new decoder takes one over and only needs a reset.
+    // prewarmQuickSync adds count decoders for the MSDK codec ('AVC ', 'MPG2', 'VC1 ') and maximum frame size
+    // and grows the cache as needed. Destroyed decoders are kept while the cache has room.
+    // setQuickSyncWarmCacheSize(0) releases all idle decoders (must be done before the DLL is unloaded).
+    HRESULT            __stdcall prewarmQuickSync(unsigned codecId, unsigned width, unsigned height, unsigned count);
+    void               __stdcall setQuickSyncWarmCacheSize(unsigned size);
+
+    // Copy thread pool shared by all decoders (CQsConfig::bEnableMtCopy).
+    // count - worker threads (0 - default), affinityMask - cores for the workers (0 - any core).
+    void               __stdcall setQuickSyncCopyThreads(unsigned count, unsigned long long affinityMask);
+
+    // Offline decoder (see IQsOfflineDecoder). pConfig can be NULL (defaults).
+    IQsOfflineDecoder* __stdcall createQuickSyncOfflineDecoder(const CQsConfig* pConfig);
+    void               __stdcall destroyQuickSyncOfflineDecoder(IQsOfflineDecoder*);
+    void               __stdcall getVersion(char* ver, const char** license);
+    DWORD              __stdcall check();
+}
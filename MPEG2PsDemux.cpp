@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "H264Nalu.h"
+#include "MPEG2PsDemux.h"
+
+// Start codes used by the program stream layer
+enum
+{
+    PS_END_CODE           = 0xB9,
+    PS_PACK_START_CODE    = 0xBA,
+    PS_VIDEO_STREAM_MIN   = 0xE0,
+    PS_VIDEO_STREAM_MAX   = 0xEF
+};
+
+CMPEG2PsDemuxer::CMPEG2PsDemuxer()
+{
+    Reset();
+}
+
+void CMPEG2PsDemuxer::Reset()
+{
+    m_pData = m_pEnd = NULL;
+    m_nPayloadSize = 0;
+    m_nSkipSize = 0;
+    m_PendingPts = -1;
+    m_VideoStreamId = 0;
+    m_nHeaderSize = 0;
+}
+
+void CMPEG2PsDemuxer::SetData(const uint8_t* pData, size_t nSize)
+{
+    ASSERT(m_pData == m_pEnd);
+    m_pData = pData;
+    m_pEnd = pData + nSize;
+}
+
+CMPEG2PsDemuxer::TParseResult CMPEG2PsDemuxer::ParsePacket(const uint8_t* p, size_t nSize, TPacketInfo& info)
+{
+    // A partial start code is valid as long as the available bytes match
+    static const uint8_t prefix[3] = { 0, 0, 1 };
+    if (memcmp(p, prefix, min(nSize, (size_t)3)) != 0)
+        return PS_INVALID;
+
+    if (nSize < 4)
+        return PS_NEED_DATA;
+
+    MSDK_ZERO_VAR(info);
+    info.pts = -1;
+    const uint8_t code = p[3];
+    if (PS_END_CODE == code)
+    {
+        info.nHeaderSize = 4;
+        return PS_OK;
+    }
+
+    if (PS_PACK_START_CODE == code)
+    {
+        if (nSize < 5)
+            return PS_NEED_DATA;
+
+        // MPEG1 pack header has a fixed size
+        if ((p[4] & 0xF0) == 0x20)
+        {
+            info.nHeaderSize = 12;
+            return (nSize < 12) ? PS_NEED_DATA : PS_OK;
+        }
+
+        if ((p[4] & 0xC0) != 0x40)
+            return PS_INVALID;
+
+        // MPEG2 - pack_stuffing_length is in the last byte
+        if (nSize < 14)
+            return PS_NEED_DATA;
+
+        info.nHeaderSize = 14 + (p[13] & 7);
+        return PS_OK;
+    }
+
+    // Elementary stream data outside of a packet - lost sync
+    if (code < PS_END_CODE)
+        return PS_INVALID;
+
+    // All other packets have a length field
+    if (nSize < 6)
+        return PS_NEED_DATA;
+
+    size_t nPacketLength = ((size_t)p[4] << 8) | p[5];
+    bool bVideo = code >= PS_VIDEO_STREAM_MIN && code <= PS_VIDEO_STREAM_MAX &&
+        (0 == m_VideoStreamId || code == m_VideoStreamId);
+
+    if (!bVideo)
+    {
+        info.nHeaderSize = 6;
+        info.nSkipSize = nPacketLength;
+        return PS_OK;
+    }
+
+    // Unbounded packets are allowed in transport streams only
+    if (0 == nPacketLength)
+        return PS_INVALID;
+
+    TParseResult result = ParsePesHeader(p, nSize, info);
+    if (PS_OK != result)
+        return result;
+
+    if (info.nHeaderSize > 6 + nPacketLength)
+        return PS_INVALID;
+
+    info.nPayloadSize = 6 + nPacketLength - info.nHeaderSize;
+    m_VideoStreamId = code;
+    return PS_OK;
+}
+
+CMPEG2PsDemuxer::TParseResult CMPEG2PsDemuxer::ParsePesHeader(const uint8_t* p, size_t nSize, TPacketInfo& info)
+{
+    if (nSize < 7)
+        return PS_NEED_DATA;
+
+    // MPEG2 PES header
+    if ((p[6] & 0xC0) == 0x80)
+    {
+        if (nSize < 9)
+            return PS_NEED_DATA;
+
+        info.nHeaderSize = 9 + p[8];
+        if (nSize < info.nHeaderSize)
+            return PS_NEED_DATA;
+
+        // PTS_DTS_flags
+        if ((p[7] & 0x80) && p[8] >= 5)
+        {
+            info.pts = ReadPesTimeStamp(p + 9);
+        }
+
+        return PS_OK;
+    }
+
+    // MPEG1 packet header - up to 16 stuffing bytes
+    size_t i = 6;
+    while (i < nSize && i < 6 + 16 && 0xFF == p[i])
+        ++i;
+
+    if (i >= nSize)
+        return PS_NEED_DATA;
+
+    // STD_buffer_scale and size
+    if ((p[i] & 0xC0) == 0x40)
+    {
+        i += 2;
+        if (i >= nSize)
+            return PS_NEED_DATA;
+    }
+
+    size_t nTimeStampSize;
+    switch (p[i] & 0xF0)
+    {
+    case 0x20: nTimeStampSize = 5;  break; // PTS
+    case 0x30: nTimeStampSize = 10; break; // PTS + DTS
+    default:
+        if (p[i] != 0x0F)
+            return PS_INVALID;
+
+        nTimeStampSize = 0;
+        ++i;
+    }
+
+    if (nTimeStampSize)
+    {
+        if (nSize < i + nTimeStampSize)
+            return PS_NEED_DATA;
+
+        info.pts = ReadPesTimeStamp(p + i);
+        i += nTimeStampSize;
+    }
+
+    info.nHeaderSize = i;
+    return PS_OK;
+}
+
+bool CMPEG2PsDemuxer::GetNextPayload(const uint8_t*& pPayload, size_t& nSize, int64_t& pts)
+{
+    TPacketInfo info;
+    for (;;)
+    {
+        const size_t nAvailable = m_pEnd - m_pData;
+
+        // Inside a video packet
+        if (m_nPayloadSize > 0)
+        {
+            if (0 == nAvailable)
+                return false;
+
+            pPayload = m_pData;
+            nSize = min(m_nPayloadSize, nAvailable);
+            pts = m_PendingPts;
+            m_PendingPts = -1;
+            m_pData += nSize;
+            m_nPayloadSize -= nSize;
+            return true;
+        }
+
+        // Inside a packet of another stream
+        if (m_nSkipSize > 0)
+        {
+            size_t nSkip = min(m_nSkipSize, nAvailable);
+            m_pData += nSkip;
+            m_nSkipSize -= nSkip;
+            if (m_nSkipSize > 0)
+                return false;
+
+            continue;
+        }
+
+        if (0 == nAvailable)
+            return false;
+
+        TParseResult result;
+        if (m_nHeaderSize > 0)
+        {
+            // Complete the header left from the previous sample
+            size_t nCopy = min((size_t)MAX_HEADER_SIZE - m_nHeaderSize, nAvailable);
+            memcpy(m_Header + m_nHeaderSize, m_pData, nCopy);
+            result = ParsePacket(m_Header, m_nHeaderSize + nCopy, info);
+            if (PS_OK == result)
+            {
+                ASSERT(info.nHeaderSize > m_nHeaderSize);
+                m_pData += info.nHeaderSize - m_nHeaderSize;
+            }
+            else if (PS_NEED_DATA == result)
+            {
+                m_nHeaderSize += nCopy;
+                m_pData = m_pEnd;
+                return false;
+            }
+
+            // Invalid data is dropped - resync at the next start code
+            m_nHeaderSize = 0;
+        }
+        else
+        {
+            // Packets follow each other - the search only skips garbage after a loss of sync.
+            // Note: FindStartCode may read 2 bytes beyond the end of the search range.
+            const uint8_t* p = (nAvailable >= 3) ? FindStartCode(m_pData, m_pEnd - 2) : m_pEnd;
+            if (p == m_pEnd - 2 || p == m_pEnd)
+            {
+                // The last bytes may be the beginning of a start code
+                p = (nAvailable >= 2) ? m_pEnd - 2 : m_pData;
+            }
+
+            if (p != m_pData)
+            {
+                MSDK_VTRACE("QsDecoder: PS demuxer skipped %u bytes\n", (unsigned)(p - m_pData));
+                m_pData = p;
+            }
+
+            result = ParsePacket(m_pData, m_pEnd - m_pData, info);
+            if (PS_OK == result)
+            {
+                m_pData += info.nHeaderSize;
+            }
+            else if (PS_NEED_DATA == result)
+            {
+                m_nHeaderSize = m_pEnd - m_pData;
+                ASSERT(m_nHeaderSize < MAX_HEADER_SIZE);
+                memcpy(m_Header, m_pData, m_nHeaderSize);
+                m_pData = m_pEnd;
+                return false;
+            }
+            else
+            {
+                ++m_pData;
+            }
+        }
+
+        if (PS_OK == result)
+        {
+            m_nPayloadSize = info.nPayloadSize;
+            m_nSkipSize = info.nSkipSize;
+            m_PendingPts = info.pts;
+        }
+    }
+}
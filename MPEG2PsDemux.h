@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Extracts a video elementary stream from a container stream
+class IStreamDemuxer
+{
+public:
+    virtual ~IStreamDemuxer() {}
+    virtual void Reset() = 0;
+
+    // Sets the next sample. The previous sample must be fully consumed by GetNextPayload.
+    virtual void SetData(const uint8_t* pData, size_t nSize) = 0;
+
+    // Returns the next piece of the video stream. Returns false when the sample is consumed.
+    // pts is the PTS (90KHz) of the packet that starts with this piece or -1.
+    // The piece is valid until the next call.
+    virtual bool GetNextPayload(const uint8_t*& pPayload, size_t& nSize, int64_t& pts) = 0;
+};
+
+// Reads a 33 bit PTS/DTS field of a PES header (5 bytes with marker bits in between)
+inline int64_t ReadPesTimeStamp(const uint8_t* p)
+{
+    return ((int64_t)((p[0] >> 1) & 7) << 30) |
+        ((int64_t)p[1] << 22) |
+        ((int64_t)(p[2] >> 1) << 15) |
+        ((int64_t)p[3] << 7) |
+        (int64_t)(p[4] >> 1);
+}
+
+// Extracts the video elementary stream from an MPEG1/MPEG2 program stream (e.g. DVD packs).
+// Samples are processed one at a time and packets may span samples.
+// Payloads are returned as pointers into the sample - only headers split between samples are copied.
+class CMPEG2PsDemuxer : public IStreamDemuxer
+{
+public:
+    CMPEG2PsDemuxer();
+    void Reset();
+    void SetData(const uint8_t* pData, size_t nSize);
+    bool GetNextPayload(const uint8_t*& pPayload, size_t& nSize, int64_t& pts);
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CMPEG2PsDemuxer);
+
+    enum TParseResult
+    {
+        PS_OK,
+        PS_NEED_DATA,
+        PS_INVALID
+    };
+
+    struct TPacketInfo
+    {
+        size_t  nHeaderSize;  // Bytes up to the payload
+        size_t  nPayloadSize; // Video payload following the header
+        size_t  nSkipSize;    // Other packets - bytes to skip after the header
+        int64_t pts;          // -1 if there is none
+    };
+
+    // Parses the packet header at p (starts with 00 00 01). nSize is the number of bytes available.
+    TParseResult ParsePacket(const uint8_t* p, size_t nSize, TPacketInfo& info);
+    TParseResult ParsePesHeader(const uint8_t* p, size_t nSize, TPacketInfo& info);
+
+    // Longest header that may be split between samples: PES header with PES_header_data_length = 255
+    enum { MAX_HEADER_SIZE = 9 + 255 };
+
+    const uint8_t* m_pData;        // Unconsumed part of the current sample
+    const uint8_t* m_pEnd;
+    size_t   m_nPayloadSize;       // Rest of the current video PES payload
+    size_t   m_nSkipSize;          // Rest of a packet that isn't needed
+    int64_t  m_PendingPts;         // PTS of the current video PES - returned with its first payload
+    uint8_t  m_VideoStreamId;      // Stream id of the first video PES seen (0 - none yet)
+    uint8_t  m_Header[MAX_HEADER_SIZE]; // Beginning of a packet header that continues in the next sample
+    size_t   m_nHeaderSize;
+};
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "H264Nalu.h"
+#include "MPEG2StartCode.h"
+
+MPEG2_StartCodeIterator::MPEG2_StartCodeIterator(const uint8_t* pBuffer, size_t bufSize, size_t startPos) :
+    m_pBuffer(pBuffer),
+    m_BufSize(bufSize),
+    m_CurPos(startPos),
+    m_NextPos(startPos)
+{
+    ASSERT(pBuffer != NULL || bufSize == 0);
+}
+
+bool MPEG2_StartCodeIterator::Next()
+{
+    // A complete start code is 4 bytes long (00 00 01 XX)
+    const size_t lastPos = (m_BufSize > 3) ? m_BufSize - 3 : 0;
+    if (m_NextPos >= lastPos)
+    {
+        m_CurPos = max(m_NextPos, lastPos);
+        return false;
+    }
+
+    const uint8_t* pEnd = m_pBuffer + lastPos;
+    const uint8_t* p = FindStartCode(m_pBuffer + m_NextPos, pEnd);
+    m_CurPos = p - m_pBuffer;
+    if (p == pEnd)
+    {
+        m_NextPos = m_CurPos;
+        return false;
+    }
+
+    // 00 00 01 can't appear again in the next 2 bytes
+    m_NextPos = m_CurPos + 3;
+    return true;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// MPEG2 start code values (the byte following 00 00 01)
+enum MPEG2_START_CODE
+{
+    MPEG2_PICTURE_START_CODE    = 0x00,
+    MPEG2_SLICE_START_CODE_MIN  = 0x01,
+    MPEG2_SLICE_START_CODE_MAX  = 0xAF,
+    MPEG2_USER_DATA_START_CODE  = 0xB2,
+    MPEG2_SEQUENCE_HEADER_CODE  = 0xB3,
+    MPEG2_EXTENSION_START_CODE  = 0xB5,
+    MPEG2_SEQUENCE_END_CODE     = 0xB7,
+    MPEG2_GROUP_START_CODE      = 0xB8
+};
+
+// extension_start_code_identifier values
+enum MPEG2_EXTENSION_ID
+{
+    MPEG2_SEQUENCE_EXTENSION_ID         = 1,
+    MPEG2_SEQUENCE_DISPLAY_EXTENSION_ID = 2,
+    MPEG2_PICTURE_CODING_EXTENSION_ID   = 8
+};
+
+// picture_structure values
+enum MPEG2_PICTURE_STRUCTURE
+{
+    MPEG2_TOP_FIELD     = 1,
+    MPEG2_BOTTOM_FIELD  = 2,
+    MPEG2_FRAME_PICTURE = 3
+};
+
+// Iterates over the start codes (00 00 01 XX) of an MPEG2 elementary stream.
+// Works for any stream using 3 byte start codes (e.g. H264 AnnexB).
+class MPEG2_StartCodeIterator
+{
+public:
+    MPEG2_StartCodeIterator(const uint8_t* pBuffer, size_t bufSize, size_t startPos = 0);
+
+    // Moves to the next complete start code. Returns false when there are no more start codes.
+    // On failure, GetPosition returns the position where the search should be resumed once more data is available.
+    bool Next();
+
+    uint8_t        GetStartCode() const { return m_pBuffer[m_CurPos + 3]; }
+    size_t         GetPosition() const { return m_CurPos; }
+    const uint8_t* GetBuffer() const { return m_pBuffer + m_CurPos; }
+    size_t         GetBufferLength() const { return m_BufSize - m_CurPos; } // Data available from the current start code
+
+private:
+    // No copying supported!
+    MPEG2_StartCodeIterator(const MPEG2_StartCodeIterator&);
+    MPEG2_StartCodeIterator& operator=(const MPEG2_StartCodeIterator&);
+
+    // data members
+    const uint8_t* m_pBuffer;
+    const size_t   m_BufSize;
+    size_t         m_CurPos;
+    size_t         m_NextPos;
+};
@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "MPEG2PsDemux.h"
+#include "MPEG2TsDemux.h"
+
+// stream_type values (ISO/IEC 13818-1 table 2-34)
+enum
+{
+    TS_STREAM_TYPE_MPEG1_VIDEO = 0x01,
+    TS_STREAM_TYPE_MPEG2_VIDEO = 0x02,
+    TS_STREAM_TYPE_H264        = 0x1B
+};
+
+CMPEG2TsDemuxer::CMPEG2TsDemuxer() :
+    m_CodecId(0),
+    m_nPmtPid(-1),
+    m_nVideoPid(-1)
+{
+    Reset();
+}
+
+void CMPEG2TsDemuxer::Reset()
+{
+    // The PIDs are kept - PAT/PMT are not repeated right after a seek
+    m_pData = m_pEnd = NULL;
+    m_nPacketSize = 0;
+    m_nSectionPid = -1;
+    m_Section.clear();
+    SetVideoPid(m_nVideoPid);
+}
+
+void CMPEG2TsDemuxer::SetVideoPid(int pid)
+{
+    m_nVideoPid = pid;
+    m_nContinuityCounter = -1;
+    m_bInPes = false;
+    m_bPesHeaderPending = false;
+    m_nPesHeaderSize = 0;
+    m_PendingPts = -1;
+}
+
+void CMPEG2TsDemuxer::SetData(const uint8_t* pData, size_t nSize)
+{
+    ASSERT(m_pData == m_pEnd);
+    m_pData = pData;
+    m_pEnd = pData + nSize;
+}
+
+const uint8_t* CMPEG2TsDemuxer::FindSyncByte(const uint8_t* p, const uint8_t* pEnd)
+{
+    // SSE2 - checks 16 positions per iteration
+    const __m128i sync = _mm_set1_epi8(TS_SYNC_BYTE);
+    while (p + 2 * TS_PACKET_SIZE + 16 <= pEnd)
+    {
+        __m128i b0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p)), sync);
+        __m128i b1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + TS_PACKET_SIZE)), sync);
+        __m128i b2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 2 * TS_PACKET_SIZE)), sync);
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(b0, b1), b2));
+        if (mask)
+        {
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return p + index;
+        }
+
+        p += 16;
+    }
+
+    // Tail - only the packets that are available are checked
+    for (; p < pEnd; ++p)
+    {
+        if (TS_SYNC_BYTE == p[0] &&
+            (p + TS_PACKET_SIZE >= pEnd || TS_SYNC_BYTE == p[TS_PACKET_SIZE]) &&
+            (p + 2 * TS_PACKET_SIZE >= pEnd || TS_SYNC_BYTE == p[2 * TS_PACKET_SIZE]))
+        {
+            return p;
+        }
+    }
+
+    return pEnd;
+}
+
+const uint8_t* CMPEG2TsDemuxer::NextPacket()
+{
+    // Complete the packet left from the previous sample
+    if (m_nPacketSize > 0)
+    {
+        size_t nCopy = min((size_t)TS_PACKET_SIZE - m_nPacketSize, (size_t)(m_pEnd - m_pData));
+        memcpy(m_Packet + m_nPacketSize, m_pData, nCopy);
+        m_nPacketSize += nCopy;
+        m_pData += nCopy;
+        if (m_nPacketSize < TS_PACKET_SIZE)
+            return NULL;
+
+        m_nPacketSize = 0;
+        return m_Packet;
+    }
+
+    if (m_pData == m_pEnd)
+        return NULL;
+
+    // Packets follow each other - the search only runs after a loss of sync
+    if (TS_SYNC_BYTE != *m_pData)
+    {
+        const uint8_t* p = FindSyncByte(m_pData, m_pEnd);
+        MSDK_TRACE("QsDecoder: TS demuxer lost sync, skipped %u bytes\n", (unsigned)(p - m_pData));
+        m_pData = p;
+        if (m_pData == m_pEnd)
+            return NULL;
+    }
+
+    if (m_pEnd - m_pData < TS_PACKET_SIZE)
+    {
+        m_nPacketSize = m_pEnd - m_pData;
+        memcpy(m_Packet, m_pData, m_nPacketSize);
+        m_pData = m_pEnd;
+        return NULL;
+    }
+
+    const uint8_t* pPacket = m_pData;
+    m_pData += TS_PACKET_SIZE;
+    return pPacket;
+}
+
+bool CMPEG2TsDemuxer::GetNextPayload(const uint8_t*& pPayload, size_t& nSize, int64_t& pts)
+{
+    const uint8_t* pPacket;
+    while (NULL != (pPacket = NextPacket()))
+    {
+        if (ProcessPacket(pPacket, pPayload, nSize, pts))
+            return true;
+    }
+
+    return false;
+}
+
+bool CMPEG2TsDemuxer::ProcessPacket(const uint8_t* p, const uint8_t*& pPayload, size_t& nSize, int64_t& pts)
+{
+    const bool bError = (p[1] & 0x80) != 0;      // transport_error_indicator
+    const bool bUnitStart = (p[1] & 0x40) != 0;  // payload_unit_start_indicator
+    const int pid = ((p[1] & 0x1F) << 8) | p[2];
+    const int adaptationFieldControl = (p[3] >> 4) & 3;
+    const int continuityCounter = p[3] & 0x0F;
+    const bool bVideo = (pid == m_nVideoPid);
+
+    if (bError)
+    {
+        // The rest of the PES packet is lost
+        if (bVideo)
+            m_bInPes = m_bPesHeaderPending = false;
+
+        return false;
+    }
+
+    size_t nOffset = 4;
+    bool bDiscontinuity = false;
+    if (adaptationFieldControl & 2)
+    {
+        const size_t nAdaptationFieldLength = p[4];
+        bDiscontinuity = nAdaptationFieldLength > 0 && (p[5] & 0x80) != 0; // discontinuity_indicator
+        nOffset += 1 + nAdaptationFieldLength;
+        if (nOffset > TS_PACKET_SIZE)
+            return false;
+    }
+
+    // No payload
+    if (!(adaptationFieldControl & 1))
+        return false;
+
+    const uint8_t* pData = p + nOffset;
+    const size_t nDataSize = TS_PACKET_SIZE - nOffset;
+    if (bVideo)
+    {
+        if (m_nContinuityCounter >= 0 && !bDiscontinuity)
+        {
+            // Duplicate packet
+            if (continuityCounter == m_nContinuityCounter)
+                return false;
+
+            // Lost packets - the rest of the PES packet is useless
+            if (continuityCounter != ((m_nContinuityCounter + 1) & 0x0F))
+            {
+                MSDK_TRACE("QsDecoder: TS demuxer detected a continuity error\n");
+                m_bInPes = m_bPesHeaderPending = false;
+            }
+        }
+
+        m_nContinuityCounter = continuityCounter;
+        return ProcessVideoPayload(pData, nDataSize, bUnitStart, pPayload, nSize, pts);
+    }
+
+    if (0 == pid || pid == m_nPmtPid)
+    {
+        ProcessSection(pData, nDataSize, bUnitStart, pid);
+    }
+
+    return false;
+}
+
+bool CMPEG2TsDemuxer::ProcessVideoPayload(const uint8_t* pData, size_t nSize, bool bUnitStart,
+                                          const uint8_t*& pPayload, size_t& nPayloadSize, int64_t& pts)
+{
+    if (bUnitStart)
+    {
+        m_bInPes = false;
+        m_bPesHeaderPending = true;
+        m_nPesHeaderSize = 0;
+        m_PendingPts = -1;
+    }
+
+    if (m_bPesHeaderPending)
+    {
+        // The PES header is usually found in a single packet. It's copied only when it isn't.
+        const uint8_t* pHeader = pData;
+        size_t nAvailable = nSize;
+        if (m_nPesHeaderSize > 0)
+        {
+            size_t nCopy = min((size_t)MAX_PES_HEADER_SIZE - m_nPesHeaderSize, nSize);
+            memcpy(m_PesHeader + m_nPesHeaderSize, pData, nCopy);
+            pHeader = m_PesHeader;
+            nAvailable = m_nPesHeaderSize + nCopy;
+        }
+
+        // packet_start_code_prefix and MPEG2 PES syntax
+        if ((nAvailable >= 3 && (pHeader[0] != 0 || pHeader[1] != 0 || pHeader[2] != 1)) ||
+            (nAvailable >= 7 && (pHeader[6] & 0xC0) != 0x80))
+        {
+            m_bPesHeaderPending = false;
+            m_nPesHeaderSize = 0;
+            return false;
+        }
+
+        size_t nHeaderSize = (nAvailable >= 9) ? 9 + (size_t)pHeader[8] : 0;
+        if (0 == nHeaderSize || nAvailable < nHeaderSize)
+        {
+            // Keep the beginning of the header for the next packet
+            if (pHeader == pData)
+            {
+                memcpy(m_PesHeader, pData, nAvailable);
+            }
+
+            m_nPesHeaderSize = nAvailable;
+            return false;
+        }
+
+        // PTS_DTS_flags. The DTS isn't needed - output time stamps are derived from the PTS.
+        if ((pHeader[7] & 0x80) && pHeader[8] >= 5)
+        {
+            m_PendingPts = ReadPesTimeStamp(pHeader + 9);
+        }
+
+        // Skip the part of the header found in this packet
+        size_t nUsed = nHeaderSize - ((pHeader == m_PesHeader) ? m_nPesHeaderSize : 0);
+        pData += nUsed;
+        nSize -= nUsed;
+        m_bPesHeaderPending = false;
+        m_nPesHeaderSize = 0;
+        m_bInPes = true;
+    }
+
+    if (!m_bInPes || 0 == nSize)
+        return false;
+
+    pPayload = pData;
+    nPayloadSize = nSize;
+    pts = m_PendingPts;
+    m_PendingPts = -1;
+    return true;
+}
+
+void CMPEG2TsDemuxer::ProcessSection(const uint8_t* pData, size_t nSize, bool bUnitStart, int pid)
+{
+    if (bUnitStart)
+    {
+        // pointer_field - the section starts after it
+        size_t nPointer = 1 + pData[0];
+        if (nPointer >= nSize)
+            return;
+
+        m_Section.assign(pData + nPointer, pData + nSize);
+        m_nSectionPid = pid;
+    }
+    else if (pid == m_nSectionPid && !m_Section.empty())
+    {
+        m_Section.insert(m_Section.end(), pData, pData + nSize);
+    }
+    else
+    {
+        return;
+    }
+
+    if (m_Section.size() < 3)
+        return;
+
+    size_t nSectionSize = 3 + ((((size_t)m_Section[1] & 0x0F) << 8) | m_Section[2]);
+    if (nSectionSize > MAX_SECTION_SIZE || nSectionSize < 12)
+    {
+        m_Section.clear();
+        return;
+    }
+
+    // Wait for the rest of the section
+    if (m_Section.size() < nSectionSize)
+        return;
+
+    // Only the current version of the tables is used (current_next_indicator)
+    if (m_Section[5] & 1)
+    {
+        if (0 == pid)
+            ParsePAT(&m_Section[0], nSectionSize);
+        else
+            ParsePMT(&m_Section[0], nSectionSize);
+    }
+
+    m_Section.clear();
+}
+
+void CMPEG2TsDemuxer::ParsePAT(const uint8_t* pSection, size_t nSize)
+{
+    // table_id 0 - program_association_section
+    if (pSection[0] != 0)
+        return;
+
+    // Program loop between the 8 byte header and the CRC
+    for (size_t i = 8; i + 4 <= nSize - 4; i += 4)
+    {
+        int programNumber = (pSection[i] << 8) | pSection[i + 1];
+        int pid = ((pSection[i + 2] & 0x1F) << 8) | pSection[i + 3];
+
+        // Program 0 is the network PID
+        if (0 == programNumber)
+            continue;
+
+        if (pid != m_nPmtPid)
+        {
+            MSDK_TRACE("QsDecoder: TS demuxer - PMT PID is %d\n", pid);
+            m_nPmtPid = pid;
+            SetVideoPid(-1);
+        }
+
+        break;
+    }
+}
+
+void CMPEG2TsDemuxer::ParsePMT(const uint8_t* pSection, size_t nSize)
+{
+    // table_id 2 - TS_program_map_section
+    if (pSection[0] != 2)
+        return;
+
+    size_t nProgramInfoLength = ((pSection[10] & 0x0F) << 8) | pSection[11];
+
+    // Elementary stream loop between the program info and the CRC
+    for (size_t i = 12 + nProgramInfoLength; i + 5 <= nSize - 4;)
+    {
+        uint8_t streamType = pSection[i];
+        int pid = ((pSection[i + 1] & 0x1F) << 8) | pSection[i + 2];
+        size_t nInfoLength = ((pSection[i + 3] & 0x0F) << 8) | pSection[i + 4];
+        if (IsVideoStreamType(streamType))
+        {
+            if (pid != m_nVideoPid)
+            {
+                MSDK_TRACE("QsDecoder: TS demuxer - video PID is %d (stream type 0x%02X)\n", pid, streamType);
+                SetVideoPid(pid);
+            }
+
+            return;
+        }
+
+        i += 5 + nInfoLength;
+    }
+}
+
+bool CMPEG2TsDemuxer::IsVideoStreamType(uint8_t streamType) const
+{
+    switch (streamType)
+    {
+    case TS_STREAM_TYPE_MPEG1_VIDEO:
+    case TS_STREAM_TYPE_MPEG2_VIDEO:
+        return 0 == m_CodecId || MFX_CODEC_MPEG2 == m_CodecId;
+
+    case TS_STREAM_TYPE_H264:
+        return 0 == m_CodecId || MFX_CODEC_AVC == m_CodecId;
+
+    default:
+        return false;
+    }
+}
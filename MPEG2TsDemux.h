@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Extracts the video elementary stream from an MPEG2 transport stream.
+// The video PID is the first video stream of the first program in the PAT/PMT.
+// Samples may hold any number of 188 byte packets, including partial packets.
+// Payloads are returned as pointers into the sample - only packets split between samples are copied.
+class CMPEG2TsDemuxer : public IStreamDemuxer
+{
+public:
+    CMPEG2TsDemuxer();
+    void Reset(); // Drops buffered data
+    void SetData(const uint8_t* pData, size_t nSize);
+    bool GetNextPayload(const uint8_t*& pPayload, size_t& nSize, int64_t& pts);
+
+    // Only video streams of this codec are selected (MFX_CODEC_*, 0 - any)
+    void SetCodec(mfxU32 codecId) { m_CodecId = codecId; }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CMPEG2TsDemuxer);
+
+    enum
+    {
+        TS_PACKET_SIZE      = 188,
+        TS_SYNC_BYTE        = 0x47,
+        MAX_SECTION_SIZE    = 1024,     // PAT and PMT sections (section_length is limited to 1021)
+        MAX_PES_HEADER_SIZE = 9 + 255
+    };
+
+    // Returns the next complete packet or NULL when the sample is consumed
+    const uint8_t* NextPacket();
+
+    // Returns the video payload of a packet
+    bool ProcessPacket(const uint8_t* pPacket, const uint8_t*& pPayload, size_t& nSize, int64_t& pts);
+    bool ProcessVideoPayload(const uint8_t* pData, size_t nSize, bool bUnitStart, const uint8_t*& pPayload, size_t& nPayloadSize, int64_t& pts);
+    void ProcessSection(const uint8_t* pData, size_t nSize, bool bUnitStart, int pid);
+    void ParsePAT(const uint8_t* pSection, size_t nSize);
+    void ParsePMT(const uint8_t* pSection, size_t nSize);
+    bool IsVideoStreamType(uint8_t streamType) const;
+    void SetVideoPid(int pid);
+
+    // Finds a sync byte followed by sync bytes one and two packets ahead (as far as the data goes)
+    static const uint8_t* FindSyncByte(const uint8_t* p, const uint8_t* pEnd);
+
+    const uint8_t* m_pData;              // Unconsumed part of the current sample
+    const uint8_t* m_pEnd;
+    mfxU32   m_CodecId;
+    uint8_t  m_Packet[TS_PACKET_SIZE];   // Packet split between samples
+    size_t   m_nPacketSize;
+    int      m_nPmtPid;                  // -1 until found in the PAT
+    int      m_nVideoPid;                // -1 until found in the PMT
+    int      m_nContinuityCounter;       // Of the video PID (-1 - unknown)
+    std::vector<uint8_t> m_Section;      // PSI section being assembled
+    int      m_nSectionPid;
+    bool     m_bInPes;                   // Video payloads belong to a valid PES packet
+    uint8_t  m_PesHeader[MAX_PES_HEADER_SIZE]; // PES header split between packets
+    size_t   m_nPesHeaderSize;
+    bool     m_bPesHeaderPending;        // A PES packet started and its header is incomplete
+    int64_t  m_PendingPts;               // PTS of the current PES - returned with its first payload
+};
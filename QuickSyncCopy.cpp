@@ -0,0 +1,1178 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "stdafx.h"
+#include "IQuickSyncDecoder.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "QuickSyncCopy.h"
+
+#define COPY_CALIBRATION_ROUNDS   3          // Samples of each kernel - the fastest sample counts
+#define COPY_CALIBRATION_MIN_SIZE (1 << 16)  // Smaller copies are dominated by fixed costs
+#define COPY_CALIBRATION_MAX_WAIT 4          // Calibration ends after this many rounds even when some kernels were never measured
+
+enum
+{
+    COPY_CPU_ANY,
+    COPY_CPU_SSE41,
+    COPY_CPU_AVX2,
+    COPY_CPU_AVX512
+};
+
+static bool s_CopyCpuSupport[] =
+{
+    true,
+    IsSSE41Enabled(),
+    IsAVX2Enabled(),
+    IsAVX512Enabled()
+};
+
+// Copies the bytes that don't fill a whole loop iteration - 16 bytes at a time, then the last bytes.
+// Reading all 16 bytes of the last block is safe as it doesn't cross a page.
+static __forceinline void CopyTailSSE41(__m128i* pTrg, __m128i* pSrc, size_t size)
+{
+    size_t end = size >> 4;
+    for (size_t i = 0; i < end; ++i)
+    {
+        _mm_store_si128(pTrg + i, _mm_stream_load_si128(pSrc + i));
+    }
+
+    size_t reminder = size & 15;
+    if (reminder)
+    {
+        __m128i temp = _mm_stream_load_si128(pSrc + end);
+        memcpy(pTrg + end, &temp, reminder);
+    }
+}
+
+template <bool bStream> static __forceinline void StoreSSE41(__m128i* p, __m128i r);
+template <> __forceinline void StoreSSE41<false>(__m128i* p, __m128i r) { _mm_store_si128(p, r); }
+template <> __forceinline void StoreSSE41<true>(__m128i* p, __m128i r)  { _mm_stream_si128(p, r); }
+
+// MOVNTDQA (SSE4.1) loads. Available since Penryn (45nm Core 2 Duo/Quad).
+template <int nRegs, bool bStream>
+static void* CopySSE41(void* d, const void* s, size_t size)
+{
+    if (d == NULL || s == NULL) return NULL;
+
+    // If memory is not aligned, use memcpy
+    if ((((size_t)s | (size_t)d) & 0xF) != 0)
+    {
+        return memcpy(d, s, size);
+    }
+
+    __m128i* pTrg = (__m128i*)d;
+    __m128i* pSrc = (__m128i*)s;
+    __m128i* pTrgEnd = pTrg + (size / (nRegs * sizeof(__m128i))) * nRegs;
+
+    // Make sure source is synced - doesn't hurt if not needed.
+    _mm_sfence();
+
+    while (pTrg < pTrgEnd)
+    {
+        __m128i regs[nRegs];
+        for (int i = 0; i < nRegs; ++i)
+        {
+            regs[i] = _mm_stream_load_si128(pSrc + i);
+        }
+
+        for (int i = 0; i < nRegs; ++i)
+        {
+            StoreSSE41<bStream>(pTrg + i, regs[i]);
+        }
+
+        pSrc += nRegs;
+        pTrg += nRegs;
+    }
+
+    CopyTailSSE41(pTrg, pSrc, size & (nRegs * sizeof(__m128i) - 1));
+
+    // Non-temporal stores must be visible before the buffer is used
+    _mm_sfence();
+    return d;
+}
+
+#if defined (AVX2_ENABLED)
+template <bool bStream> static __forceinline void StoreAVX2(__m256i* p, __m256i r);
+template <> __forceinline void StoreAVX2<false>(__m256i* p, __m256i r) { _mm256_store_si256(p, r); }
+template <> __forceinline void StoreAVX2<true>(__m256i* p, __m256i r)  { _mm256_stream_si256(p, r); }
+
+// VMOVNTDQA (AVX2) loads. Available since Haswell (22nm, 4th Generation Core).
+template <int nRegs, bool bStream>
+static void* CopyAVX2(void* d, const void* s, size_t size)
+{
+    if (d == NULL || s == NULL) return NULL;
+
+    if ((((size_t)s | (size_t)d) & 0x1F) != 0)
+    {
+        return CopySSE41<4, bStream>(d, s, size);
+    }
+
+    __m256i* pTrg = (__m256i*)d;
+    __m256i* pSrc = (__m256i*)s;
+    __m256i* pTrgEnd = pTrg + (size / (nRegs * sizeof(__m256i))) * nRegs;
+
+    _mm_sfence();
+
+    while (pTrg < pTrgEnd)
+    {
+        __m256i regs[nRegs];
+        for (int i = 0; i < nRegs; ++i)
+        {
+            regs[i] = _mm256_stream_load_si256(pSrc + i);
+        }
+
+        for (int i = 0; i < nRegs; ++i)
+        {
+            StoreAVX2<bStream>(pTrg + i, regs[i]);
+        }
+
+        pSrc += nRegs;
+        pTrg += nRegs;
+    }
+
+    // Avoid AVX-SSE transition penalties in the SSE tail
+    _mm256_zeroupper();
+    CopyTailSSE41((__m128i*)pTrg, (__m128i*)pSrc, size & (nRegs * sizeof(__m256i) - 1));
+    _mm_sfence();
+    return d;
+}
+#endif
+
+#if defined (AVX512_ENABLED)
+template <bool bStream> static __forceinline void StoreAVX512(__m512i* p, __m512i r);
+template <> __forceinline void StoreAVX512<false>(__m512i* p, __m512i r) { _mm512_store_si512(p, r); }
+template <> __forceinline void StoreAVX512<true>(__m512i* p, __m512i r)  { _mm512_stream_si512(p, r); }
+
+// VMOVNTDQA (AVX-512F) loads. Available since Skylake-SP and Ice Lake.
+template <int nRegs, bool bStream>
+static void* CopyAVX512(void* d, const void* s, size_t size)
+{
+    if (d == NULL || s == NULL) return NULL;
+
+    if ((((size_t)s | (size_t)d) & 0x3F) != 0)
+    {
+        return CopySSE41<4, bStream>(d, s, size);
+    }
+
+    __m512i* pTrg = (__m512i*)d;
+    __m512i* pSrc = (__m512i*)s;
+    __m512i* pTrgEnd = pTrg + (size / (nRegs * sizeof(__m512i))) * nRegs;
+
+    _mm_sfence();
+
+    while (pTrg < pTrgEnd)
+    {
+        __m512i regs[nRegs];
+        for (int i = 0; i < nRegs; ++i)
+        {
+            regs[i] = _mm512_stream_load_si512(pSrc + i);
+        }
+
+        for (int i = 0; i < nRegs; ++i)
+        {
+            StoreAVX512<bStream>(pTrg + i, regs[i]);
+        }
+
+        pSrc += nRegs;
+        pTrg += nRegs;
+    }
+
+    // Clears the upper ZMM bits as well
+    _mm256_zeroupper();
+    CopyTailSSE41((__m128i*)pTrg, (__m128i*)pSrc, size & (nRegs * sizeof(__m512i) - 1));
+    _mm_sfence();
+    return d;
+}
+#endif
+
+#if defined (AVX2_ENABLED)
+#   define COPY_AVX2(N, STREAM) CopyAVX2<N, STREAM>
+#else
+#   define COPY_AVX2(N, STREAM) NULL
+#endif
+
+#if defined (AVX512_ENABLED)
+#   define COPY_AVX512(N, STREAM) CopyAVX512<N, STREAM>
+#else
+#   define COPY_AVX512(N, STREAM) NULL
+#endif
+
+// Indexed by QsCopyKernel. Kernels without a function weren't built by this compiler.
+static const struct
+{
+    const char* name;
+    Tmemcpy     func;
+    int         cpu;
+    size_t      alignment; // The kernel falls back to a narrower one for less aligned buffers
+} s_Kernels[QS_COPY_KERNEL_COUNT] =
+{
+    { "auto",              NULL,                        COPY_CPU_ANY,     0 },
+    { "memcpy",            memcpy,                      COPY_CPU_ANY,     1 },
+    { "sse4.1 legacy",     gpu_memcpy_sse41,            COPY_CPU_ANY,     16 }, // Falls back to memcpy without SSE4.1
+    { "sse4.1 store x2",   CopySSE41<2, false>,         COPY_CPU_SSE41,   16 },
+    { "sse4.1 store x4",   CopySSE41<4, false>,         COPY_CPU_SSE41,   16 },
+    { "sse4.1 store x8",   CopySSE41<8, false>,         COPY_CPU_SSE41,   16 },
+    { "sse4.1 stream x4",  CopySSE41<4, true>,          COPY_CPU_SSE41,   16 },
+    { "sse4.1 stream x8",  CopySSE41<8, true>,          COPY_CPU_SSE41,   16 },
+    { "avx2 store x2",     COPY_AVX2(2, false),         COPY_CPU_AVX2,    32 },
+    { "avx2 store x4",     COPY_AVX2(4, false),         COPY_CPU_AVX2,    32 },
+    { "avx2 stream x4",    COPY_AVX2(4, true),          COPY_CPU_AVX2,    32 },
+    { "avx512 store x2",   COPY_AVX512(2, false),       COPY_CPU_AVX512,  64 },
+    { "avx512 store x4",   COPY_AVX512(4, false),       COPY_CPU_AVX512,  64 },
+    { "avx512 stream x4",  COPY_AVX512(4, true),        COPY_CPU_AVX512,  64 }
+};
+
+// Constructed when the DLL is loaded - function local statics aren't thread safe with older compilers
+CQsCopyKernels CQsCopyKernels::s_Instance;
+
+CQsCopyKernels& CQsCopyKernels::Instance()
+{
+    return s_Instance;
+}
+
+CQsCopyKernels::CQsCopyKernels() :
+    m_nNextSample(0),
+    m_Selected(QS_COPY_AUTO),
+    m_pSelectedFunc(NULL)
+{
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    m_Frequency = freq.QuadPart;
+
+    MSDK_ZERO_VAR(m_BestCost);
+    MSDK_ZERO_VAR(m_nSampleCount);
+
+    // memcpy is never a candidate - it's several times slower on video memory
+    for (int i = QS_COPY_SSE41_LEGACY; i < QS_COPY_KERNEL_COUNT; ++i)
+    {
+        if (IsSupported((QsCopyKernel)i))
+        {
+            m_Candidates.push_back((QsCopyKernel)i);
+        }
+    }
+
+    // Nothing to choose from (no SSE4.1)
+    if (m_Candidates.size() == 1)
+    {
+        SelectFastest();
+    }
+}
+
+bool CQsCopyKernels::IsSupported(QsCopyKernel kernel) const
+{
+    return kernel > QS_COPY_AUTO && kernel < QS_COPY_KERNEL_COUNT &&
+        NULL != s_Kernels[kernel].func && s_CopyCpuSupport[s_Kernels[kernel].cpu];
+}
+
+const char* CQsCopyKernels::GetName(QsCopyKernel kernel)
+{
+    return (kernel >= QS_COPY_AUTO && kernel < QS_COPY_KERNEL_COUNT) ? s_Kernels[kernel].name : "unknown";
+}
+
+Tmemcpy CQsCopyKernels::GetCopyFunc(QsCopyKernel kernel)
+{
+    return (IsSupported(kernel)) ? s_Kernels[kernel].func : gpu_memcpy;
+}
+
+void* CQsCopyKernels::Calibrate(void* d, const void* s, size_t size)
+{
+    // Small copies say little about a kernel's throughput
+    if (size < COPY_CALIBRATION_MIN_SIZE)
+    {
+        return gpu_memcpy_sse41(d, s, size);
+    }
+
+    LONG nSample = InterlockedIncrement(&m_nNextSample) - 1;
+    QsCopyKernel kernel = m_Candidates[nSample % m_Candidates.size()];
+
+    // A kernel that would fall back to a narrower one isn't measured
+    if ((((size_t)s | (size_t)d) & (s_Kernels[kernel].alignment - 1)) != 0)
+    {
+        kernel = QS_COPY_AUTO;
+    }
+
+    LARGE_INTEGER start, stop;
+    QueryPerformanceCounter(&start);
+    (QS_COPY_AUTO != kernel) ? s_Kernels[kernel].func(d, s, size) : gpu_memcpy_sse41(d, s, size);
+    QueryPerformanceCounter(&stop);
+
+    CQsAutoLock cObjectLock(&m_csLock);
+
+    // Another thread completed the calibration
+    if (NULL != m_pSelectedFunc)
+        return d;
+
+    if (QS_COPY_AUTO != kernel)
+    {
+        double cost = (double)(stop.QuadPart - start.QuadPart) * (1 << 20) / (double)size;
+        if (0 == m_nSampleCount[kernel] || cost < m_BestCost[kernel])
+        {
+            m_BestCost[kernel] = cost;
+        }
+
+        ++m_nSampleCount[kernel];
+    }
+
+    bool bDone = true;
+    for (size_t i = 0; i < m_Candidates.size(); ++i)
+    {
+        bDone = bDone && m_nSampleCount[m_Candidates[i]] >= COPY_CALIBRATION_ROUNDS;
+    }
+
+    if (bDone || (size_t)nSample >= COPY_CALIBRATION_MAX_WAIT * COPY_CALIBRATION_ROUNDS * m_Candidates.size())
+    {
+        SelectFastest();
+    }
+
+    return d;
+}
+
+void CQsCopyKernels::SelectFastest()
+{
+    // The legacy kernel is the default when no kernel was measured
+    QsCopyKernel best = QS_COPY_SSE41_LEGACY;
+    for (size_t i = 0; i < m_Candidates.size(); ++i)
+    {
+        QsCopyKernel kernel = m_Candidates[i];
+        if (m_nSampleCount[kernel] > 0 &&
+            (0 == m_nSampleCount[best] || m_BestCost[kernel] < m_BestCost[best]))
+        {
+            best = kernel;
+        }
+    }
+
+    MSDK_TRACE("QsDecoder: copy kernel \"%s\" was selected (%.0f MB/s)\n", GetName(best),
+        (m_BestCost[best] > 0) ? m_Frequency / m_BestCost[best] : 0.0);
+
+    m_Selected = best;
+    m_pSelectedFunc = s_Kernels[best].func;
+}
+
+void* gpu_memcpy(void* d, const void* s, size_t size)
+{
+    return CQsCopyKernels::Instance().Copy(d, s, size);
+}
+
+// AVX2 kernel when supported
+void* gpu_memcpy_avx2(void* d, const void* s, size_t size)
+{
+    return CQsCopyKernels::Instance().GetCopyFunc(QS_COPY_AVX2_STORE_X4)(d, s, size);
+}
+
+////////////////////////////////////////////////////////////////////
+//                      CQsCopyThreadPool
+////////////////////////////////////////////////////////////////////
+#define COPY_POOL_DEFAULT_WAYS      4          // Default split of a job - workers and the calling thread
+#define COPY_POOL_BANDS_PER_THREAD  4          // Smaller bands balance the work when a thread is late
+#define COPY_POOL_MIN_BAND          (1 << 16)  // Smaller bands don't pay for waking a worker
+#define COPY_POOL_CACHE_LINE        64
+#define COPY_POOL_SPIN_COUNT        4000       // Spins before the calling thread yields its time slice
+
+CQsCopyThreadPool CQsCopyThreadPool::s_Instance;
+
+CQsCopyThreadPool& CQsCopyThreadPool::Instance()
+{
+    return s_Instance;
+}
+
+CQsCopyThreadPool::CQsCopyThreadPool() :
+    m_bRunning(false),
+    m_bExit(false),
+    m_nRunningThreads(0),
+    m_nThreads(0),
+    m_AffinityMask(0),
+    m_nUsers(0)
+{
+    m_hWork = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+}
+
+CQsCopyThreadPool::~CQsCopyThreadPool()
+{
+    // The last decoder stopped the threads
+    ASSERT(m_Threads.empty());
+    CloseHandle(m_hWork);
+}
+
+void CQsCopyThreadPool::Attach()
+{
+    CQsAutoLock lock(&m_csThreadsLock);
+    ++m_nUsers;
+}
+
+void CQsCopyThreadPool::Detach()
+{
+    CQsAutoLock lock(&m_csThreadsLock);
+    ASSERT(m_nUsers > 0);
+    if (--m_nUsers == 0)
+    {
+        StopThreads();
+    }
+}
+
+void CQsCopyThreadPool::Configure(unsigned nThreads, DWORD_PTR affinityMask)
+{
+    CQsAutoLock lock(&m_csThreadsLock);
+    m_nThreads = nThreads;
+    m_AffinityMask = affinityMask;
+
+    // Restarted by the next job
+    StopThreads();
+}
+
+// Returns the nth core of the mask (round robin)
+static DWORD_PTR GetAffinityCore(DWORD_PTR mask, unsigned n)
+{
+    unsigned nCores = 0;
+    for (DWORD_PTR bit = 1; bit != 0; bit <<= 1)
+    {
+        nCores += (mask & bit) ? 1 : 0;
+    }
+
+    n %= nCores;
+    for (DWORD_PTR bit = 1; bit != 0; bit <<= 1)
+    {
+        if ((mask & bit) && 0 == n--)
+            return bit;
+    }
+
+    return 0;
+}
+
+void CQsCopyThreadPool::StartThreads()
+{
+    CQsAutoLock lock(&m_csThreadsLock);
+    if (m_bRunning || 0 == m_nUsers)
+        return;
+
+    unsigned nThreads = m_nThreads;
+    if (0 == nThreads)
+    {
+        SYSTEM_INFO sysInfo;
+        GetSystemInfo(&sysInfo);
+        nThreads = min((unsigned)sysInfo.dwNumberOfProcessors, COPY_POOL_DEFAULT_WAYS) - 1;
+    }
+
+    m_bExit = false;
+    for (unsigned i = 0; i < nThreads; ++i)
+    {
+        HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, &WorkerThreadProc, this, 0, NULL);
+        if (NULL == hThread)
+            break;
+
+        if (m_AffinityMask)
+        {
+            SetThreadAffinityMask(hThread, GetAffinityCore(m_AffinityMask, i));
+        }
+
+        m_Threads.push_back(hThread);
+    }
+
+    MSDK_TRACE("QsDecoder: copy thread pool started %u threads\n", (unsigned)m_Threads.size());
+    m_nRunningThreads = (LONG)m_Threads.size();
+    m_bRunning = true;
+}
+
+void CQsCopyThreadPool::StopThreads()
+{
+    CQsAutoLock lock(&m_csThreadsLock);
+    if (!m_bRunning)
+        return;
+
+    // New jobs run on their calling thread
+    m_nRunningThreads = 0;
+    {
+        CQsAutoLock jobLock(&m_csLock);
+        m_bExit = true;
+    }
+
+    // Workers finish their current band and exit
+    if (!m_Threads.empty())
+    {
+        ReleaseSemaphore(m_hWork, (LONG)m_Threads.size(), NULL);
+    }
+
+    for (size_t i = 0; i < m_Threads.size(); ++i)
+    {
+        WaitForSingleObject(m_Threads[i], INFINITE);
+        CloseHandle(m_Threads[i]);
+    }
+
+    m_Threads.clear();
+    m_bRunning = false;
+}
+
+void CQsCopyThreadPool::RunBands(TJob& job)
+{
+    for (;;)
+    {
+        LONG nBand = InterlockedIncrement(&job.nNextBand) - 1;
+        if (nBand >= job.nBands)
+            break;
+
+        job.func(job.pContext, nBand);
+    }
+}
+
+void CQsCopyThreadPool::Run(size_t nBands, TBandFunc func, void* pContext)
+{
+    TJob job = { func, pContext, (LONG)nBands, 0, 0 };
+    if (nBands > 1 && !m_bRunning)
+    {
+        StartThreads();
+    }
+
+    LONG nWake = min((LONG)nBands - 1, m_nRunningThreads);
+    if (nWake <= 0)
+    {
+        RunBands(job);
+        return;
+    }
+
+    {
+        CQsAutoLock lock(&m_csLock);
+        m_Jobs.push_back(&job);
+    }
+
+    ReleaseSemaphore(m_hWork, nWake, NULL);
+    RunBands(job);
+
+    // No worker can join once the job left the queue
+    {
+        CQsAutoLock lock(&m_csLock);
+        auto it = std::find(m_Jobs.begin(), m_Jobs.end(), &job);
+        if (it != m_Jobs.end())
+        {
+            m_Jobs.erase(it);
+        }
+    }
+
+    // Workers that joined are finishing their last band
+    for (unsigned nSpins = 0; job.nWorkers > 0; ++nSpins)
+    {
+        if (nSpins < COPY_POOL_SPIN_COUNT)
+            YieldProcessor();
+        else
+            SwitchToThread();
+    }
+}
+
+unsigned __stdcall CQsCopyThreadPool::WorkerThreadProc(void* pThis)
+{
+    return ((CQsCopyThreadPool*)pThis)->WorkerThreadMsgLoop();
+}
+
+unsigned CQsCopyThreadPool::WorkerThreadMsgLoop()
+{
+    SetThreadName("*** QS Copy ***");
+
+    for (;;)
+    {
+        WaitForSingleObject(m_hWork, INFINITE);
+
+        TJob* pJob = NULL;
+        {
+            CQsAutoLock lock(&m_csLock);
+            if (m_bExit)
+                break;
+
+            // Jobs without bands left are only waiting for their workers
+            while (!m_Jobs.empty())
+            {
+                TJob* pFront = m_Jobs.front();
+                if (pFront->nNextBand < pFront->nBands)
+                {
+                    pJob = pFront;
+                    InterlockedIncrement(&pJob->nWorkers);
+                    break;
+                }
+
+                m_Jobs.pop_front();
+            }
+        }
+
+        if (pJob)
+        {
+            RunBands(*pJob);
+            InterlockedDecrement(&pJob->nWorkers);
+        }
+    }
+
+    return 0;
+}
+
+size_t CQsCopyThreadPool::GetBandSize(size_t nSize, size_t nPitch)
+{
+    // Bands of lcm(pitch, cache line) bytes start on a row and on a cache line
+    nPitch = (nPitch) ? nPitch : COPY_POOL_CACHE_LINE;
+    size_t quantum = nPitch * (COPY_POOL_CACHE_LINE / GCD((mfxU32)nPitch, COPY_POOL_CACHE_LINE));
+
+    size_t nBandSize = nSize / ((m_nRunningThreads + 1) * COPY_POOL_BANDS_PER_THREAD);
+    nBandSize = max(nBandSize, (size_t)COPY_POOL_MIN_BAND);
+    return (nBandSize + quantum - 1) / quantum * quantum;
+}
+
+void CopyPlaneBand(const TQsCopyPlane& plane, size_t nOffset, size_t nSize, Tmemcpy copyFunc)
+{
+    if (0 == plane.nDstPitch)
+    {
+        copyFunc((char*)plane.pDst + nOffset, (const char*)plane.pSrc + nOffset, nSize);
+        return;
+    }
+
+    // Row by row - the padding and the area outside the row aren't read
+    ASSERT(plane.nRowSize <= plane.nPitch && plane.nRowSize <= plane.nDstPitch);
+    size_t nFirstRow = nOffset / plane.nPitch;
+    size_t nRows = nSize / plane.nPitch;
+    const char* pSrc = (const char*)plane.pSrc + nFirstRow * plane.nPitch;
+    char* pDst = (char*)plane.pDst + nFirstRow * plane.nDstPitch;
+    for (size_t i = 0; i < nRows; ++i)
+    {
+        copyFunc(pDst, pSrc, plane.nRowSize);
+        pSrc += plane.nPitch;
+        pDst += plane.nDstPitch;
+    }
+}
+
+struct TQsCopyJobContext
+{
+    TQsCopyPlane planes[COPY_POOL_MAX_PLANES];
+    size_t       nBandSize[COPY_POOL_MAX_PLANES];
+    size_t       nFirstBand[COPY_POOL_MAX_PLANES + 1];
+    Tmemcpy      copyFunc;
+};
+
+static void CopyBand(void* pContext, size_t nBand)
+{
+    TQsCopyJobContext& ctx = *(TQsCopyJobContext*)pContext;
+    size_t i = 0;
+    while (nBand >= ctx.nFirstBand[i + 1])
+    {
+        ++i;
+    }
+
+    const TQsCopyPlane& plane = ctx.planes[i];
+    size_t offset = (nBand - ctx.nFirstBand[i]) * ctx.nBandSize[i];
+    CopyPlaneBand(plane, offset, min(ctx.nBandSize[i], plane.nSize - offset), ctx.copyFunc);
+}
+
+void CQsCopyThreadPool::Copy(const TQsCopyPlane* pPlanes, size_t nPlanes, Tmemcpy copyFunc)
+{
+    ASSERT(nPlanes <= COPY_POOL_MAX_PLANES);
+    nPlanes = min(nPlanes, (size_t)COPY_POOL_MAX_PLANES);
+
+    // The band size depends on the number of threads
+    if (!m_bRunning)
+    {
+        StartThreads();
+    }
+
+    size_t nTotalSize = 0;
+    for (size_t i = 0; i < nPlanes; ++i)
+    {
+        nTotalSize += pPlanes[i].nSize;
+    }
+
+    // All planes are split evenly
+    TQsCopyJobContext ctx;
+    ctx.copyFunc = copyFunc;
+    ctx.nFirstBand[0] = 0;
+    for (size_t i = 0; i < nPlanes; ++i)
+    {
+        ctx.planes[i] = pPlanes[i];
+        ctx.nBandSize[i] = GetBandSize(nTotalSize, pPlanes[i].nPitch);
+        ctx.nFirstBand[i + 1] = ctx.nFirstBand[i] + (pPlanes[i].nSize + ctx.nBandSize[i] - 1) / ctx.nBandSize[i];
+    }
+
+    Run(ctx.nFirstBand[nPlanes], CopyBand, &ctx);
+}
+
+////////////////////////////////////////////////////////////////////
+//                      NV12 conversion
+////////////////////////////////////////////////////////////////////
+#define CONVERT_MIN_BAND_ROWS 16 // Chroma rows
+
+// Row converters. nWidth is in pixels - the UV row has nWidth bytes.
+typedef void (*TDeinterleaveRow)(BYTE* pU, BYTE* pV, const BYTE* pUV, size_t nWidth);
+typedef void (*TPackRows)(BYTE* pDst0, BYTE* pDst1, const BYTE* pY0, const BYTE* pY1, const BYTE* pUV, size_t nWidth);
+typedef void (*TRgbRows)(BYTE* pDst0, BYTE* pDst1, const BYTE* pY0, const BYTE* pY1, const BYTE* pUV, size_t nWidth, const TQsRgbMatrix& m);
+
+static void DeinterleaveRowC(BYTE* pU, BYTE* pV, const BYTE* pUV, size_t nWidth)
+{
+    for (size_t x = 0; x < nWidth / 2; ++x)
+    {
+        pU[x] = pUV[2 * x];
+        pV[x] = pUV[2 * x + 1];
+    }
+}
+
+// Two rows sharing a chroma row
+static void PackYUY2RowsC(BYTE* pDst0, BYTE* pDst1, const BYTE* pY0, const BYTE* pY1, const BYTE* pUV, size_t nWidth)
+{
+    for (size_t x = 0; x < nWidth; ++x)
+    {
+        pDst0[2 * x]     = pY0[x];
+        pDst0[2 * x + 1] = pUV[x];
+        pDst1[2 * x]     = pY1[x];
+        pDst1[2 * x + 1] = pUV[x];
+    }
+}
+
+// 16 pixels per iteration
+static void DeinterleaveRowSSE41(BYTE* pU, BYTE* pV, const BYTE* pUV, size_t nWidth)
+{
+    // U bytes to the low half, V bytes to the high half
+    const __m128i shuffle = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+
+    size_t x = 0;
+    for (; x + 16 <= nWidth; x += 16)
+    {
+        __m128i uv = _mm_shuffle_epi8(_mm_stream_load_si128((__m128i*)(pUV + x)), shuffle);
+        _mm_storel_epi64((__m128i*)(pU + x / 2), uv);
+        _mm_storel_epi64((__m128i*)(pV + x / 2), _mm_srli_si128(uv, 8));
+    }
+
+    DeinterleaveRowC(pU + x / 2, pV + x / 2, pUV + x, nWidth - x);
+}
+
+// 16 pixels per iteration
+static void PackYUY2RowsSSE41(BYTE* pDst0, BYTE* pDst1, const BYTE* pY0, const BYTE* pY1, const BYTE* pUV, size_t nWidth)
+{
+    size_t x = 0;
+    for (; x + 16 <= nWidth; x += 16)
+    {
+        __m128i uv = _mm_stream_load_si128((__m128i*)(pUV + x));
+        __m128i y0 = _mm_stream_load_si128((__m128i*)(pY0 + x));
+        __m128i y1 = _mm_stream_load_si128((__m128i*)(pY1 + x));
+
+        // Y0 U0 Y1 V0 ...
+        _mm_storeu_si128((__m128i*)(pDst0 + 2 * x),      _mm_unpacklo_epi8(y0, uv));
+        _mm_storeu_si128((__m128i*)(pDst0 + 2 * x + 16), _mm_unpackhi_epi8(y0, uv));
+        _mm_storeu_si128((__m128i*)(pDst1 + 2 * x),      _mm_unpacklo_epi8(y1, uv));
+        _mm_storeu_si128((__m128i*)(pDst1 + 2 * x + 16), _mm_unpackhi_epi8(y1, uv));
+    }
+
+    PackYUY2RowsC(pDst0 + 2 * x, pDst1 + 2 * x, pY0 + x, pY1 + x, pUV + x, nWidth - x);
+}
+
+#if defined (AVX2_ENABLED)
+// 64 pixels per iteration
+static void DeinterleaveRowAVX2(BYTE* pU, BYTE* pV, const BYTE* pUV, size_t nWidth)
+{
+    // Per 128 bit lane - U bytes to the low half, V bytes to the high half
+    const __m256i shuffle = _mm256_setr_epi8(
+        0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+        0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+
+    size_t x = 0;
+    for (; x + 64 <= nWidth; x += 64)
+    {
+        // U0-7 V0-7 | U8-15 V8-15 --> U0-15 | V0-15
+        __m256i a = _mm256_shuffle_epi8(_mm256_stream_load_si256((__m256i*)(pUV + x)), shuffle);
+        __m256i b = _mm256_shuffle_epi8(_mm256_stream_load_si256((__m256i*)(pUV + x + 32)), shuffle);
+        a = _mm256_permute4x64_epi64(a, 0xD8);
+        b = _mm256_permute4x64_epi64(b, 0xD8);
+
+        _mm256_storeu_si256((__m256i*)(pU + x / 2), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i*)(pV + x / 2), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+
+    // Avoid AVX-SSE transition penalties in the SSE tail
+    _mm256_zeroupper();
+    DeinterleaveRowSSE41(pU + x / 2, pV + x / 2, pUV + x, nWidth - x);
+}
+
+// 32 pixels per iteration
+static void PackYUY2RowsAVX2(BYTE* pDst0, BYTE* pDst1, const BYTE* pY0, const BYTE* pY1, const BYTE* pUV, size_t nWidth)
+{
+    size_t x = 0;
+    for (; x + 32 <= nWidth; x += 32)
+    {
+        __m256i uv = _mm256_stream_load_si256((__m256i*)(pUV + x));
+        __m256i y0 = _mm256_stream_load_si256((__m256i*)(pY0 + x));
+        __m256i y1 = _mm256_stream_load_si256((__m256i*)(pY1 + x));
+
+        // Unpacking works per lane: lo holds pixels 0-7 and 16-23, hi holds 8-15 and 24-31
+        __m256i lo = _mm256_unpacklo_epi8(y0, uv);
+        __m256i hi = _mm256_unpackhi_epi8(y0, uv);
+        _mm256_storeu_si256((__m256i*)(pDst0 + 2 * x),      _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(pDst0 + 2 * x + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+
+        lo = _mm256_unpacklo_epi8(y1, uv);
+        hi = _mm256_unpackhi_epi8(y1, uv);
+        _mm256_storeu_si256((__m256i*)(pDst1 + 2 * x),      _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(pDst1 + 2 * x + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    _mm256_zeroupper();
+    PackYUY2RowsSSE41(pDst0 + 2 * x, pDst1 + 2 * x, pY0 + x, pY1 + x, pUV + x, nWidth - x);
+}
+#endif
+
+// RGB32 - two rows sharing a chroma row. Same fixed-point math as _mm_mulhrs_epi16 so all paths match.
+static __forceinline int MulHrs(int a, int b)
+{
+    return (a * b + 0x4000) >> 15;
+}
+
+static __forceinline BYTE ClampRgb(int x)
+{
+    x = (x + 8) >> 4;
+    return (BYTE)((x < 0) ? 0 : (x > 255) ? 255 : x);
+}
+
+static void RgbRowsC(BYTE* pDst0, BYTE* pDst1, const BYTE* pY0, const BYTE* pY1, const BYTE* pUV, size_t nWidth, const TQsRgbMatrix& m)
+{
+    for (size_t x = 0; x < nWidth; x += 2)
+    {
+        // Chroma terms are Q4
+        int u = (pUV[x] - 128) * 64;
+        int v = (pUV[x + 1] - 128) * 64;
+        int r = MulHrs(v, m.nRV);
+        int g = MulHrs(u, m.nGU) + MulHrs(v, m.nGV);
+        int b = MulHrs(u, m.nBU);
+
+        BYTE* pDst[] = { pDst0 + 4 * x, pDst0 + 4 * x + 4, pDst1 + 4 * x, pDst1 + 4 * x + 4 };
+        int y[] = { pY0[x], pY0[x + 1], pY1[x], pY1[x + 1] };
+        for (int i = 0; i < 4; ++i)
+        {
+            int yt = MulHrs((y[i] - m.nYOffset) * 64, m.nYScale);
+            pDst[i][0] = ClampRgb(yt + b);
+            pDst[i][1] = ClampRgb(yt + g);
+            pDst[i][2] = ClampRgb(yt + r);
+            pDst[i][3] = 0xFF;
+        }
+    }
+}
+
+// Chroma terms of 8 pixels (Q4 words) - U and V are repeated for each pixel pair
+struct TRgbChromaSSE41
+{
+    __m128i r, g, b;
+};
+
+static __forceinline void LoadRgbChromaSSE41(TRgbChromaSSE41& c, __m128i uv, const TQsRgbMatrix& m)
+{
+    const __m128i dupU = _mm_setr_epi8(0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13);
+    const __m128i dupV = _mm_setr_epi8(2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15);
+
+    uv = _mm_slli_epi16(_mm_sub_epi16(_mm_cvtepu8_epi16(uv), _mm_set1_epi16(128)), 6);
+    __m128i u = _mm_shuffle_epi8(uv, dupU);
+    __m128i v = _mm_shuffle_epi8(uv, dupV);
+    c.r = _mm_mulhrs_epi16(v, _mm_set1_epi16(m.nRV));
+    c.g = _mm_add_epi16(_mm_mulhrs_epi16(u, _mm_set1_epi16(m.nGU)), _mm_mulhrs_epi16(v, _mm_set1_epi16(m.nGV)));
+    c.b = _mm_mulhrs_epi16(u, _mm_set1_epi16(m.nBU));
+}
+
+// Luma term of 8 pixels (Q4 words)
+static __forceinline __m128i LoadRgbLumaSSE41(__m128i y, const TQsRgbMatrix& m)
+{
+    y = _mm_slli_epi16(_mm_sub_epi16(_mm_cvtepu8_epi16(y), _mm_set1_epi16(m.nYOffset)), 6);
+    return _mm_mulhrs_epi16(y, _mm_set1_epi16(m.nYScale));
+}
+
+static __forceinline __m128i PackRgbSSE41(__m128i y0, __m128i c0, __m128i y1, __m128i c1)
+{
+    const __m128i round = _mm_set1_epi16(8);
+    return _mm_packus_epi16(
+        _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(y0, c0), round), 4),
+        _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(y1, c1), round), 4));
+}
+
+// 16 pixels
+static __forceinline void StoreRgbSSE41(BYTE* pDst, __m128i y, const TRgbChromaSSE41& c0, const TRgbChromaSSE41& c1, const TQsRgbMatrix& m)
+{
+    __m128i y0 = LoadRgbLumaSSE41(y, m);
+    __m128i y1 = LoadRgbLumaSSE41(_mm_srli_si128(y, 8), m);
+    __m128i b = PackRgbSSE41(y0, c0.b, y1, c1.b);
+    __m128i g = PackRgbSSE41(y0, c0.g, y1, c1.g);
+    __m128i r = PackRgbSSE41(y0, c0.r, y1, c1.r);
+    __m128i a = _mm_set1_epi8(-1);
+
+    __m128i bg = _mm_unpacklo_epi8(b, g);
+    __m128i ra = _mm_unpacklo_epi8(r, a);
+    _mm_storeu_si128((__m128i*)pDst,        _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128((__m128i*)(pDst + 16), _mm_unpackhi_epi16(bg, ra));
+    bg = _mm_unpackhi_epi8(b, g);
+    ra = _mm_unpackhi_epi8(r, a);
+    _mm_storeu_si128((__m128i*)(pDst + 32), _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128((__m128i*)(pDst + 48), _mm_unpackhi_epi16(bg, ra));
+}
+
+// 16 pixels per iteration
+static void RgbRowsSSE41(BYTE* pDst0, BYTE* pDst1, const BYTE* pY0, const BYTE* pY1, const BYTE* pUV, size_t nWidth, const TQsRgbMatrix& m)
+{
+    size_t x = 0;
+    for (; x + 16 <= nWidth; x += 16)
+    {
+        // Both rows use the same chroma terms
+        __m128i uv = _mm_stream_load_si128((__m128i*)(pUV + x));
+        TRgbChromaSSE41 c0, c1;
+        LoadRgbChromaSSE41(c0, uv, m);
+        LoadRgbChromaSSE41(c1, _mm_srli_si128(uv, 8), m);
+
+        StoreRgbSSE41(pDst0 + 4 * x, _mm_stream_load_si128((__m128i*)(pY0 + x)), c0, c1, m);
+        StoreRgbSSE41(pDst1 + 4 * x, _mm_stream_load_si128((__m128i*)(pY1 + x)), c0, c1, m);
+    }
+
+    RgbRowsC(pDst0 + 4 * x, pDst1 + 4 * x, pY0 + x, pY1 + x, pUV + x, nWidth - x, m);
+}
+
+#if defined (AVX2_ENABLED)
+// Chroma terms of 16 pixels - lane 0 holds pixels 0-7, lane 1 pixels 8-15
+struct TRgbChromaAVX2
+{
+    __m256i r, g, b;
+};
+
+static __forceinline void LoadRgbChromaAVX2(TRgbChromaAVX2& c, __m128i uv, const TQsRgbMatrix& m)
+{
+    const __m256i dupU = _mm256_setr_epi8(
+        0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13,
+        0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13);
+    const __m256i dupV = _mm256_setr_epi8(
+        2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15,
+        2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15);
+
+    __m256i uv16 = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(uv), _mm256_set1_epi16(128)), 6);
+    __m256i u = _mm256_shuffle_epi8(uv16, dupU);
+    __m256i v = _mm256_shuffle_epi8(uv16, dupV);
+    c.r = _mm256_mulhrs_epi16(v, _mm256_set1_epi16(m.nRV));
+    c.g = _mm256_add_epi16(_mm256_mulhrs_epi16(u, _mm256_set1_epi16(m.nGU)), _mm256_mulhrs_epi16(v, _mm256_set1_epi16(m.nGV)));
+    c.b = _mm256_mulhrs_epi16(u, _mm256_set1_epi16(m.nBU));
+}
+
+static __forceinline __m256i LoadRgbLumaAVX2(__m128i y, const TQsRgbMatrix& m)
+{
+    __m256i y16 = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(y), _mm256_set1_epi16(m.nYOffset)), 6);
+    return _mm256_mulhrs_epi16(y16, _mm256_set1_epi16(m.nYScale));
+}
+
+static __forceinline __m256i PackRgbAVX2(__m256i y0, __m256i c0, __m256i y1, __m256i c1)
+{
+    const __m256i round = _mm256_set1_epi16(8);
+    return _mm256_packus_epi16(
+        _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(y0, c0), round), 4),
+        _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(y1, c1), round), 4));
+}
+
+// 32 pixels
+static __forceinline void StoreRgbAVX2(BYTE* pDst, __m256i y, const TRgbChromaAVX2& c0, const TRgbChromaAVX2& c1, const TQsRgbMatrix& m)
+{
+    __m256i y0 = LoadRgbLumaAVX2(_mm256_castsi256_si128(y), m);
+    __m256i y1 = LoadRgbLumaAVX2(_mm256_extracti128_si256(y, 1), m);
+
+    // Packing works per lane: lane 0 holds pixels 0-7 and 16-23, lane 1 holds 8-15 and 24-31
+    __m256i b = PackRgbAVX2(y0, c0.b, y1, c1.b);
+    __m256i g = PackRgbAVX2(y0, c0.g, y1, c1.g);
+    __m256i r = PackRgbAVX2(y0, c0.r, y1, c1.r);
+    __m256i a = _mm256_set1_epi8(-1);
+
+    __m256i bg = _mm256_unpacklo_epi8(b, g);
+    __m256i ra = _mm256_unpacklo_epi8(r, a);
+    __m256i lo = _mm256_unpacklo_epi16(bg, ra);
+    __m256i hi = _mm256_unpackhi_epi16(bg, ra);
+    _mm256_storeu_si256((__m256i*)pDst,        _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i*)(pDst + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+
+    bg = _mm256_unpackhi_epi8(b, g);
+    ra = _mm256_unpackhi_epi8(r, a);
+    lo = _mm256_unpacklo_epi16(bg, ra);
+    hi = _mm256_unpackhi_epi16(bg, ra);
+    _mm256_storeu_si256((__m256i*)(pDst + 64), _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i*)(pDst + 96), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+// 32 pixels per iteration
+static void RgbRowsAVX2(BYTE* pDst0, BYTE* pDst1, const BYTE* pY0, const BYTE* pY1, const BYTE* pUV, size_t nWidth, const TQsRgbMatrix& m)
+{
+    size_t x = 0;
+    for (; x + 32 <= nWidth; x += 32)
+    {
+        __m256i uv = _mm256_stream_load_si256((__m256i*)(pUV + x));
+        TRgbChromaAVX2 c0, c1;
+        LoadRgbChromaAVX2(c0, _mm256_castsi256_si128(uv), m);
+        LoadRgbChromaAVX2(c1, _mm256_extracti128_si256(uv, 1), m);
+
+        StoreRgbAVX2(pDst0 + 4 * x, _mm256_stream_load_si256((__m256i*)(pY0 + x)), c0, c1, m);
+        StoreRgbAVX2(pDst1 + 4 * x, _mm256_stream_load_si256((__m256i*)(pY1 + x)), c0, c1, m);
+    }
+
+    _mm256_zeroupper();
+    RgbRowsSSE41(pDst0 + 4 * x, pDst1 + 4 * x, pY0 + x, pY1 + x, pUV + x, nWidth - x, m);
+}
+#endif
+
+void InitRgbMatrix(TQsRgbMatrix& matrix, double kr, double kb, bool bFullRange)
+{
+    double kg = 1.0 - kr - kb;
+    double yScale = (bFullRange) ? 1.0 : 255.0 / 219.0;
+    double cScale = (bFullRange) ? 1.0 : 255.0 / 224.0;
+
+    // Q13
+    matrix.nYOffset = (bFullRange) ? 0 : 16;
+    matrix.nYScale  = (short)floor(0.5 + 8192 * yScale);
+    matrix.nRV      = (short)floor(0.5 + 8192 * cScale * 2 * (1 - kr));
+    matrix.nGU      = (short)floor(0.5 - 8192 * cScale * 2 * kb * (1 - kb) / kg);
+    matrix.nGV      = (short)floor(0.5 - 8192 * cScale * 2 * kr * (1 - kr) / kg);
+    matrix.nBU      = (short)floor(0.5 + 8192 * cScale * 2 * (1 - kb));
+}
+
+struct TQsConvertContext
+{
+    const TQsConvertFrame* pFrame;
+    Tmemcpy                copyFunc;
+    TDeinterleaveRow       deinterleaveRow; // NULL for packed formats
+    TPackRows              packRows;        // YUY2
+    TRgbRows               rgbRows;         // RGB32
+    size_t                 nWidth;          // Whole chroma pairs
+    size_t                 nSimdWidth;      // Pixels read with SIMD - the rest of the row is converted in C
+    size_t                 nBandRows;       // Chroma rows
+    bool                   bInterlaced;
+};
+
+// Converts chroma rows [nFirst, nFirst + nCount) and the luma rows that use them
+static void ConvertRows(const TQsConvertContext& ctx, size_t nFirst, size_t nCount)
+{
+    const TQsConvertFrame& f = *ctx.pFrame;
+    size_t nChromaPitch = f.nDstPitch / 2;
+    size_t nRest = (ctx.nWidth > ctx.nSimdWidth) ? ctx.nWidth - ctx.nSimdWidth : 0;
+    for (size_t c = nFirst; c < nFirst + nCount; ++c)
+    {
+        const BYTE* pUV = f.pSrcUV + c * f.nSrcPitch;
+        if (ctx.deinterleaveRow)
+        {
+            // Planar - luma rows 2c and 2c+1 are plain copies
+            ctx.copyFunc(f.pDstY + 2 * c * f.nDstPitch, f.pSrcY + 2 * c * f.nSrcPitch, ctx.nWidth);
+            ctx.copyFunc(f.pDstY + (2 * c + 1) * f.nDstPitch, f.pSrcY + (2 * c + 1) * f.nSrcPitch, ctx.nWidth);
+            BYTE* pU = f.pDstU + c * nChromaPitch;
+            BYTE* pV = f.pDstV + c * nChromaPitch;
+            ctx.deinterleaveRow(pU, pV, pUV, ctx.nSimdWidth);
+            DeinterleaveRowC(pU + ctx.nSimdWidth / 2, pV + ctx.nSimdWidth / 2, pUV + ctx.nSimdWidth, nRest);
+        }
+        else
+        {
+            // Interlaced frames: chroma row c belongs to field c & 1 - luma rows 2c and 2c+1 of that field
+            size_t y0 = (ctx.bInterlaced) ? ((c & ~1) * 2 + (c & 1)) : 2 * c;
+            size_t y1 = y0 + ((ctx.bInterlaced) ? 2 : 1);
+            BYTE* pDst0 = f.pDstY + y0 * f.nDstPitch;
+            BYTE* pDst1 = f.pDstY + y1 * f.nDstPitch;
+            const BYTE* pY0 = f.pSrcY + y0 * f.nSrcPitch;
+            const BYTE* pY1 = f.pSrcY + y1 * f.nSrcPitch;
+            if (ctx.rgbRows)
+            {
+                ctx.rgbRows(pDst0, pDst1, pY0, pY1, pUV, ctx.nSimdWidth, *f.pMatrix);
+                RgbRowsC(pDst0 + 4 * ctx.nSimdWidth, pDst1 + 4 * ctx.nSimdWidth,
+                    pY0 + ctx.nSimdWidth, pY1 + ctx.nSimdWidth, pUV + ctx.nSimdWidth, nRest, *f.pMatrix);
+            }
+            else
+            {
+                ctx.packRows(pDst0, pDst1, pY0, pY1, pUV, ctx.nSimdWidth);
+                PackYUY2RowsC(pDst0 + 2 * ctx.nSimdWidth, pDst1 + 2 * ctx.nSimdWidth,
+                    pY0 + ctx.nSimdWidth, pY1 + ctx.nSimdWidth, pUV + ctx.nSimdWidth, nRest);
+            }
+        }
+    }
+}
+
+static void ConvertBand(void* pContext, size_t nBand)
+{
+    TQsConvertContext& ctx = *(TQsConvertContext*)pContext;
+    size_t nChromaRows = ctx.pFrame->nHeight / 2;
+    size_t nFirst = nBand * ctx.nBandRows;
+    ConvertRows(ctx, nFirst, min(ctx.nBandRows, nChromaRows - nFirst));
+}
+
+void ConvertNV12(const TQsConvertFrame& frame, QsOutputFormat format, Tmemcpy copyFunc, bool bMultiThreaded)
+{
+    ASSERT(format != QS_OUTPUT_NV12);
+    ASSERT(((frame.nWidth + 1) & ~(size_t)1) <= frame.nDstPitch);
+    ASSERT(format != QS_OUTPUT_RGB32 || frame.pMatrix);
+
+    TQsConvertContext ctx;
+    ctx.pFrame = &frame;
+    ctx.copyFunc = copyFunc;
+    ctx.deinterleaveRow = NULL;
+    ctx.packRows = PackYUY2RowsC;
+    ctx.rgbRows = RgbRowsC;
+    ctx.nWidth = (frame.nWidth + 1) & ~(size_t)1; // The last pixel of an odd width has a whole chroma pair
+    ctx.nSimdWidth = 0;
+    ctx.nBandRows = 0;
+
+    // Each field needs an even number of chroma rows - otherwise the rows are paired like a progressive frame
+    ctx.bInterlaced = frame.bInterlaced && 0 == (frame.nHeight & 3);
+
+    // Streaming loads need 16 byte (SSE4.1) or 32 byte (AVX2) alignment
+    size_t alignment = (size_t)frame.pSrcY | (size_t)frame.pSrcUV | frame.nSrcPitch;
+    if (0 == (alignment & 15) && s_CopyCpuSupport[COPY_CPU_SSE41])
+    {
+        // Whole 16 pixel blocks as long as they are inside the pitch
+        ctx.nSimdWidth = min((size_t)MSDK_ALIGN16(frame.nWidth), frame.nSrcPitch);
+        ctx.packRows = PackYUY2RowsSSE41;
+        ctx.rgbRows = RgbRowsSSE41;
+        ctx.deinterleaveRow = DeinterleaveRowSSE41;
+#if defined (AVX2_ENABLED)
+        if (0 == (alignment & 31) && s_CopyCpuSupport[COPY_CPU_AVX2])
+        {
+            ctx.packRows = PackYUY2RowsAVX2;
+            ctx.rgbRows = RgbRowsAVX2;
+            ctx.deinterleaveRow = DeinterleaveRowAVX2;
+        }
+#endif
+    }
+
+    // Only one of the row functions is used
+    if (QS_OUTPUT_I420 == format || QS_OUTPUT_YV12 == format)
+    {
+        ctx.deinterleaveRow = (ctx.deinterleaveRow) ? ctx.deinterleaveRow : DeinterleaveRowC;
+    }
+    else
+    {
+        ctx.deinterleaveRow = NULL;
+    }
+
+    if (QS_OUTPUT_RGB32 != format)
+    {
+        ctx.rgbRows = NULL;
+    }
+
+    size_t nChromaRows = frame.nHeight / 2;
+    if (!bMultiThreaded)
+    {
+        ConvertRows(ctx, 0, nChromaRows);
+        return;
+    }
+
+    // Bands are sized like the copy's - a chroma row reads two luma rows and one chroma row
+    CQsCopyThreadPool& pool = CQsCopyThreadPool::Instance();
+    size_t nRowBytes = 3 * frame.nSrcPitch;
+    ctx.nBandRows = pool.GetBandSize(nChromaRows * nRowBytes, nRowBytes) / nRowBytes;
+    ctx.nBandRows = max(ctx.nBandRows, (size_t)CONVERT_MIN_BAND_ROWS);
+    pool.Run((nChromaRows + ctx.nBandRows - 1) / ctx.nBandRows, ConvertBand, &ctx);
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+// Registry of the kernels that copy frames out of video memory (USWC).
+// The best kernel depends on the CPU generation - the load width, unroll depth and store type
+// that win on one CPU can lose on another. QS_COPY_AUTO measures the supported kernels on the
+// first frames copied in the process (round robin) and keeps the fastest one from then on.
+// Video memory is needed for a meaningful measurement - streaming loads from cached memory
+// behave like regular loads.
+class CQsCopyKernels
+{
+public:
+    static CQsCopyKernels& Instance();
+
+    // Copy function of a kernel. Kernels the CPU doesn't support fall back to QS_COPY_AUTO.
+    // The QS_COPY_AUTO function is gpu_memcpy.
+    Tmemcpy GetCopyFunc(QsCopyKernel kernel);
+
+    bool IsSupported(QsCopyKernel kernel) const;
+    static const char* GetName(QsCopyKernel kernel);
+
+    // Kernel chosen by the calibration, QS_COPY_AUTO while still calibrating
+    QsCopyKernel GetSelected() const { return m_Selected; }
+
+    // Copies with the selected kernel or runs a calibration sample
+    __forceinline void* Copy(void* d, const void* s, size_t size)
+    {
+        return (m_pSelectedFunc) ? m_pSelectedFunc(d, s, size) : Calibrate(d, s, size);
+    }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsCopyKernels);
+    CQsCopyKernels();
+
+    void* Calibrate(void* d, const void* s, size_t size);
+    void SelectFastest();
+
+    static CQsCopyKernels s_Instance;
+
+    std::vector<QsCopyKernel> m_Candidates;                   // Supported kernels measured by the calibration
+    double                    m_BestCost[QS_COPY_KERNEL_COUNT]; // Fastest sample of each kernel (ticks per MB)
+    unsigned                  m_nSampleCount[QS_COPY_KERNEL_COUNT];
+    volatile LONG             m_nNextSample;
+    LONGLONG                  m_Frequency;                    // Performance counter ticks per second
+    volatile QsCopyKernel     m_Selected;
+    volatile Tmemcpy          m_pSelectedFunc;                // NULL while calibrating
+    CQsLock                   m_csLock;
+};
+
+#define COPY_POOL_MAX_PLANES 4
+
+// A plane copied by CQsCopyThreadPool::Copy
+struct TQsCopyPlane
+{
+    void*       pDst;
+    const void* pSrc;
+    size_t      nSize;      // Bytes of the source plane (whole rows)
+    size_t      nPitch;     // Source row size - bands are split on row boundaries
+    size_t      nDstPitch;  // 0 - the plane is copied as is. Otherwise only the first nRowSize bytes
+    size_t      nRowSize;   // of each row are copied, into rows of nDstPitch bytes.
+};
+
+// Copies nSize bytes of a plane starting at source offset nOffset.
+// Both must be whole rows when the plane is compacted (nDstPitch isn't 0).
+void CopyPlaneBand(const TQsCopyPlane& plane, size_t nOffset, size_t nSize, Tmemcpy copyFunc);
+
+// Fixed-point YUV to RGB matrix. Coefficients are Q13, applied to (Y - nYOffset) and (C - 128).
+struct TQsRgbMatrix
+{
+    short nYOffset;
+    short nYScale;
+    short nRV;
+    short nGU;
+    short nGV;
+    short nBU;
+};
+
+// Matrix for the luma weights of the red and blue components (BT.601: 0.299/0.114, BT.709: 0.2126/0.0722).
+// Limited range expands 16-235 luma and 16-240 chroma to 0-255.
+void InitRgbMatrix(TQsRgbMatrix& matrix, double kr, double kb, bool bFullRange);
+
+// An NV12 frame converted by ConvertNV12
+struct TQsConvertFrame
+{
+    const BYTE* pSrcY;
+    const BYTE* pSrcUV;
+    size_t      nSrcPitch;
+    BYTE*       pDstY;       // Y plane or the packed frame (YUY2, RGB32)
+    BYTE*       pDstU;       // Planar formats only
+    BYTE*       pDstV;
+    size_t      nDstPitch;   // Y plane or packed frame - chroma planes use half of it
+    size_t      nWidth;      // Pixels. An odd width is converted up to the next even pixel (a whole chroma pair).
+                             // Rows are read and written up to the next 16 pixels when the source pitch
+                             // allows it - the destination pitch must allow it too.
+    size_t      nHeight;     // Rows, even
+    bool        bInterlaced; // Chroma rows alternate between the fields (YUY2 and RGB32, height a multiple of 4)
+    const TQsRgbMatrix* pMatrix; // RGB32 only
+};
+
+// Converts an NV12 frame to I420/YV12 (the U and V pointers decide the plane order), YUY2 or RGB32 in the same
+// pass as the copy, so a frame in video memory is read once. Y rows of planar formats are copied by copyFunc.
+// RGB32 pixels are stored as B, G, R, A with an opaque alpha. Chroma isn't interpolated.
+// Reads with streaming loads (SSE4.1 or AVX2) when the source is 16 byte aligned.
+// bMultiThreaded splits the frame into bands of rows on the copy thread pool.
+void ConvertNV12(const TQsConvertFrame& frame, QsOutputFormat format, Tmemcpy copyFunc, bool bMultiThreaded);
+
+// Persistent worker threads shared by all decoders for copying and converting frames.
+// A job is split into bands that the workers and the calling thread take in turn.
+// The calling thread waits for the last band by spinning - no kernel objects are involved.
+// The threads start with the first job and are stopped when the last decoder detaches,
+// so no thread runs the DLL's code after the decoders are destroyed.
+// Without an attached decoder jobs run on the calling thread.
+class CQsCopyThreadPool
+{
+public:
+    typedef void (*TBandFunc)(void* pContext, size_t nBand);
+
+    static CQsCopyThreadPool& Instance();
+
+    void Attach();
+    void Detach();
+
+    // nThreads - worker threads, 0 - default (one less than the number of cores, up to 3).
+    // affinityMask - cores for the workers, one core per worker (round robin). 0 - any core.
+    // Running threads are restarted.
+    void Configure(unsigned nThreads, DWORD_PTR affinityMask);
+
+    // Runs func for every band in [0, nBands). Returns when all bands are done.
+    void Run(size_t nBands, TBandFunc func, void* pContext);
+
+    // Copies up to COPY_POOL_MAX_PLANES planes at once. Bands are whole rows and start on a cache line.
+    void Copy(const TQsCopyPlane* pPlanes, size_t nPlanes, Tmemcpy copyFunc);
+
+    // Band size for nSize bytes of rows of nPitch bytes - a multiple of the pitch and of the cache line
+    size_t GetBandSize(size_t nSize, size_t nPitch);
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsCopyThreadPool);
+    CQsCopyThreadPool();
+    ~CQsCopyThreadPool();
+
+    struct TJob
+    {
+        TBandFunc     func;
+        void*         pContext;
+        LONG          nBands;
+        volatile LONG nNextBand;
+        volatile LONG nWorkers; // Workers running bands of the job
+    };
+
+    static void RunBands(TJob& job);
+    void StartThreads();
+    void StopThreads();
+    static unsigned __stdcall WorkerThreadProc(void* pThis);
+    unsigned WorkerThreadMsgLoop();
+
+    static CQsCopyThreadPool s_Instance;
+
+    std::deque<TJob*>   m_Jobs;          // Jobs with bands left for the workers
+    std::vector<HANDLE> m_Threads;
+    HANDLE              m_hWork;         // Semaphore - released once per worker a job can use
+    volatile bool       m_bRunning;      // Threads were started (there may be none on a single core)
+    bool                m_bExit;
+    volatile LONG       m_nRunningThreads;
+    unsigned            m_nThreads;      // Worker threads (configured)
+    DWORD_PTR           m_AffinityMask;
+    LONG                m_nUsers;        // Attached decoders
+    CQsLock             m_csLock;        // Protects the job queue
+    CQsLock             m_csThreadsLock; // Protects starting and stopping the threads
+};
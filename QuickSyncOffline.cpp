@@ -0,0 +1,613 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "stdafx.h"
+#include "IQuickSyncDecoder.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "QuickSyncCopy.h"
+#include "TimeManager.h"
+#include "H264Nalu.h"
+#include "H264Parser.h"
+#include "QuickSyncDecoder.h"
+#include "QuickSyncOffline.h"
+
+// Frames in flight of each GOP decoder when the config doesn't set it - latency doesn't matter
+#define OFFLINE_ASYNC_DEPTH 4
+
+// GOPs that may be decoded ahead of delivery, per GOP decoder.
+// Decoded frames are kept in system memory until their GOP is delivered.
+#define OFFLINE_GOPS_AHEAD 2
+
+// Frame duration (100ns units) when neither the input nor the stream has a frame rate (25 fps)
+#define OFFLINE_DEFAULT_FRAME_DURATION 400000
+
+// Parameter sets of the access unit being split
+#define AU_HAS_SPS 1
+#define AU_HAS_PPS 2
+
+TQsGop::~TQsGop()
+{
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        delete frames[i].pBuffer;
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+//                      CQsMsdkGopDecoder
+////////////////////////////////////////////////////////////////////
+CQsGopDecoder* CQsGopDecoderFactory::CreateGopDecoder(const CQsConfig& cfg)
+{
+    return new CQsMsdkGopDecoder(cfg);
+}
+
+CQsMsdkGopDecoder::CQsMsdkGopDecoder(const CQsConfig& cfg) :
+    m_Config(cfg),
+    m_pDecoder(NULL),
+    m_nPitch(0),
+    m_bInitialized(false)
+{
+    MSDK_ZERO_VAR(m_VideoParams);
+
+    mfxStatus sts = MFX_ERR_NONE;
+    m_pDecoder = new CQuickSyncDecoder(m_Config, &m_BusyHandler, false, sts);
+    if (MSDK_FAILED(sts))
+    {
+        MSDK_TRACE("QsOffline: decoder creation failed!\n");
+        MSDK_SAFE_DELETE(m_pDecoder);
+    }
+}
+
+CQsMsdkGopDecoder::~CQsMsdkGopDecoder()
+{
+    MSDK_SAFE_DELETE(m_pDecoder);
+}
+
+mfxStatus CQsMsdkGopDecoder::InitDecoder(mfxBitstream& bs)
+{
+    mfxVideoParam params;
+    MSDK_ZERO_VAR(params);
+    params.mfx.CodecId = MFX_CODEC_AVC;
+    mfxStatus sts = m_pDecoder->DecodeHeader(&bs, &params);
+    MSDK_CHECK_RESULT_P_RET(sts, MFX_ERR_NONE);
+
+    params.AsyncDepth = (mfxU16)m_Config.nAsyncDepth;
+    params.IOPattern = m_VideoParams.IOPattern;
+    params.mfx.FrameInfo.Height = (mfxU16)MSDK_ALIGN32(params.mfx.FrameInfo.Height);
+    m_VideoParams = params;
+    m_nPitch = MSDK_ALIGN32(m_VideoParams.mfx.FrameInfo.Width);
+
+    // Every GOP starts with an IDR picture - a reset is enough (the surfaces are reallocated when the frame size grows)
+    if (m_bInitialized)
+    {
+        sts = m_pDecoder->Reset(&m_VideoParams, m_nPitch);
+    }
+    else
+    {
+        // Frames are copied right away - a couple of surfaces on top of the decoder's are enough
+        m_pDecoder->SetAuxFramesCount(2);
+        sts = m_pDecoder->Init(&m_VideoParams, m_nPitch);
+    }
+
+    m_bInitialized = MSDK_SUCCEEDED(sts);
+    return sts;
+}
+
+HRESULT CQsMsdkGopDecoder::DecodeGop(TQsGop& gop)
+{
+    MSDK_CHECK_POINTER(m_pDecoder, E_UNEXPECTED);
+    MSDK_CHECK_NOT_EQUAL(gop.data.empty(), false, S_OK);
+
+    // Access units are complete - the decoder doesn't wait for the next one to find their end.
+    // The first one holds the parameter sets.
+    size_t nPicture = 0;
+    mfxBitstream bs;
+    MSDK_ZERO_VAR(bs);
+    bs.Data = &gop.data[0];
+    bs.DataFlag = MFX_BITSTREAM_COMPLETE_FRAME;
+    SetAccessUnit(gop, nPicture, bs);
+
+    mfxStatus sts = InitDecoder(bs);
+    MSDK_CHECK_NOT_EQUAL(sts, MFX_ERR_NONE, E_FAIL);
+
+    const mfxFrameInfo& info = m_VideoParams.mfx.FrameInfo;
+    if (info.FrameRateExtN > 0 && info.FrameRateExtD > 0)
+    {
+        gop.rtFrameDuration = (REFERENCE_TIME)(0.5 + 1e7 * info.FrameRateExtD / info.FrameRateExtN);
+    }
+
+    // A NULL bitstream drains the decoder once all data was taken
+    mfxBitstream* pBS = &bs;
+    for (;;)
+    {
+        mfxFrameSurface1* pSurface = NULL;
+        sts = m_pDecoder->Decode(pBS, pSurface);
+        if (MSDK_SUCCEEDED(sts))
+        {
+            if (pSurface)
+            {
+                CopyFrame(pSurface, gop);
+                m_pDecoder->UnlockSurface(pSurface);
+            }
+
+            continue;
+        }
+
+        if (MFX_ERR_MORE_SURFACE == sts || MFX_WRN_VIDEO_PARAM_CHANGED == sts)
+            continue;
+
+        if (MFX_ERR_MORE_DATA == sts && pBS != NULL)
+        {
+            if (++nPicture >= gop.pictures.size())
+            {
+                pBS = NULL;
+            }
+            else
+            {
+                SetAccessUnit(gop, nPicture, bs);
+            }
+
+            continue;
+        }
+
+        break;
+    }
+
+    // MFX_ERR_MORE_DATA with a NULL bitstream - the decoder is empty
+    return (MFX_ERR_MORE_DATA == sts) ? S_OK : E_FAIL;
+}
+
+void CQsMsdkGopDecoder::SetAccessUnit(const TQsGop& gop, size_t nPicture, mfxBitstream& bs)
+{
+    // A GOP without access units is decoded as a whole
+    size_t nStart = (nPicture < gop.pictures.size()) ? gop.pictures[nPicture].nOffset : 0;
+    size_t nEnd = (nPicture + 1 < gop.pictures.size()) ? gop.pictures[nPicture + 1].nOffset : gop.data.size();
+    bs.DataOffset = (mfxU32)nStart;
+    bs.DataLength = (mfxU32)(nEnd - nStart);
+    bs.MaxLength = (mfxU32)nEnd;
+    bs.TimeStamp = nPicture;
+}
+
+void CQsMsdkGopDecoder::CopyFrame(mfxFrameSurface1* pSurface, TQsGop& gop)
+{
+    mfxFrameData frameData;
+    if (MSDK_FAILED(m_pDecoder->LockFrame(pSurface, &frameData)))
+        return;
+
+    const mfxFrameInfo& info = pSurface->Info;
+    size_t height = info.CropH; // Cropped image height
+    size_t pitch  = frameData.Pitch;
+
+    TQsOfflineFrame frame;
+    frame.pBuffer = new CQsAlignedBuffer(pitch * height * 3 / 2);
+    QsFrameData& outFrameData = frame.frameData;
+    MSDK_ZERO_VAR(outFrameData);
+
+    outFrameData.fourCC = info.FourCC;
+    outFrameData.bCorrupted = pSurface->Data.Corrupted != 0;
+    PARtoDAR(info.AspectRatioW, info.AspectRatioH, info.CropW, info.CropH,
+        outFrameData.dwPictAspectRatioX, outFrameData.dwPictAspectRatioY);
+
+    // The time stamp is the index of the access unit
+    mfxU64 nPicture = pSurface->Data.TimeStamp;
+    mfxU16 frameType = (nPicture < gop.pictures.size()) ? gop.pictures[(size_t)nPicture].frameType : 0;
+    if (frameType & MFX_FRAMETYPE_B)
+        outFrameData.frameType = QsFrameData::B;
+    else if (frameType & MFX_FRAMETYPE_P)
+        outFrameData.frameType = QsFrameData::P;
+    else if (frameType & MFX_FRAMETYPE_I)
+        outFrameData.frameType = QsFrameData::I;
+    else
+        outFrameData.frameType = QsFrameData::Invalid;
+
+    if (info.PicStruct & MFX_PICSTRUCT_PROGRESSIVE)
+    {
+        outFrameData.frameStructure = QsFrameData::fsProgressiveFrame;
+        outFrameData.dwInterlaceFlags = AM_VIDEO_FLAG_WEAVE;
+    }
+    else
+    {
+        outFrameData.frameStructure = QsFrameData::fsInterlacedFrame;
+        outFrameData.dwInterlaceFlags = (info.PicStruct & MFX_PICSTRUCT_FIELD_TFF) ? AM_VIDEO_FLAG_FIELD1FIRST : 0;
+    }
+
+    // Same layout as frames delivered by CQuickSync
+    outFrameData.rcFull.top    = outFrameData.rcFull.left = 0;
+    outFrameData.rcFull.bottom = (LONG)height - 1;
+    outFrameData.rcFull.right  = MSDK_ALIGN16(info.CropW + info.CropX) - 1;
+    outFrameData.rcClip.top    = 0;
+    outFrameData.rcClip.bottom = (LONG)height - 1;
+    outFrameData.rcClip.left   = info.CropX;
+    outFrameData.rcClip.right  = info.CropW + info.CropX - 1;
+    outFrameData.dwStride      = (DWORD)pitch;
+    outFrameData.y = frame.pBuffer->GetBuffer();
+    outFrameData.u = outFrameData.y + pitch * height;
+
+    // D3D9 surfaces are in USWC memory
+    Tmemcpy memcpyFunc = (m_pDecoder->IsD3DAlloc() && !m_pDecoder->IsD3D11Alloc()) ?
+        CQsCopyKernels::Instance().GetCopyFunc((QsCopyKernel)m_Config.nCopyKernel) : memcpy;
+    memcpyFunc(outFrameData.y, frameData.Y + info.CropY * pitch, pitch * height);
+    memcpyFunc(outFrameData.u, frameData.CbCr + (info.CropY / 2) * pitch, pitch * height / 2);
+
+    m_pDecoder->UnlockFrame(pSurface, &frameData);
+    gop.frames.push_back(frame);
+}
+
+////////////////////////////////////////////////////////////////////
+//                      CQsOfflineDecoder
+////////////////////////////////////////////////////////////////////
+CQsOfflineDecoder::CQsOfflineDecoder(const CQsConfig& cfg, CQsGopDecoderFactory* pFactory) :
+    m_Config(cfg),
+    m_pFactory((pFactory) ? pFactory : &m_MsdkFactory),
+    m_nParallelism(2),
+    m_pCurrentGop(NULL),
+    m_bAuHasPicture(false),
+    m_bFieldPending(false),
+    m_rtPending(INVALID_REFTIME),
+    m_nNextGop(0),
+    m_bAbort(false),
+    m_hWindow(NULL),
+    m_rtNext(0)
+{
+    MSDK_TRACE("QsOffline: Constructor\n");
+    MSDK_ZERO_VAR(m_PrevIdr);
+    MSDK_ZERO_VAR(m_LastField);
+
+    if (0 == m_Config.nAsyncDepth)
+    {
+        m_Config.nAsyncDepth = OFFLINE_ASYNC_DEPTH;
+    }
+
+    // Copies run on the GOP decoders' threads
+    m_Config.bEnableMtCopy = false;
+    m_hGopDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+CQsOfflineDecoder::~CQsOfflineDecoder()
+{
+    MSDK_TRACE("QsOffline: Destructor\n");
+    ClearGops();
+    MSDK_SAFE_DELETE(m_pCurrentGop);
+    CloseHandle(m_hGopDone);
+}
+
+void CQsOfflineDecoder::SetParallelism(unsigned nDecoders)
+{
+    m_nParallelism = max(1, min(nDecoders, MAXIMUM_WAIT_OBJECTS));
+}
+
+HRESULT CQsOfflineDecoder::AddSample(const BYTE* pData, size_t nSize, REFERENCE_TIME rtStart)
+{
+    MSDK_CHECK_POINTER(pData, E_POINTER);
+
+    if (NULL == m_pCurrentGop)
+    {
+        StartGop(NULL);
+    }
+
+    // The time stamp belongs to the first picture of the sample
+    m_rtPending = rtStart;
+
+    H264_NaluIterator itStartCode(pData, nSize, 0);
+    H264_NAL_RC rc;
+    while (NALU_EOS != (rc = itStartCode.Next()))
+    {
+        // Samples hold whole NALUs - the last one isn't partial
+        if (NALU_INVALID == rc || itStartCode.GetDataLength() < 2)
+            continue;
+
+        AddNalu(itStartCode.GetNALBuffer(), itStartCode.GetNalLength(),
+            itStartCode.GetDataBuffer() + 1, itStartCode.GetDataLength() - 1, itStartCode.GetNaluType());
+    }
+
+    return S_OK;
+}
+
+void CQsOfflineDecoder::AddNalu(const BYTE* pNalu, size_t nNaluSize, const BYTE* pPayload, size_t nPayloadSize, NALU_TYPE type)
+{
+    bool bVcl = (type >= NALU_TYPE_SLICE && type <= NALU_TYPE_IDR);
+
+    // first_mb_in_slice is 0 (a single '1' bit) in the first slice of a picture
+    bool bFirstSlice = bVcl && (pPayload[0] & 0x80);
+
+    // A new access unit starts with the first slice of a picture or with AUD/SEI/SPS/PPS after a picture (7.4.1.2.3)
+    bool bAuStart = m_bAuHasPicture &&
+        (bFirstSlice || (type >= NALU_TYPE_SEI && type <= NALU_TYPE_AUD));
+
+    if (bAuStart)
+    {
+        m_pCurrentGop->nAuStart = m_pCurrentGop->data.size();
+        m_pCurrentGop->nAuParameterSets = 0;
+    }
+
+    if (NALU_TYPE_SPS == type && nPayloadSize > 3)
+    {
+        // seq_parameter_set_id follows profile_idc, the constraint flags and level_idc
+        CH264BitReader bs(pPayload + 3, nPayloadSize - 3);
+        StoreParameterSet(m_SPS, H264_MAX_SPS_COUNT, bs.GetUE(), pNalu, nNaluSize);
+        m_Parser.ParseSPS(pPayload, nPayloadSize);
+        m_pCurrentGop->nAuParameterSets |= AU_HAS_SPS;
+    }
+    else if (NALU_TYPE_PPS == type)
+    {
+        CH264BitReader bs(pPayload, nPayloadSize);
+        StoreParameterSet(m_PPS, H264_MAX_PPS_COUNT, bs.GetUE(), pNalu, nNaluSize);
+        m_Parser.ParsePPS(pPayload, nPayloadSize);
+        m_pCurrentGop->nAuParameterSets |= AU_HAS_PPS;
+    }
+    else if (bFirstSlice)
+    {
+        H264_SliceHeader header;
+        bool bHeader = m_Parser.ParseSliceHeader(*(pPayload - 1), pPayload, nPayloadSize, header) && header.has_picture_info;
+
+        if (NALU_TYPE_IDR == type)
+        {
+            // The second field of an IDR frame stays with the first one
+            bool bSecondField = bHeader && m_PrevIdr.bValid && header.field_pic_flag && m_PrevIdr.bField &&
+                header.bottom_field_flag != m_PrevIdr.bBottom && header.idr_pic_id == m_PrevIdr.nIdrPicId;
+
+            if (m_pCurrentGop->bHasPicture && !bSecondField)
+            {
+                StartGop(m_pCurrentGop);
+            }
+
+            m_PrevIdr.bValid = bHeader;
+            m_PrevIdr.bField = bHeader && header.field_pic_flag;
+            m_PrevIdr.bBottom = bHeader && header.bottom_field_flag;
+            m_PrevIdr.nIdrPicId = (bHeader) ? header.idr_pic_id : 0;
+        }
+        else
+        {
+            m_PrevIdr.bValid = false;
+        }
+
+        // The frame type is the type of the first field
+        std::vector<TQsGopPicture>& pictures = m_pCurrentGop->pictures;
+        if (m_bFieldPending && IsSecondField(header, m_LastField))
+        {
+            m_bFieldPending = false;
+            if (!pictures.empty())
+                pictures.back().frameType |= GetH264FrameType(header) & MFX_FRAMETYPE_REF;
+        }
+        else
+        {
+            // The first access unit of a GOP starts with its parameter sets
+            TQsGopPicture picture = { (pictures.empty()) ? 0 : m_pCurrentGop->nAuStart, (mfxU16)((bHeader) ? GetH264FrameType(header) : 0) };
+            pictures.push_back(picture);
+            m_bFieldPending = bHeader && header.field_pic_flag;
+            m_LastField = header;
+        }
+
+        if (m_rtPending != INVALID_REFTIME)
+        {
+            m_pCurrentGop->timeStamps.push_back(m_rtPending);
+            m_rtPending = INVALID_REFTIME;
+        }
+    }
+    else if (bVcl && !m_pCurrentGop->pictures.empty())
+    {
+        // Additional slices
+        H264_SliceHeader header;
+        TQsGopPicture& picture = m_pCurrentGop->pictures.back();
+        if (picture.frameType != 0 && m_Parser.ParseSliceHeader(*(pPayload - 1), pPayload, nPayloadSize, header) && header.has_picture_info)
+        {
+            picture.frameType |= GetH264FrameType(header);
+        }
+    }
+
+    m_pCurrentGop->bHasPicture = m_pCurrentGop->bHasPicture || bVcl;
+    m_pCurrentGop->data.insert(m_pCurrentGop->data.end(), pNalu, pNalu + nNaluSize);
+
+    // End of sequence/stream and filler data stay in the access unit of the picture
+    m_bAuHasPicture = bVcl || (m_bAuHasPicture && !bAuStart);
+}
+
+void CQsOfflineDecoder::StartGop(TInputGop* pPrevGop)
+{
+    TInputGop* pGop = new TInputGop;
+
+    // Parameter sets seen so far unless the access unit carries its own
+    if (NULL == pPrevGop || pPrevGop->nAuParameterSets != (AU_HAS_SPS | AU_HAS_PPS))
+    {
+        for (size_t i = 0; i < H264_MAX_SPS_COUNT; ++i)
+        {
+            pGop->data.insert(pGop->data.end(), m_SPS[i].begin(), m_SPS[i].end());
+        }
+
+        for (size_t i = 0; i < H264_MAX_PPS_COUNT; ++i)
+        {
+            pGop->data.insert(pGop->data.end(), m_PPS[i].begin(), m_PPS[i].end());
+        }
+    }
+
+    // The access unit that starts the new GOP moves over
+    if (pPrevGop)
+    {
+        pGop->nAuStart = pGop->data.size();
+        pGop->nAuParameterSets = pPrevGop->nAuParameterSets;
+        pGop->data.insert(pGop->data.end(), pPrevGop->data.begin() + pPrevGop->nAuStart, pPrevGop->data.end());
+        pPrevGop->data.resize(pPrevGop->nAuStart);
+        m_Gops.push_back(pPrevGop);
+    }
+
+    m_pCurrentGop = pGop;
+}
+
+void CQsOfflineDecoder::StoreParameterSet(std::vector<BYTE>* pSets, size_t nMaxSets, uint32_t id, const BYTE* pNalu, size_t nSize)
+{
+    if (id < nMaxSets)
+    {
+        pSets[id].assign(pNalu, pNalu + nSize);
+    }
+}
+
+HRESULT CQsOfflineDecoder::Decode(void* obj, TQS_DeliverSurfaceCallback func)
+{
+    MSDK_CHECK_POINTER(func, E_POINTER);
+
+    // The GOP being split is complete. Input added later starts a new one.
+    if (m_pCurrentGop && m_pCurrentGop->bHasPicture)
+    {
+        m_Gops.push_back(m_pCurrentGop);
+        m_pCurrentGop = NULL;
+        m_bAuHasPicture = false;
+        m_bFieldPending = false;
+    }
+
+    const size_t nGops = m_Gops.size();
+    if (0 == nGops)
+        return S_OK;
+
+    CQsTimer timer;
+    timer.Start();
+
+    unsigned nThreads = (unsigned)min(m_nParallelism, nGops);
+    LONG nWindow = (LONG)(nThreads * OFFLINE_GOPS_AHEAD);
+    m_hWindow = CreateSemaphore(NULL, nWindow, LONG_MAX, NULL);
+    m_nNextGop = 0;
+    m_bAbort = false;
+
+    std::vector<HANDLE> threads;
+    for (unsigned i = 0; i < nThreads; ++i)
+    {
+        HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, &WorkerThreadProc, this, 0, NULL);
+        if (hThread)
+        {
+            threads.push_back(hThread);
+        }
+    }
+
+    HRESULT hr = (threads.empty()) ? E_FAIL : S_OK;
+    MSDK_TRACE("QsOffline: decoding %u GOPs on %u decoders\n", (unsigned)nGops, (unsigned)threads.size());
+
+    // Deliver the GOPs in order as they complete
+    for (size_t i = 0; i < nGops && SUCCEEDED(hr); ++i)
+    {
+        TQsGop* pGop = m_Gops[i];
+        while (!pGop->bDone)
+        {
+            WaitForSingleObject(m_hGopDone, INFINITE);
+        }
+
+        hr = pGop->hr;
+        if (SUCCEEDED(hr))
+        {
+            DeliverGop(*pGop, obj, func);
+        }
+
+        // Frees the frames - another GOP may be decoded ahead
+        delete pGop;
+        m_Gops[i] = NULL;
+        ReleaseSemaphore(m_hWindow, 1, NULL);
+    }
+
+    // Workers waiting for the window stop
+    if (FAILED(hr))
+    {
+        MSDK_TRACE("QsOffline: decoding failed!\n");
+        m_bAbort = true;
+        ReleaseSemaphore(m_hWindow, nThreads, NULL);
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+
+    CloseHandle(m_hWindow);
+    m_hWindow = NULL;
+    ClearGops();
+
+    timer.Stop();
+    MSDK_TRACE("QsOffline: decoding took %u ms\n", (unsigned)(timer.GetDuration() / 1000));
+    return hr;
+}
+
+void CQsOfflineDecoder::DeliverGop(TQsGop& gop, void* obj, TQS_DeliverSurfaceCallback func)
+{
+    // Input time stamps in presentation order
+    std::vector<REFERENCE_TIME>& timeStamps = gop.timeStamps;
+    std::sort(timeStamps.begin(), timeStamps.end());
+    REFERENCE_TIME rtDuration = (gop.rtFrameDuration > 0) ? gop.rtFrameDuration : OFFLINE_DEFAULT_FRAME_DURATION;
+
+    for (size_t i = 0; i < gop.frames.size(); ++i)
+    {
+        // Frames beyond the input time stamps continue from the last one
+        REFERENCE_TIME rtStart = (i < timeStamps.size()) ? timeStamps[i] : m_rtNext;
+        m_rtNext = rtStart + rtDuration;
+
+        QsFrameData& frameData = gop.frames[i].frameData;
+        frameData.rtStart = rtStart;
+        frameData.rtStop = rtStart + 1;
+        func(obj, &frameData);
+    }
+}
+
+void CQsOfflineDecoder::ClearGops()
+{
+    for (size_t i = 0; i < m_Gops.size(); ++i)
+    {
+        delete m_Gops[i];
+    }
+
+    m_Gops.clear();
+}
+
+unsigned __stdcall CQsOfflineDecoder::WorkerThreadProc(void* pThis)
+{
+    return ((CQsOfflineDecoder*)pThis)->WorkerThreadMsgLoop();
+}
+
+unsigned CQsOfflineDecoder::WorkerThreadMsgLoop()
+{
+    SetThreadName("*** QS Offline Decoder ***");
+
+    // Each worker has its own session
+    CQsGopDecoder* pDecoder = m_pFactory->CreateGopDecoder(m_Config);
+    const LONG nGops = (LONG)m_Gops.size();
+
+    while (!m_bAbort)
+    {
+        // Don't run too far ahead of the delivery
+        WaitForSingleObject(m_hWindow, INFINITE);
+        LONG i = InterlockedIncrement(&m_nNextGop) - 1;
+        if (i >= nGops || m_bAbort)
+            break;
+
+        TQsGop& gop = *m_Gops[i];
+        gop.hr = (pDecoder) ? pDecoder->DecodeGop(gop) : E_OUTOFMEMORY;
+        gop.bDone = true;
+        SetEvent(m_hGopDone);
+    }
+
+    delete pDecoder;
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+class CQuickSyncDecoder;
+
+// A frame decoded by a GOP decoder. The planes point into pBuffer.
+struct TQsOfflineFrame
+{
+    QsFrameData       frameData;
+    CQsAlignedBuffer* pBuffer;
+};
+
+// An access unit of a GOP. It spans the data up to the next access unit - the first one starts with
+// the parameter sets. Both fields of a frame are in a single access unit.
+struct TQsGopPicture
+{
+    size_t nOffset;
+    mfxU16 frameType;   // MFX_FRAMETYPE_* from the slice headers, 0 - unknown
+};
+
+// A group of pictures that decodes on its own - starts with an IDR access unit and holds
+// the parameter sets it needs (AnnexB H264).
+struct TQsGop
+{
+    TQsGop() : rtFrameDuration(0), hr(S_OK), bDone(false) {}
+    virtual ~TQsGop(); // GOPs being split are deleted as TQsGop
+
+    std::vector<BYTE>             data;
+    std::vector<TQsGopPicture>    pictures;        // Access units (decoding order)
+    std::vector<REFERENCE_TIME>   timeStamps;      // Input time stamps (decoding order), empty when the input has none
+    std::vector<TQsOfflineFrame>  frames;          // Output frames (display order) - filled by the GOP decoder
+    REFERENCE_TIME                rtFrameDuration; // From the stream's frame rate, 0 - unknown. Set by the GOP decoder.
+    HRESULT                       hr;
+    volatile bool                 bDone;
+};
+
+// Decodes whole GOPs. Each worker thread of the offline decoder has its own instance.
+class CQsGopDecoder
+{
+public:
+    virtual ~CQsGopDecoder() {}
+
+    // Decodes all pictures of the GOP into gop.frames (time stamps are set later)
+    virtual HRESULT DecodeGop(TQsGop& gop) = 0;
+};
+
+// Creates the GOP decoders. The default creates MSDK decoders.
+// Can be replaced to run the offline decoder with stub decoders (no GPU needed).
+class CQsGopDecoderFactory
+{
+public:
+    virtual ~CQsGopDecoderFactory() {}
+    virtual CQsGopDecoder* CreateGopDecoder(const CQsConfig& cfg);
+};
+
+// Decodes a GOP on an independent MSDK session. Frames are copied to system memory.
+// Access units are fed one at a time with their index as the time stamp - it gives the frame type of an output surface.
+class CQsMsdkGopDecoder : public CQsGopDecoder
+{
+public:
+    CQsMsdkGopDecoder(const CQsConfig& cfg);
+    ~CQsMsdkGopDecoder();
+    HRESULT DecodeGop(TQsGop& gop);
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsMsdkGopDecoder);
+
+    mfxStatus InitDecoder(mfxBitstream& bs);
+    static void SetAccessUnit(const TQsGop& gop, size_t nPicture, mfxBitstream& bs);
+    void CopyFrame(mfxFrameSurface1* pSurface, TQsGop& gop);
+
+    CQsConfig            m_Config;
+    CQsDeviceBusyHandler m_BusyHandler;
+    CQuickSyncDecoder*   m_pDecoder;
+    mfxVideoParam        m_VideoParams;
+    mfxU32               m_nPitch;
+    bool                 m_bInitialized;
+};
+
+// Offline (batch) decoding of H264 AnnexB streams - throughput over latency.
+// The input is split at IDR access units found with H264_NaluIterator. The GOPs are decoded at once by
+// several GOP decoders and the frames are delivered in presentation order from the thread that calls Decode.
+// Only a limited number of GOPs beyond the one being delivered are decoded ahead (memory bound).
+class CQsOfflineDecoder : public IQsOfflineDecoder
+{
+public:
+    CQsOfflineDecoder(const CQsConfig& cfg, CQsGopDecoderFactory* pFactory = NULL);
+    virtual ~CQsOfflineDecoder();
+
+    virtual void SetParallelism(unsigned nDecoders);
+    virtual HRESULT AddSample(const BYTE* pData, size_t nSize, REFERENCE_TIME rtStart);
+    virtual HRESULT Decode(void* obj, TQS_DeliverSurfaceCallback func);
+
+    size_t GetGopCount() const { return m_Gops.size() + ((m_pCurrentGop && m_pCurrentGop->bHasPicture) ? 1 : 0); }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsOfflineDecoder);
+
+    // GOP being split from the input
+    struct TInputGop : public TQsGop
+    {
+        TInputGop() : nAuStart(0), nAuParameterSets(0), bHasPicture(false) {}
+        size_t   nAuStart;          // Offset of the current access unit
+        unsigned nAuParameterSets;  // Parameter sets in the current access unit (AU_HAS_* flags)
+        bool     bHasPicture;
+    };
+
+    // First slice of the previous picture when it was an IDR picture
+    struct TIdrPicture
+    {
+        bool     bValid;
+        bool     bField;
+        bool     bBottom;
+        uint32_t nIdrPicId;
+    };
+
+    void AddNalu(const BYTE* pNalu, size_t nNaluSize, const BYTE* pPayload, size_t nPayloadSize, NALU_TYPE type);
+
+    // Starts a new GOP with the current access unit of pPrevGop (NULL - empty)
+    void StartGop(TInputGop* pPrevGop);
+    void StoreParameterSet(std::vector<BYTE>* pSets, size_t nMaxSets, uint32_t id, const BYTE* pNalu, size_t nSize);
+    void DeliverGop(TQsGop& gop, void* obj, TQS_DeliverSurfaceCallback func);
+    void ClearGops();
+
+    static unsigned __stdcall WorkerThreadProc(void* pThis);
+    unsigned WorkerThreadMsgLoop();
+
+    CQsConfig             m_Config;
+    CQsGopDecoderFactory* m_pFactory;
+    CQsGopDecoderFactory  m_MsdkFactory;
+    unsigned              m_nParallelism;
+
+    // Input
+    TInputGop*            m_pCurrentGop;
+    std::vector<TQsGop*>  m_Gops;
+    bool                  m_bAuHasPicture;  // The next first slice or AUD/SEI/SPS/PPS starts a new access unit
+    REFERENCE_TIME        m_rtPending;      // Time stamp of the sample's first picture
+    CH264Parser           m_Parser;         // Slice headers tell the second field of an IDR frame apart
+    TIdrPicture           m_PrevIdr;
+    H264_SliceHeader      m_LastField;      // First field of the previous picture
+    bool                  m_bFieldPending;  // The second field of m_LastField may follow
+    std::vector<BYTE>     m_SPS[H264_MAX_SPS_COUNT];
+    std::vector<BYTE>     m_PPS[H264_MAX_PPS_COUNT];
+
+    // Decoding
+    volatile LONG         m_nNextGop;       // Next GOP to decode
+    volatile bool         m_bAbort;
+    HANDLE                m_hGopDone;       // Set when a worker finished a GOP
+    HANDLE                m_hWindow;        // Counts the GOPs that may be decoded ahead of delivery
+    REFERENCE_TIME        m_rtNext;         // Time stamp of the next frame when the input has none
+};
@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "stdafx.h"
+#include "IQuickSyncDecoder.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "hw_device.h"
+#include "d3d_allocator.h"
+#include "d3d11_allocator.h"
+#include "sysmem_allocator.h"
+#include "d3d_device.h"
+#include "d3d11_device.h"
+#include "QuickSyncDecoder.h"
+#include "QuickSyncPool.h"
+
+// Constructed when the DLL is loaded - function local statics aren't thread safe with older compilers
+CQsDecoderPool CQsDecoderPool::s_Instance;
+
+CQsDecoderPool& CQsDecoderPool::Instance()
+{
+    return s_Instance;
+}
+
+CQsDecoderPool::CQsDecoderPool() :
+    m_pFactory(&m_MsdkFactory),
+    m_nMaxStreamsPerDevice(0),
+    m_nStreams(0)
+{
+}
+
+CQsDecoderPool::~CQsDecoderPool()
+{
+    // Streams that are still open belong to decoders that were never destroyed.
+    // MSDK can't be called safely while the DLL is unloaded so the devices are leaked.
+    ASSERT(m_Devices.empty());
+}
+
+mfxStatus CQsDecoderPool::OpenStream(mfxIMPL impl, const mfxVersion& minVersion, TQsPoolStream*& pStream)
+{
+    CQsAutoLock lock(&m_csLock);
+    pStream = NULL;
+
+    TDevice* pDevice = FindDevice(impl);
+    mfxStatus sts = MFX_ERR_NONE;
+    if (NULL == pDevice)
+    {
+        sts = CreateDevice(impl, minVersion, pDevice);
+        MSDK_CHECK_RESULT_P_RET(sts, MFX_ERR_NONE);
+    }
+
+    // The child session uses the same implementation as the parent
+    mfxVersion version = pDevice->version;
+    MFXVideoSession* pSession = m_pFactory->CreateSession();
+    sts = pSession->Init(pDevice->impl, &version);
+    if (MSDK_SUCCEEDED(sts))
+    {
+        sts = AttachSession(*pDevice, pSession);
+    }
+
+    if (MSDK_SUCCEEDED(sts))
+    {
+        // From now on the parent's scheduler runs the child's tasks
+        sts = pDevice->pParent->JoinSession((mfxSession)*pSession);
+    }
+
+    if (MSDK_FAILED(sts))
+    {
+        MSDK_TRACE("QsDecoder: pool failed to open a stream (%i)\n", (int)sts);
+        delete pSession;
+        if (0 == pDevice->nStreams)
+        {
+            DestroyDevice(pDevice);
+        }
+
+        return sts;
+    }
+
+    pStream = new TQsPoolStream;
+    pStream->pSession   = pSession;
+    pStream->pDecoder   = m_pFactory->CreateDecoder(pSession);
+    pStream->pAllocator = pDevice->pAllocator;
+    pStream->pHwDevice  = pDevice->pHwDevice;
+    pStream->impl       = pDevice->impl;
+    pStream->version    = pDevice->version;
+    pStream->pOwner     = pDevice;
+
+    ++pDevice->nStreams;
+    ++m_nStreams;
+    MSDK_TRACE("QsDecoder: pool opened a stream (%u streams, %u devices)\n", (unsigned)m_nStreams, (unsigned)m_Devices.size());
+    return MFX_ERR_NONE;
+}
+
+void CQsDecoderPool::CloseStream(TQsPoolStream* pStream)
+{
+    MSDK_CHECK_POINTER_NO_RET(pStream);
+    CQsAutoLock lock(&m_csLock);
+
+    TDevice* pDevice = (TDevice*)pStream->pOwner;
+    ASSERT(std::find(m_Devices.begin(), m_Devices.end(), pDevice) != m_Devices.end());
+
+    // A child session must leave the parent before it's closed
+    delete pStream->pDecoder;
+    pStream->pSession->DisjoinSession();
+    delete pStream->pSession;
+    delete pStream;
+
+    --m_nStreams;
+    if (0 == --pDevice->nStreams)
+    {
+        DestroyDevice(pDevice);
+    }
+
+    MSDK_TRACE("QsDecoder: pool closed a stream (%u streams, %u devices)\n", (unsigned)m_nStreams, (unsigned)m_Devices.size());
+}
+
+void CQsDecoderPool::SetMaxStreamsPerDevice(size_t nMaxStreams)
+{
+    CQsAutoLock lock(&m_csLock);
+    m_nMaxStreamsPerDevice = nMaxStreams;
+}
+
+bool CQsDecoderPool::SetSessionFactory(CQsSessionFactory* pFactory)
+{
+    CQsAutoLock lock(&m_csLock);
+    if (!m_Devices.empty())
+        return false;
+
+    m_pFactory = (pFactory) ? pFactory : &m_MsdkFactory;
+    return true;
+}
+
+size_t CQsDecoderPool::GetDeviceCount()
+{
+    CQsAutoLock lock(&m_csLock);
+    return m_Devices.size();
+}
+
+size_t CQsDecoderPool::GetStreamCount()
+{
+    CQsAutoLock lock(&m_csLock);
+    return m_nStreams;
+}
+
+CQsDecoderPool::TDevice* CQsDecoderPool::FindDevice(mfxIMPL impl)
+{
+    // Fill the devices in creation order so streams gather on as few devices as possible
+    for (auto it = m_Devices.begin(); it != m_Devices.end(); ++it)
+    {
+        TDevice* pDevice = *it;
+        if (pDevice->requestedImpl == impl && (0 == m_nMaxStreamsPerDevice || pDevice->nStreams < m_nMaxStreamsPerDevice))
+            return pDevice;
+    }
+
+    return NULL;
+}
+
+mfxStatus CQsDecoderPool::CreateDevice(mfxIMPL impl, const mfxVersion& minVersion, TDevice*& pDevice)
+{
+    pDevice = new TDevice;
+    MSDK_ZERO_MEMORY(pDevice, sizeof(TDevice));
+    pDevice->requestedImpl = impl;
+    pDevice->version = minVersion;
+    m_Devices.push_back(pDevice);
+
+    // The parent session never decodes - it only owns the scheduler shared by the streams
+    pDevice->pParent = m_pFactory->CreateSession();
+    mfxStatus sts = pDevice->pParent->Init(impl, &pDevice->version);
+    if (MSDK_SUCCEEDED(sts))
+    {
+        pDevice->pParent->QueryIMPL(&pDevice->impl);
+        pDevice->pParent->QueryVersion(&pDevice->version);
+        sts = CreateAllocator(*pDevice);
+    }
+
+    if (MSDK_SUCCEEDED(sts))
+    {
+        sts = AttachSession(*pDevice, pDevice->pParent);
+    }
+
+    if (MSDK_FAILED(sts))
+    {
+        MSDK_TRACE("QsDecoder: pool failed to create a device (%i)\n", (int)sts);
+        DestroyDevice(pDevice);
+        pDevice = NULL;
+    }
+
+    return sts;
+}
+
+mfxStatus CQsDecoderPool::CreateAllocator(TDevice& device)
+{
+    std::auto_ptr<mfxAllocatorParams> pParam(NULL);
+    mfxStatus sts = MFX_ERR_NONE;
+
+    // SW implementation
+    if (MFX_IMPL_SOFTWARE == device.impl)
+    {
+        device.pAllocator = new SysMemFrameAllocator();
+        return device.pAllocator->Init(NULL);
+    }
+
+    int nAdapterID = GetMSDKAdapterNumber(*device.pParent);
+    if ((device.impl & MFX_IMPL_VIA_D3D11) == MFX_IMPL_VIA_D3D11)
+    {
+#if MFX_D3D11_SUPPORT
+        device.pHwDevice = new CD3D11Device();
+        sts = device.pHwDevice->Init(nAdapterID);
+        MSDK_CHECK_RESULT_P_RET(sts, MFX_ERR_NONE);
+
+        D3D11AllocatorParams* p = new D3D11AllocatorParams;
+        p->pDevice = (ID3D11Device*)device.pHwDevice->GetHandle(MFX_HANDLE_D3D11_DEVICE);
+        pParam.reset(p);
+        device.pAllocator = new D3D11FrameAllocator();
+#else
+        return MFX_ERR_UNSUPPORTED;
+#endif
+    }
+    else
+    {
+        // The device isn't shared with a renderer - full screen exclusive mode isn't supported
+        device.pHwDevice = new CD3D9Device(NULL);
+        sts = device.pHwDevice->Init(nAdapterID);
+        MSDK_CHECK_RESULT_P_RET(sts, MFX_ERR_NONE);
+
+        D3DAllocatorParams* p = new D3DAllocatorParams;
+        p->pManager = (IDirect3DDeviceManager9*)device.pHwDevice->GetHandle(MFX_HANDLE_D3D9_DEVICE_MANAGER);
+        pParam.reset(p);
+        device.pAllocator = new D3DFrameAllocator();
+    }
+
+    return device.pAllocator->Init(pParam.get());
+}
+
+mfxStatus CQsDecoderPool::AttachSession(TDevice& device, MFXVideoSession* pSession)
+{
+    mfxStatus sts = MFX_ERR_NONE;
+    if (device.pHwDevice)
+    {
+        bool bD3D11 = (device.impl & MFX_IMPL_VIA_D3D11) == MFX_IMPL_VIA_D3D11;
+        mfxHandleType type = (bD3D11) ? MFX_HANDLE_D3D11_DEVICE : MFX_HANDLE_D3D9_DEVICE_MANAGER;
+        sts = pSession->SetHandle(type, device.pHwDevice->GetHandle(type));
+        MSDK_CHECK_RESULT_P_RET(sts, MFX_ERR_NONE);
+    }
+
+    return pSession->SetFrameAllocator(device.pAllocator);
+}
+
+void CQsDecoderPool::DestroyDevice(TDevice* pDevice)
+{
+    ASSERT(0 == pDevice->nStreams);
+    auto it = std::find(m_Devices.begin(), m_Devices.end(), pDevice);
+    if (it != m_Devices.end())
+    {
+        m_Devices.erase(it);
+    }
+
+    // The session is closed before the objects it uses
+    delete pDevice->pParent;
+    delete pDevice->pAllocator;
+    delete pDevice->pHwDevice;
+    delete pDevice;
+}
+
+CQsWarmDecoderCache CQsWarmDecoderCache::s_Instance;
+
+CQsWarmDecoderCache& CQsWarmDecoderCache::Instance()
+{
+    return s_Instance;
+}
+
+CQsWarmDecoderCache::CQsWarmDecoderCache() :
+    m_nCapacity(0)
+{
+}
+
+CQsWarmDecoderCache::~CQsWarmDecoderCache()
+{
+    // Like the decoder pool - the application should empty the cache (SetCapacity(0)) before unloading the DLL
+    ASSERT(m_Decoders.empty());
+}
+
+CQuickSyncDecoder* CQsWarmDecoderCache::Acquire(bool bPooled, mfxIMPL impl, mfxU32 codecId, mfxU16 width, mfxU16 height)
+{
+    CQsAutoLock lock(&m_csLock);
+
+    auto best = m_Decoders.end();
+    for (auto it = m_Decoders.begin(); it != m_Decoders.end(); ++it)
+    {
+        // A pooled decoder's session is joined to the pool's device - it can't replace a private session
+        if ((*it)->IsPooled() != bPooled || (*it)->GetRequestedImpl() != impl)
+            continue;
+
+        if ((*it)->IsWarmFor(codecId, width, height) &&
+            (best == m_Decoders.end() || (*it)->GetAllocatedArea() < (*best)->GetAllocatedArea()))
+        {
+            best = it;
+        }
+    }
+
+    if (best == m_Decoders.end())
+        return NULL;
+
+    CQuickSyncDecoder* pDecoder = *best;
+    m_Decoders.erase(best);
+    return pDecoder;
+}
+
+bool CQsWarmDecoderCache::Release(CQuickSyncDecoder* pDecoder)
+{
+    MSDK_CHECK_POINTER(pDecoder, false);
+    CQsAutoLock lock(&m_csLock);
+
+    if (m_Decoders.size() >= m_nCapacity || !pDecoder->Park(&m_IdleBusyHandler))
+        return false;
+
+    m_Decoders.push_back(pDecoder);
+    MSDK_TRACE("QsDecoder: warm decoder cache holds %u decoders\n", (unsigned)m_Decoders.size());
+    return true;
+}
+
+void CQsWarmDecoderCache::SetCapacity(size_t nCapacity)
+{
+    CQsAutoLock lock(&m_csLock);
+    m_nCapacity = nCapacity;
+
+    // The oldest decoders go first
+    while (m_Decoders.size() > m_nCapacity)
+    {
+        delete m_Decoders.front();
+        m_Decoders.erase(m_Decoders.begin());
+    }
+}
+
+size_t CQsWarmDecoderCache::GetCapacity()
+{
+    CQsAutoLock lock(&m_csLock);
+    return m_nCapacity;
+}
+
+size_t CQsWarmDecoderCache::GetSize()
+{
+    CQsAutoLock lock(&m_csLock);
+    return m_Decoders.size();
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+class CHWDevice;
+class MFXFrameAllocator;
+
+// Creates the MSDK objects used by the decoder pool.
+// Can be replaced to run the pool with stub sessions and decoders (no GPU needed).
+class CQsSessionFactory
+{
+public:
+    virtual ~CQsSessionFactory() {}
+    virtual MFXVideoSession* CreateSession() { return new MFXVideoSession; }
+    virtual MFXVideoDECODE* CreateDecoder(MFXVideoSession* pSession) { return new MFXVideoDECODE((mfxSession)*pSession); }
+};
+
+// A stream opened on the decoder pool - a child session joined to the parent session of a device.
+// All objects belong to the pool.
+struct TQsPoolStream
+{
+    MFXVideoSession*   pSession;
+    MFXVideoDECODE*    pDecoder;
+    MFXFrameAllocator* pAllocator; // Shared by the streams of the device
+    CHWDevice*         pHwDevice;  // Shared by the streams of the device, NULL for SW sessions
+    mfxIMPL            impl;       // Actual implementation
+    mfxVersion         version;    // Actual API version
+    void*              pOwner;     // Device the stream is joined to
+};
+
+// Process wide pool of decoding sessions.
+// Streams opened with the same implementation share a parent session (one scheduler for all of them),
+// the HW device and the frame allocator. Each stream allocates its own surfaces.
+// A device is created with its first stream and released with its last one.
+class CQsDecoderPool
+{
+public:
+    static CQsDecoderPool& Instance();
+
+    // impl and minVersion are passed to MFXInit when a new device is needed
+    mfxStatus OpenStream(mfxIMPL impl, const mfxVersion& minVersion, TQsPoolStream*& pStream);
+    void CloseStream(TQsPoolStream* pStream);
+
+    // Streams joined to a single parent session. A new device is created when all are full. 0 - no limit.
+    void SetMaxStreamsPerDevice(size_t nMaxStreams);
+
+    // Must be called when no stream is open. NULL restores the MSDK factory.
+    bool SetSessionFactory(CQsSessionFactory* pFactory);
+
+    size_t GetDeviceCount();
+    size_t GetStreamCount();
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsDecoderPool);
+    CQsDecoderPool();
+    ~CQsDecoderPool();
+
+    struct TDevice
+    {
+        mfxIMPL            requestedImpl;
+        mfxIMPL            impl;
+        mfxVersion         version;
+        MFXVideoSession*   pParent;
+        CHWDevice*         pHwDevice;
+        MFXFrameAllocator* pAllocator;
+        size_t             nStreams;
+    };
+
+    TDevice* FindDevice(mfxIMPL impl);
+    mfxStatus CreateDevice(mfxIMPL impl, const mfxVersion& minVersion, TDevice*& pDevice);
+    mfxStatus CreateAllocator(TDevice& device);
+    mfxStatus AttachSession(TDevice& device, MFXVideoSession* pSession);
+    void DestroyDevice(TDevice* pDevice);
+
+    static CQsDecoderPool s_Instance;
+
+    std::vector<TDevice*> m_Devices;
+    CQsSessionFactory     m_MsdkFactory;
+    CQsSessionFactory*    m_pFactory;
+    size_t                m_nMaxStreamsPerDevice;
+    size_t                m_nStreams;
+    CQsLock               m_csLock;
+};
+
+class CQuickSyncDecoder;
+
+// Idle decoders with an initialized session, HW device, surfaces and MSDK decoder.
+// A new stream takes one over and only needs a decoder Reset instead of a cold start, which shortens channel
+// switching. Decoders are added by prewarming or when a decoder is destroyed while the cache has room.
+class CQsWarmDecoderCache
+{
+public:
+    static CQsWarmDecoderCache& Instance();
+
+    // Most suitable idle decoder: same session kind (pooled or not, requested implementation),
+    // same codec and the smallest surfaces that fit width x height. Returns NULL when there's none.
+    CQuickSyncDecoder* Acquire(bool bPooled, mfxIMPL impl, mfxU32 codecId, mfxU16 width, mfxU16 height);
+
+    // Keeps an idle decoder. Returns false when the decoder can't be kept - the caller still owns it.
+    bool Release(CQuickSyncDecoder* pDecoder);
+
+    // Maximum number of idle decoders. Extra decoders are destroyed.
+    void SetCapacity(size_t nCapacity);
+    size_t GetCapacity();
+    size_t GetSize();
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsWarmDecoderCache);
+    CQsWarmDecoderCache();
+    ~CQsWarmDecoderCache();
+
+    static CQsWarmDecoderCache s_Instance;
+
+    std::vector<CQuickSyncDecoder*> m_Decoders; // Oldest first
+    size_t                          m_nCapacity;
+    CQsDeviceBusyHandler            m_IdleBusyHandler; // Idle decoders don't decode - placeholder for the owner's handler
+    CQsLock                         m_csLock;
+};
@@ -1,217 +1,484 @@
-/*
- * Copyright (c) 2011, INTEL CORPORATION
- * All rights reserved.
- * 
- * Redistribution and use in source and binary forms, with or without modification,
- * are permitted provided that the following conditions are met:
- * 
- * Redistributions of source code must retain the above copyright notice,
- * this list of conditions and the following disclaimer.
- * Redistributions in binary form must reproduce the above copyright notice,
- * this list of conditions and the following disclaimer in the documentation and/or
- * other materials provided with the distribution.
- * Neither the name of INTEL CORPORATION nor the names of its contributors may
- * be used to endorse or promote products derived from this software without specific
- * prior written permission.
- *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
- * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
- * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
- * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
- * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
- * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
- * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
- * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- * POSSIBILITY OF SUCH DAMAGE.
- */
-
-#pragma once
-
-extern "C" 
-{
-    // SSE4.1 based memcpy that copies from video memory to system memory
-    void* gpu_memcpy_sse41(void* d, const void* s, size_t _size);
-    // AVX2 based memcpy that copies from video memory to system memory
-    void* gpu_memcpy_avx2(void* d, const void* s, size_t size);
-    void* mt_memcpy(void* d, const void* s, size_t size);
-    void* mt_gpu_memcpy(void* d, const void* s, size_t size);
-}
-
-// Finds greatest common divider
-mfxU32 GCD(mfxU32 a, mfxU32 b);
-
-// Pixel Aspect Ratio to Display Aspect Ratio conversion
-mfxStatus PARtoDAR(DWORD parw, DWORD parh, DWORD w, DWORD h, DWORD& darw, DWORD& darh);
-
-// Display Aspect Ratio to Pixel Aspect Ratio conversion
-mfxStatus DARtoPAR(mfxU32 darw, mfxU32 darh, mfxU32 w, mfxU32 h, mfxU16& parw, mfxU16& parh);
-
-// Name from codec identifier (MSDK enum)
-const char* GetCodecName(DWORD codec);
-
-// Name of codec's profile - profile identifier is accoding to DirectShow
-const char* GetProfileName(DWORD codec, DWORD profile);
-
-// Returns true when running on SSE4.1 HW - Intel Penryn or newer.
-bool IsSSE41Enabled();
-
-// Returns true when running on AVX2 HW - Intel 4th generation Core (Haswell) or newer
-bool IsAVX2Enabled();
-
-// Set current thread name in VS debugger
-void SetThreadName(LPCSTR szThreadName, DWORD dwThreadID = -1 /* current thread */);
-
-// Get an Intel GPU ID using Direct3D9 (screen must be connected to Intel GPU)
-int GetIntelAdapterIdD3D9(IDirect3D9* _pd3d);
-
-// Get the ID of the adapter (GPU) associated with an MSDK session, -1 for SW session
-int GetMSDKAdapterNumber(mfxSession session);
-
-#ifdef _DEBUG
-// Print assert to debugger output
-void DebugAssert(const TCHAR *pCondition,const TCHAR *pFileName, int iLine);
-#endif
-
-typedef void* (*Tmemcpy)(void*, const void*, size_t);
-
-// Wrapper for low level critical section
-class CQsLock
-{
-    friend class CQsAutoLock;
-    friend class CQsAutoUnlock;
-public:
-    CQsLock()  { InitializeCriticalSection(&m_CritSec); }
-    ~CQsLock() { DeleteCriticalSection(&m_CritSec); }
-    __forceinline bool IsLocked()
-    {
-        if (TryEnterCriticalSection(&m_CritSec))
-        {
-            // Not locked
-            LeaveCriticalSection(&m_CritSec);
-            return false;
-        }
-
-        return true;
-    }
-
-private:
-    // Lock and Unlock are private and can only be called from
-    // the CQsAutoLock/CQsAutoUnlock classes
-    __forceinline void Lock()   { ASSERT(this != NULL); EnterCriticalSection(&m_CritSec); }
-    __forceinline void Unlock() { ASSERT(this != NULL); LeaveCriticalSection(&m_CritSec); }
-
-    // Make copy constructor and assignment operator inaccessible
-    DISALLOW_COPY_AND_ASSIGN(CQsLock)
-    CRITICAL_SECTION m_CritSec;
-};
-
-// Locks a critical section, and unlocks it automatically
-// when the auto-lock object goes out of scope
-class CQsAutoLock
-{
-public:
-    __forceinline CQsAutoLock(CQsLock* plock)
-    {
-        m_pLock = plock;
-        if (m_pLock != NULL)
-            m_pLock->Lock();
-    }
-
-    __forceinline ~CQsAutoLock()
-    {
-        if (m_pLock != NULL)
-            m_pLock->Unlock();
-    }
-
-private:
-    DISALLOW_COPY_AND_ASSIGN(CQsAutoLock);
-    CQsLock* m_pLock;
-};
-
-// Unlocks a critical section, and locks it automatically
-// when the auto-unlock object goes out of scope
-class CQsAutoUnlock
-{
-public:
-    __forceinline CQsAutoUnlock(CQsLock* plock)
-    {
-        m_pLock = plock;
-        if (m_pLock != NULL)
-            m_pLock->Unlock();
-    }
-
-    __forceinline ~CQsAutoUnlock()
-    {
-        if (m_pLock != NULL)
-            m_pLock->Lock();
-    }
-
-private:
-    DISALLOW_COPY_AND_ASSIGN(CQsAutoUnlock);
-    CQsLock* m_pLock;
-};
-
-// Simple SSE friendly buffer class
-class CQsAlignedBuffer
-{
-public:
-    CQsAlignedBuffer(size_t bufferSize) : m_BufferSize(bufferSize)
-    {
-        m_Buffer = (BYTE*)_aligned_malloc(m_BufferSize, 64);
-    }
-
-    ~CQsAlignedBuffer()
-    {
-        _aligned_free(m_Buffer);
-    }
-
-    __forceinline size_t GetBufferSize() { return m_BufferSize; }
-    __forceinline BYTE* GetBuffer() { return m_Buffer; }
-
-private:
-    size_t m_BufferSize;
-    BYTE* m_Buffer;
-};
-
-class CQsTimer
-{
-public:
-    CQsTimer()
-    {
-        LARGE_INTEGER freq;
-        QueryPerformanceFrequency(&freq);
-        m_Frequency = freq.QuadPart;
-
-        // Calibration
-        Start();
-        Stop();
-
-        m_Correction = m_Stop.QuadPart - m_Start.QuadPart;
-    }
-
-    __forceinline void Start()
-    {
-        // Ensure we will not be interrupted by any other thread for a while
-        Sleep(0);
-        QueryPerformanceCounter(&m_Start);
-    }
-
-    __forceinline void Stop()
-    {
-        QueryPerformanceCounter(&m_Stop);
-    }
-
-    __forceinline double GetDuration() const
-    {
-        return (double)(m_Stop.QuadPart - m_Start.QuadPart - m_Correction) * 1000000.0 / m_Frequency;
-    }
-
-
-protected:
-    LARGE_INTEGER m_Start;
-    LARGE_INTEGER m_Stop;
-
-    LONGLONG m_Frequency;
-    LONGLONG m_Correction;
-};
+/*
+ * Copyright (c) 2011, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+extern "C" 
+{
+    // SSE4.1 based memcpy that copies from video memory to system memory
+    void* gpu_memcpy_sse41(void* d, const void* s, size_t _size);
+    // AVX2 based memcpy that copies from video memory to system memory
+    void* gpu_memcpy_avx2(void* d, const void* s, size_t size);
+    // Copies from video memory to system memory with the fastest kernel for the CPU (see CQsCopyKernels)
+    void* gpu_memcpy(void* d, const void* s, size_t size);
+    void* mt_memcpy(void* d, const void* s, size_t size);
+    void* mt_gpu_memcpy(void* d, const void* s, size_t size);
+}
+
+struct CQsConfig;
+
+// Finds greatest common divider
+mfxU32 GCD(mfxU32 a, mfxU32 b);
+
+// Pixel Aspect Ratio to Display Aspect Ratio conversion
+mfxStatus PARtoDAR(DWORD parw, DWORD parh, DWORD w, DWORD h, DWORD& darw, DWORD& darh);
+
+// Display Aspect Ratio to Pixel Aspect Ratio conversion
+mfxStatus DARtoPAR(mfxU32 darw, mfxU32 darh, mfxU32 w, mfxU32 h, mfxU16& parw, mfxU16& parh);
+
+// Name from codec identifier (MSDK enum)
+const char* GetCodecName(DWORD codec);
+
+// Name of codec's profile - profile identifier is accoding to DirectShow
+const char* GetProfileName(DWORD codec, DWORD profile);
+
+// Returns true when running on SSE4.1 HW - Intel Penryn or newer.
+bool IsSSE41Enabled();
+
+// Returns true when running on AVX2 HW - Intel 4th generation Core (Haswell) or newer
+bool IsAVX2Enabled();
+
+// Returns true when running on AVX-512 HW with OS support - Intel Skylake-SP, Ice Lake or newer
+bool IsAVX512Enabled();
+
+// Copies the fields known to both configurations (see QS_CONFIG_VERSION).
+// The destination keeps its own version and the values of newer fields.
+void CopyConfig(CQsConfig* pDst, const CQsConfig* pSrc);
+
+// Set current thread name in VS debugger
+void SetThreadName(LPCSTR szThreadName, DWORD dwThreadID = -1 /* current thread */);
+
+// Get an Intel GPU ID using Direct3D9 (screen must be connected to Intel GPU)
+int GetIntelAdapterIdD3D9(IDirect3D9* _pd3d);
+
+// Get the ID of the adapter (GPU) associated with an MSDK session, -1 for SW session
+int GetMSDKAdapterNumber(mfxSession session);
+
+#ifdef _DEBUG
+// Print assert to debugger output
+void DebugAssert(const TCHAR *pCondition,const TCHAR *pFileName, int iLine);
+#endif
+
+typedef void* (*Tmemcpy)(void*, const void*, size_t);
+
+// Splits a copy between the threads of the copy thread pool (see CQsCopyThreadPool)
+void* mt_copy(void* d, const void* s, size_t size, Tmemcpy memcpyFunc);
+
+// Wrapper for low level critical section
+class CQsLock
+{
+    friend class CQsAutoLock;
+    friend class CQsAutoUnlock;
+public:
+    CQsLock()  { InitializeCriticalSection(&m_CritSec); }
+    ~CQsLock() { DeleteCriticalSection(&m_CritSec); }
+    __forceinline bool IsLocked()
+    {
+        if (TryEnterCriticalSection(&m_CritSec))
+        {
+            // Not locked
+            LeaveCriticalSection(&m_CritSec);
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    // Lock and Unlock are private and can only be called from
+    // the CQsAutoLock/CQsAutoUnlock classes
+    __forceinline void Lock()   { ASSERT(this != NULL); EnterCriticalSection(&m_CritSec); }
+    __forceinline void Unlock() { ASSERT(this != NULL); LeaveCriticalSection(&m_CritSec); }
+
+    // Make copy constructor and assignment operator inaccessible
+    DISALLOW_COPY_AND_ASSIGN(CQsLock)
+    CRITICAL_SECTION m_CritSec;
+};
+
+// Locks a critical section, and unlocks it automatically
+// when the auto-lock object goes out of scope
+class CQsAutoLock
+{
+public:
+    __forceinline CQsAutoLock(CQsLock* plock)
+    {
+        m_pLock = plock;
+        if (m_pLock != NULL)
+            m_pLock->Lock();
+    }
+
+    __forceinline ~CQsAutoLock()
+    {
+        if (m_pLock != NULL)
+            m_pLock->Unlock();
+    }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsAutoLock);
+    CQsLock* m_pLock;
+};
+
+// Unlocks a critical section, and locks it automatically
+// when the auto-unlock object goes out of scope
+class CQsAutoUnlock
+{
+public:
+    __forceinline CQsAutoUnlock(CQsLock* plock)
+    {
+        m_pLock = plock;
+        if (m_pLock != NULL)
+            m_pLock->Unlock();
+    }
+
+    __forceinline ~CQsAutoUnlock()
+    {
+        if (m_pLock != NULL)
+            m_pLock->Lock();
+    }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsAutoUnlock);
+    CQsLock* m_pLock;
+};
+
+// Simple SSE friendly buffer class
+class CQsAlignedBuffer
+{
+public:
+    CQsAlignedBuffer(size_t bufferSize) : m_BufferSize(bufferSize)
+    {
+        m_Buffer = (BYTE*)_aligned_malloc(m_BufferSize, 64);
+    }
+
+    ~CQsAlignedBuffer()
+    {
+        _aligned_free(m_Buffer);
+    }
+
+    __forceinline size_t GetBufferSize() { return m_BufferSize; }
+    __forceinline BYTE* GetBuffer() { return m_Buffer; }
+
+private:
+    size_t m_BufferSize;
+    BYTE* m_Buffer;
+};
+
+class CQsTimer
+{
+public:
+    CQsTimer()
+    {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        m_Frequency = freq.QuadPart;
+
+        // Calibration
+        Start();
+        Stop();
+
+        m_Correction = m_Stop.QuadPart - m_Start.QuadPart;
+    }
+
+    __forceinline void Start()
+    {
+        // Ensure we will not be interrupted by any other thread for a while
+        Sleep(0);
+        QueryPerformanceCounter(&m_Start);
+    }
+
+    __forceinline void Stop()
+    {
+        QueryPerformanceCounter(&m_Stop);
+    }
+
+    __forceinline double GetDuration() const
+    {
+        return (double)(m_Stop.QuadPart - m_Start.QuadPart - m_Correction) * 1000000.0 / m_Frequency;
+    }
+
+
+protected:
+    LARGE_INTEGER m_Start;
+    LARGE_INTEGER m_Stop;
+
+    LONGLONG m_Frequency;
+    LONGLONG m_Correction;
+};
+
+// Surfaces of a decoder or VPP.
+// A surface is free when the application holds no lock on it and MSDK doesn't use it (Data.Locked).
+// A bitmap of surfaces without application locks keeps the search away from surfaces held in queues.
+// A thread that finds no free surface blocks on an event that every release signals: application unlocks,
+// UnlockAll and completed MSDK operations (SignalRelease).
+class CQsSurfacePool
+{
+public:
+    CQsSurfacePool();
+    ~CQsSurfacePool();
+
+    // Sets the surfaces (NULL - none). All surfaces start unlocked.
+    void Init(mfxFrameSurface1* pSurfaces, size_t nCount);
+
+    // Drops all application locks
+    void UnlockAll();
+
+    __forceinline void LockSurface(mfxFrameSurface1* pSurface)
+    {
+        size_t i = GetIndex(pSurface);
+        if (i < m_nCount)
+        {
+            // The bitmap is updated lazily by the next search
+            if (1 == InterlockedIncrement(&m_LockCount[i]))
+            {
+                InterlockedIncrement(&m_nLocked);
+            }
+        }
+    }
+
+    __forceinline void UnlockSurface(mfxFrameSurface1* pSurface)
+    {
+        size_t i = GetIndex(pSurface);
+        if (i < m_nCount)
+        {
+            ASSERT(m_LockCount[i] > 0);
+            if (0 == InterlockedDecrement(&m_LockCount[i]))
+            {
+                InterlockedDecrement(&m_nLocked);
+                InterlockedOr(&m_Unlocked[i / 32], (LONG)(1u << (i % 32)));
+                SignalRelease();
+            }
+        }
+    }
+
+    // Wakes up threads waiting in FindFreeSurface. Called after an MSDK operation completed - it may have
+    // released surfaces (Data.Locked).
+    __forceinline void SignalRelease()
+    {
+        if (m_nWaiters > 0)
+        {
+            SetEvent(m_hReleaseEvent);
+        }
+    }
+
+    __forceinline bool IsSurfaceLocked(mfxFrameSurface1* pSurface) const
+    {
+        size_t i = GetIndex(pSurface);
+        return (i < m_nCount) ? (m_LockCount[i] > 0 || pSurface->Data.Locked > 0) : true;
+    }
+
+    // Returns a free surface. Waits up to dwTimeout ms when all surfaces are in use (NULL on timeout).
+    // The wait ends on a release. MSDK doesn't notify when it drops Data.Locked on its own, so surfaces
+    // only MSDK holds are still looked at again every 1ms.
+    mfxFrameSurface1* FindFreeSurface(DWORD dwTimeout = 1000);
+
+    // Number of times FindFreeSurface had to wait
+    LONG GetWaitCount() const { return m_nWaitCount; }
+
+    // Most surfaces in use at once (counted by FindFreeSurface, including the returned surface)
+    size_t GetHighWaterMark() const { return m_nHighWaterMark; }
+    void ResetHighWaterMark() { m_nHighWaterMark = 0; }
+
+    // True when the application holds a surface
+    bool HasLockedSurfaces() const;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsSurfacePool);
+
+    __forceinline size_t GetIndex(mfxFrameSurface1* pSurface) const
+    {
+        ASSERT(pSurface != NULL);
+        size_t i = (NULL == pSurface) ? m_nCount : (size_t)(pSurface - m_pSurfaces);
+        ASSERT(i < m_nCount);
+        return i;
+    }
+
+    // nBusy is set to the number of surfaces without application locks that MSDK still uses,
+    // out of those looked at before the free surface was found
+    mfxFrameSurface1* ScanFreeSurface(size_t& nBusy);
+    void UpdateHighWaterMark(size_t nBusy);
+
+    enum { BITMAP_SIZE = (MSDK_MAX_SURFACES + 31) / 32 };
+
+    mfxFrameSurface1* m_pSurfaces;
+    size_t            m_nCount;
+    volatile LONG     m_LockCount[MSDK_MAX_SURFACES]; // Application locks
+    volatile LONG     m_Unlocked[BITMAP_SIZE];        // Bit is set when the surface may have no application locks
+    volatile LONG     m_nLocked;                      // Surfaces with application locks
+    volatile LONG     m_nWaiters;                     // Threads waiting in FindFreeSurface
+    volatile LONG     m_nWaitCount;
+    size_t            m_nHighWaterMark;
+    HANDLE            m_hReleaseEvent;
+};
+
+// Fixed capacity queue of decoded surfaces with a single producer and a single consumer.
+// PushSurface is called by the producer, PopSurface, FrontSurface and GetSnapshot by the consumer.
+// No locks are taken - each index is written by one side only. Volatile accesses have acquire/release
+// semantics with MSVC on x86/x64 (/volatile:ms), so a slot is written before the tail that publishes it.
+class CQsSurfaceRing
+{
+public:
+    // Read only view of the queued surfaces, oldest first. Stays valid until the consumer pops a surface.
+    class CSnapshot
+    {
+    public:
+        CSnapshot(mfxFrameSurface1* const* pSlots, size_t nMask, size_t nFirst, size_t nCount) :
+            m_pSlots(pSlots), m_nMask(nMask), m_nFirst(nFirst), m_nCount(nCount)
+        {
+        }
+
+        size_t size() const { return m_nCount; }
+        bool empty() const { return 0 == m_nCount; }
+        mfxFrameSurface1* operator[](size_t i) const
+        {
+            ASSERT(i < m_nCount);
+            return m_pSlots[(m_nFirst + i) & m_nMask];
+        }
+
+    private:
+        mfxFrameSurface1* const* m_pSlots;
+        size_t m_nMask;
+        size_t m_nFirst;
+        size_t m_nCount;
+    };
+
+    CQsSurfaceRing() : m_nMask(0), m_nHead(0), m_nTail(0)
+    {
+        MSDK_ZERO_MEMORY((void*)m_Slots, sizeof(m_Slots));
+    }
+
+    // Empties the queue and sets its capacity (rounded up to a power of 2).
+    // Must not be called while the producer or the consumer are active.
+    void Init(size_t nCapacity)
+    {
+        size_t nSize = 1;
+        while (nSize < nCapacity && nSize < MSDK_MAX_SURFACES)
+            nSize <<= 1;
+
+        m_nMask = nSize - 1;
+        m_nHead = m_nTail = 0;
+    }
+
+    // Producer only. Returns false when the queue is full.
+    __forceinline bool PushSurface(mfxFrameSurface1* pSurface)
+    {
+        size_t nTail = m_nTail;
+        if (nTail - m_nHead > m_nMask)
+            return false;
+
+        m_Slots[nTail & m_nMask] = pSurface;
+        m_nTail = nTail + 1;
+        return true;
+    }
+
+    // Consumer only. Returns NULL when the queue is empty.
+    __forceinline mfxFrameSurface1* PopSurface()
+    {
+        size_t nHead = m_nHead;
+        if (nHead == m_nTail)
+            return NULL;
+
+        mfxFrameSurface1* pSurface = m_Slots[nHead & m_nMask];
+        m_nHead = nHead + 1;
+        return pSurface;
+    }
+
+    // Consumer only. Oldest surface without removing it (NULL when empty).
+    __forceinline mfxFrameSurface1* FrontSurface() const
+    {
+        size_t nHead = m_nHead;
+        return (nHead == m_nTail) ? NULL : m_Slots[nHead & m_nMask];
+    }
+
+    // Consumer only. Surfaces pushed after the call are not part of the snapshot.
+    __forceinline CSnapshot GetSnapshot() const
+    {
+        size_t nHead = m_nHead;
+        return CSnapshot((mfxFrameSurface1* const*)m_Slots, m_nMask, nHead, m_nTail - nHead);
+    }
+
+    // Exact when called by the producer or the consumer, a hint otherwise
+    __forceinline size_t Size() const
+    {
+        size_t nHead = m_nHead;
+        return m_nTail - nHead;
+    }
+
+    __forceinline bool Empty() const { return m_nHead == m_nTail; }
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsSurfaceRing);
+
+    mfxFrameSurface1* volatile m_Slots[MSDK_MAX_SURFACES];
+    size_t                     m_nMask;
+    volatile size_t            m_nHead; // Next surface to pop - written by the consumer
+    volatile size_t            m_nTail; // Next free slot - written by the producer
+};
+
+struct IQsDeviceBusyPolicy;
+
+// Handles MFX_WRN_DEVICE_BUSY for the decoder and the VPP of a stream.
+// Waits according to the application's policy (exponential backoff by default) and counts
+// the busy returns and the time spent waiting.
+class CQsDeviceBusyHandler
+{
+public:
+    CQsDeviceBusyHandler();
+
+    // NULL - default backoff
+    void SetPolicy(IQsDeviceBusyPolicy* pPolicy) { m_pPolicy = pPolicy; }
+
+    // Called for each busy return
+    __forceinline void CountBusy() { InterlockedIncrement(&m_nBusyCount); }
+
+    // Waits before the operation is retried. nAttempt counts the consecutive busy returns (starting at 1).
+    // Returns false when the policy gives up.
+    bool Wait(unsigned nAttempt);
+
+    LONG GetBusyCount() const { return m_nBusyCount; }
+
+    // Total wait time in microseconds
+    LONGLONG GetWaitTime() const { return m_nWaitTicks * 1000000 / m_Frequency; }
+
+    // Default policy - short spins first as the GPU usually frees up within microseconds.
+    // Sleep(1) may take a whole timer tick (15.6ms) so it's the last resort.
+    static void Backoff(unsigned nAttempt);
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsDeviceBusyHandler);
+
+    enum
+    {
+        SPIN_ATTEMPTS  = 6, // 16 to 512 pause instructions
+        YIELD_ATTEMPTS = 4  // SwitchToThread
+    };
+
+    IQsDeviceBusyPolicy* volatile m_pPolicy;
+    volatile LONG                 m_nBusyCount;
+    volatile LONGLONG             m_nWaitTicks;
+    LONGLONG                      m_Frequency;
+};
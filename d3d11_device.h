@@ -1,54 +1,54 @@
-/*
- * Copyright (c) 2013, INTEL CORPORATION
- * All rights reserved.
- * 
- * Redistribution and use in source and binary forms, with or without modification,
- * are permitted provided that the following conditions are met:
- * 
- * Redistributions of source code must retain the above copyright notice,
- * this list of conditions and the following disclaimer.
- * Redistributions in binary form must reproduce the above copyright notice,
- * this list of conditions and the following disclaimer in the documentation and/or
- * other materials provided with the distribution.
- * Neither the name of INTEL CORPORATION nor the names of its contributors may
- * be used to endorse or promote products derived from this software without specific
- * prior written permission.
- *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
- * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
- * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
- * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
- * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
- * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
- * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
- * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- * POSSIBILITY OF SUCH DAMAGE.
- */
-
-#pragma once
-
-#if MFX_D3D11_SUPPORT
-#include "hw_device.h"
-
-class CD3D11Device: public CHWDevice
-{
-public:
-    // ctor/dtor
-    CD3D11Device();
-    virtual ~CD3D11Device();
-    //
-    virtual mfxStatus Init(int nAdapterNum);
-    virtual mfxStatus Reset();
-    virtual mfxHDL    GetHandle(mfxHandleType type);
-    virtual void      Close();
-
-protected:
-    CComPtr<ID3D11Device>         m_pD3D11Device;
-    CComPtr<ID3D11DeviceContext>  m_pD3D11Ctx;
-    CComQIPtr<ID3D11VideoDevice>  m_pDX11VideoDevice;
-    CComQIPtr<ID3D11VideoContext> m_pVideoContext;
-    CComQIPtr<IDXGIAdapter>       m_pAdapter;
-    CComPtr<IDXGIFactory2>        m_pDXGIFactory;
-};
-#endif //#if MFX_D3D11_SUPPORT
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#if MFX_D3D11_SUPPORT
+#include "hw_device.h"
+
+class CD3D11Device: public CHWDevice
+{
+public:
+    // ctor/dtor
+    CD3D11Device();
+    virtual ~CD3D11Device();
+    //
+    virtual mfxStatus Init(int nAdapterNum);
+    virtual mfxStatus Reset();
+    virtual mfxHDL    GetHandle(mfxHandleType type);
+    virtual void      Close();
+
+protected:
+    CComPtr<ID3D11Device>         m_pD3D11Device;
+    CComPtr<ID3D11DeviceContext>  m_pD3D11Ctx;
+    CComQIPtr<ID3D11VideoDevice>  m_pDX11VideoDevice;
+    CComQIPtr<ID3D11VideoContext> m_pVideoContext;
+    CComQIPtr<IDXGIAdapter>       m_pAdapter;
+    CComPtr<IDXGIFactory2>        m_pDXGIFactory;
+};
+#endif //#if MFX_D3D11_SUPPORT
@@ -1,659 +1,1617 @@
-/*
- * Copyright (c) 2013, INTEL CORPORATION
- * All rights reserved.
- * 
- * Redistribution and use in source and binary forms, with or without modification,
- * are permitted provided that the following conditions are met:
- * 
- * Redistributions of source code must retain the above copyright notice,
- * this list of conditions and the following disclaimer.
- * Redistributions in binary form must reproduce the above copyright notice,
- * this list of conditions and the following disclaimer in the documentation and/or
- * other materials provided with the distribution.
- * Neither the name of INTEL CORPORATION nor the names of its contributors may
- * be used to endorse or promote products derived from this software without specific
- * prior written permission.
- *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
- * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
- * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
- * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
- * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
- * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
- * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
- * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- * POSSIBILITY OF SUCH DAMAGE.
- */
-
-#include "stdafx.h"
-#include "QuickSync_defs.h"
-#include "QuickSyncUtils.h"
-#include "CodecInfo.h"
-#include "TimeManager.h"
-#include "frame_constructors.h"
-#include "H264Nalu.h"
-
-static inline mfxU32 GetValue32(mfxU8* pBuf)
-{
-    MSDK_CHECK_POINTER(pBuf, 0);
-    return ((mfxU32)(pBuf[0]) << 24) | ((mfxU32)(pBuf[1]) << 16) | ((mfxU32)(pBuf[2]) << 8) | ((mfxU32)(pBuf[3]));
-}
-
-static inline void SetValue(mfxU32 nValue, mfxU8* pBuf)
-{
-    MSDK_CHECK_POINTER_NO_RET(pBuf);
-    for (mfxU32 i = 0; i < 4; ++i)
-    {
-        *pBuf++ = (mfxU8)(nValue >> 8 * i);
-    }
-
-    return;
-}
-
-//////////////////////////////////////////////////////////////////////////////////////////////////////
-//                                      CFrameConstructor
-//////////////////////////////////////////////////////////////////////////////////////////////////////
-CFrameConstructor::CFrameConstructor(CDecTimeManager* tsManager) 
-{
-    ASSERT(tsManager != NULL);
-    m_TimeManager = tsManager;
-    m_bSeqHeaderInserted = false;
-    m_bDvdStripPackets = false;
-    MSDK_ZERO_VAR(m_ResidialBS);
-    MSDK_ZERO_VAR(m_Headers);
-    m_ResidialBS.MaxLength = 100;
-    m_ResidialBS.Data = new mfxU8[m_ResidialBS.MaxLength];
-}
-
-CFrameConstructor::~CFrameConstructor() 
-{
-    delete[] m_ResidialBS.Data;
-    delete[] m_Headers.Data;
-}
-
-void CFrameConstructor::Reset()
-{
-    m_ResidialBS.DataOffset = m_ResidialBS.DataLength = 0;
-    m_bSeqHeaderInserted = false;
-}
-
-void CFrameConstructor::UpdateTimeStamp(IMediaSample* pSample, mfxBitstream* pBS)
-{
-    REFERENCE_TIME rtStart, rtEnd;
-    HRESULT hr = pSample->GetTime(&rtStart, &rtEnd);
-    if (!(S_OK == hr || VFW_S_NO_STOP_TIME == hr))
-        rtStart = INVALID_REFTIME;
-
-    MSDK_VTRACE("QsDecoder: Input time stamp (%I64d)\n", rtStart);
-    pBS->TimeStamp =  m_TimeManager->ConvertReferenceTime2MFXTime(rtStart);
-}
-
-void CFrameConstructor::SaveResidualData(mfxBitstream* pBS)
-{
-    MSDK_CHECK_POINTER_NO_RET(pBS);
-    // m_ResidialBS must be empty
-    ASSERT(m_ResidialBS.DataLength == 0);
-    m_ResidialBS.DataOffset = 0;
-    m_ResidialBS.DataLength = pBS->DataLength;
-    
-    // Check if a bigger buffer is needed
-    if (pBS->DataLength > m_ResidialBS.MaxLength)
-    {
-        delete[] m_ResidialBS.Data;
-        mfxU32 newSize = pBS->DataLength;
-        m_ResidialBS.Data = new mfxU8[newSize];
-        MSDK_CHECK_POINTER_NO_RET(m_ResidialBS.Data);
-        m_ResidialBS.MaxLength = newSize;
-    }
-
-    ASSERT(pBS->DataOffset + pBS->DataLength <= pBS->MaxLength);
-    memcpy(m_ResidialBS.Data, pBS->Data + pBS->DataOffset, pBS->DataLength);
-}
-
-mfxStatus CFrameConstructor::ConstructHeaders(
-    VIDEOINFOHEADER2* vih,
-    const GUID& guidFormat,
-    size_t nMtSize,
-    size_t nVideoInfoSize)
-{
-    MSDK_SAFE_DELETE_ARRAY(m_Headers.Data);
-    MSDK_ZERO_VAR(m_Headers);
-
-    // Nothing to do here...
-    if (nMtSize <= nVideoInfoSize)
-    {
-        return MFX_ERR_MORE_DATA;
-    }
-
-    // Splitter adds sequence headers to the end of the vih
-    size_t nSeqHeaderSize;
-    mfxU8* pSeqHeader;
-    MPEG2VIDEOINFO* mp2 = NULL;
-    if (FORMAT_MPEG2_VIDEO == guidFormat)
-    {
-        mp2 = (MPEG2VIDEOINFO*)(vih);
-        MSDK_CHECK_POINTER(mp2, MFX_ERR_NULL_PTR);
-        pSeqHeader = (mfxU8*)mp2->dwSequenceHeader;
-        nSeqHeaderSize = mp2->cbSequenceHeader;
-    }
-    else
-    {
-        pSeqHeader = (mfxU8*)vih + nVideoInfoSize;
-        nSeqHeaderSize = nMtSize - nVideoInfoSize;
-    }
-
-    m_Headers.Data = new mfxU8[nSeqHeaderSize];
-    m_Headers.MaxLength = m_Headers.DataLength = (mfxU32)nSeqHeaderSize;
-
-    // Copy the sequence header
-    memcpy(m_Headers.Data, pSeqHeader, nSeqHeaderSize);
-    return MFX_ERR_NONE;
-}
-
-mfxStatus CFrameConstructor::ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS)
-{
-    mfxStatus sts         = MFX_ERR_NONE;
-    mfxU8*    pDataBuffer = NULL;
-    int       nDataSize   = 0;
-
-    MSDK_CHECK_POINTER(pSample, MFX_ERR_NULL_PTR);
-    nDataSize = pSample->GetActualDataLength();
-    MSDK_CHECK_ERROR(nDataSize, 0, MFX_ERR_MORE_DATA);
-    
-    pSample->GetPointer(&pDataBuffer);
-    MSDK_CHECK_POINTER(pDataBuffer, MFX_ERR_NULL_PTR);
-
-    MSDK_SAFE_DELETE_ARRAY(pBS->Data);
-
-    if (m_bDvdStripPackets)
-    {
-        StripDvdPacket(pDataBuffer, nDataSize);
-        MSDK_CHECK_ERROR(nDataSize, 0, MFX_ERR_MORE_DATA);
-    }
-
-    // Prefix the sequence headers if needed
-    size_t newDataSize = nDataSize + m_ResidialBS.DataLength +
-                ((m_bSeqHeaderInserted) ? 0 : m_Headers.DataLength);
-
-    pBS->MaxLength = pBS->DataLength = (mfxU32)newDataSize;
-
-    mfxU8* pData = pBS->Data = new mfxU8[newDataSize];
-    MSDK_CHECK_POINTER(pData, MFX_ERR_NULL_PTR);
-
-    // Write data left from previous samples
-    WriteResidualData(pData);
-
-    // Write sequence headers
-    WriteHeaders(pData);
-
-    // Append new data
-    WriteSampleData(pData, pDataBuffer, nDataSize);
-    pBS->DataLength = (mfxU32)(pData - pBS->Data);
-
-    UpdateTimeStamp(pSample, pBS);
-    return sts;
-}
-
-void CFrameConstructor::StripDvdPacket(BYTE*& p, int& len)
-{
-    if (len > 0 && *(DWORD*)p == 0xba010000)
-    { // MEDIATYPE_*_PACK
-        len -= 14;
-        p += 14;
-        if (int stuffing = (p[-1]&7))
-        {
-            len -= stuffing;
-            p += stuffing;
-        }
-    }
-
-    if (len > 0 && *(DWORD*)p == 0xbb010000)
-    {
-        len -= 4;
-        p += 4;
-        int hdrlen = ((p[0]<<8)|p[1]) + 2;
-        len -= hdrlen;
-        p += hdrlen;
-    }
-
-    if (len > 0 &&
-        ((*(DWORD*)p&0xf0ffffff) == 0xe0010000 ||
-        (*(DWORD*)p&0xe0ffffff) == 0xc0010000 ||
-        (*(DWORD*)p&0xbdffffff) == 0xbd010000))
-    { // PES
-        bool ps1 = (*(DWORD*)p&0xbdffffff) == 0xbd010000;
-
-        len -= 4;
-        p += 4;
-        int expected = ((p[0]<<8)|p[1]);
-        len -= 2;
-        p += 2;
-        BYTE* p0 = p;
-
-        for (int i = 0; i < 16 && *p == 0xff; i++, len--, p++)
-        {
-            ;
-        }
-
-        if ((*p&0xc0) == 0x80)
-        { // mpeg2
-            len -= 2;
-            p += 2;
-            len -= *p+1;
-            p += *p+1;
-        }
-        else
-        { // mpeg1
-            if ((*p&0xc0) == 0x40)
-            {
-                len -= 2;
-                p += 2;
-            }
-
-            if ((*p&0x30) == 0x30 || (*p&0x30) == 0x20)
-            {
-                bool pts = !!(*p&0x20), dts = !!(*p&0x10);
-                if (pts)
-                {
-                    len -= 5;
-                }
-                p += 5;
-                if (dts)
-                {
-                    ASSERT((*p&0xf0) == 0x10);
-                    len -= 5;
-                    p += 5;
-                }
-            }
-            else
-            {
-                len--;
-                p++;
-            }
-        }
-
-        if (ps1)
-        {
-            len--;
-            p++;
-        }
-
-        if (expected > 0)
-        {
-            expected -= (int)(p - p0);
-            len = min(expected, len);
-        }
-    }
-
-    if (len < 0)
-    {
-        ASSERT(len < 0);
-        len = 0;
-    }
-}
-
-void CFrameConstructor::WriteResidualData(mfxU8*& pData)
-{
-    if (m_ResidialBS.DataLength)
-    {
-        memcpy(pData, m_ResidialBS.Data, m_ResidialBS.DataLength);
-        pData += m_ResidialBS.DataLength;
-        m_ResidialBS.DataLength = 0;
-    }
-}
-
-void CFrameConstructor::WriteHeaders(mfxU8*& pData)
-{
-    if (!m_bSeqHeaderInserted)
-    {
-        memcpy(pData, m_Headers.Data, m_Headers.DataLength); 
-        pData += m_Headers.DataLength;
-        m_bSeqHeaderInserted = true;
-    }
-}
-
-void CFrameConstructor::WriteSampleData(mfxU8*& pData, const mfxU8* pSrc, size_t nDataSize)
-{
-    memcpy(pData, pSrc, nDataSize);
-    pData += nDataSize;
-}
-
-//////////////////////////////////////////////////////////////////////////////////////////////////////
-//                                      CVC1FrameConstructor
-//////////////////////////////////////////////////////////////////////////////////////////////////////
-CVC1FrameConstructor::CVC1FrameConstructor(CDecTimeManager* tsManager) :
-    CFrameConstructor(tsManager), m_FourCC(0), m_Width(0), m_Height(0)
-{
-}
-
-mfxStatus CVC1FrameConstructor::ConstructHeaders(
-    VIDEOINFOHEADER2* vih,
-    const GUID& guidFormat,
-    size_t nMtSize,
-    size_t nVideoInfoSize)
-{
-    m_FourCC = vih->bmiHeader.biCompression;
-    m_Width  = vih->bmiHeader.biWidth;
-    m_Height = vih->bmiHeader.biHeight;
-    
-    // All other formats except WMV3
-    if (FOURCC_WMV3 != m_FourCC)
-    {
-        if (FOURCC_VC1 == m_FourCC)
-        {
-            ++nVideoInfoSize;
-        }
-
-        return CFrameConstructor::ConstructHeaders(vih, guidFormat, nMtSize, nVideoInfoSize);
-    }
-
-    // Special case WMV3
-    MSDK_SAFE_DELETE_ARRAY(m_Headers.Data);
-    MSDK_ZERO_VAR(m_Headers);
-
-    // Nothing to do here...
-    if (nMtSize <= nVideoInfoSize)
-    {
-        return MFX_ERR_MORE_DATA;
-    }
-
-    // Header should be additionally constructed for main&simple profile in asf data type
-    m_Headers.MaxLength = m_Headers.DataLength = (mfxU32)(nMtSize - nVideoInfoSize + 20);
-    m_Headers.Data = new mfxU8[m_Headers.MaxLength];
-    mfxStatus sts = ConstructHeaderSM(m_Headers.Data,
-                                      m_Headers.DataLength,
-                                      (mfxU8*)(vih) + nVideoInfoSize,
-                                      (mfxU32)(nMtSize - nVideoInfoSize));
-    return sts;
-}
-
-mfxStatus CVC1FrameConstructor::ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS)
-{
-    mfxU8* pDataBuffer = NULL;
-    mfxU32 nDataSize   = 0;
-    MSDK_CHECK_POINTER(pSample, MFX_ERR_NULL_PTR);
-    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
-
-    nDataSize = pSample->GetActualDataLength();
-    MSDK_CHECK_ERROR(nDataSize, 0, MFX_ERR_MORE_DATA);
-
-    pSample->GetPointer(&pDataBuffer);
-    MSDK_CHECK_POINTER(pDataBuffer, MFX_ERR_NULL_PTR);
-
-    UpdateTimeStamp(pSample, pBS);
-
-    // Prefix the sequence headers if needed
-    size_t newDataSize = nDataSize + m_ResidialBS.DataLength +
-        ((m_bSeqHeaderInserted) ? 0 : m_Headers.DataLength) + // Add headers size 
-        8; // Add upto 8 bytes for extra start codes
-
-    pBS->MaxLength = (mfxU32)newDataSize;
-
-    mfxU8* pData = pBS->Data = new mfxU8[newDataSize];
-    MSDK_CHECK_POINTER(pData, MFX_ERR_NULL_PTR);
-
-    // Write data left from previous samples
-    WriteResidualData(pData);
-
-    // Write sequence headers
-    WriteHeaders(pData);
-
-    if (FOURCC_VC1 != m_FourCC)
-    {
-        SetValue(nDataSize, pData); 
-        SetValue(0, pData + 4);
-        pData += 8;
-    }
-    else if (false == StartCodeExist(pDataBuffer))
-    {
-        // Set start code to first 4 bytes
-        SetValue(0x0D010000, pData);
-        pData += 4;
-    }
-
-    // Append new data
-    WriteSampleData(pData, pDataBuffer, nDataSize);
-    pBS->DataLength = (mfxU32)(pData - pBS->Data);
-
-    return MFX_ERR_NONE;
-}
-
-mfxStatus CVC1FrameConstructor::ConstructHeaderSM(mfxU8* pHeaderSM, mfxU32 nHeaderSize, mfxU8* pDataBuffer, mfxU32 nDataSize)
-{
-    MSDK_CHECK_POINTER(pHeaderSM, MFX_ERR_NULL_PTR);
-    MSDK_CHECK_POINTER(pDataBuffer, MFX_ERR_NULL_PTR);
-    if (nHeaderSize < nDataSize + 20)
-    {
-        return MFX_ERR_NOT_ENOUGH_BUFFER;
-    }
-
-    // Set start code
-    SetValue(0xC5000000, pHeaderSM);
-
-    // Set size of sequence header is 4 bytes
-    SetValue(nDataSize, pHeaderSM + 4);
-
-    // Copy saved data back
-    memcpy(pHeaderSM + 8, pDataBuffer, nDataSize);
-
-    // Set sizes to the end of data
-    SetValue(m_Height, pHeaderSM + 8  + nDataSize);
-    SetValue(m_Width,  pHeaderSM + 12 + nDataSize);
-
-    // Set 0 to the last 4 bytes
-    SetValue(0,  pHeaderSM + 16 + nDataSize);
-
-    return MFX_ERR_NONE;
-}
-
-bool CVC1FrameConstructor::StartCodeExist(mfxU8* pStart)
-{
-    MSDK_CHECK_POINTER(pStart, false);
-
-    // Check first 4 bytes to be start code
-    mfxU32 value = GetValue32(pStart);
-    switch (value)
-    {
-    case 0x010A:
-    case 0x010B:
-    case 0x010C:
-    case 0x010D:
-    case 0x010E:
-    case 0x010F:
-    case 0x011B:
-    case 0x011C:
-    case 0x011D:
-    case 0x011E:
-    case 0x011F:
-        // Start code found
-        return true;
-    default:
-        // Start code not found
-        return false; 
-    }
-}
-
-//////////////////////////////////////////////////////////////////////////////////////////////////////
-//                                      CAVCFrameConstructor
-//////////////////////////////////////////////////////////////////////////////////////////////////////
-CAVCFrameConstructor::CAVCFrameConstructor(CDecTimeManager* tsManager) : CFrameConstructor(tsManager)
-{
-    m_HeaderNalSize = 2;  //MSDN - MPEG2VideoInfo->dwSequenceHeader delimited by 2 byte length fields
-    m_NalSize = 0;
-    SetValue(0x01000000, m_H264StartCode);
-    m_OutputBuffer.reserve(1<<20);
-}
-
-CAVCFrameConstructor::~CAVCFrameConstructor()
-{
-}
-
-mfxStatus CAVCFrameConstructor::ConstructHeaders(VIDEOINFOHEADER2* vih,
-        const GUID& guidFormat,
-        size_t nMtSize,
-        size_t nVideoInfoSize)
-{
-    MSDK_SAFE_DELETE_ARRAY(m_Headers.Data);
-    m_Headers.DataLength = m_Headers.MaxLength = 0;
-
-    // Nothing to do here...
-    if (nMtSize <= nVideoInfoSize || FORMAT_MPEG2_VIDEO != guidFormat)
-    {
-        return MFX_ERR_MORE_DATA;
-    }
-
-    MPEG2VIDEOINFO* mp2 = (MPEG2VIDEOINFO*)(vih);
-    MSDK_CHECK_POINTER(mp2, MFX_ERR_NULL_PTR);
-
-    // SPS and/or PPS Data will be present
-    mfxStatus sts = MFX_ERR_NONE; 
-    MSDK_ZERO_VAR(m_Headers);
-    m_OutputBuffer.clear();
-    m_NalSize = mp2->dwFlags;     
-    H264_NaluIterator itStartCode((BYTE*)mp2->dwSequenceHeader, mp2->cbSequenceHeader, m_HeaderNalSize); // Nal size = 2 
-    H264_NAL_RC rc;
-    bool eos = false;
-
-    while (!eos)
-    {
-        rc = itStartCode.Next();
-        NALU_TYPE naluType = itStartCode.GetNaluType();
-
-        switch (rc)
-        {
-        case NALU_PARTIAL: // For headers, partials are fine (h264 extra data)
-        case NALU_OK:
-            {
-                size_t nNalDataLen = itStartCode.GetDataLength();
-                const BYTE* pNalDataBuff = itStartCode.GetDataBuffer();
-                if (naluType == NALU_TYPE_SPS || naluType == NALU_TYPE_PPS)
-                {
-                    m_OutputBuffer.insert(m_OutputBuffer.end(), m_H264StartCode, m_H264StartCode + 4);
-                    m_OutputBuffer.insert(m_OutputBuffer.end(), pNalDataBuff, pNalDataBuff+nNalDataLen);
-                }
-            }
-            break;
-
-        case NALU_EOS:
-            eos = true;
-            break;
-
-        case NALU_INVALID:
-            break;
-        } // switch
-    }
-
-    if (m_OutputBuffer.size())
-    {
-        // Keep a copy of the SPS/PPS to be placed into the decode stream (after each new segment).
-        MSDK_SAFE_DELETE_ARRAY(m_Headers.Data);
-        m_Headers.Data = new mfxU8[m_OutputBuffer.size()];
-        m_Headers.DataLength = m_Headers.MaxLength = (mfxU32)m_OutputBuffer.size();
-        memcpy(m_Headers.Data, &m_OutputBuffer.front(), m_OutputBuffer.size());
-    }
-
-    return sts; 
-}
-
-mfxStatus CAVCFrameConstructor::ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS)
-{
-    mfxU8* pDataBuffer = NULL;    
-    MSDK_CHECK_POINTER(pSample, MFX_ERR_NULL_PTR); 
-    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR); 
-
-    UpdateTimeStamp(pSample, pBS);
-    
-    mfxU32 nDataSize = pSample->GetActualDataLength();
-    MSDK_CHECK_ERROR(nDataSize, 0, MFX_ERR_MORE_DATA); 
-
-    pSample->GetPointer(&pDataBuffer);
-    MSDK_CHECK_POINTER(pDataBuffer, MFX_ERR_NULL_PTR);
-
-    if (!m_InputBuffer.empty())
-    {
-        m_InputBuffer.insert(m_InputBuffer.end(), pDataBuffer, pDataBuffer + nDataSize);
-        pDataBuffer = &m_InputBuffer.front();
-        nDataSize = (mfxU32)m_InputBuffer.size();
-    }
-
-    m_OutputBuffer.clear();
-    m_OutputBuffer.reserve(nDataSize);
-
-    H264_NaluIterator itStartCode(pDataBuffer, nDataSize, m_NalSize); // Nal size = 4 (usually); declared in extra data (ConstructHeaders)
-    bool eos = false;
-    // Iterate over the NALUs and convert them to have start codes.
-    while (!eos)
-    {
-        H264_NAL_RC rc = itStartCode.Next();
-        NALU_TYPE naluType = itStartCode.GetNaluType();
-
-        switch (rc)
-        {
-        case NALU_OK:
-            {                
-                // Discard AUD NALUs
-                if (NALU_TYPE_AUD == naluType)
-                    continue;
-
-                size_t nNalDataLen = itStartCode.GetDataLength(); 
-                const BYTE* pNalDataBuff = itStartCode.GetDataBuffer();
-                
-                m_OutputBuffer.insert(m_OutputBuffer.end(), m_H264StartCode, m_H264StartCode + 4);
-                m_OutputBuffer.insert(m_OutputBuffer.end(), pNalDataBuff, pNalDataBuff + nNalDataLen);
-            }
-            break;
-
-        // Got partial NAL, save it for next run
-        // Note - The residial data buffer contains processed NALs.
-        //        Here we need to save unprocessed NALs.
-        case NALU_PARTIAL:
-            {
-                 std::vector<mfxU8> temp;
-                 size_t start = (itStartCode.GetNALBuffer() - pDataBuffer);
-                 temp.insert(temp.end(), pDataBuffer + start, pDataBuffer + nDataSize);
-                 m_InputBuffer.swap(temp);
-            }
-            break;
-
-        case NALU_EOS:
-            eos = true;
-            break;
-
-        case NALU_INVALID: // discard
-            break;
-        } // switch
-    }
-
-    if (m_OutputBuffer.empty())
-    {
-        return MFX_ERR_NONE;
-    }
-
-    // Update data size
-    nDataSize = (mfxU32)m_OutputBuffer.size();
-    pDataBuffer = &m_OutputBuffer.front();
-    size_t newDataSize = nDataSize + m_ResidialBS.DataLength +
-        ((m_bSeqHeaderInserted) ? 0 : m_Headers.DataLength);
-
-    mfxU8* pData = pBS->Data = new mfxU8[newDataSize];
-    pBS->MaxLength = (mfxU32)newDataSize;
-
-    // Write data left from previous samples (processed data)
-    WriteResidualData(pData);
-
-    // Write sequence headers if needed
-    WriteHeaders(pData);
-
-    // Append new data
-    WriteSampleData(pData, pDataBuffer, nDataSize);
-    pBS->DataLength = (mfxU32)(pData - pBS->Data);
-
-    return MFX_ERR_NONE;
-}
-
-void CAVCFrameConstructor::Reset()
-{
-    CFrameConstructor::Reset();
-    m_InputBuffer.clear();
-}
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "CodecInfo.h"
+#include "TimeManager.h"
+#include "H264Nalu.h"
+#include "H264Parser.h"
+#include "MPEG2StartCode.h"
+#include "MPEG2PsDemux.h"
+#include "MPEG2TsDemux.h"
+#include "H264RtpDepacketizer.h"
+#include "frame_constructors.h"
+
+static inline mfxU32 GetValue32(mfxU8* pBuf)
+{
+    MSDK_CHECK_POINTER(pBuf, 0);
+    return ((mfxU32)(pBuf[0]) << 24) | ((mfxU32)(pBuf[1]) << 16) | ((mfxU32)(pBuf[2]) << 8) | ((mfxU32)(pBuf[3]));
+}
+
+static inline void SetValue(mfxU32 nValue, mfxU8* pBuf)
+{
+    MSDK_CHECK_POINTER_NO_RET(pBuf);
+    for (mfxU32 i = 0; i < 4; ++i)
+    {
+        *pBuf++ = (mfxU8)(nValue >> 8 * i);
+    }
+
+    return;
+}
+
+// True for pictures that no other picture refers to
+static inline bool IsDisposableFrame(mfxU16 frameType)
+{
+    return 0 != (frameType & (MFX_FRAMETYPE_I | MFX_FRAMETYPE_P | MFX_FRAMETYPE_B)) &&
+           0 == (frameType & MFX_FRAMETYPE_REF);
+}
+
+// SPS and PPS NALUs (p points to the start code 00 00 01)
+static inline bool IsH264ParameterSet(const mfxU8* p, size_t nSize)
+{
+    if (nSize < 4)
+        return false;
+
+    mfxU8 naluType = p[3] & 0x1F;
+    return NALU_TYPE_SPS == naluType || NALU_TYPE_PPS == naluType;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      CQsBitstreamBuffer
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+CQsBitstreamBuffer::CQsBitstreamBuffer(size_t nInitialSize) :
+    m_nSize(nInitialSize),
+    m_nOffset(0),
+    m_nLength(0)
+{
+    m_pBuffer = (mfxU8*)_aligned_malloc(m_nSize, 64);
+
+    // Out of memory - Reserve tries again
+    if (NULL == m_pBuffer)
+    {
+        m_nSize = 0;
+    }
+}
+
+CQsBitstreamBuffer::~CQsBitstreamBuffer()
+{
+    _aligned_free(m_pBuffer);
+}
+
+mfxU8* CQsBitstreamBuffer::Reserve(size_t nSize)
+{
+    // Buffer is empty - start writing from the beginning
+    if (0 == m_nLength)
+    {
+        m_nOffset = 0;
+    }
+
+    // Not enough free space at the end of the buffer
+    if (m_nOffset + m_nLength + nSize > m_nSize)
+    {
+        // Move the unconsumed data to the front of the buffer
+        if (m_nLength + nSize <= m_nSize)
+        {
+            memmove(m_pBuffer, m_pBuffer + m_nOffset, m_nLength);
+        }
+        // Grow the buffer
+        else
+        {
+            size_t nNewSize = MSDK_ALIGN64(max(2 * m_nSize, m_nLength + nSize));
+            mfxU8* pNewBuffer = (mfxU8*)_aligned_malloc(nNewSize, 64);
+            if (NULL == pNewBuffer)
+            {
+                MSDK_TRACE("QsDecoder: failed to grow the bitstream buffer to %u bytes\n", (unsigned)nNewSize);
+                return NULL;
+            }
+
+            if (m_nLength > 0)
+            {
+                memcpy(pNewBuffer, m_pBuffer + m_nOffset, m_nLength);
+            }
+
+            _aligned_free(m_pBuffer);
+            m_pBuffer = pNewBuffer;
+            m_nSize = nNewSize;
+            MSDK_TRACE("QsDecoder: bitstream buffer grew to %u bytes\n", (unsigned)m_nSize);
+        }
+
+        m_nOffset = 0;
+    }
+
+    return m_pBuffer + m_nOffset + m_nLength;
+}
+
+void CQsBitstreamBuffer::Detach(mfxBitstream* pBS, size_t nSize)
+{
+    MSDK_CHECK_POINTER_NO_RET(pBS);
+    nSize = min(nSize, m_nLength);
+    pBS->Data       = m_pBuffer;
+    pBS->DataOffset = (mfxU32)m_nOffset;
+    pBS->DataLength = (mfxU32)nSize;
+    pBS->MaxLength  = (mfxU32)m_nSize;
+
+    // Data belongs to the decoder now
+    m_nOffset += nSize;
+    m_nLength -= nSize;
+}
+
+void CQsBitstreamBuffer::Attach(const mfxBitstream* pBS)
+{
+    MSDK_CHECK_POINTER_NO_RET(pBS);
+
+    // A view from another buffer - nothing to take back
+    ASSERT(pBS->Data == m_pBuffer);
+    if (pBS->Data != m_pBuffer)
+        return;
+
+    // The decoder consumes data from the front of the view, so the
+    // remaining bytes are still right in front of the data that wasn't handed out.
+    ASSERT(pBS->DataOffset + pBS->DataLength == m_nOffset);
+    m_nOffset = pBS->DataOffset;
+    m_nLength += pBS->DataLength;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      CFrameConstructor
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+CFrameConstructor::CFrameConstructor(CDecTimeManager* tsManager) 
+{
+    ASSERT(tsManager != NULL);
+    m_TimeManager = tsManager;
+    m_bSeqHeaderInserted = false;
+    m_pDemuxer = NULL;
+    m_bSkipNonRefFrames = false;
+    m_DisplayOrder = INVALID_DISPLAY_ORDER;
+    m_rtPesOffset = INVALID_REFTIME;
+    m_LastPesPts = -1;
+    m_PesPtsWrap = 0;
+    m_RtpTimeOffset = 0;
+    m_bHasRtpTimeOffset = false;
+    MSDK_ZERO_VAR(m_Headers);
+}
+
+CFrameConstructor::~CFrameConstructor() 
+{
+    delete[] m_Headers.Data;
+}
+
+void CFrameConstructor::Reset()
+{
+    m_Bitstream.Clear();
+    m_bSeqHeaderInserted = false;
+    if (m_pDemuxer)
+    {
+        m_pDemuxer->Reset();
+    }
+
+    m_rtPesOffset = INVALID_REFTIME;
+    m_LastPesPts = -1;
+    m_PesPtsWrap = 0;
+    m_bHasRtpTimeOffset = false;
+}
+
+void CFrameConstructor::UpdateTimeStamp(IMediaSample* pSample, mfxBitstream* pBS)
+{
+    REFERENCE_TIME rtStart, rtEnd;
+    HRESULT hr = pSample->GetTime(&rtStart, &rtEnd);
+    if (!(S_OK == hr || VFW_S_NO_STOP_TIME == hr))
+        rtStart = INVALID_REFTIME;
+
+    MSDK_VTRACE("QsDecoder: Input time stamp (%I64d)\n", rtStart);
+    pBS->TimeStamp =  m_TimeManager->ConvertReferenceTime2MFXTime(rtStart);
+}
+
+void CFrameConstructor::SaveResidualData(mfxBitstream* pBS)
+{
+    MSDK_CHECK_POINTER_NO_RET(pBS);
+    ASSERT(pBS->DataOffset + pBS->DataLength <= pBS->MaxLength);
+
+    // Data not consumed by the decoder stays in place and prefixes the next sample
+    m_Bitstream.Attach(pBS);
+}
+
+mfxStatus CFrameConstructor::ConstructHeaders(
+    VIDEOINFOHEADER2* vih,
+    const GUID& guidFormat,
+    size_t nMtSize,
+    size_t nVideoInfoSize)
+{
+    MSDK_SAFE_DELETE_ARRAY(m_Headers.Data);
+    MSDK_ZERO_VAR(m_Headers);
+
+    // Nothing to do here...
+    if (nMtSize <= nVideoInfoSize)
+    {
+        return MFX_ERR_MORE_DATA;
+    }
+
+    // Splitter adds sequence headers to the end of the vih
+    size_t nSeqHeaderSize;
+    mfxU8* pSeqHeader;
+    MPEG2VIDEOINFO* mp2 = NULL;
+    if (FORMAT_MPEG2_VIDEO == guidFormat)
+    {
+        mp2 = (MPEG2VIDEOINFO*)(vih);
+        MSDK_CHECK_POINTER(mp2, MFX_ERR_NULL_PTR);
+        pSeqHeader = (mfxU8*)mp2->dwSequenceHeader;
+        nSeqHeaderSize = mp2->cbSequenceHeader;
+    }
+    else
+    {
+        pSeqHeader = (mfxU8*)vih + nVideoInfoSize;
+        nSeqHeaderSize = nMtSize - nVideoInfoSize;
+    }
+
+    m_Headers.Data = new mfxU8[nSeqHeaderSize];
+    m_Headers.MaxLength = m_Headers.DataLength = (mfxU32)nSeqHeaderSize;
+
+    // Copy the sequence header
+    memcpy(m_Headers.Data, pSeqHeader, nSeqHeaderSize);
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CFrameConstructor::ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS)
+{
+    mfxStatus sts         = MFX_ERR_NONE;
+    mfxU8*    pDataBuffer = NULL;
+    int       nDataSize   = 0;
+
+    MSDK_CHECK_POINTER(pSample, MFX_ERR_NULL_PTR);
+    nDataSize = pSample->GetActualDataLength();
+    MSDK_CHECK_ERROR(nDataSize, 0, MFX_ERR_MORE_DATA);
+    
+    pSample->GetPointer(&pDataBuffer);
+    MSDK_CHECK_POINTER(pDataBuffer, MFX_ERR_NULL_PTR);
+
+    UpdateTimeStamp(pSample, pBS);
+
+    // Data left from previous samples is already in the bitstream buffer.
+    // Write sequence headers if needed
+    size_t nSampleStart = m_Bitstream.GetDataLength();
+    bool bSeqHeaderInserted = m_bSeqHeaderInserted;
+    bool bAppended = WriteHeaders();
+
+    // Append new data
+    if (m_pDemuxer)
+    {
+        // The first PES packet with a PTS gives the time stamp (e.g. DVD samples without time stamps).
+        // Every PTS is mapped so PTS wrap arounds are tracked.
+        REFERENCE_TIME rtSample = m_TimeManager->ConvertMFXTime2ReferenceTime(pBS->TimeStamp);
+        bool bHasPts = false;
+        const mfxU8* pPayload;
+        size_t nPayloadSize;
+        int64_t pts;
+        m_pDemuxer->SetData(pDataBuffer, nDataSize);
+        while (bAppended && m_pDemuxer->GetNextPayload(pPayload, nPayloadSize, pts))
+        {
+            if (pts >= 0)
+            {
+                REFERENCE_TIME rtPts = GetPesTimeStamp(pts, rtSample);
+                if (!bHasPts)
+                {
+                    pBS->TimeStamp = m_TimeManager->ConvertReferenceTime2MFXTime(rtPts);
+                    bHasPts = true;
+                }
+
+                rtSample = INVALID_REFTIME;
+            }
+
+            bAppended = m_Bitstream.Append(pPayload, nPayloadSize);
+        }
+    }
+    else if (bAppended)
+    {
+        bAppended = m_Bitstream.Append(pDataBuffer, nDataSize);
+    }
+
+    // Out of memory - the sample is dropped as a whole
+    if (!bAppended)
+    {
+        m_Bitstream.Truncate(nSampleStart);
+        m_bSeqHeaderInserted = bSeqHeaderInserted;
+        return MFX_ERR_MEMORY_ALLOC;
+    }
+
+    m_Bitstream.Detach(pBS);
+    return sts;
+}
+
+REFERENCE_TIME CFrameConstructor::GetPesTimeStamp(int64_t pts, REFERENCE_TIME rtSample)
+{
+    // The 33 bit PTS wraps around every 26.5 hours
+    pts += m_PesPtsWrap;
+    if (m_LastPesPts >= 0 && pts + (1LL << 32) < m_LastPesPts)
+    {
+        m_PesPtsWrap += 1LL << 33;
+        pts += 1LL << 33;
+    }
+
+    m_LastPesPts = pts;
+
+    // 90KHz to 100ns units
+    REFERENCE_TIME rtPts = (REFERENCE_TIME)(pts * 1000 / 9);
+
+    // The offset is refreshed by every sample time stamp - it changes on discontinuities (e.g. DVD cells)
+    if (INVALID_REFTIME != rtSample)
+    {
+        m_rtPesOffset = rtSample - rtPts;
+    }
+    // Transport streams are often fed without sample time stamps - the PTS is the time line then
+    else if (INVALID_REFTIME == m_rtPesOffset && m_pDemuxer == &m_TsDemuxer)
+    {
+        m_rtPesOffset = 0;
+    }
+
+    return (INVALID_REFTIME != m_rtPesOffset) ? rtPts + m_rtPesOffset : INVALID_REFTIME;
+}
+
+mfxU64 CFrameConstructor::GetRtpTimeStamp(int64_t ts, mfxU64 sampleTime)
+{
+    // MFX time uses the same 90KHz clock when the time manager is enabled (100ns units otherwise)
+    int64_t t = (m_TimeManager->Enabled()) ? ts : ts * 1000 / 9;
+
+    // RTP time stamps start at a random value - the first one is aligned to the sample time line (or 0)
+    if (!m_bHasRtpTimeOffset)
+    {
+        m_RtpTimeOffset = (m_TimeManager->IsValidTimeStamp((REFERENCE_TIME)sampleTime)) ? (int64_t)sampleTime - t : -t;
+        m_bHasRtpTimeOffset = true;
+    }
+
+    return (mfxU64)(t + m_RtpTimeOffset);
+}
+
+bool CFrameConstructor::WriteHeaders()
+{
+    if (!m_bSeqHeaderInserted)
+    {
+        if (m_Headers.DataLength && !m_Bitstream.Append(m_Headers.Data, m_Headers.DataLength))
+            return false;
+
+        m_bSeqHeaderInserted = true;
+    }
+
+    return true;
+}
+
+size_t CFrameConstructor::GatherParameterSets(mfxU8* p, size_t nSize)
+{
+    size_t nKept = 0;
+    size_t nUnitStart = 0;
+    bool bKeepUnit = false;
+    MPEG2_StartCodeIterator itStartCode(p, nSize);
+    for (;;)
+    {
+        bool bNext = itStartCode.Next();
+        size_t nUnitEnd = (bNext) ? itStartCode.GetPosition() : nSize;
+
+        // The leading zero of a 4 byte start code (00 00 00 01) goes with the next unit
+        if (bNext && nUnitEnd > nUnitStart && 0 == p[nUnitEnd - 1])
+            --nUnitEnd;
+
+        // Kept units only move towards the start - the data that wasn't scanned yet stays in place
+        if (bKeepUnit)
+        {
+            memmove(p + nKept, p + nUnitStart, nUnitEnd - nUnitStart);
+            nKept += nUnitEnd - nUnitStart;
+        }
+
+        if (!bNext)
+            break;
+
+        nUnitStart = nUnitEnd;
+        bKeepUnit = IsParameterSet(itStartCode.GetBuffer(), itStartCode.GetBufferLength());
+    }
+
+    return nKept;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      CAccessUnitFrameConstructor
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+CAccessUnitFrameConstructor::CAccessUnitFrameConstructor(CDecTimeManager* tsManager) :
+    CFrameConstructor(tsManager),
+    m_ParsedFrameType(0),
+    m_ParsedDisplayOrder(INVALID_DISPLAY_ORDER),
+    m_nPendingSize(0),
+    m_nScanPos(0),
+    m_nPrefixPos(NO_POSITION),
+    m_bHasPicture(false),
+    m_PendingFrameType(0),
+    m_PendingDisplayOrder(INVALID_DISPLAY_ORDER)
+{
+    m_PendingTimeStamp = m_SampleTimeStamp = m_TimeManager->ConvertReferenceTime2MFXTime(INVALID_REFTIME);
+}
+
+void CAccessUnitFrameConstructor::Reset()
+{
+    CFrameConstructor::Reset();
+    m_AccessUnits.clear();
+    m_nPendingSize = 0;
+    m_nScanPos = 0;
+    m_nPrefixPos = NO_POSITION;
+    m_bHasPicture = false;
+    m_PendingTimeStamp = m_SampleTimeStamp = m_TimeManager->ConvertReferenceTime2MFXTime(INVALID_REFTIME);
+    m_PendingFrameType = 0;
+    m_PendingDisplayOrder = INVALID_DISPLAY_ORDER;
+    ResetParser();
+}
+
+mfxStatus CAccessUnitFrameConstructor::ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS)
+{
+    mfxU8* pDataBuffer = NULL;
+    int    nDataSize   = 0;
+
+    MSDK_CHECK_POINTER(pSample, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+    nDataSize = pSample->GetActualDataLength();
+    MSDK_CHECK_ERROR(nDataSize, 0, MFX_ERR_MORE_DATA);
+
+    pSample->GetPointer(&pDataBuffer);
+    MSDK_CHECK_POINTER(pDataBuffer, MFX_ERR_NULL_PTR);
+
+    UpdateTimeStamp(pSample, pBS);
+    if (m_pDemuxer)
+    {
+        // Each PES payload is added separately - the PTS belongs to the first access unit starting in it
+        REFERENCE_TIME rtSample = m_TimeManager->ConvertMFXTime2ReferenceTime(pBS->TimeStamp);
+        const mfxU8* pPayload;
+        size_t nPayloadSize;
+        int64_t pts;
+        m_pDemuxer->SetData(pDataBuffer, nDataSize);
+        while (m_pDemuxer->GetNextPayload(pPayload, nPayloadSize, pts))
+        {
+            if (pts >= 0)
+            {
+                SetSampleTimeStamp((m_pDemuxer == &m_RtpDepacketizer) ?
+                    GetRtpTimeStamp(pts, pBS->TimeStamp) :
+                    m_TimeManager->ConvertReferenceTime2MFXTime(GetPesTimeStamp(pts, rtSample)));
+                rtSample = INVALID_REFTIME;
+            }
+
+            if (!AppendData(pPayload, nPayloadSize))
+                return MFX_ERR_MEMORY_ALLOC;
+        }
+    }
+    else
+    {
+        // The sample's time stamp belongs to the first access unit starting in it
+        SetSampleTimeStamp(pBS->TimeStamp);
+        if (!AppendData(pDataBuffer, nDataSize))
+            return MFX_ERR_MEMORY_ALLOC;
+    }
+
+    return (GetNextFrame(pBS)) ? MFX_ERR_NONE : MFX_ERR_MORE_DATA;
+}
+
+bool CAccessUnitFrameConstructor::SetTransportStreamInput(mfxU32 codecId)
+{
+    // The demuxer feeds PES payloads straight into the access unit splitter
+    m_TsDemuxer.SetCodec(codecId);
+    m_pDemuxer = &m_TsDemuxer;
+    return true;
+}
+
+void CAccessUnitFrameConstructor::SetSampleTimeStamp(mfxU64 timeStamp)
+{
+    m_SampleTimeStamp = timeStamp;
+
+    // Data without a picture (e.g. the delimiter that ended the previous access unit) doesn't take the
+    // time stamp away from the picture starting in this sample
+    if (0 == m_nPendingSize ||
+        (!m_bHasPicture && !m_TimeManager->IsValidTimeStamp((REFERENCE_TIME)m_PendingTimeStamp)))
+    {
+        m_PendingTimeStamp = m_SampleTimeStamp;
+        m_SampleTimeStamp = m_TimeManager->ConvertReferenceTime2MFXTime(INVALID_REFTIME);
+    }
+}
+
+bool CAccessUnitFrameConstructor::AppendData(const mfxU8* pData, size_t nSize)
+{
+    // New data is appended to the pending access unit
+    size_t nOldLength = m_Bitstream.GetDataLength();
+    bool bAppended = WriteHeaders() && m_Bitstream.Append(pData, nSize);
+    m_nPendingSize += m_Bitstream.GetDataLength() - nOldLength;
+    if (!bAppended)
+        return false;
+
+    ScanAccessUnits();
+    return true;
+}
+
+void CAccessUnitFrameConstructor::ScanAccessUnits()
+{
+    const mfxU8* pPending = m_Bitstream.GetData() + m_Bitstream.GetDataLength() - m_nPendingSize;
+    size_t nFrameStart = 0; // Start of the pending access unit (relative to pPending)
+    MPEG2_StartCodeIterator itStartCode(pPending, m_nPendingSize, m_nScanPos);
+
+    // Only new data is scanned - each start code is parsed once
+    bool bNeedData = false;
+    while (!bNeedData && itStartCode.Next())
+    {
+        size_t nPos = itStartCode.GetPosition();
+        m_ParsedFrameType = 0;
+        m_ParsedDisplayOrder = INVALID_DISPLAY_ORDER;
+        switch (ParseStartCode(itStartCode.GetBuffer(), itStartCode.GetBufferLength()))
+        {
+        case AU_SC_PREFIX:
+            if (NO_POSITION == m_nPrefixPos)
+                m_nPrefixPos = nPos;
+            break;
+
+        case AU_SC_DELIMITER:
+            // Ends the access unit right away instead of at the next picture - saves a sample of latency
+            if (m_bHasPicture)
+            {
+                nFrameStart = EndAccessUnit(pPending, nFrameStart, nPos);
+                m_bHasPicture = false;
+                m_nPrefixPos = NO_POSITION;
+            }
+            else if (NO_POSITION == m_nPrefixPos)
+            {
+                m_nPrefixPos = nPos;
+            }
+            break;
+
+        case AU_SC_PICTURE:
+            // The previous access unit ends before the prefix start codes of the new picture
+            if (m_bHasPicture)
+            {
+                nFrameStart = EndAccessUnit(pPending, nFrameStart, nPos);
+            }
+
+            m_bHasPicture = true;
+            m_nPrefixPos = NO_POSITION;
+            m_PendingFrameType = m_ParsedFrameType;
+            m_PendingDisplayOrder = m_ParsedDisplayOrder;
+            break;
+
+        case AU_SC_SECOND_FIELD:
+            // The frame type is the type of the first field
+            m_nPrefixPos = NO_POSITION;
+            m_PendingFrameType |= (m_ParsedFrameType & MFX_FRAMETYPE_REF);
+            break;
+
+        case AU_SC_NEED_DATA:
+            bNeedData = true;
+            break;
+
+        case AU_SC_OTHER:
+            // Additional slices
+            m_PendingFrameType |= m_ParsedFrameType;
+            break;
+        }
+    }
+
+    // Note: GetPosition points to the first start code that wasn't parsed
+    m_nScanPos = itStartCode.GetPosition() - nFrameStart;
+    m_nPendingSize -= nFrameStart;
+    if (NO_POSITION != m_nPrefixPos)
+    {
+        m_nPrefixPos -= nFrameStart;
+    }
+}
+
+size_t CAccessUnitFrameConstructor::EndAccessUnit(const mfxU8* pPending, size_t nFrameStart, size_t nPos)
+{
+    size_t nFrameEnd = (NO_POSITION != m_nPrefixPos) ? m_nPrefixPos : nPos;
+
+    // The leading zero of a 4 byte start code (00 00 00 01) belongs to the next access unit
+    if (nFrameEnd > nFrameStart && 0 == pPending[nFrameEnd - 1])
+        --nFrameEnd;
+
+    PushAccessUnit(nFrameEnd - nFrameStart);
+    return nFrameEnd;
+}
+
+bool CAccessUnitFrameConstructor::IsHeaderComplete(const mfxU8* p, size_t nSize)
+{
+    if (nSize >= MAX_HEADER_SCAN_SIZE)
+        return true;
+
+    MPEG2_StartCodeIterator itStartCode(p, nSize, 4);
+    return itStartCode.Next();
+}
+
+void CAccessUnitFrameConstructor::PushAccessUnit(size_t nSize)
+{
+    TAccessUnit au = { nSize, m_PendingTimeStamp, m_PendingFrameType, m_PendingDisplayOrder };
+    m_AccessUnits.push_back(au);
+    m_PendingFrameType = 0;
+    m_PendingDisplayOrder = INVALID_DISPLAY_ORDER;
+
+    // The next access unit takes the current sample's time stamp if it wasn't used yet
+    m_PendingTimeStamp = m_SampleTimeStamp;
+    m_SampleTimeStamp = m_TimeManager->ConvertReferenceTime2MFXTime(INVALID_REFTIME);
+}
+
+bool CAccessUnitFrameConstructor::GetNextFrame(mfxBitstream* pBS)
+{
+    MSDK_CHECK_POINTER(pBS, false);
+
+    // Non-reference frames are dropped before reaching the decoder.
+    // Their parameter sets are moved to the start of the next access unit.
+    while (m_bSkipNonRefFrames && !m_AccessUnits.empty() && IsDisposableFrame(m_AccessUnits.front().FrameType))
+    {
+        size_t nSize = m_AccessUnits.front().nSize;
+        size_t nKept = 0;
+
+        // Nothing follows at the end of the stream
+        if (m_AccessUnits.size() > 1 || m_nPendingSize > 0)
+        {
+            mfxU8* p = m_Bitstream.GetData();
+            nKept = GatherParameterSets(p, nSize);
+            memmove(p + nSize - nKept, p, nKept);
+        }
+
+        mfxBitstream bsSkipped;
+        m_Bitstream.Detach(&bsSkipped, nSize - nKept);
+        m_AccessUnits.pop_front();
+
+        if (!m_AccessUnits.empty())
+        {
+            m_AccessUnits.front().nSize += nKept;
+        }
+        // Positions in the pending access unit are relative to its start
+        else if (nKept > 0)
+        {
+            m_nPendingSize += nKept;
+            m_nScanPos += nKept;
+            if (NO_POSITION != m_nPrefixPos)
+            {
+                m_nPrefixPos += nKept;
+            }
+        }
+    }
+
+    if (m_AccessUnits.empty())
+        return false;
+
+    // Complete access units are at the front of the bitstream buffer
+    const TAccessUnit& au = m_AccessUnits.front();
+    m_Bitstream.Detach(pBS, au.nSize);
+    pBS->TimeStamp = au.TimeStamp;
+    pBS->FrameType = au.FrameType;
+    pBS->DataFlag = MFX_BITSTREAM_COMPLETE_FRAME;
+    m_DisplayOrder = au.DisplayOrder;
+    m_AccessUnits.pop_front();
+    return true;
+}
+
+bool CAccessUnitFrameConstructor::FlushFrame(mfxBitstream* pBS)
+{
+    // End of stream - the pending access unit is complete
+    if (m_nPendingSize > 0)
+    {
+        PushAccessUnit(m_nPendingSize);
+        m_nPendingSize = 0;
+        m_nScanPos = 0;
+        m_nPrefixPos = NO_POSITION;
+        m_bHasPicture = false;
+    }
+
+    return GetNextFrame(pBS);
+}
+
+void CAccessUnitFrameConstructor::SaveResidualData(mfxBitstream* pBS)
+{
+    MSDK_CHECK_POINTER_NO_RET(pBS);
+
+    // The decoder takes complete frames entirely. Leftovers can't be merged with the next frame.
+    if (pBS->DataLength > 0)
+    {
+        MSDK_TRACE("QsDecoder: discarding %u bytes left from a complete frame\n", pBS->DataLength);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      CH264FrameConstructor
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+CH264FrameConstructor::CH264FrameConstructor(CDecTimeManager* tsManager) :
+    CAccessUnitFrameConstructor(tsManager)
+{
+    ResetParser();
+}
+
+mfxStatus CH264FrameConstructor::ConstructHeaders(VIDEOINFOHEADER2* vih, const GUID& guidFormat, size_t nMtSize, size_t nVideoInfoSize)
+{
+    mfxStatus sts = CAccessUnitFrameConstructor::ConstructHeaders(vih, guidFormat, nMtSize, nVideoInfoSize);
+    MSDK_CHECK_RESULT_P_RET(sts, MFX_ERR_NONE);
+
+    // Parse the parameter sets so the stream parameters are known before the first sample arrives
+    H264_NaluIterator itStartCode(m_Headers.Data, m_Headers.DataLength, 0);
+    H264_NAL_RC rc;
+    while (NALU_EOS != (rc = itStartCode.Next()))
+    {
+        if (NALU_INVALID == rc || itStartCode.GetDataLength() < 2)
+            continue;
+
+        const mfxU8* pPayload = itStartCode.GetDataBuffer() + 1;
+        size_t nPayloadSize = itStartCode.GetDataLength() - 1;
+        if (NALU_TYPE_SPS == itStartCode.GetNaluType())
+            m_Parser.ParseSPS(pPayload, nPayloadSize);
+        else if (NALU_TYPE_PPS == itStartCode.GetNaluType())
+            m_Parser.ParsePPS(pPayload, nPayloadSize);
+    }
+
+    return sts;
+}
+
+bool CH264FrameConstructor::GetReorderInfo(mfxU32& nNumReorderFrames, mfxU32& nMaxDecFrameBuffering)
+{
+    return m_Parser.GetReorderInfo(nNumReorderFrames, nMaxDecFrameBuffering);
+}
+
+bool CH264FrameConstructor::GetVideoSignalInfo(bool& bFullRange, mfxU32& nMatrixCoefficients)
+{
+    return m_Parser.GetVideoSignalInfo(bFullRange, nMatrixCoefficients);
+}
+
+bool CH264FrameConstructor::SetRtpInput()
+{
+    // The depacketizer writes the NALUs with start codes - the access unit splitter sees an AnnexB stream
+    m_pDemuxer = &m_RtpDepacketizer;
+    return true;
+}
+
+void CH264FrameConstructor::ResetParser()
+{
+    m_Parser.Reset();
+    MSDK_ZERO_VAR(m_LastField);
+    m_bFieldPending = false;
+    m_nPocPeriod = 0;
+}
+
+bool CH264FrameConstructor::IsParameterSet(const mfxU8* p, size_t nSize)
+{
+    return IsH264ParameterSet(p, nSize);
+}
+
+CAccessUnitFrameConstructor::TStartCodeType CH264FrameConstructor::ParseStartCode(const mfxU8* p, size_t nSize)
+{
+    const mfxU8* pPayload = p + 4;
+    size_t nPayloadSize = nSize - 4;
+
+    // NALUs that precede the first slice of a picture start a new access unit (7.4.1.2.3).
+    // Between the fields of a pair they wait for the next slice - the fields are decoded together.
+    TStartCodeType prefixType = (m_bFieldPending) ? AU_SC_PREFIX : AU_SC_DELIMITER;
+
+    // Note: not using H264_NAL - VS2010 treats the NALU_TYPE bit field as signed.
+    // Parsing failures are caused by missing data only until the NALU is complete.
+    switch (p[3] & 0x1F)
+    {
+    case NALU_TYPE_SPS:
+        if (!m_Parser.ParseSPS(pPayload, nPayloadSize) && !IsHeaderComplete(p, nSize))
+            return AU_SC_NEED_DATA;
+        return prefixType;
+
+    case NALU_TYPE_PPS:
+        if (!m_Parser.ParsePPS(pPayload, nPayloadSize) && !IsHeaderComplete(p, nSize))
+            return AU_SC_NEED_DATA;
+        return prefixType;
+
+    case NALU_TYPE_SEI:
+    case NALU_TYPE_AUD:
+    case 14: case 15: case 16: case 17: case 18:
+        return prefixType;
+
+    // SPS extension - follows its SPS
+    case 13:
+        return AU_SC_PREFIX;
+
+    case NALU_TYPE_SLICE:
+    case NALU_TYPE_DPA:
+    case NALU_TYPE_IDR:
+        {
+            H264_SliceHeader header;
+            if (!m_Parser.ParseSliceHeader(p[3], pPayload, nPayloadSize, header))
+                return (IsHeaderComplete(p, nSize)) ? AU_SC_OTHER : AU_SC_NEED_DATA;
+
+            m_ParsedFrameType = GetH264FrameType(header);
+
+            // Not the first slice of a picture
+            if (header.first_mb_in_slice != 0)
+                return AU_SC_OTHER;
+
+            // The POC state is updated by every picture and field
+            int32_t poc;
+            bool bHasPoc = m_Parser.DecodePOC(header, poc);
+
+            // Second field of a field pair
+            if (m_bFieldPending && IsSecondField(header, m_LastField))
+            {
+                m_bFieldPending = false;
+                return AU_SC_SECOND_FIELD;
+            }
+
+            if (bHasPoc)
+            {
+                if (NALU_TYPE_IDR == header.nal_unit_type || header.has_mmco5)
+                    ++m_nPocPeriod;
+
+                m_ParsedDisplayOrder = MakeDisplayOrder(m_nPocPeriod, poc);
+            }
+
+            m_bFieldPending = header.has_picture_info && header.field_pic_flag;
+            m_LastField = header;
+            return AU_SC_PICTURE;
+        }
+
+    default:
+        return AU_SC_OTHER;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      CMPEG2FrameConstructor
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+CMPEG2FrameConstructor::CMPEG2FrameConstructor(CDecTimeManager* tsManager) :
+    CAccessUnitFrameConstructor(tsManager)
+{
+    ResetParser();
+}
+
+void CMPEG2FrameConstructor::ResetParser()
+{
+    m_nPendingField = 0;
+    m_nGopPeriod = 0;
+    m_nLastTemporalRef = -1;
+}
+
+bool CMPEG2FrameConstructor::IsParameterSet(const mfxU8* p, size_t nSize)
+{
+    if (nSize < 5)
+        return false;
+
+    // Sequence header and the sequence level extensions following it
+    mfxU8 extensionId = p[4] >> 4;
+    return MPEG2_SEQUENCE_HEADER_CODE == p[3] ||
+        (MPEG2_EXTENSION_START_CODE == p[3] &&
+         (MPEG2_SEQUENCE_EXTENSION_ID == extensionId || MPEG2_SEQUENCE_DISPLAY_EXTENSION_ID == extensionId));
+}
+
+CAccessUnitFrameConstructor::TStartCodeType CMPEG2FrameConstructor::ParseStartCode(const mfxU8* p, size_t nSize)
+{
+    // Sequence and GOP headers start a new access unit - they can't appear between the fields of a pair
+    TStartCodeType prefixType = (0 == m_nPendingField) ? AU_SC_DELIMITER : AU_SC_PREFIX;
+
+    switch (p[3])
+    {
+    case MPEG2_GROUP_START_CODE:
+        // temporal_reference restarts after a GOP header
+        ++m_nGopPeriod;
+        m_nLastTemporalRef = -1;
+        return prefixType;
+
+    case MPEG2_SEQUENCE_HEADER_CODE:
+        return prefixType;
+
+    case MPEG2_PICTURE_START_CODE:
+        {
+            // picture_structure is found in the picture coding extension following the picture header
+            mfxU32 nStructure = 0;
+            MPEG2_StartCodeIterator itStartCode(p, nSize, 4);
+            while (itStartCode.Next())
+            {
+                mfxU8 code = itStartCode.GetStartCode();
+                if (MPEG2_EXTENSION_START_CODE == code)
+                {
+                    if (itStartCode.GetBufferLength() < 7)
+                        break;
+
+                    const mfxU8* pExt = itStartCode.GetBuffer() + 4;
+                    if ((pExt[0] >> 4) == MPEG2_PICTURE_CODING_EXTENSION_ID)
+                    {
+                        nStructure = pExt[2] & 3;
+                        if (0 == nStructure) // reserved
+                            nStructure = MPEG2_FRAME_PICTURE;
+
+                        break;
+                    }
+                }
+                // MPEG1 - no picture coding extension
+                else if (MPEG2_USER_DATA_START_CODE != code)
+                {
+                    nStructure = MPEG2_FRAME_PICTURE;
+                    break;
+                }
+            }
+
+            if (0 == nStructure)
+            {
+                if (nSize < MAX_HEADER_SCAN_SIZE)
+                    return AU_SC_NEED_DATA;
+
+                nStructure = MPEG2_FRAME_PICTURE;
+            }
+
+            // picture_coding_type follows the 10 bit temporal_reference. B pictures are never referenced.
+            switch ((p[5] >> 3) & 7)
+            {
+            case 2:  m_ParsedFrameType = MFX_FRAMETYPE_P | MFX_FRAMETYPE_REF; break;
+            case 3:  m_ParsedFrameType = MFX_FRAMETYPE_B; break;
+            default: m_ParsedFrameType = MFX_FRAMETYPE_I | MFX_FRAMETYPE_REF; break; // I or D pictures
+            }
+
+            // Second field of a field pair
+            if (nStructure != MPEG2_FRAME_PICTURE && m_nPendingField != 0 && nStructure != m_nPendingField)
+            {
+                m_nPendingField = 0;
+                return AU_SC_SECOND_FIELD;
+            }
+
+            // GOP headers are optional - temporal_reference (modulo 1024) wraps around in long GOPs
+            mfxI32 nTemporalRef = ((mfxI32)p[4] << 2) | (p[5] >> 6);
+            if (m_nLastTemporalRef >= 0 && nTemporalRef + 512 < m_nLastTemporalRef)
+                ++m_nGopPeriod;
+
+            m_nLastTemporalRef = nTemporalRef;
+            m_ParsedDisplayOrder = MakeDisplayOrder(m_nGopPeriod, nTemporalRef);
+            m_nPendingField = (nStructure != MPEG2_FRAME_PICTURE) ? nStructure : 0;
+            return AU_SC_PICTURE;
+        }
+
+    default:
+        return AU_SC_OTHER;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      CVC1FrameConstructor
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+CVC1FrameConstructor::CVC1FrameConstructor(CDecTimeManager* tsManager) :
+    CFrameConstructor(tsManager), m_FourCC(0), m_Width(0), m_Height(0)
+{
+}
+
+mfxStatus CVC1FrameConstructor::ConstructHeaders(
+    VIDEOINFOHEADER2* vih,
+    const GUID& guidFormat,
+    size_t nMtSize,
+    size_t nVideoInfoSize)
+{
+    m_FourCC = vih->bmiHeader.biCompression;
+    m_Width  = vih->bmiHeader.biWidth;
+    m_Height = vih->bmiHeader.biHeight;
+    
+    // All other formats except WMV3
+    if (FOURCC_WMV3 != m_FourCC)
+    {
+        if (FOURCC_VC1 == m_FourCC)
+        {
+            ++nVideoInfoSize;
+        }
+
+        return CFrameConstructor::ConstructHeaders(vih, guidFormat, nMtSize, nVideoInfoSize);
+    }
+
+    // Special case WMV3
+    MSDK_SAFE_DELETE_ARRAY(m_Headers.Data);
+    MSDK_ZERO_VAR(m_Headers);
+
+    // Nothing to do here...
+    if (nMtSize <= nVideoInfoSize)
+    {
+        return MFX_ERR_MORE_DATA;
+    }
+
+    // Header should be additionally constructed for main&simple profile in asf data type
+    m_Headers.MaxLength = m_Headers.DataLength = (mfxU32)(nMtSize - nVideoInfoSize + 20);
+    m_Headers.Data = new mfxU8[m_Headers.MaxLength];
+    mfxStatus sts = ConstructHeaderSM(m_Headers.Data,
+                                      m_Headers.DataLength,
+                                      (mfxU8*)(vih) + nVideoInfoSize,
+                                      (mfxU32)(nMtSize - nVideoInfoSize));
+    return sts;
+}
+
+mfxStatus CVC1FrameConstructor::ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS)
+{
+    mfxU8* pDataBuffer = NULL;
+    mfxU32 nDataSize   = 0;
+    MSDK_CHECK_POINTER(pSample, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+
+    nDataSize = pSample->GetActualDataLength();
+    MSDK_CHECK_ERROR(nDataSize, 0, MFX_ERR_MORE_DATA);
+
+    pSample->GetPointer(&pDataBuffer);
+    MSDK_CHECK_POINTER(pDataBuffer, MFX_ERR_NULL_PTR);
+
+    UpdateTimeStamp(pSample, pBS);
+
+    // Data left from previous samples is already in the bitstream buffer.
+    // Write sequence headers if needed
+    if (!WriteHeaders())
+        return MFX_ERR_MEMORY_ALLOC;
+
+    // Add upto 8 bytes for extra start codes
+    mfxU8* pData = m_Bitstream.Reserve(nDataSize + 8);
+    MSDK_CHECK_POINTER(pData, MFX_ERR_MEMORY_ALLOC);
+    mfxU8* pStart = pData;
+
+    if (FOURCC_VC1 != m_FourCC)
+    {
+        SetValue(nDataSize, pData); 
+        SetValue(0, pData + 4);
+        pData += 8;
+    }
+    else if (false == StartCodeExist(pDataBuffer))
+    {
+        // Set start code to first 4 bytes
+        SetValue(0x0D010000, pData);
+        pData += 4;
+    }
+
+    // Append new data
+    memcpy(pData, pDataBuffer, nDataSize);
+    pData += nDataSize;
+    m_Bitstream.Commit(pData - pStart);
+    m_Bitstream.Detach(pBS);
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CVC1FrameConstructor::ConstructHeaderSM(mfxU8* pHeaderSM, mfxU32 nHeaderSize, mfxU8* pDataBuffer, mfxU32 nDataSize)
+{
+    MSDK_CHECK_POINTER(pHeaderSM, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(pDataBuffer, MFX_ERR_NULL_PTR);
+    if (nHeaderSize < nDataSize + 20)
+    {
+        return MFX_ERR_NOT_ENOUGH_BUFFER;
+    }
+
+    // Set start code
+    SetValue(0xC5000000, pHeaderSM);
+
+    // Set size of sequence header is 4 bytes
+    SetValue(nDataSize, pHeaderSM + 4);
+
+    // Copy saved data back
+    memcpy(pHeaderSM + 8, pDataBuffer, nDataSize);
+
+    // Set sizes to the end of data
+    SetValue(m_Height, pHeaderSM + 8  + nDataSize);
+    SetValue(m_Width,  pHeaderSM + 12 + nDataSize);
+
+    // Set 0 to the last 4 bytes
+    SetValue(0,  pHeaderSM + 16 + nDataSize);
+
+    return MFX_ERR_NONE;
+}
+
+bool CVC1FrameConstructor::StartCodeExist(mfxU8* pStart)
+{
+    MSDK_CHECK_POINTER(pStart, false);
+
+    // Check first 4 bytes to be start code
+    mfxU32 value = GetValue32(pStart);
+    switch (value)
+    {
+    case 0x010A:
+    case 0x010B:
+    case 0x010C:
+    case 0x010D:
+    case 0x010E:
+    case 0x010F:
+    case 0x011B:
+    case 0x011C:
+    case 0x011D:
+    case 0x011E:
+    case 0x011F:
+        // Start code found
+        return true;
+    default:
+        // Start code not found
+        return false; 
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      CAVCFrameConstructor
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+CAVCFrameConstructor::CAVCFrameConstructor(CDecTimeManager* tsManager, mfxU32 nMaxFragmentSizeMB) :
+    CFrameConstructor(tsManager)
+{
+    m_HeaderNalSize = 2;  //MSDN - MPEG2VideoInfo->dwSequenceHeader delimited by 2 byte length fields
+    m_NalSize = 0;
+    m_nFragmentSize = 0;
+    m_nMaxFragmentSize = ((nMaxFragmentSizeMB) ? nMaxFragmentSizeMB : MAX_NALU_FRAGMENT_SIZE_MB) << 20;
+    m_nSkipSize = 0;
+    m_SampleFrameType = 0;
+    m_SampleDisplayOrder = INVALID_DISPLAY_ORDER;
+    m_FragmentTimeStamp = m_TimeManager->ConvertReferenceTime2MFXTime(INVALID_REFTIME);
+    MSDK_ZERO_VAR(m_LastField);
+    m_bFieldPending = false;
+    m_nPocPeriod = 0;
+    SetValue(0x01000000, m_H264StartCode);
+}
+
+CAVCFrameConstructor::~CAVCFrameConstructor()
+{
+}
+
+mfxStatus CAVCFrameConstructor::ConstructHeaders(VIDEOINFOHEADER2* vih,
+        const GUID& guidFormat,
+        size_t nMtSize,
+        size_t nVideoInfoSize)
+{
+    MSDK_SAFE_DELETE_ARRAY(m_Headers.Data);
+    m_Headers.DataLength = m_Headers.MaxLength = 0;
+
+    // Nothing to do here...
+    if (nMtSize <= nVideoInfoSize || FORMAT_MPEG2_VIDEO != guidFormat)
+    {
+        return MFX_ERR_MORE_DATA;
+    }
+
+    MPEG2VIDEOINFO* mp2 = (MPEG2VIDEOINFO*)(vih);
+    MSDK_CHECK_POINTER(mp2, MFX_ERR_NULL_PTR);
+
+    // SPS and/or PPS Data will be present
+    mfxStatus sts = MFX_ERR_NONE; 
+    MSDK_ZERO_VAR(m_Headers);
+    m_OutputBuffer.clear();
+    m_NalSize = mp2->dwFlags;     
+    H264_NaluIterator itStartCode((BYTE*)mp2->dwSequenceHeader, mp2->cbSequenceHeader, m_HeaderNalSize); // Nal size = 2 
+    H264_NAL_RC rc;
+    bool eos = false;
+
+    while (!eos)
+    {
+        rc = itStartCode.Next();
+        NALU_TYPE naluType = itStartCode.GetNaluType();
+
+        switch (rc)
+        {
+        case NALU_PARTIAL: // For headers, partials are fine (h264 extra data)
+        case NALU_OK:
+            {
+                size_t nNalDataLen = itStartCode.GetDataLength();
+                const BYTE* pNalDataBuff = itStartCode.GetDataBuffer();
+                if (naluType == NALU_TYPE_SPS || naluType == NALU_TYPE_PPS)
+                {
+                    ParseNalu(pNalDataBuff, nNalDataLen);
+                    m_OutputBuffer.insert(m_OutputBuffer.end(), m_H264StartCode, m_H264StartCode + 4);
+                    m_OutputBuffer.insert(m_OutputBuffer.end(), pNalDataBuff, pNalDataBuff+nNalDataLen);
+                }
+            }
+            break;
+
+        case NALU_EOS:
+            eos = true;
+            break;
+
+        case NALU_INVALID:
+            break;
+        } // switch
+    }
+
+    if (m_OutputBuffer.size())
+    {
+        // Keep a copy of the SPS/PPS to be placed into the decode stream (after each new segment).
+        MSDK_SAFE_DELETE_ARRAY(m_Headers.Data);
+        m_Headers.Data = new mfxU8[m_OutputBuffer.size()];
+        m_Headers.DataLength = m_Headers.MaxLength = (mfxU32)m_OutputBuffer.size();
+        memcpy(m_Headers.Data, &m_OutputBuffer.front(), m_OutputBuffer.size());
+    }
+
+    return sts; 
+}
+
+mfxStatus CAVCFrameConstructor::ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS)
+{
+    mfxU8* pDataBuffer = NULL;    
+    MSDK_CHECK_POINTER(pSample, MFX_ERR_NULL_PTR); 
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR); 
+
+    UpdateTimeStamp(pSample, pBS);
+    
+    mfxU32 nDataSize = pSample->GetActualDataLength();
+    MSDK_CHECK_ERROR(nDataSize, 0, MFX_ERR_MORE_DATA); 
+
+    pSample->GetPointer(&pDataBuffer);
+    MSDK_CHECK_POINTER(pDataBuffer, MFX_ERR_NULL_PTR);
+
+    // The rest of a NALU discarded by the fragment size limit is skipped. Its size field may be corrupted,
+    // so a sample that starts an access unit (time stamp, sync point or discontinuity) ends the skipping.
+    if (m_nSkipSize > 0 &&
+        (m_TimeManager->IsValidTimeStamp((REFERENCE_TIME)pBS->TimeStamp) ||
+         S_OK == pSample->IsSyncPoint() || S_OK == pSample->IsDiscontinuity()))
+    {
+        MSDK_TRACE("QsDecoder: resynchronized %I64u bytes before the end of a discarded NALU\n", m_nSkipSize);
+        m_nSkipSize = 0;
+    }
+
+    size_t nSkipped = SkipDiscardedData(nDataSize);
+    pDataBuffer += nSkipped;
+    nDataSize -= (mfxU32)nSkipped;
+
+    // A sample holds a single access unit - it's dropped when it's not a reference frame.
+    // The NALU completed from previous samples belongs to it (its slice header is parsed below).
+    size_t nSampleStart = m_Bitstream.GetDataLength();
+    bool bSeqHeaderInserted = m_bSeqHeaderInserted;
+    m_SampleFrameType = 0;
+    m_SampleDisplayOrder = INVALID_DISPLAY_ORDER;
+
+    // Complete the NALU left over from previous samples.
+    // Only the missing part is copied - the sample is not concatenated and parsed again.
+    bool bConverted = true;
+    if (!m_InputBuffer.empty())
+    {
+        size_t nUsed = 0;
+        bConverted = AppendNaluFragment(pDataBuffer, nDataSize, nUsed);
+        nUsed += SkipDiscardedData(nDataSize - nUsed);
+        pDataBuffer += nUsed;
+        nDataSize -= (mfxU32)nUsed;
+
+        // The picture started in the sample the fragment came from - it takes that sample's time stamp
+        if (INVALID_DISPLAY_ORDER != m_SampleDisplayOrder && m_TimeManager->IsValidTimeStamp((REFERENCE_TIME)m_FragmentTimeStamp))
+        {
+            pBS->TimeStamp = m_FragmentTimeStamp;
+        }
+    }
+
+    if (bConverted && nDataSize > 0)
+    {
+        // 4 byte NAL size fields are as long as a start code - convert without an intermediate buffer
+        if (4 == m_NalSize)
+        {
+            bConverted = ConvertNalusInPlace(pDataBuffer, nDataSize);
+        }
+        else
+        {
+            bConverted = ConvertNalus(pDataBuffer, nDataSize);
+        }
+
+        // A NALU left for the next sample starts a picture unless a picture started before it
+        m_FragmentTimeStamp = (INVALID_DISPLAY_ORDER == m_SampleDisplayOrder) ?
+            pBS->TimeStamp : m_TimeManager->ConvertReferenceTime2MFXTime(INVALID_REFTIME);
+    }
+
+    // Out of memory - the sample is dropped as a whole
+    if (!bConverted)
+    {
+        m_Bitstream.Truncate(nSampleStart);
+        m_bSeqHeaderInserted = bSeqHeaderInserted;
+        m_InputBuffer.clear();
+        m_nFragmentSize = 0;
+        m_SampleFrameType = 0;
+        m_SampleDisplayOrder = INVALID_DISPLAY_ORDER;
+        return MFX_ERR_MEMORY_ALLOC;
+    }
+
+    // Only the parameter sets of a dropped sample go to the decoder (the sequence headers inserted before it too)
+    if (m_bSkipNonRefFrames && IsDisposableFrame(m_SampleFrameType))
+    {
+        mfxU8* pSample = m_Bitstream.GetData() + nSampleStart;
+        m_Bitstream.Truncate(nSampleStart + GatherParameterSets(pSample, m_Bitstream.GetDataLength() - nSampleStart));
+        m_SampleFrameType = 0;
+        m_SampleDisplayOrder = INVALID_DISPLAY_ORDER;
+    }
+
+    // Data left from previous samples (processed data) is already in the bitstream buffer
+    m_Bitstream.Detach(pBS);
+    pBS->FrameType = m_SampleFrameType;
+    m_DisplayOrder = m_SampleDisplayOrder;
+    return MFX_ERR_NONE;
+}
+
+bool CAVCFrameConstructor::ConvertNalus(const mfxU8* pDataBuffer, mfxU32 nDataSize)
+{
+    H264_NaluIterator itStartCode(pDataBuffer, nDataSize, m_NalSize); // Nal size = 4 (usually); declared in extra data (ConstructHeaders)
+    bool eos = false;
+    // Iterate over the NALUs and convert them to have start codes.
+    while (!eos)
+    {
+        H264_NAL_RC rc = itStartCode.Next();
+
+        switch (rc)
+        {
+        case NALU_OK:
+            if (!WriteNalu(itStartCode.GetDataBuffer(), itStartCode.GetDataLength()))
+                return false;
+            break;
+
+        // Got partial NAL, save it for next run
+        // Note - The residial data buffer contains processed NALs.
+        //        Here we need to save unprocessed NALs.
+        case NALU_PARTIAL:
+            SaveNaluFragment(itStartCode.GetNALBuffer(), pDataBuffer + nDataSize);
+            break;
+
+        case NALU_EOS:
+            eos = true;
+            break;
+
+        case NALU_INVALID: // discard
+            break;
+        } // switch
+    }
+
+    // A size field split between samples (or not followed by any data yet)
+    if (itStartCode.GetPosition() < nDataSize)
+    {
+        SaveNaluFragment(pDataBuffer + itStartCode.GetPosition(), pDataBuffer + nDataSize);
+    }
+
+    return true;
+}
+
+bool CAVCFrameConstructor::ConvertNalusInPlace(const mfxU8* pDataBuffer, mfxU32 nDataSize)
+{
+    ASSERT(4 == m_NalSize);
+
+    // Each NALU (size field included) is copied once to the bitstream buffer.
+    // The size field is then overwritten by a start code of the same length.
+    mfxU8* pOutBuffer = NULL;
+    size_t nOutSize = 0;
+
+    H264_NaluIterator itStartCode(pDataBuffer, nDataSize, m_NalSize);
+    bool eos = false;
+    while (!eos)
+    {
+        H264_NAL_RC rc = itStartCode.Next();
+        NALU_TYPE naluType = itStartCode.GetNaluType();
+
+        switch (rc)
+        {
+        case NALU_OK:
+            {
+                // Discard AUD NALUs
+                if (NALU_TYPE_AUD == naluType)
+                    continue;
+
+                ParseNalu(itStartCode.GetDataBuffer(), itStartCode.GetDataLength());
+
+                if (NULL == pOutBuffer)
+                {
+                    // Write sequence headers if needed
+                    if (!WriteHeaders())
+                        return false;
+
+                    // Output is never larger than the input
+                    pOutBuffer = m_Bitstream.Reserve(nDataSize);
+                    if (NULL == pOutBuffer)
+                        return false;
+                }
+
+                size_t nNalLen = itStartCode.GetNalLength();
+                mfxU8* pNal = pOutBuffer + nOutSize;
+                memcpy(pNal, itStartCode.GetNALBuffer(), nNalLen);
+                memcpy(pNal, m_H264StartCode, 4);
+                nOutSize += nNalLen;
+            }
+            break;
+
+        // Got partial NAL, save it for next run
+        case NALU_PARTIAL:
+            SaveNaluFragment(itStartCode.GetNALBuffer(), pDataBuffer + nDataSize);
+            break;
+
+        case NALU_EOS:
+            eos = true;
+            break;
+
+        case NALU_INVALID: // discard
+            break;
+        } // switch
+    }
+
+    // A size field split between samples (or not followed by any data yet)
+    if (itStartCode.GetPosition() < nDataSize)
+    {
+        SaveNaluFragment(pDataBuffer + itStartCode.GetPosition(), pDataBuffer + nDataSize);
+    }
+
+    if (nOutSize > 0)
+    {
+        m_Bitstream.Commit(nOutSize);
+    }
+
+    return true;
+}
+
+bool CAVCFrameConstructor::WriteNalu(const mfxU8* pNalData, size_t nNalDataLen)
+{
+    if (0 == nNalDataLen)
+        return true;
+
+    // Discard AUD NALUs
+    H264_NAL nal;
+    nal.data = *pNalData;
+    if (NALU_TYPE_AUD == nal.nal_unit_type)
+        return true;
+
+    ParseNalu(pNalData, nNalDataLen);
+
+    // Write sequence headers if needed
+    if (!WriteHeaders())
+        return false;
+
+    mfxU8* pOutBuffer = m_Bitstream.Reserve(nNalDataLen + 4);
+    MSDK_CHECK_POINTER(pOutBuffer, false);
+    memcpy(pOutBuffer, m_H264StartCode, 4);
+    memcpy(pOutBuffer + 4, pNalData, nNalDataLen);
+    m_Bitstream.Commit(nNalDataLen + 4);
+    return true;
+}
+
+void CAVCFrameConstructor::SaveNaluFragment(const mfxU8* pStart, const mfxU8* pEnd)
+{
+    m_InputBuffer.assign(pStart, pEnd);
+    m_nFragmentSize = 0;
+    ReadFragmentSize();
+}
+
+void CAVCFrameConstructor::ReadFragmentSize()
+{
+    // Size is known or the size field isn't complete yet
+    if (m_nFragmentSize > 0 || m_InputBuffer.size() < m_NalSize)
+        return;
+
+    size_t nNalSize = 0;
+    for (mfxU32 i = 0; i < m_NalSize; ++i)
+    {
+        nNalSize = (nNalSize << 8) + m_InputBuffer[i];
+    }
+
+    // Protect against corrupted size fields.
+    // The rest of the NALU is skipped - the next samples would be parsed from the middle of it otherwise.
+    if (nNalSize > m_nMaxFragmentSize - m_NalSize)
+    {
+        MSDK_TRACE("QsDecoder: discarding a fragmented NALU of %u bytes (limit is %u bytes)\n",
+            (unsigned)nNalSize, (unsigned)m_nMaxFragmentSize);
+        m_nSkipSize = (mfxU64)m_NalSize + nNalSize - m_InputBuffer.size();
+        m_InputBuffer.clear();
+        return;
+    }
+
+    m_nFragmentSize = m_NalSize + nNalSize;
+
+    // Allocate the complete NALU once, each fragment is copied to its final place
+    m_InputBuffer.reserve(m_nFragmentSize);
+}
+
+bool CAVCFrameConstructor::AppendNaluFragment(const mfxU8* pDataBuffer, size_t nDataSize, size_t& nUsed)
+{
+    nUsed = 0;
+
+    // Complete the size field first
+    if (0 == m_nFragmentSize)
+    {
+        nUsed = min(nDataSize, m_NalSize - m_InputBuffer.size());
+        m_InputBuffer.insert(m_InputBuffer.end(), pDataBuffer, pDataBuffer + nUsed);
+        ReadFragmentSize();
+
+        // Still incomplete or discarded
+        if (0 == m_nFragmentSize)
+            return true;
+    }
+
+    ASSERT(m_InputBuffer.size() <= m_nFragmentSize);
+    size_t nCopy = min(nDataSize - nUsed, m_nFragmentSize - m_InputBuffer.size());
+    m_InputBuffer.insert(m_InputBuffer.end(), pDataBuffer + nUsed, pDataBuffer + nUsed + nCopy);
+    nUsed += nCopy;
+
+    // NALU is complete
+    if (m_InputBuffer.size() == m_nFragmentSize)
+    {
+        if (!WriteNalu(&m_InputBuffer.front() + m_NalSize, m_nFragmentSize - m_NalSize))
+            return false;
+
+        m_InputBuffer.clear();
+        m_nFragmentSize = 0;
+    }
+
+    return true;
+}
+
+size_t CAVCFrameConstructor::SkipDiscardedData(size_t nDataSize)
+{
+    size_t nSkip = (size_t)min((mfxU64)nDataSize, m_nSkipSize);
+    m_nSkipSize -= nSkip;
+    return nSkip;
+}
+
+bool CAVCFrameConstructor::IsParameterSet(const mfxU8* p, size_t nSize)
+{
+    return IsH264ParameterSet(p, nSize);
+}
+
+void CAVCFrameConstructor::ParseNalu(const mfxU8* pNalData, size_t nNalDataLen)
+{
+    if (nNalDataLen < 2)
+        return;
+
+    const mfxU8* pPayload = pNalData + 1;
+    size_t nPayloadSize = nNalDataLen - 1;
+
+    // Note: not using H264_NAL - VS2010 treats the NALU_TYPE bit field as signed
+    switch (pNalData[0] & 0x1F)
+    {
+    // In-band parameter sets may change the stream parameters
+    case NALU_TYPE_SPS:
+        m_Parser.ParseSPS(pPayload, nPayloadSize);
+        break;
+
+    case NALU_TYPE_PPS:
+        m_Parser.ParsePPS(pPayload, nPayloadSize);
+        break;
+
+    case NALU_TYPE_SLICE:
+    case NALU_TYPE_DPA:
+    case NALU_TYPE_IDR:
+        {
+            H264_SliceHeader header;
+            if (!m_Parser.ParseSliceHeader(pNalData[0], pPayload, nPayloadSize, header))
+                break;
+
+            m_SampleFrameType |= GetH264FrameType(header);
+            if (header.first_mb_in_slice != 0)
+                break;
+
+            // The POC state is updated by every picture and field.
+            // The second field of a pair doesn't start a new frame.
+            int32_t poc;
+            bool bHasPoc = m_Parser.DecodePOC(header, poc);
+            if (m_bFieldPending && IsSecondField(header, m_LastField))
+            {
+                m_bFieldPending = false;
+                break;
+            }
+
+            if (bHasPoc && INVALID_DISPLAY_ORDER == m_SampleDisplayOrder)
+            {
+                if (NALU_TYPE_IDR == header.nal_unit_type || header.has_mmco5)
+                    ++m_nPocPeriod;
+
+                m_SampleDisplayOrder = MakeDisplayOrder(m_nPocPeriod, poc);
+            }
+
+            m_bFieldPending = header.has_picture_info && header.field_pic_flag;
+            m_LastField = header;
+        }
+        break;
+    }
+}
+
+bool CAVCFrameConstructor::GetReorderInfo(mfxU32& nNumReorderFrames, mfxU32& nMaxDecFrameBuffering)
+{
+    return m_Parser.GetReorderInfo(nNumReorderFrames, nMaxDecFrameBuffering);
+}
+
+bool CAVCFrameConstructor::GetVideoSignalInfo(bool& bFullRange, mfxU32& nMatrixCoefficients)
+{
+    return m_Parser.GetVideoSignalInfo(bFullRange, nMatrixCoefficients);
+}
+
+void CAVCFrameConstructor::Reset()
+{
+    CFrameConstructor::Reset();
+    m_InputBuffer.clear();
+    m_nFragmentSize = 0;
+    m_nSkipSize = 0;
+    m_FragmentTimeStamp = m_TimeManager->ConvertReferenceTime2MFXTime(INVALID_REFTIME);
+    m_bFieldPending = false;
+
+    // The display order restarts after a seek
+    ++m_nPocPeriod;
+}
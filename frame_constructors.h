@@ -1,94 +1,379 @@
-/*
- * Copyright (c) 2013, INTEL CORPORATION
- * All rights reserved.
- * 
- * Redistribution and use in source and binary forms, with or without modification,
- * are permitted provided that the following conditions are met:
- * 
- * Redistributions of source code must retain the above copyright notice,
- * this list of conditions and the following disclaimer.
- * Redistributions in binary form must reproduce the above copyright notice,
- * this list of conditions and the following disclaimer in the documentation and/or
- * other materials provided with the distribution.
- * Neither the name of INTEL CORPORATION nor the names of its contributors may
- * be used to endorse or promote products derived from this software without specific
- * prior written permission.
- *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
- * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
- * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
- * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
- * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
- * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
- * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
- * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- * POSSIBILITY OF SUCH DAMAGE.
- */
-
-#pragma once
-
-class CFrameConstructor
-{
-public:
-    CFrameConstructor(CDecTimeManager* tsManager);
-    virtual ~CFrameConstructor();
-    virtual mfxStatus ConstructHeaders(VIDEOINFOHEADER2* vih, const GUID& guidFormat, size_t nMtSize, size_t nVideoInfoSize);
-    virtual mfxStatus ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS);
-    virtual void Reset();
-    void SaveResidualData(mfxBitstream* pBS);
-    inline mfxBitstream& GetHeaders() { return m_Headers; }
-    void SetDvdPacketStripping(bool stripPackets) { m_bDvdStripPackets = stripPackets; }
-
-protected:
-    inline void UpdateTimeStamp(IMediaSample* pSample, mfxBitstream* pBS);
-    inline void WriteResidualData(mfxU8*& pData);
-    inline void WriteHeaders(mfxU8*& pData);
-    inline void WriteSampleData(mfxU8*& pData, const mfxU8* pSrc, size_t nDataSize);
-    static void StripDvdPacket(BYTE*& p, int& len);
-
-    CDecTimeManager* m_TimeManager;
-    bool m_bSeqHeaderInserted;
-    bool m_bDvdStripPackets;
-    mfxBitstream m_Headers; 
-    mfxBitstream m_ResidialBS;
-};
-
-////////////////////////////////////////////////////////////////////////////////////////////
-
-class CVC1FrameConstructor : public CFrameConstructor
-{
-public:    
-    CVC1FrameConstructor(CDecTimeManager* tsManager);
-    mfxStatus ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS);
-    mfxStatus ConstructHeaders(VIDEOINFOHEADER2* vih, const GUID& guidFormat, size_t nMtSize, size_t nVideoInfoSize);
-
-protected:
-    mfxStatus ConstructHeaderSM(mfxU8* pHeaderSM, mfxU32 nHeaderSize, mfxU8* pDataBuffer, mfxU32 nDataSize);
-    bool StartCodeExist(mfxU8* pStart);
-
-    FOURCC m_FourCC;
-    DWORD m_Width, m_Height;
-};
-
-////////////////////////////////////////////////////////////////////////////////////////////
-
-class CAVCFrameConstructor : public CFrameConstructor
-{
-public:
-    CAVCFrameConstructor(CDecTimeManager* tsManager);
-    ~CAVCFrameConstructor();
-    mfxStatus ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS);
-    mfxStatus ConstructHeaders(VIDEOINFOHEADER2* vih,
-        const GUID& guidFormat,
-        size_t nMtSize,
-        size_t nVideoInfoSize);
-    void Reset();
-
-private:
-    mfxU32             m_NalSize; 
-    mfxU32             m_HeaderNalSize; 
-    mfxU8              m_H264StartCode[4];
-    std::vector<mfxU8> m_InputBuffer;
-    std::vector<mfxU8> m_OutputBuffer;       // Used for building the output stream
-};
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Reusable, growable bitstream buffer owned by a frame constructor.
+// New sample data is appended after the bytes the decoder hasn't consumed yet,
+// so residual data stays in place and steady state decoding does no heap allocations.
+// The unconsumed bytes are moved to the front of the buffer only when the free space
+// at the end runs out (mfxBitstream data must be contiguous so the buffer can't wrap).
+class CQsBitstreamBuffer
+{
+public:
+    CQsBitstreamBuffer(size_t nInitialSize = 1 << 20);
+    ~CQsBitstreamBuffer();
+
+    // Discard all data
+    void Clear() { m_nOffset = m_nLength = 0; }
+
+    // Returns a write pointer with at least nSize free bytes after the current data.
+    // Returns NULL when the buffer can't grow (the data is kept).
+    mfxU8* Reserve(size_t nSize);
+
+    // Appends nSize bytes that were written to the pointer returned by Reserve
+    void Commit(size_t nSize)
+    {
+        ASSERT(m_nOffset + m_nLength + nSize <= m_nSize);
+        m_nLength += nSize;
+    }
+
+    // Returns false when the buffer can't grow
+    bool Append(const mfxU8* pSrc, size_t nSize)
+    {
+        mfxU8* pDst = Reserve(nSize);
+        if (NULL == pDst)
+            return false;
+
+        memcpy(pDst, pSrc, nSize);
+        Commit(nSize);
+        return true;
+    }
+
+    // Discards the data appended after the first nLength bytes
+    void Truncate(size_t nLength)
+    {
+        ASSERT(nLength <= m_nLength);
+        m_nLength = min(nLength, m_nLength);
+    }
+
+    const mfxU8* GetData() const { return m_pBuffer + m_nOffset; }
+    mfxU8* GetData() { return m_pBuffer + m_nOffset; }
+    size_t GetDataLength() const { return m_nLength; }
+
+    // Hands out a view of the first nSize bytes (default is all data) to the decoder.
+    // The data is considered consumed until the view is attached back.
+    void Detach(mfxBitstream* pBS, size_t nSize = (size_t)-1);
+
+    // Takes back a view handed out by Detach. Bytes not consumed by the decoder are
+    // kept in place and will prefix the remaining data.
+    void Attach(const mfxBitstream* pBS);
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CQsBitstreamBuffer);
+
+    mfxU8* m_pBuffer;
+    size_t m_nSize;
+    size_t m_nOffset;  // Start of unconsumed data
+    size_t m_nLength;  // Length of unconsumed data
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+class CFrameConstructor
+{
+public:
+    CFrameConstructor(CDecTimeManager* tsManager);
+    virtual ~CFrameConstructor();
+    virtual mfxStatus ConstructHeaders(VIDEOINFOHEADER2* vih, const GUID& guidFormat, size_t nMtSize, size_t nVideoInfoSize);
+    virtual mfxStatus ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS);
+    virtual void Reset();
+    virtual void SaveResidualData(mfxBitstream* pBS);
+
+    // Constructors that split the stream into frames may have more frames ready after ConstructFrame.
+    // Should be called after SaveResidualData. Returns false when there are no more frames.
+    virtual bool GetNextFrame(mfxBitstream* /* pBS */) { return false; }
+
+    // End of stream - returns the data held back while waiting for the end of a frame
+    virtual bool FlushFrame(mfxBitstream* /* pBS */) { return false; }
+
+    // Reordering parameters of the latest sequence header (H264 only).
+    // Returns false when the stream didn't provide them yet.
+    virtual bool GetReorderInfo(mfxU32& /* nNumReorderFrames */, mfxU32& /* nMaxDecFrameBuffering */) { return false; }
+
+    // Range and matrix coefficients (H264 Table E-5) of the latest sequence header (H264 only).
+    // Returns false when the stream didn't signal them.
+    virtual bool GetVideoSignalInfo(bool& /* bFullRange */, mfxU32& /* nMatrixCoefficients */) { return false; }
+
+    // Display order (H264 POC, MPEG2 temporal_reference) of the last frame handed out.
+    // Returns false when it's unknown. Values only compare within the same stream segment (until Reset).
+    bool GetDisplayOrder(mfxI64& displayOrder) const
+    {
+        displayOrder = m_DisplayOrder;
+        return INVALID_DISPLAY_ORDER != m_DisplayOrder;
+    }
+
+    inline mfxBitstream& GetHeaders() { return m_Headers; }
+    void SetDvdPacketStripping(bool stripPackets) { m_pDemuxer = (stripPackets) ? &m_PsDemuxer : NULL; }
+
+    // Samples hold MPEG2 transport stream packets. Returns false when the stream type can't be carried
+    // in a transport stream. codecId selects the video stream (MFX_CODEC_*).
+    virtual bool SetTransportStreamInput(mfxU32 /* codecId */) { return false; }
+
+    // Samples hold RTP packets (RFC 6184). Returns false when the stream type can't be carried in RTP.
+    virtual bool SetRtpInput() { return false; }
+
+    // Non-reference frames are dropped instead of being sent to the decoder (H264 and MPEG2)
+    void SetSkipNonRefFrames(bool bSkip) { m_bSkipNonRefFrames = bSkip; }
+
+protected:
+    inline void UpdateTimeStamp(IMediaSample* pSample, mfxBitstream* pBS);
+    // Returns false when the bitstream buffer can't grow
+    inline bool WriteHeaders();
+
+    // Maps a PES PTS (90KHz) to the time line of the sample time stamps.
+    // rtSample is the sample's time stamp if the PES packet is the first one with a PTS in the sample.
+    REFERENCE_TIME GetPesTimeStamp(int64_t pts, REFERENCE_TIME rtSample);
+
+    // Maps an RTP time stamp (90KHz) to mfxBitstream::TimeStamp without going through REFERENCE_TIME.
+    // sampleTime is the sample's time stamp (MFX time).
+    mfxU64 GetRtpTimeStamp(int64_t ts, mfxU64 sampleTime);
+
+    // Combines a period counter (incremented whenever the display order restarts, e.g. IDR or GOP header)
+    // with the order inside the period into a single increasing value
+    static inline mfxI64 MakeDisplayOrder(mfxU32 nPeriod, mfxI32 nOrder) { return ((mfxI64)nPeriod << 32) + nOrder; }
+
+    // True when the unit at the start code p (00 00 01 XX) holds parameter sets (e.g. H264 SPS/PPS).
+    // nSize is the number of bytes available from p. Parameter sets survive dropped frames.
+    virtual bool IsParameterSet(const mfxU8* /* p */, size_t /* nSize */) { return false; }
+
+    // Moves the parameter sets found in the nSize bytes at p to the start of p (in stream order).
+    // Returns their size - the rest of the data is left over from the other units.
+    size_t GatherParameterSets(mfxU8* p, size_t nSize);
+
+    CDecTimeManager* m_TimeManager;
+    bool m_bSeqHeaderInserted;
+    IStreamDemuxer* m_pDemuxer;     // Extracts the video stream from DVD packs, TS or RTP packets (NULL - elementary stream)
+    bool m_bSkipNonRefFrames;
+    mfxI64 m_DisplayOrder;   // Display order of the last frame handed out
+    mfxBitstream m_Headers; 
+    CQsBitstreamBuffer m_Bitstream; // Holds residual data + new samples
+    CMPEG2PsDemuxer m_PsDemuxer;
+    CMPEG2TsDemuxer m_TsDemuxer;
+    CH264RtpDepacketizer m_RtpDepacketizer;
+    REFERENCE_TIME m_rtPesOffset;   // Sample time stamp minus PES PTS (100ns units)
+    int64_t m_LastPesPts;           // Unwrapped PTS of the previous PES packet (-1 - none)
+    int64_t m_PesPtsWrap;           // Added to PTS values after a wrap around of the 33 bit counter
+    int64_t m_RtpTimeOffset;        // Added to RTP time stamps (MFX time units)
+    bool m_bHasRtpTimeOffset;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Splits elementary streams with start codes into access units.
+// Each mfxBitstream holds exactly one frame (or a complementary field pair) and is marked with
+// MFX_BITSTREAM_COMPLETE_FRAME, so the decoder doesn't wait for the next sample to find the end of a frame.
+class CAccessUnitFrameConstructor : public CFrameConstructor
+{
+public:
+    CAccessUnitFrameConstructor(CDecTimeManager* tsManager);
+    mfxStatus ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS);
+    void Reset();
+    void SaveResidualData(mfxBitstream* pBS);
+    bool GetNextFrame(mfxBitstream* pBS);
+    bool FlushFrame(mfxBitstream* pBS);
+    bool SetTransportStreamInput(mfxU32 codecId);
+
+protected:
+    enum TStartCodeType
+    {
+        AU_SC_OTHER,          // Part of the current access unit
+        AU_SC_PREFIX,         // May start the next access unit (e.g. sequence headers), doesn't end the current one by itself
+        AU_SC_DELIMITER,      // Starts the next access unit - ends the current one if it has a picture (e.g. H264 AUD)
+        AU_SC_PICTURE,        // First start code of a new picture
+        AU_SC_SECOND_FIELD,   // First start code of the second field of the current picture
+        AU_SC_NEED_DATA       // Can't tell without more data
+    };
+
+    // Classifies the start code at p (00 00 01 XX). nSize is the number of bytes available from p.
+    // Must not change the parser state when returning AU_SC_NEED_DATA.
+    // Picture data found at a start code sets m_ParsedFrameType.
+    virtual TStartCodeType ParseStartCode(const mfxU8* p, size_t nSize) = 0;
+    virtual void ResetParser() = 0;
+
+    // Maximal amount of data needed for parsing the headers following a start code
+    enum { MAX_HEADER_SCAN_SIZE = 4096 };
+
+    // True when more data can't help parsing the start code at p - the unit is followed by the next
+    // start code or MAX_HEADER_SCAN_SIZE bytes are available
+    static bool IsHeaderComplete(const mfxU8* p, size_t nSize);
+
+    mfxU16 m_ParsedFrameType;     // MFX_FRAMETYPE_* flags of the last parsed start code (0 - no picture data)
+    mfxI64 m_ParsedDisplayOrder;  // Display order of the picture starting at the last parsed start code
+
+private:
+    static const size_t NO_POSITION = (size_t)-1;
+
+    struct TAccessUnit
+    {
+        size_t nSize;
+        mfxU64 TimeStamp;
+        mfxU16 FrameType;
+        mfxI64 DisplayOrder;
+    };
+
+    // The time stamp belongs to the first access unit starting in the data appended next
+    void SetSampleTimeStamp(mfxU64 timeStamp);
+
+    // Appends elementary stream data and splits off complete access units.
+    // Returns false when the bitstream buffer can't grow.
+    bool AppendData(const mfxU8* pData, size_t nSize);
+    void ScanAccessUnits();
+    void PushAccessUnit(size_t nSize);
+
+    // Pushes the pending access unit, which ends before the prefix start codes or at nPos.
+    // Returns the start of the next access unit (relative to pPending).
+    size_t EndAccessUnit(const mfxU8* pPending, size_t nFrameStart, size_t nPos);
+
+    std::deque<TAccessUnit> m_AccessUnits; // Complete access units waiting in the bitstream buffer
+    size_t m_nPendingSize;     // Size of the access unit being built (at the end of the bitstream buffer)
+    size_t m_nScanPos;         // Start code scanning resumes here (relative to the pending access unit)
+    size_t m_nPrefixPos;       // First prefix start code after the last picture (relative) or npos
+    bool   m_bHasPicture;      // Pending access unit contains a picture
+    mfxU64 m_PendingTimeStamp; // Time stamp of the pending access unit
+    mfxU16 m_PendingFrameType; // MFX_FRAMETYPE_* flags of the pending access unit
+    mfxI64 m_PendingDisplayOrder; // Display order of the pending access unit
+    mfxU64 m_SampleTimeStamp;  // Time stamp of the current sample, until an access unit starting in it takes it
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+class CH264FrameConstructor : public CAccessUnitFrameConstructor
+{
+public:
+    CH264FrameConstructor(CDecTimeManager* tsManager);
+    mfxStatus ConstructHeaders(VIDEOINFOHEADER2* vih, const GUID& guidFormat, size_t nMtSize, size_t nVideoInfoSize);
+    bool GetReorderInfo(mfxU32& nNumReorderFrames, mfxU32& nMaxDecFrameBuffering);
+    bool GetVideoSignalInfo(bool& bFullRange, mfxU32& nMatrixCoefficients);
+    bool SetRtpInput();
+
+protected:
+    TStartCodeType ParseStartCode(const mfxU8* p, size_t nSize);
+    void ResetParser();
+    bool IsParameterSet(const mfxU8* p, size_t nSize);
+
+    CH264Parser m_Parser;
+    H264_SliceHeader m_LastField;  // First field of the pending access unit
+    bool m_bFieldPending;          // m_LastField is waiting for its complementary field
+    mfxU32 m_nPocPeriod;           // Incremented on IDR and MMCO 5 pictures
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+class CMPEG2FrameConstructor : public CAccessUnitFrameConstructor
+{
+public:
+    CMPEG2FrameConstructor(CDecTimeManager* tsManager);
+
+protected:
+    TStartCodeType ParseStartCode(const mfxU8* p, size_t nSize);
+    void ResetParser();
+    bool IsParameterSet(const mfxU8* p, size_t nSize);
+
+    mfxU32 m_nPendingField;      // Picture structure of a first field waiting for its complementary field (0 - none)
+    mfxU32 m_nGopPeriod;         // Incremented on GOP headers - temporal_reference restarts
+    mfxI32 m_nLastTemporalRef;   // temporal_reference of the previous picture (-1 - new GOP)
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+class CVC1FrameConstructor : public CFrameConstructor
+{
+public:    
+    CVC1FrameConstructor(CDecTimeManager* tsManager);
+    mfxStatus ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS);
+    mfxStatus ConstructHeaders(VIDEOINFOHEADER2* vih, const GUID& guidFormat, size_t nMtSize, size_t nVideoInfoSize);
+
+protected:
+    mfxStatus ConstructHeaderSM(mfxU8* pHeaderSM, mfxU32 nHeaderSize, mfxU8* pDataBuffer, mfxU32 nDataSize);
+    bool StartCodeExist(mfxU8* pStart);
+
+    FOURCC m_FourCC;
+    DWORD m_Width, m_Height;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+class CAVCFrameConstructor : public CFrameConstructor
+{
+public:
+    CAVCFrameConstructor(CDecTimeManager* tsManager, mfxU32 nMaxFragmentSizeMB = 0);
+    ~CAVCFrameConstructor();
+    mfxStatus ConstructFrame(IMediaSample* pSample, mfxBitstream* pBS);
+    mfxStatus ConstructHeaders(VIDEOINFOHEADER2* vih,
+        const GUID& guidFormat,
+        size_t nMtSize,
+        size_t nVideoInfoSize);
+    void Reset();
+    bool GetReorderInfo(mfxU32& nNumReorderFrames, mfxU32& nMaxDecFrameBuffering);
+    bool GetVideoSignalInfo(bool& bFullRange, mfxU32& nMatrixCoefficients);
+
+private:
+    // Converts size fields to start codes while copying the sample to the bitstream buffer.
+    // The functions writing to the bitstream buffer return false when it can't grow.
+    bool ConvertNalus(const mfxU8* pDataBuffer, mfxU32 nDataSize);
+
+    // Converts 4 byte size fields to start codes while copying the sample to the bitstream buffer
+    bool ConvertNalusInPlace(const mfxU8* pDataBuffer, mfxU32 nDataSize);
+
+    // Writes a single NALU (without size field) with a start code to the bitstream buffer
+    bool WriteNalu(const mfxU8* pNalData, size_t nNalDataLen);
+
+    // Keeps the beginning of a NALU that continues in the next sample(s)
+    void SaveNaluFragment(const mfxU8* pStart, const mfxU8* pEnd);
+
+    // Reads the size of the fragmented NALU once its size field is complete
+    void ReadFragmentSize();
+
+    // Adds the continuation of a saved NALU. nUsed is the number of bytes used.
+    bool AppendNaluFragment(const mfxU8* pDataBuffer, size_t nDataSize, size_t& nUsed);
+
+    // Skips the part of a discarded NALU found at the start of the data. Returns the number of bytes skipped.
+    size_t SkipDiscardedData(size_t nDataSize);
+
+    // Parses parameter sets and slice headers (pNalData starts with the NALU header)
+    void ParseNalu(const mfxU8* pNalData, size_t nNalDataLen);
+
+    bool IsParameterSet(const mfxU8* p, size_t nSize);
+
+    mfxU32             m_NalSize; 
+    mfxU32             m_HeaderNalSize; 
+    mfxU8              m_H264StartCode[4];
+    std::vector<mfxU8> m_InputBuffer;        // Partial NALU (size field included) waiting for more data
+    size_t             m_nFragmentSize;      // Full size of the partial NALU in m_InputBuffer
+    size_t             m_nMaxFragmentSize;   // Partial NALUs larger than this are discarded
+    mfxU64             m_nSkipSize;          // Bytes of a discarded NALU still to come in the next samples
+    std::vector<mfxU8> m_OutputBuffer;       // Used for building the sequence headers
+    CH264Parser        m_Parser;             // Keeps the parameter sets (headers and in-band)
+    mfxU16             m_SampleFrameType;    // MFX_FRAMETYPE_* flags of the slices in the current sample
+    mfxI64             m_SampleDisplayOrder; // POC of the picture starting in the current sample
+    mfxU64             m_FragmentTimeStamp;  // Time stamp of the sample the partial NALU started in
+    H264_SliceHeader   m_LastField;          // First field of the last picture
+    bool               m_bFieldPending;      // m_LastField is waiting for its complementary field
+    mfxU32             m_nPocPeriod;         // Incremented on IDR and MMCO 5 pictures
+};
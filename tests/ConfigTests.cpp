@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "IQuickSyncDecoder.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "QsTest.h"
+
+// Applications built before QS_CONFIG_VERSION have a CQsConfig of 3 unions with the version bits zeroed
+QS_TEST(ConfigCopyOldApplication)
+{
+    CQsConfig decoderConfig;
+    decoderConfig.nOutputQueueLength = 8;
+    decoderConfig.bEnableH264 = true;
+    decoderConfig.nMaxWidth = 1920;
+    decoderConfig.nCopyKernel = QS_COPY_SSE41_STORE_X2;
+
+    // Getting the configuration doesn't write past the old structure
+    unsigned oldConfig[4] = { 0, 0, 0, 0xDEADBEEF };
+    CopyConfig((CQsConfig*)oldConfig, &decoderConfig);
+    QS_CHECK(0 == ((CQsConfig*)oldConfig)->nConfigVersion);
+    QS_CHECK(8 == ((CQsConfig*)oldConfig)->nOutputQueueLength);
+    QS_CHECK(((CQsConfig*)oldConfig)->bEnableH264);
+    QS_CHECK(0xDEADBEEF == oldConfig[3]);
+
+    // Setting it keeps the newer fields
+    ((CQsConfig*)oldConfig)->nOutputQueueLength = 16;
+    CopyConfig(&decoderConfig, (CQsConfig*)oldConfig);
+    QS_CHECK(QS_CONFIG_VERSION == decoderConfig.nConfigVersion);
+    QS_CHECK(16 == decoderConfig.nOutputQueueLength);
+    QS_CHECK(1920 == decoderConfig.nMaxWidth);
+    QS_CHECK(QS_COPY_SSE41_STORE_X2 == decoderConfig.nCopyKernel);
+}
+
+// Version 1 applications have the output stride in a 14 bit field of the copy options
+QS_TEST(ConfigCopyVersion1Application)
+{
+    // Version 1 ends before the output options
+    unsigned appConfig[(offsetof(CQsConfig, output) / sizeof(unsigned)) + 1];
+    memset(appConfig, 0, sizeof(appConfig));
+    appConfig[MSDK_ARRAY_LEN(appConfig) - 1] = 0xDEADBEEF;
+    CQsConfig* pAppConfig = (CQsConfig*)appConfig;
+    pAppConfig->nConfigVersion = 1;
+    pAppConfig->depr_nOutputStride = 4096;
+    pAppConfig->nOutputFormat = 2;
+
+    CQsConfig decoderConfig;
+    CopyConfig(&decoderConfig, pAppConfig);
+    QS_CHECK(4096 == decoderConfig.nOutputStride);
+    QS_CHECK(2 == decoderConfig.nOutputFormat);
+
+    // A 4K RGB32 stride doesn't fit - the application sees the default
+    decoderConfig.nOutputStride = 16384;
+    CopyConfig(pAppConfig, &decoderConfig);
+    QS_CHECK(1 == pAppConfig->nConfigVersion);
+    QS_CHECK(0 == pAppConfig->depr_nOutputStride);
+    QS_CHECK(0xDEADBEEF == appConfig[MSDK_ARRAY_LEN(appConfig) - 1]);
+
+    decoderConfig.nOutputStride = 8192;
+    CopyConfig(pAppConfig, &decoderConfig);
+    QS_CHECK(8192 == pAppConfig->depr_nOutputStride);
+}
+
+QS_TEST(ConfigCopyCurrentVersion)
+{
+    CQsConfig src, dst;
+    src.nMaxHeight = 1080;
+    src.bAutoSurfaceCount = true;
+    src.nOutputFormat = 1;
+    src.nOutputStride = 16384;
+    CopyConfig(&dst, &src);
+    QS_CHECK(0 == memcmp(&src, &dst, sizeof(CQsConfig)));
+}
@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "IQuickSyncDecoder.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "QuickSyncCopy.h"
+#include "TimeManager.h"
+#include "QsTest.h"
+#include "QsTestUtils.h"
+
+namespace
+{
+    // Bytes written to the destination before converting - bytes outside of the frame must keep it
+    const BYTE CANARY = 0xCD;
+
+    // NV12 surface with random pixels. The planes start at nShift bytes past a 64 byte boundary,
+    // which selects the kernel: 32 - AVX2, 16 - SSE4.1, other - C.
+    class CTestSurface
+    {
+    public:
+        CTestSurface(size_t nPitch, size_t nHeight, size_t nShift, CQsTestRandom& random) :
+            m_nPitch(nPitch),
+            m_Buffer(nPitch * nHeight * 3 / 2 + 64)
+        {
+            m_pY = m_Buffer.GetBuffer() + nShift;
+            m_pUV = m_pY + nPitch * nHeight;
+            for (size_t i = 0; i < nPitch * nHeight * 3 / 2; ++i)
+            {
+                m_pY[i] = (BYTE)random.Next(256);
+            }
+        }
+
+        size_t GetPitch() const { return m_nPitch; }
+        const BYTE* GetY(size_t x, size_t y) const { return m_pY + y * m_nPitch + x; }
+        const BYTE* GetUV(size_t x, size_t y) const { return m_pUV + (y / 2) * m_nPitch + (x & ~(size_t)1); }
+
+    private:
+        size_t           m_nPitch;
+        CQsAlignedBuffer m_Buffer;
+        BYTE*            m_pY;
+        BYTE*            m_pUV;
+    };
+
+    // A frame cropped from a surface. NV12 crops whole chroma samples, so an odd crop offset or size
+    // extends the converted window to the chroma sample's pixels (rows of the same field when interlaced).
+    struct TCrop
+    {
+        size_t nX, nY, nWidth, nHeight;
+    };
+
+    // Frame converted by ConvertNV12 and the reference result
+    struct TConvertJob
+    {
+        const CTestSurface* pSurface;
+        size_t              nX, nY;   // Window in the surface
+        size_t              nWidth, nHeight;
+        bool                bInterlaced;
+        QsOutputFormat      format;
+        TQsRgbMatrix        matrix;
+        double              kr, kb;   // Matrix of the reference
+        bool                bFullRange;
+    };
+
+    size_t GetBytesPerPixel(QsOutputFormat format)
+    {
+        return (QS_OUTPUT_RGB32 == format) ? 4 : (QS_OUTPUT_YUY2 == format) ? 2 : 1;
+    }
+
+    // Surface luma row of the chroma used by row y of the window (GetUV takes luma rows).
+    // Interlaced chroma rows alternate between the fields when the height is a multiple of 4.
+    size_t GetChromaRow(const TConvertJob& job, size_t y)
+    {
+        bool bFields = job.bInterlaced && 0 == (job.nHeight & 3);
+        size_t nChromaRow = (bFields) ? 2 * (y / 4) + (y & 1) : y / 2;
+        return job.nY + 2 * nChromaRow;
+    }
+
+    BYTE RefClamp(double x)
+    {
+        x = floor(x + 0.5);
+        return (BYTE)((x < 0) ? 0 : (x > 255) ? 255 : x);
+    }
+
+    // Converts pixel (x, y) of the window the straightforward way
+    void RefPixel(const TConvertJob& job, size_t x, size_t y, BYTE* pOut)
+    {
+        const BYTE Y = *job.pSurface->GetY(job.nX + x, job.nY + y);
+        const BYTE* pUV = job.pSurface->GetUV(job.nX + x, GetChromaRow(job, y));
+        double kg = 1 - job.kr - job.kb;
+        double yScale = (job.bFullRange) ? 1.0 : 255.0 / 219.0;
+        double cScale = (job.bFullRange) ? 1.0 : 255.0 / 224.0;
+        double yn = (Y - ((job.bFullRange) ? 0 : 16)) * yScale;
+        double cb = (pUV[0] - 128) * cScale;
+        double cr = (pUV[1] - 128) * cScale;
+
+        pOut[0] = RefClamp(yn + 2 * (1 - job.kb) * cb);
+        pOut[1] = RefClamp(yn - (2 * job.kb * (1 - job.kb) * cb + 2 * job.kr * (1 - job.kr) * cr) / kg);
+        pOut[2] = RefClamp(yn + 2 * (1 - job.kr) * cr);
+        pOut[3] = 0xFF;
+    }
+
+    // RGB may differ from the floating point reference by one (fixed-point rounding)
+    bool CompareRgb(const BYTE* pActual, const BYTE* pExpected)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            if (abs(pActual[i] - pExpected[i]) > 1)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool IsCanary(const BYTE* p, size_t nSize)
+    {
+        for (size_t i = 0; i < nSize; ++i)
+        {
+            if (CANARY != p[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    // Converts the window and checks every converted byte against the reference.
+    // Bytes past the rows (up to the next 16 pixels are allowed) and past the last row must stay untouched.
+    // The converted frame is returned for comparisons between the kernels.
+    bool ConvertAndCheck(const TConvertJob& job, bool bMultiThreaded, std::vector<BYTE>& out)
+    {
+        const size_t nBytesPerPixel = GetBytesPerPixel(job.format);
+        const size_t nWidth = (job.nWidth + 1) & ~(size_t)1;
+        const size_t nRowSize = MSDK_ALIGN16(nWidth) * nBytesPerPixel;
+        const size_t nDstPitch = MSDK_ALIGN32(nRowSize + 32);
+        const bool bPlanar = QS_OUTPUT_I420 == job.format || QS_OUTPUT_YV12 == job.format;
+        const size_t nChromaPitch = nDstPitch / 2;
+
+        // Y plane (or packed frame) and chroma planes with a row to spare
+        out.assign(nDstPitch * (job.nHeight + 1) + 2 * nChromaPitch * (job.nHeight / 2 + 1), CANARY);
+        BYTE* pDst = &out[0];
+        BYTE* pU = pDst + nDstPitch * (job.nHeight + 1);
+        BYTE* pV = pU + nChromaPitch * (job.nHeight / 2 + 1);
+        if (QS_OUTPUT_YV12 == job.format)
+        {
+            std::swap(pU, pV);
+        }
+
+        TQsConvertFrame frame =
+        {
+            job.pSurface->GetY(job.nX, job.nY), job.pSurface->GetUV(job.nX, job.nY), job.pSurface->GetPitch(),
+            pDst, (bPlanar) ? pU : NULL, (bPlanar) ? pV : NULL, nDstPitch,
+            job.nWidth, job.nHeight, job.bInterlaced, &job.matrix
+        };
+
+        ConvertNV12(frame, job.format, memcpy, bMultiThreaded);
+
+        bool bPassed = true;
+        for (size_t y = 0; y < job.nHeight; ++y)
+        {
+            BYTE* pRow = pDst + y * nDstPitch;
+            for (size_t x = 0; x < nWidth; ++x)
+            {
+                const BYTE* pUV = job.pSurface->GetUV(job.nX + x, GetChromaRow(job, y));
+                BYTE Y = *job.pSurface->GetY(job.nX + x, job.nY + y);
+                if (QS_OUTPUT_RGB32 == job.format)
+                {
+                    BYTE expected[4];
+                    RefPixel(job, x, y, expected);
+                    bPassed = bPassed && CompareRgb(pRow + 4 * x, expected);
+                }
+                else if (QS_OUTPUT_YUY2 == job.format)
+                {
+                    bPassed = bPassed && pRow[2 * x] == Y && pRow[2 * x + 1] == pUV[x & 1];
+                }
+                else
+                {
+                    bPassed = bPassed && pRow[x] == Y;
+                }
+            }
+
+            // The converter may write up to the next 16 pixels
+            bPassed = bPassed && IsCanary(pRow + nRowSize, nDstPitch - nRowSize);
+        }
+
+        bPassed = bPassed && IsCanary(pDst + job.nHeight * nDstPitch, nDstPitch);
+
+        if (bPlanar)
+        {
+            // Chroma planes are copied row by row - interlacing doesn't matter
+            for (size_t c = 0; c < job.nHeight / 2; ++c)
+            {
+                const BYTE* pUV = job.pSurface->GetUV(job.nX, job.nY + 2 * c);
+                for (size_t x = 0; x < nWidth / 2; ++x)
+                {
+                    bPassed = bPassed && pU[c * nChromaPitch + x] == pUV[2 * x] && pV[c * nChromaPitch + x] == pUV[2 * x + 1];
+                }
+
+                bPassed = bPassed && IsCanary(pU + c * nChromaPitch + nRowSize / 2, nChromaPitch - nRowSize / 2);
+                bPassed = bPassed && IsCanary(pV + c * nChromaPitch + nRowSize / 2, nChromaPitch - nRowSize / 2);
+            }
+
+            bPassed = bPassed && IsCanary(pU + (job.nHeight / 2) * nChromaPitch, nChromaPitch);
+            bPassed = bPassed && IsCanary(pV + (job.nHeight / 2) * nChromaPitch, nChromaPitch);
+        }
+
+        return bPassed;
+    }
+
+    // Converts the crop with every format on the C, SSE4.1 and AVX2 paths and checks the results
+    void CheckCrop(const TCrop& crop, bool bInterlaced, bool bMultiThreaded)
+    {
+        // Interlaced windows start on a field pair. Heights that aren't a multiple of 4 are paired like progressive rows.
+        const size_t nRowAlign = (bInterlaced) ? 4 : 2;
+        const size_t nShifts[] = { 0, 16, 32, 2 };
+        const QsOutputFormat formats[] = { QS_OUTPUT_I420, QS_OUTPUT_YV12, QS_OUTPUT_YUY2, QS_OUTPUT_RGB32 };
+
+        TConvertJob job;
+        job.nX = crop.nX & ~(size_t)1;
+        job.nY = crop.nY - crop.nY % nRowAlign;
+        job.nWidth = crop.nX + crop.nWidth - job.nX;
+        job.nHeight = ((crop.nY + crop.nHeight + 1) & ~(size_t)1) - job.nY;
+        job.bInterlaced = bInterlaced;
+
+        // Room past the window for the 16 pixel blocks, spare rows
+        size_t nPitch = MSDK_ALIGN32(job.nX + job.nWidth + 64);
+        CQsTestRandom random;
+
+        for (size_t f = 0; f < MSDK_ARRAY_LEN(formats); ++f)
+        {
+            job.format = formats[f];
+
+            // BT.601 limited range and BT.709 full range
+            for (int m = 0; m < 2; ++m)
+            {
+                job.kr = (0 == m) ? 0.299 : 0.2126;
+                job.kb = (0 == m) ? 0.114 : 0.0722;
+                job.bFullRange = 1 == m;
+                InitRgbMatrix(job.matrix, job.kr, job.kb, job.bFullRange);
+
+                for (size_t s = 0; s < MSDK_ARRAY_LEN(nShifts); ++s)
+                {
+                    CTestSurface surface(nPitch, job.nY + job.nHeight + 2, nShifts[s], random);
+                    job.pSurface = &surface;
+
+                    std::vector<BYTE> out;
+                    if (!QS_CHECK(ConvertAndCheck(job, bMultiThreaded, out)))
+                    {
+                        printf("    format %d, %s, crop %u,%u %ux%u, shift %u\n", (int)job.format, (bInterlaced) ? "interlaced" : "progressive",
+                            (unsigned)crop.nX, (unsigned)crop.nY, (unsigned)crop.nWidth, (unsigned)crop.nHeight, (unsigned)nShifts[s]);
+                        return;
+                    }
+                }
+            }
+        }
+    }
+
+    // Odd widths, odd crop offsets and small frames that leave only C tails
+    const TCrop s_Crops[] =
+    {
+        {  0, 0,   2,  2 }, {  0, 0,   1,  4 }, {  0, 0,  15,  4 }, {  0, 0,  16,  8 }, {  0, 0,  17,  8 },
+        {  0, 0,  31, 12 }, {  0, 0,  33, 16 }, {  0, 0,  63, 10 }, {  0, 0,  64, 16 }, {  0, 0, 127, 18 },
+        {  1, 1,  16,  8 }, {  3, 2,  30,  6 }, {  7, 3,  63, 13 }, { 17, 5,  99, 21 }, { 34, 6, 100, 16 },
+        { 33, 9, 129, 31 }, { 48, 4, 200, 24 }
+    };
+}
+
+QS_TEST(ConvertProgressive)
+{
+    for (size_t i = 0; i < MSDK_ARRAY_LEN(s_Crops); ++i)
+    {
+        CheckCrop(s_Crops[i], false, false);
+    }
+}
+
+// Windows of 4n + 2 rows check the progressive pairing of interlaced frames
+QS_TEST(ConvertInterlaced)
+{
+    for (size_t i = 0; i < MSDK_ARRAY_LEN(s_Crops); ++i)
+    {
+        CheckCrop(s_Crops[i], true, false);
+    }
+}
+
+// The SIMD paths give the same RGB as the C path - the reference comparison allows for rounding
+QS_TEST(ConvertRgbKernelsMatch)
+{
+    const size_t nPitch = 256, nWidth = 190, nHeight = 32;
+    const size_t nShifts[] = { 2, 16, 32 };
+    CQsTestRandom random;
+    CTestSurface surface(nPitch, nHeight, 0, random);
+    TQsRgbMatrix matrix;
+    InitRgbMatrix(matrix, 0.2126, 0.0722, false);
+
+    std::vector<BYTE> outputs[MSDK_ARRAY_LEN(nShifts)];
+    for (size_t s = 0; s < MSDK_ARRAY_LEN(nShifts); ++s)
+    {
+        // The same pixels at another alignment
+        CQsAlignedBuffer buffer(nPitch * nHeight * 3 / 2 + 64);
+        BYTE* pY = buffer.GetBuffer() + nShifts[s];
+        memcpy(pY, surface.GetY(0, 0), nPitch * nHeight * 3 / 2);
+
+        outputs[s].assign(4 * nPitch * nHeight, CANARY);
+        TQsConvertFrame frame =
+        {
+            pY, pY + nPitch * nHeight, nPitch,
+            &outputs[s][0], NULL, NULL, 4 * nPitch,
+            nWidth, nHeight, true, &matrix
+        };
+
+        ConvertNV12(frame, QS_OUTPUT_RGB32, memcpy, false);
+    }
+
+    // SIMD paths write whole 16 pixel blocks - only the frame's pixels are compared
+    for (size_t s = 1; s < MSDK_ARRAY_LEN(nShifts); ++s)
+    {
+        bool bSame = true;
+        for (size_t y = 0; y < nHeight; ++y)
+        {
+            bSame = bSame && 0 == memcmp(&outputs[0][4 * nPitch * y], &outputs[s][4 * nPitch * y], 4 * nWidth);
+        }
+
+        QS_CHECK(bSame);
+    }
+}
+
+// Bands of rows on the copy thread pool give the same result
+QS_TEST(ConvertMultiThreaded)
+{
+    CQsCopyThreadPool& pool = CQsCopyThreadPool::Instance();
+    pool.Configure(3, 0);
+    pool.Attach();
+
+    TCrop crops[] = { { 0, 0, 256, 136 }, { 5, 3, 333, 270 } };
+    for (size_t i = 0; i < MSDK_ARRAY_LEN(crops); ++i)
+    {
+        CheckCrop(crops[i], false, true);
+        CheckCrop(crops[i], true, true);
+    }
+
+    pool.Detach();
+    pool.Configure(0, 0);
+}
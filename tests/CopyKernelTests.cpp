@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "IQuickSyncDecoder.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "QuickSyncCopy.h"
+#include "TimeManager.h"
+#include "QsTest.h"
+#include "QsTestUtils.h"
+
+namespace
+{
+    // Bytes around the destination - a kernel must not write them
+    const BYTE CANARY = 0xCD;
+
+    // Room before and after the copied bytes. The source needs some for the over-read of the last block.
+    const size_t GUARD_SIZE = 64;
+
+    // Kernels that run on this CPU (QS_COPY_AUTO included - it calibrates on the first large copies)
+    std::vector<QsCopyKernel> GetSupportedKernels()
+    {
+        std::vector<QsCopyKernel> kernels;
+        CQsCopyKernels& registry = CQsCopyKernels::Instance();
+        for (int i = 0; i < QS_COPY_KERNEL_COUNT; ++i)
+        {
+            if (QS_COPY_AUTO == i || registry.IsSupported((QsCopyKernel)i))
+            {
+                kernels.push_back((QsCopyKernel)i);
+            }
+        }
+
+        return kernels;
+    }
+
+    // Copies nSize random bytes from nSrcShift to nDstShift bytes past a 64 byte boundary and compares
+    // the result with the source. Returns false on the first difference.
+    bool CheckCopy(Tmemcpy copyFunc, size_t nSize, size_t nSrcShift, size_t nDstShift, CQsTestRandom& random)
+    {
+        CQsAlignedBuffer src(nSize + 3 * GUARD_SIZE);
+        CQsAlignedBuffer dst(nSize + 3 * GUARD_SIZE);
+        BYTE* pSrc = src.GetBuffer() + GUARD_SIZE + nSrcShift;
+        BYTE* pDst = dst.GetBuffer() + GUARD_SIZE + nDstShift;
+        for (size_t i = 0; i < src.GetBufferSize(); ++i)
+        {
+            src.GetBuffer()[i] = (BYTE)random.Next(256);
+        }
+
+        memset(dst.GetBuffer(), CANARY, dst.GetBufferSize());
+        if (copyFunc(pDst, pSrc, nSize) != pDst)
+            return false;
+
+        if (0 != memcmp(pDst, pSrc, nSize))
+            return false;
+
+        for (BYTE* p = dst.GetBuffer(); p < pDst; ++p)
+        {
+            if (CANARY != *p)
+                return false;
+        }
+
+        for (BYTE* p = pDst + nSize; p < dst.GetBuffer() + dst.GetBufferSize(); ++p)
+        {
+            if (CANARY != *p)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Source and destination offsets from a 64 byte boundary. Equal offsets select the kernel:
+    // 0 - AVX-512, 32 - AVX2, 16/48 - SSE4.1, other - memcpy. Different offsets fall back to slower paths.
+    const size_t s_Shifts[][2] = { { 0, 0 }, { 16, 16 }, { 32, 32 }, { 48, 48 }, { 1, 1 }, { 0, 16 }, { 16, 0 }, { 3, 7 } };
+}
+
+// Every size up to a few loop iterations of the widest kernel - the tails of all unroll depths
+QS_TEST(CopyKernelsSmallSizes)
+{
+    CQsTestRandom random;
+    std::vector<QsCopyKernel> kernels = GetSupportedKernels();
+    for (size_t k = 0; k < kernels.size(); ++k)
+    {
+        Tmemcpy copyFunc = CQsCopyKernels::Instance().GetCopyFunc(kernels[k]);
+        for (size_t s = 0; s < MSDK_ARRAY_LEN(s_Shifts); ++s)
+        {
+            for (size_t nSize = 0; nSize <= 1024; ++nSize)
+            {
+                if (!CheckCopy(copyFunc, nSize, s_Shifts[s][0], s_Shifts[s][1], random))
+                {
+                    printf("  %s failed: %u bytes, offsets %u/%u\n", CQsCopyKernels::GetName(kernels[k]),
+                        (unsigned)nSize, (unsigned)s_Shifts[s][0], (unsigned)s_Shifts[s][1]);
+                    QS_CHECK(false);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Frame sized copies with tails that don't fill a whole block
+QS_TEST(CopyKernelsLargeSizes)
+{
+    static const size_t sizes[] = { 64 * 1024, 64 * 1024 + 15, 64 * 1024 + 17, 64 * 1024 + 63, 64 * 1024 + 200,
+        1920 * 1088 * 3 / 2, 1024 * 1024 + 48 };
+
+    CQsTestRandom random;
+    std::vector<QsCopyKernel> kernels = GetSupportedKernels();
+    for (size_t k = 0; k < kernels.size(); ++k)
+    {
+        Tmemcpy copyFunc = CQsCopyKernels::Instance().GetCopyFunc(kernels[k]);
+        for (size_t s = 0; s < MSDK_ARRAY_LEN(s_Shifts); ++s)
+        {
+            for (size_t i = 0; i < MSDK_ARRAY_LEN(sizes); ++i)
+            {
+                if (!CheckCopy(copyFunc, sizes[i], s_Shifts[s][0], s_Shifts[s][1], random))
+                {
+                    printf("  %s failed: %u bytes, offsets %u/%u\n", CQsCopyKernels::GetName(kernels[k]),
+                        (unsigned)sizes[i], (unsigned)s_Shifts[s][0], (unsigned)s_Shifts[s][1]);
+                    QS_CHECK(false);
+                }
+            }
+        }
+    }
+}
+
+// The last block of the source is read whole (16 bytes) even when only some of its bytes are copied.
+// The block is aligned, so the read can't reach the next page - here a page that can't be accessed.
+QS_TEST(CopyKernelsTailStaysInPage)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const size_t nPage = info.dwPageSize;
+    BYTE* pPages = (BYTE*)VirtualAlloc(NULL, 2 * nPage, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!QS_CHECK(pPages != NULL))
+        return;
+
+    DWORD dwOldProtect;
+    QS_CHECK(VirtualProtect(pPages + nPage, nPage, PAGE_NOACCESS, &dwOldProtect));
+
+    CQsTestRandom random;
+    for (size_t i = 0; i < nPage; ++i)
+    {
+        pPages[i] = (BYTE)random.Next(256);
+    }
+
+    std::vector<QsCopyKernel> kernels = GetSupportedKernels();
+    CQsAlignedBuffer dst(nPage);
+    for (size_t k = 0; k < kernels.size(); ++k)
+    {
+        Tmemcpy copyFunc = CQsCopyKernels::Instance().GetCopyFunc(kernels[k]);
+        for (size_t nSize = 1; nSize <= 512; ++nSize)
+        {
+            // The last 16 byte block of the source ends with the page
+            const BYTE* pSrc = pPages + nPage - MSDK_ALIGN16(nSize);
+            copyFunc(dst.GetBuffer(), pSrc, nSize);
+            if (0 != memcmp(dst.GetBuffer(), pSrc, nSize))
+            {
+                printf("  %s failed: %u bytes\n", CQsCopyKernels::GetName(kernels[k]), (unsigned)nSize);
+                QS_CHECK(false);
+                break;
+            }
+        }
+    }
+
+    VirtualFree(pPages, 0, MEM_RELEASE);
+}
+
+namespace
+{
+    // Compares the first nRowSize bytes of each row with the source. The rest of the destination rows
+    // and the bytes after the last row must keep the canary.
+    bool CheckCompactedPlane(const TQsCopyPlane& plane, size_t nDstSize)
+    {
+        size_t nRows = plane.nSize / plane.nPitch;
+        const BYTE* pSrc = (const BYTE*)plane.pSrc;
+        const BYTE* pDst = (const BYTE*)plane.pDst;
+        for (size_t y = 0; y < nRows; ++y)
+        {
+            if (0 != memcmp(pDst + y * plane.nDstPitch, pSrc + y * plane.nPitch, plane.nRowSize))
+                return false;
+
+            for (size_t x = plane.nRowSize; x < plane.nDstPitch; ++x)
+            {
+                if (CANARY != pDst[y * plane.nDstPitch + x])
+                    return false;
+            }
+        }
+
+        for (size_t i = nRows * plane.nDstPitch; i < nDstSize; ++i)
+        {
+            if (CANARY != pDst[i])
+                return false;
+        }
+
+        return true;
+    }
+}
+
+// Compacted planes: only the row size of each source row is copied, into rows of the destination pitch.
+// Bands start at any row.
+QS_TEST(CopyPlaneBandCompacts)
+{
+    // Pitch, row size and destination pitch (visible width rounded to 64 bytes, application strides)
+    static const size_t layouts[][3] = { { 2048, 1920, 1920 }, { 2048, 1344, 1408 }, { 256, 100, 112 }, { 256, 1, 16 } };
+    const size_t nRows = 37;
+
+    CQsTestRandom random;
+    for (size_t l = 0; l < MSDK_ARRAY_LEN(layouts); ++l)
+    {
+        const size_t nPitch = layouts[l][0];
+        CQsAlignedBuffer src(nPitch * nRows);
+        for (size_t i = 0; i < src.GetBufferSize(); ++i)
+        {
+            src.GetBuffer()[i] = (BYTE)random.Next(256);
+        }
+
+        const size_t nDstSize = layouts[l][2] * nRows + GUARD_SIZE;
+        CQsAlignedBuffer dst(nDstSize);
+        TQsCopyPlane plane = { dst.GetBuffer(), src.GetBuffer(), nPitch * nRows, nPitch, layouts[l][2], layouts[l][1] };
+
+        // The whole plane at once
+        memset(dst.GetBuffer(), CANARY, nDstSize);
+        CopyPlaneBand(plane, 0, plane.nSize, CQsCopyKernels::Instance().GetCopyFunc(QS_COPY_SSE41_STORE_X4));
+        QS_CHECK(CheckCompactedPlane(plane, nDstSize));
+
+        // Bands of 1, 2 and 5 rows
+        static const size_t bandRows[] = { 1, 2, 5 };
+        for (size_t b = 0; b < MSDK_ARRAY_LEN(bandRows); ++b)
+        {
+            memset(dst.GetBuffer(), CANARY, nDstSize);
+            for (size_t nOffset = 0; nOffset < plane.nSize; nOffset += bandRows[b] * nPitch)
+            {
+                CopyPlaneBand(plane, nOffset, min(bandRows[b] * nPitch, plane.nSize - nOffset), memcpy);
+            }
+
+            QS_CHECK(CheckCompactedPlane(plane, nDstSize));
+        }
+
+        // Not compacted - the plane is copied as is
+        CQsAlignedBuffer dstWhole(plane.nSize);
+        TQsCopyPlane whole = { dstWhole.GetBuffer(), src.GetBuffer(), nPitch * nRows, nPitch, 0, 0 };
+        CopyPlaneBand(whole, 0, whole.nSize, memcpy);
+        QS_CHECK(0 == memcmp(dstWhole.GetBuffer(), src.GetBuffer(), whole.nSize));
+    }
+}
+
+// NV12 planes compacted by the copy thread pool - bands go to several threads
+QS_TEST(CopyPoolCompactsPlanes)
+{
+    const size_t nPitch = 4096, nRowSize = 3840, nDstPitch = 3904, nHeight = 2160;
+    CQsTestRandom random;
+    CQsAlignedBuffer src(nPitch * nHeight * 3 / 2);
+    for (size_t i = 0; i < src.GetBufferSize(); ++i)
+    {
+        src.GetBuffer()[i] = (BYTE)random.Next(256);
+    }
+
+    const size_t nDstSize = nDstPitch * nHeight * 3 / 2 + GUARD_SIZE;
+    CQsAlignedBuffer dst(nDstSize);
+    memset(dst.GetBuffer(), CANARY, nDstSize);
+
+    BYTE* pSrcUV = src.GetBuffer() + nPitch * nHeight;
+    BYTE* pDstUV = dst.GetBuffer() + nDstPitch * nHeight;
+    TQsCopyPlane planes[2] =
+    {
+        { dst.GetBuffer(), src.GetBuffer(), nPitch * nHeight, nPitch, nDstPitch, nRowSize },
+        { pDstUV, pSrcUV, nPitch * nHeight / 2, nPitch, nDstPitch, nRowSize }
+    };
+
+    CQsCopyThreadPool& pool = CQsCopyThreadPool::Instance();
+    pool.Attach();
+    pool.Copy(planes, 2, CQsCopyKernels::Instance().GetCopyFunc(QS_COPY_SSE41_STORE_X4));
+    pool.Detach();
+
+    QS_CHECK(CheckCompactedPlane(planes[0], nDstPitch * nHeight));
+    QS_CHECK(CheckCompactedPlane(planes[1], nDstSize - nDstPitch * nHeight));
+}
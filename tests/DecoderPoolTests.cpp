@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "IQuickSyncDecoder.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "QuickSyncPool.h"
+#include "QuickSyncDecoder.h"
+#include "QsTest.h"
+
+namespace
+{
+    // Shared by the stub objects of a test
+    struct TStubState
+    {
+        bool   bFailChildInit; // Init of stream sessions fails (the parent is initialized with the requested implementation)
+        bool   bFailJoin;
+        bool   bClosedJoined;  // A session was closed while joined to a parent
+        size_t nSessions;      // Alive
+        size_t nDecoders;      // Alive
+        size_t nDecoderInits;
+        size_t nDecoderResets;
+    };
+
+    // MSDK session that never reaches the dispatcher. Reports the SW implementation so the pool
+    // uses the system memory allocator and no HW device.
+    class CStubSession : public MFXVideoSession
+    {
+    public:
+        CStubSession(TStubState& state) : m_State(state), m_pParent(NULL), m_nChildren(0)
+        {
+            ++m_State.nSessions;
+        }
+
+        ~CStubSession()
+        {
+            Close();
+            --m_State.nSessions;
+        }
+
+        mfxStatus Init(mfxIMPL impl, mfxVersion* /* ver */)
+        {
+            // The pool's parent sessions are the first ones with the requested implementation
+            if (m_State.bFailChildInit && impl == MFX_IMPL_SOFTWARE)
+                return MFX_ERR_UNSUPPORTED;
+
+            m_session = (mfxSession)this;
+            return MFX_ERR_NONE;
+        }
+
+        mfxStatus Close()
+        {
+            // A joined session must leave its parent first
+            m_State.bClosedJoined = m_State.bClosedJoined || NULL != m_pParent;
+            m_session = (mfxSession)0;
+            return MFX_ERR_NONE;
+        }
+
+        mfxStatus QueryIMPL(mfxIMPL* impl) { *impl = MFX_IMPL_SOFTWARE; return MFX_ERR_NONE; }
+        mfxStatus QueryVersion(mfxVersion* version) { version->Major = 1; version->Minor = 1; return MFX_ERR_NONE; }
+
+        mfxStatus JoinSession(mfxSession child)
+        {
+            if (m_State.bFailJoin)
+                return MFX_ERR_UNSUPPORTED;
+
+            ((CStubSession*)child)->m_pParent = this;
+            ++m_nChildren;
+            return MFX_ERR_NONE;
+        }
+
+        mfxStatus DisjoinSession()
+        {
+            MSDK_CHECK_POINTER(m_pParent, MFX_ERR_UNDEFINED_BEHAVIOR);
+            --m_pParent->m_nChildren;
+            m_pParent = NULL;
+            return MFX_ERR_NONE;
+        }
+
+        mfxStatus SetFrameAllocator(mfxFrameAllocator*) { return MFX_ERR_NONE; }
+        mfxStatus SetHandle(mfxHandleType, mfxHDL) { return MFX_ERR_NONE; }
+
+        CStubSession* GetParent() const { return m_pParent; }
+        size_t GetChildCount() const { return m_nChildren; }
+
+    private:
+        TStubState&   m_State;
+        CStubSession* m_pParent;
+        size_t        m_nChildren;
+    };
+
+    class CStubDecoder : public MFXVideoDECODE
+    {
+    public:
+        CStubDecoder(mfxSession session, TStubState& state) : MFXVideoDECODE(session), m_State(state) { ++m_State.nDecoders; }
+        ~CStubDecoder()
+        {
+            // The base destructor must not pass the stub session to MSDK
+            m_session = (mfxSession)0;
+            --m_State.nDecoders;
+        }
+
+        mfxStatus Close() { return MFX_ERR_NONE; }
+        mfxStatus Init(mfxVideoParam*) { ++m_State.nDecoderInits; return MFX_ERR_NONE; }
+        mfxStatus Reset(mfxVideoParam*) { ++m_State.nDecoderResets; return MFX_ERR_NONE; }
+
+        mfxStatus QueryIOSurf(mfxVideoParam*, mfxFrameAllocRequest* request)
+        {
+            request->NumFrameMin = request->NumFrameSuggested = 4;
+            return MFX_ERR_NONE;
+        }
+
+    private:
+        TStubState& m_State;
+    };
+
+    class CStubSessionFactory : public CQsSessionFactory
+    {
+    public:
+        CStubSessionFactory() { MSDK_ZERO_VAR(m_State); }
+
+        MFXVideoSession* CreateSession() { return new CStubSession(m_State); }
+        MFXVideoDECODE* CreateDecoder(MFXVideoSession* pSession) { return new CStubDecoder((mfxSession)*pSession, m_State); }
+
+        TStubState m_State;
+    };
+
+    // Installs the stub factory on the process wide pool for the lifetime of a test
+    class CStubPool
+    {
+    public:
+        CStubPool() : m_Pool(CQsDecoderPool::Instance())
+        {
+            m_bInstalled = m_Pool.SetSessionFactory(&m_Factory);
+            m_Pool.SetMaxStreamsPerDevice(0);
+        }
+
+        ~CStubPool()
+        {
+            m_Pool.SetMaxStreamsPerDevice(0);
+            m_Pool.SetSessionFactory(NULL);
+        }
+
+        CQsDecoderPool&     m_Pool;
+        CStubSessionFactory m_Factory;
+        bool                m_bInstalled;
+    };
+
+    const mfxVersion s_MinVersion = { { MIN_REQUIRED_API_VER_MINOR, MIN_REQUIRED_API_VER_MAJOR } };
+    const mfxIMPL s_Impl = MFX_IMPL_AUTO_ANY | MFX_IMPL_VIA_D3D9;
+}
+
+// Streams with the same implementation are joined to one parent session and share its allocator.
+// The device goes away with its last stream.
+QS_TEST(DecoderPoolStreamsShareDevice)
+{
+    CStubPool stub;
+    QS_CHECK(stub.m_bInstalled);
+
+    TQsPoolStream* pStreams[2] = { NULL, NULL };
+    QS_CHECK(MFX_ERR_NONE == stub.m_Pool.OpenStream(s_Impl, s_MinVersion, pStreams[0]));
+    QS_CHECK(MFX_ERR_NONE == stub.m_Pool.OpenStream(s_Impl, s_MinVersion, pStreams[1]));
+    if (!QS_CHECK(pStreams[0] && pStreams[1]))
+        return;
+
+    QS_CHECK(1 == stub.m_Pool.GetDeviceCount());
+    QS_CHECK(2 == stub.m_Pool.GetStreamCount());
+    QS_CHECK(3 == stub.m_Factory.m_State.nSessions);
+    QS_CHECK(2 == stub.m_Factory.m_State.nDecoders);
+
+    // Both streams run on the parent's scheduler with the SW allocator
+    CStubSession* pParent = ((CStubSession*)pStreams[0]->pSession)->GetParent();
+    QS_CHECK(pParent != NULL);
+    QS_CHECK(pParent == ((CStubSession*)pStreams[1]->pSession)->GetParent());
+    QS_CHECK(pParent && 2 == pParent->GetChildCount());
+    QS_CHECK(pStreams[0]->pAllocator != NULL && pStreams[0]->pAllocator == pStreams[1]->pAllocator);
+    QS_CHECK(NULL == pStreams[0]->pHwDevice);
+    QS_CHECK(MFX_IMPL_SOFTWARE == pStreams[0]->impl);
+    QS_CHECK(pStreams[0]->pDecoder != pStreams[1]->pDecoder);
+
+    // The device stays while a stream uses it
+    stub.m_Pool.CloseStream(pStreams[0]);
+    QS_CHECK(1 == stub.m_Pool.GetDeviceCount());
+    QS_CHECK(pParent && 1 == pParent->GetChildCount());
+    QS_CHECK(2 == stub.m_Factory.m_State.nSessions);
+    QS_CHECK(1 == stub.m_Factory.m_State.nDecoders);
+
+    // A new factory can't be set while a device is open
+    QS_CHECK(!stub.m_Pool.SetSessionFactory(NULL));
+
+    stub.m_Pool.CloseStream(pStreams[1]);
+    QS_CHECK(0 == stub.m_Pool.GetDeviceCount());
+    QS_CHECK(0 == stub.m_Pool.GetStreamCount());
+    QS_CHECK(!stub.m_Factory.m_State.bClosedJoined);
+    QS_CHECK(0 == stub.m_Factory.m_State.nSessions);
+    QS_CHECK(0 == stub.m_Factory.m_State.nDecoders);
+}
+
+// Devices are filled up to the stream limit. Other implementations get their own device.
+QS_TEST(DecoderPoolMaxStreamsPerDevice)
+{
+    CStubPool stub;
+    stub.m_Pool.SetMaxStreamsPerDevice(2);
+
+    TQsPoolStream* pStreams[4] = { NULL, NULL, NULL, NULL };
+    for (size_t i = 0; i < 3; ++i)
+    {
+        QS_CHECK(MFX_ERR_NONE == stub.m_Pool.OpenStream(s_Impl, s_MinVersion, pStreams[i]));
+    }
+
+    QS_CHECK(2 == stub.m_Pool.GetDeviceCount());
+    QS_CHECK(pStreams[0]->pOwner == pStreams[1]->pOwner);
+    QS_CHECK(pStreams[0]->pOwner != pStreams[2]->pOwner);
+
+    const mfxIMPL implD3D11 = MFX_IMPL_AUTO_ANY | MFX_IMPL_VIA_D3D11;
+    QS_CHECK(MFX_ERR_NONE == stub.m_Pool.OpenStream(implD3D11, s_MinVersion, pStreams[3]));
+    QS_CHECK(3 == stub.m_Pool.GetDeviceCount());
+    QS_CHECK(pStreams[3]->pOwner != pStreams[2]->pOwner);
+
+    // The first device has room again - it's used before the second one
+    stub.m_Pool.CloseStream(pStreams[1]);
+    QS_CHECK(MFX_ERR_NONE == stub.m_Pool.OpenStream(s_Impl, s_MinVersion, pStreams[1]));
+    QS_CHECK(pStreams[0]->pOwner == pStreams[1]->pOwner);
+
+    for (size_t i = 0; i < MSDK_ARRAY_LEN(pStreams); ++i)
+    {
+        stub.m_Pool.CloseStream(pStreams[i]);
+    }
+
+    QS_CHECK(0 == stub.m_Pool.GetDeviceCount());
+    QS_CHECK(0 == stub.m_Factory.m_State.nSessions);
+    QS_CHECK(0 == stub.m_Factory.m_State.nDecoders);
+}
+
+// A stream that can't be opened leaves nothing behind - a new device is released right away
+QS_TEST(DecoderPoolOpenFailure)
+{
+    CStubPool stub;
+    TQsPoolStream* pStream = NULL;
+
+    stub.m_Factory.m_State.bFailJoin = true;
+    QS_CHECK(MFX_ERR_UNSUPPORTED == stub.m_Pool.OpenStream(s_Impl, s_MinVersion, pStream));
+    QS_CHECK(NULL == pStream);
+    QS_CHECK(0 == stub.m_Pool.GetDeviceCount());
+    QS_CHECK(0 == stub.m_Factory.m_State.nSessions);
+
+    stub.m_Factory.m_State.bFailJoin = false;
+    stub.m_Factory.m_State.bFailChildInit = true;
+    QS_CHECK(MFX_ERR_UNSUPPORTED == stub.m_Pool.OpenStream(s_Impl, s_MinVersion, pStream));
+    QS_CHECK(0 == stub.m_Pool.GetDeviceCount());
+    QS_CHECK(0 == stub.m_Factory.m_State.nSessions);
+
+    // An existing device stays for its other streams
+    stub.m_Factory.m_State.bFailChildInit = false;
+    TQsPoolStream* pFirst = NULL;
+    QS_CHECK(MFX_ERR_NONE == stub.m_Pool.OpenStream(s_Impl, s_MinVersion, pFirst));
+    stub.m_Factory.m_State.bFailJoin = true;
+    QS_CHECK(MFX_ERR_UNSUPPORTED == stub.m_Pool.OpenStream(s_Impl, s_MinVersion, pStream));
+    QS_CHECK(1 == stub.m_Pool.GetDeviceCount());
+    QS_CHECK(1 == stub.m_Pool.GetStreamCount());
+
+    stub.m_Pool.CloseStream(pFirst);
+    QS_CHECK(0 == stub.m_Pool.GetDeviceCount());
+    QS_CHECK(0 == stub.m_Factory.m_State.nSessions);
+    QS_CHECK(0 == stub.m_Factory.m_State.nDecoders);
+}
+
+// A stream that takes a warm decoder over keeps its surfaces when they are enough for it.
+// Surfaces are reallocated only for a stream that needs more of them.
+QS_TEST(WarmDecoderTakeOverKeepsSurfaces)
+{
+    CStubPool stub;
+    CQsWarmDecoderCache& cache = CQsWarmDecoderCache::Instance();
+    size_t nCapacity = cache.GetCapacity();
+    cache.SetCapacity(1);
+
+    CQsConfig cfg;
+    cfg.bEnableD3D11 = true;
+    mfxStatus sts = MFX_ERR_NONE;
+    CQuickSyncDecoder* pDecoder = new CQuickSyncDecoder(cfg, NULL, true, sts);
+    QS_CHECK(MFX_ERR_NONE == sts);
+
+    mfxVideoParam params;
+    MSDK_ZERO_VAR(params);
+    params.mfx.CodecId = MFX_CODEC_AVC;
+    mfxFrameInfo& info = params.mfx.FrameInfo;
+    info.FourCC       = MFX_FOURCC_NV12;
+    info.ChromaFormat = MFX_CHROMAFORMAT_YUV420;
+    info.Width        = info.CropW = 1280;
+    info.Height       = 736;
+    info.CropH        = 720;
+
+    // Prewarmed decoder
+    pDecoder->SetAuxFramesCount(8);
+    QS_CHECK(MFX_ERR_NONE == pDecoder->Init(&params, info.Width));
+    QS_CHECK(12 == pDecoder->GetSurfaceCount());
+    mfxFrameSurface1* pSurface = pDecoder->FindFreeSurface();
+    mfxMemId mid = (pSurface) ? pSurface->Data.MemId : NULL;
+    QS_CHECK(cache.Release(pDecoder));
+
+    CQuickSyncDecoder* pWarm = cache.Acquire(true, pDecoder->GetRequestedImpl(), MFX_CODEC_AVC, 1280, 720);
+    QS_CHECK(pWarm == pDecoder);
+    if (NULL == pWarm)
+    {
+        cache.SetCapacity(nCapacity);
+        return;
+    }
+
+    // Fewer aux surfaces - the warm surfaces stay and the MSDK decoder is only reset
+    pWarm->ReserveAuxFramesCount(5);
+    QS_CHECK(pWarm->IsWarmFor(MFX_CODEC_AVC, 1280, 720));
+    QS_CHECK(MFX_ERR_NONE == pWarm->Reset(&params, info.Width));
+    QS_CHECK(12 == pWarm->GetSurfaceCount());
+    pSurface = pWarm->FindFreeSurface();
+    QS_CHECK(pSurface && pSurface->Data.MemId == mid);
+    QS_CHECK(1 == stub.m_Factory.m_State.nDecoderInits);
+    QS_CHECK(1 == stub.m_Factory.m_State.nDecoderResets);
+
+    // More aux surfaces - allocated again
+    pWarm->ReserveAuxFramesCount(10);
+    QS_CHECK(0 == pWarm->GetSurfaceCount());
+    QS_CHECK(MFX_ERR_NONE == pWarm->Reset(&params, info.Width));
+    QS_CHECK(14 == pWarm->GetSurfaceCount());
+    QS_CHECK(2 == stub.m_Factory.m_State.nDecoderInits);
+
+    delete pWarm;
+    cache.SetCapacity(nCapacity);
+    QS_CHECK(0 == stub.m_Factory.m_State.nDecoders);
+}
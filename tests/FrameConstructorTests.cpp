@@ -0,0 +1,532 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "TimeManager.h"
+#include "H264Nalu.h"
+#include "H264Parser.h"
+#include "MPEG2PsDemux.h"
+#include "MPEG2TsDemux.h"
+#include "H264RtpDepacketizer.h"
+#include "frame_constructors.h"
+#include "QsTest.h"
+#include "QsTestUtils.h"
+
+namespace
+{
+    // Frame as handed out to the decoder
+    struct TTestFrame
+    {
+        std::vector<mfxU8> data;
+        mfxU64 timeStamp;
+        mfxU16 frameType;
+        mfxI64 displayOrder;
+    };
+
+    // Feeds a sample the way CQuickSync::Decode does. The decoder takes all data it's given.
+    mfxStatus FeedSample(CFrameConstructor& fc, IMediaSample* pSample, std::vector<TTestFrame>& frames)
+    {
+        mfxBitstream bs;
+        MSDK_ZERO_VAR(bs);
+        mfxStatus sts = fc.ConstructFrame(pSample, &bs);
+        if (MFX_ERR_NONE != sts)
+            return sts;
+
+        do
+        {
+            if (bs.DataLength > 0)
+            {
+                TTestFrame frame;
+                frame.data.assign(bs.Data + bs.DataOffset, bs.Data + bs.DataOffset + bs.DataLength);
+                frame.timeStamp = bs.TimeStamp;
+                frame.frameType = bs.FrameType;
+                if (!fc.GetDisplayOrder(frame.displayOrder))
+                    frame.displayOrder = INVALID_DISPLAY_ORDER;
+
+                frames.push_back(frame);
+            }
+
+            bs.DataOffset += bs.DataLength;
+            bs.DataLength = 0;
+            fc.SaveResidualData(&bs);
+        } while (fc.GetNextFrame(&bs));
+
+        return sts;
+    }
+
+    // MPEG2VIDEOINFO of an avc1 media type - SPS and PPS with 2 byte size fields
+    std::vector<mfxU8> MakeAvcFormat(mfxU32 nNalSize)
+    {
+        std::vector<mfxU8> seqHeader;
+        QsTestAppendNalu(seqHeader, QsTestMakeSPS(), 2);
+        QsTestAppendNalu(seqHeader, QsTestMakePPS(), 2);
+
+        std::vector<mfxU8> format(sizeof(MPEG2VIDEOINFO) + seqHeader.size());
+        MPEG2VIDEOINFO* mp2 = (MPEG2VIDEOINFO*)&format.front();
+        mp2->dwFlags = nNalSize;
+        mp2->cbSequenceHeader = (DWORD)seqHeader.size();
+        memcpy(mp2->dwSequenceHeader, &seqHeader.front(), seqHeader.size());
+        return format;
+    }
+
+    mfxStatus ConstructAvcHeaders(CFrameConstructor& fc, std::vector<mfxU8>& format)
+    {
+        return fc.ConstructHeaders((VIDEOINFOHEADER2*)&format.front(), FORMAT_MPEG2_VIDEO, format.size(), sizeof(VIDEOINFOHEADER2));
+    }
+
+    // Video PES packet with an optional PTS (90KHz, -1 - none)
+    std::vector<mfxU8> MakeVideoPes(int64_t pts, size_t nPayloadSize)
+    {
+        std::vector<mfxU8> pes;
+        const size_t nHeaderDataSize = (pts >= 0) ? 5 : 0;
+        const size_t nLength = 3 + nHeaderDataSize + nPayloadSize;
+        const mfxU8 header[] = { 0, 0, 1, 0xE0, (mfxU8)(nLength >> 8), (mfxU8)nLength,
+            0x81, (mfxU8)((pts >= 0) ? 0x80 : 0), (mfxU8)nHeaderDataSize };
+        pes.assign(header, header + sizeof(header));
+        if (pts >= 0)
+        {
+            pes.push_back((mfxU8)(0x21 | ((pts >> 29) & 0x0E)));
+            pes.push_back((mfxU8)(pts >> 22));
+            pes.push_back((mfxU8)(0x01 | ((pts >> 14) & 0xFE)));
+            pes.push_back((mfxU8)(pts >> 7));
+            pes.push_back((mfxU8)(0x01 | ((pts << 1) & 0xFE)));
+        }
+
+        pes.resize(pes.size() + nPayloadSize, 0x55);
+        return pes;
+    }
+}
+
+// An IDR picture split between two samples. The second sample has no time stamp, like the continuation
+// samples splitters produce. The picture keeps its frame type, its POC and the time stamp of its first sample,
+// so the time manager gives the output frames their own time stamps.
+QS_TEST(AvcFragmentedPictureTimeStamp)
+{
+    // 4 byte size fields are converted in place, other sizes through ConvertNalus
+    static const mfxU32 nalSizes[] = { 4, 2 };
+    for (size_t n = 0; n < MSDK_ARRAY_LEN(nalSizes); ++n)
+    {
+        const mfxU32 nNalSize = nalSizes[n];
+        CDecTimeManager timeManager;
+        CAVCFrameConstructor fc(&timeManager);
+        std::vector<mfxU8> format = MakeAvcFormat(nNalSize);
+        QS_CHECK(MFX_ERR_NONE == ConstructAvcHeaders(fc, format));
+
+        // Decoding order I0 P4 B2 (POC), presentation time stamps
+        std::vector<mfxU8> idr, p, b;
+        QsTestAppendNalu(idr, QsTestMakeSlice(true, true, H264_SLICE_I, 0, 0, 3000), nNalSize);
+        QsTestAppendNalu(p, QsTestMakeSlice(false, true, H264_SLICE_P, 1, 4, 1000), nNalSize);
+        QsTestAppendNalu(b, QsTestMakeSlice(false, false, H264_SLICE_B, 2, 2, 500), nNalSize);
+
+        const size_t nSplit = 1000;
+        CQsTestSample sample1(&idr.front(), nSplit, 0);
+        CQsTestSample sample2(&idr.front() + nSplit, idr.size() - nSplit);
+        CQsTestSample sample3(p, 800000);
+        CQsTestSample sample4(b, 400000);
+
+        std::vector<TTestFrame> frames;
+        FeedSample(fc, &sample1, frames);
+        QS_CHECK(frames.empty());
+        FeedSample(fc, &sample2, frames);
+        FeedSample(fc, &sample3, frames);
+        FeedSample(fc, &sample4, frames);
+        if (!QS_CHECK(3 == frames.size()))
+            continue;
+
+        QS_CHECK((MFX_FRAMETYPE_I | MFX_FRAMETYPE_REF | MFX_FRAMETYPE_IDR) == frames[0].frameType);
+        QS_CHECK(timeManager.ConvertReferenceTime2MFXTime(0) == frames[0].timeStamp);
+        QS_CHECK(INVALID_DISPLAY_ORDER != frames[0].displayOrder);
+        QS_CHECK(frames[0].displayOrder < frames[2].displayOrder);
+        QS_CHECK(frames[2].displayOrder < frames[1].displayOrder);
+
+        // The first frame holds the sequence headers and the reassembled NALU
+        std::vector<mfxU8> expected;
+        QsTestAppendNalu(expected, QsTestMakeSPS());
+        QsTestAppendNalu(expected, QsTestMakePPS());
+        QsTestAppendNalu(expected, std::vector<mfxU8>(idr.begin() + nNalSize, idr.end()));
+        QS_CHECK(expected == frames[0].data);
+
+        // Decoder side - frames are output in display order with the time stamp of their bitstream
+        for (size_t i = 0; i < frames.size(); ++i)
+        {
+            timeManager.AddDecodedFrame(frames[i].displayOrder, timeManager.ConvertMFXTime2ReferenceTime(frames[i].timeStamp));
+        }
+
+        static const size_t outputOrder[] = { 0, 2, 1 };
+        static const REFERENCE_TIME outputTimeStamps[] = { 0, 400000, 800000 };
+        for (size_t i = 0; i < MSDK_ARRAY_LEN(outputOrder); ++i)
+        {
+            mfxFrameSurface1 surface;
+            MSDK_ZERO_VAR(surface);
+            surface.Info.PicStruct = MFX_PICSTRUCT_PROGRESSIVE;
+            surface.Data.TimeStamp = frames[outputOrder[i]].timeStamp;
+            mfxFrameSurface1* pSurface = &surface;
+
+            REFERENCE_TIME rtStart = INVALID_REFTIME;
+            QS_CHECK(timeManager.GetSampleTimeStamp(TFrameSnapshot(&pSurface, 0, 0, 1), rtStart));
+            QS_CHECK(outputTimeStamps[i] == rtStart);
+        }
+    }
+}
+
+// NALUs larger than the fragment size limit are discarded. The rest of the NALU in the next samples is skipped,
+// parsing goes on right after it, in the middle of a sample.
+QS_TEST(AvcDiscardedFragmentSkipsRestOfNalu)
+{
+    CDecTimeManager timeManager;
+    CAVCFrameConstructor fc(&timeManager, 1);
+    std::vector<mfxU8> format = MakeAvcFormat(4);
+    QS_CHECK(MFX_ERR_NONE == ConstructAvcHeaders(fc, format));
+
+    // 1.5MB slice split in 3 samples. The last one also holds the first slice of the next picture.
+    std::vector<mfxU8> big, p, data;
+    QsTestAppendNalu(big, QsTestMakeSlice(true, true, H264_SLICE_I, 0, 0, 3 << 19), 4);
+    QsTestAppendNalu(p, QsTestMakeSlice(false, true, H264_SLICE_P, 1, 2, 1000), 4);
+    data = big;
+    data.insert(data.end(), p.begin(), p.end());
+
+    const size_t nSampleSize = big.size() / 3 + 1;
+    std::vector<TTestFrame> frames;
+    for (size_t nPos = 0; nPos < data.size(); nPos += nSampleSize)
+    {
+        CQsTestSample sample(&data.front() + nPos, min(nSampleSize, data.size() - nPos), (0 == nPos) ? 0 : INVALID_REFTIME);
+        FeedSample(fc, &sample, frames);
+    }
+
+    // The P slice follows the sequence headers
+    std::vector<mfxU8> expected;
+    QsTestAppendNalu(expected, QsTestMakeSPS());
+    QsTestAppendNalu(expected, QsTestMakePPS());
+    QsTestAppendNalu(expected, std::vector<mfxU8>(p.begin() + 4, p.end()));
+    if (QS_CHECK(1 == frames.size()))
+    {
+        QS_CHECK(expected == frames[0].data);
+        QS_CHECK((MFX_FRAMETYPE_P | MFX_FRAMETYPE_REF) == frames[0].frameType);
+    }
+}
+
+// A corrupted size field makes the rest of the stream look like a huge NALU.
+// The next sample that starts an access unit ends the skipping.
+QS_TEST(AvcDiscardedFragmentResyncsOnTimeStamp)
+{
+    // Size field in one sample, size field split between samples
+    static const size_t sizeFieldSplit[] = { 4, 2 };
+    for (size_t n = 0; n < MSDK_ARRAY_LEN(sizeFieldSplit); ++n)
+    {
+        CDecTimeManager timeManager;
+        CAVCFrameConstructor fc(&timeManager, 1);
+        std::vector<mfxU8> format = MakeAvcFormat(4);
+        QS_CHECK(MFX_ERR_NONE == ConstructAvcHeaders(fc, format));
+
+        std::vector<mfxU8> idr, p;
+        QsTestAppendNalu(idr, QsTestMakeSlice(true, true, H264_SLICE_I, 0, 0, 500), 4);
+        QsTestAppendNalu(p, QsTestMakeSlice(false, true, H264_SLICE_P, 1, 2, 1000), 4);
+
+        // A valid NALU followed by a size field of 4GB and garbage
+        static const mfxU8 corruptedSize[] = { 0xFF, 0x00, 0x00, 0x00 };
+        std::vector<mfxU8> data1(idr);
+        data1.insert(data1.end(), corruptedSize, corruptedSize + sizeFieldSplit[n]);
+        std::vector<mfxU8> data2(corruptedSize + sizeFieldSplit[n], corruptedSize + 4);
+        data2.resize(data2.size() + 300, 0x55);
+
+        std::vector<TTestFrame> frames;
+        CQsTestSample sample1(data1, 0);
+        CQsTestSample sample2(data2);
+        CQsTestSample sample3(p);
+        CQsTestSample sample4(p, 400000);
+        FeedSample(fc, &sample1, frames);
+        FeedSample(fc, &sample2, frames);
+
+        // Still in the discarded NALU
+        FeedSample(fc, &sample3, frames);
+        QS_CHECK(1 == frames.size());
+
+        // Starts an access unit
+        FeedSample(fc, &sample4, frames);
+        if (QS_CHECK(2 == frames.size()))
+        {
+            std::vector<mfxU8> expected;
+            QsTestAppendNalu(expected, std::vector<mfxU8>(p.begin() + 4, p.end()));
+            QS_CHECK(expected == frames[1].data);
+            QS_CHECK((MFX_FRAMETYPE_P | MFX_FRAMETYPE_REF) == frames[1].frameType);
+            QS_CHECK(timeManager.ConvertReferenceTime2MFXTime(400000) == frames[1].timeStamp);
+        }
+    }
+}
+
+// DVD packs through the generic frame constructor. Samples without a time stamp take it from the first
+// PES packet with a PTS, placed on the time line of the last sample time stamp.
+QS_TEST(DvdPacketsPesTimeStamp)
+{
+    CDecTimeManager timeManager;
+    CFrameConstructor fc(&timeManager);
+    fc.SetDvdPacketStripping(true);
+
+    // PTS 1s, 1.04s (no sample time stamp) and a packet without a PTS followed by 1.08s
+    std::vector<mfxU8> data1 = MakeVideoPes(90000, 100);
+    std::vector<mfxU8> data2 = MakeVideoPes(93600, 100);
+    std::vector<mfxU8> data3 = MakeVideoPes(-1, 100);
+    std::vector<mfxU8> pes3 = MakeVideoPes(97200, 100);
+    data3.insert(data3.end(), pes3.begin(), pes3.end());
+
+    std::vector<TTestFrame> frames;
+    CQsTestSample sample1(data1, 5000000);
+    CQsTestSample sample2(data2);
+    CQsTestSample sample3(data3);
+    QS_CHECK(MFX_ERR_NONE == FeedSample(fc, &sample1, frames));
+    QS_CHECK(MFX_ERR_NONE == FeedSample(fc, &sample2, frames));
+    QS_CHECK(MFX_ERR_NONE == FeedSample(fc, &sample3, frames));
+    if (QS_CHECK(3 == frames.size()))
+    {
+        QS_CHECK(100 == frames[0].data.size());
+        QS_CHECK(200 == frames[2].data.size());
+        QS_CHECK(timeManager.ConvertReferenceTime2MFXTime(5000000) == frames[0].timeStamp);
+        QS_CHECK(timeManager.ConvertReferenceTime2MFXTime(5400000) == frames[1].timeStamp);
+        QS_CHECK(timeManager.ConvertReferenceTime2MFXTime(5800000) == frames[2].timeStamp);
+    }
+}
+
+// An access unit delimiter at the end of a sample ends the picture before it. The picture is handed out
+// with that sample instead of waiting for the first slice of the next picture.
+QS_TEST(H264DelimiterEndsAccessUnit)
+{
+    CDecTimeManager timeManager;
+    CH264FrameConstructor fc(&timeManager);
+
+    std::vector<mfxU8> aud, idr, p, data1, data2;
+    QsTestAppendNalu(aud, QsTestMakeNalu(NALU_TYPE_AUD, 1));
+    idr = aud;
+    QsTestAppendNalu(idr, QsTestMakeSPS());
+    QsTestAppendNalu(idr, QsTestMakePPS());
+    QsTestAppendNalu(idr, QsTestMakeSlice(true, true, H264_SLICE_I, 0, 0, 500));
+    p = aud;
+    QsTestAppendNalu(p, QsTestMakeSlice(false, true, H264_SLICE_P, 1, 2, 300));
+
+    // The delimiter of the P picture ends the first sample, the SPS of the next picture ends the second
+    data1 = idr;
+    data1.insert(data1.end(), aud.begin(), aud.end());
+    data2.assign(p.begin() + aud.size(), p.end());
+    QsTestAppendNalu(data2, QsTestMakeSPS());
+
+    std::vector<TTestFrame> frames;
+    CQsTestSample sample1(data1, 0);
+    CQsTestSample sample2(data2, 400000);
+    QS_CHECK(MFX_ERR_NONE == FeedSample(fc, &sample1, frames));
+    if (QS_CHECK(1 == frames.size()))
+    {
+        QS_CHECK(idr == frames[0].data);
+        QS_CHECK(timeManager.ConvertReferenceTime2MFXTime(0) == frames[0].timeStamp);
+    }
+
+    // The P picture takes the time stamp of the sample its slice starts in
+    QS_CHECK(MFX_ERR_NONE == FeedSample(fc, &sample2, frames));
+    if (QS_CHECK(2 == frames.size()))
+    {
+        QS_CHECK(p == frames[1].data);
+        QS_CHECK((MFX_FRAMETYPE_P | MFX_FRAMETYPE_REF) == frames[1].frameType);
+        QS_CHECK(timeManager.ConvertReferenceTime2MFXTime(400000) == frames[1].timeStamp);
+    }
+}
+
+// A slice header that can't be parsed is decided on at the next start code - the stream doesn't stall
+// until MAX_HEADER_SCAN_SIZE bytes have arrived.
+QS_TEST(H264BrokenSliceHeaderDoesNotWaitForData)
+{
+    CDecTimeManager timeManager;
+    CH264FrameConstructor fc(&timeManager);
+
+    // Slice NALU that ends within its header
+    static const mfxU8 brokenSlice[] = { NALU_TYPE_SLICE, 0x01, 0x01 };
+
+    std::vector<mfxU8> picture, data;
+    QsTestAppendNalu(picture, QsTestMakeSPS());
+    QsTestAppendNalu(picture, QsTestMakePPS());
+    QsTestAppendNalu(picture, QsTestMakeSlice(true, true, H264_SLICE_I, 0, 0, 500));
+    QsTestAppendNalu(picture, std::vector<mfxU8>(brokenSlice, brokenSlice + sizeof(brokenSlice)));
+    data = picture;
+    QsTestAppendNalu(data, QsTestMakeNalu(NALU_TYPE_AUD, 1));
+
+    std::vector<TTestFrame> frames;
+    CQsTestSample sample(data, 0);
+    QS_CHECK(MFX_ERR_NONE == FeedSample(fc, &sample, frames));
+    if (QS_CHECK(1 == frames.size()))
+    {
+        // The broken slice stays with the picture
+        QS_CHECK(picture == frames[0].data);
+    }
+}
+
+// Non-reference pictures are dropped when skipping is enabled. In-band parameter sets sent with them
+// reach the decoder in stream order - they precede the next access unit.
+QS_TEST(H264SkippedFrameKeepsParameterSets)
+{
+    std::vector<mfxU8> idr, parameterSets, p, data;
+    QsTestAppendNalu(idr, QsTestMakeSPS());
+    QsTestAppendNalu(idr, QsTestMakePPS());
+    QsTestAppendNalu(idr, QsTestMakeSlice(true, true, H264_SLICE_I, 0, 0, 500));
+    QsTestAppendNalu(parameterSets, QsTestMakeSPS());
+    QsTestAppendNalu(parameterSets, QsTestMakePPS());
+    QsTestAppendNalu(p, QsTestMakeSlice(false, true, H264_SLICE_P, 1, 4, 300));
+
+    // The dropped access unit: SPS, SEI, PPS, non-reference slice
+    data = idr;
+    QsTestAppendNalu(data, QsTestMakeSPS());
+    QsTestAppendNalu(data, QsTestMakeNalu(NALU_TYPE_SEI, 8));
+    QsTestAppendNalu(data, QsTestMakePPS());
+    QsTestAppendNalu(data, QsTestMakeSlice(false, false, H264_SLICE_P, 1, 2, 300));
+    data.insert(data.end(), p.begin(), p.end());
+    const size_t nPictureEnd = data.size();
+    QsTestAppendNalu(data, QsTestMakeNalu(NALU_TYPE_AUD, 1));
+
+    // The next access unit is complete or still pending when the non-reference picture is dropped
+    const size_t splits[] = { data.size(), nPictureEnd };
+    for (size_t n = 0; n < MSDK_ARRAY_LEN(splits); ++n)
+    {
+        CDecTimeManager timeManager;
+        CH264FrameConstructor fc(&timeManager);
+        fc.SetSkipNonRefFrames(true);
+
+        std::vector<TTestFrame> frames;
+        CQsTestSample sample1(&data.front(), splits[n], 0);
+        QS_CHECK(MFX_ERR_NONE == FeedSample(fc, &sample1, frames));
+        if (splits[n] < data.size())
+        {
+            CQsTestSample sample2(&data.front() + splits[n], data.size() - splits[n], 400000);
+            QS_CHECK(MFX_ERR_NONE == FeedSample(fc, &sample2, frames));
+        }
+
+        if (!QS_CHECK(2 == frames.size()))
+            continue;
+
+        QS_CHECK(idr == frames[0].data);
+
+        std::vector<mfxU8> expected = parameterSets;
+        expected.insert(expected.end(), p.begin(), p.end());
+        QS_CHECK(expected == frames[1].data);
+        QS_CHECK((MFX_FRAMETYPE_P | MFX_FRAMETYPE_REF) == frames[1].frameType);
+    }
+}
+
+// A dropped avc1 sample leaves its parameter sets for the decoder
+QS_TEST(AvcSkippedFrameKeepsParameterSets)
+{
+    const mfxU32 nNalSize = 4;
+    CDecTimeManager timeManager;
+    CAVCFrameConstructor fc(&timeManager);
+    std::vector<mfxU8> format = MakeAvcFormat(nNalSize);
+    QS_CHECK(MFX_ERR_NONE == ConstructAvcHeaders(fc, format));
+    fc.SetSkipNonRefFrames(true);
+
+    std::vector<mfxU8> idr, nonRef, p;
+    QsTestAppendNalu(idr, QsTestMakeSlice(true, true, H264_SLICE_I, 0, 0, 500), nNalSize);
+    QsTestAppendNalu(nonRef, QsTestMakeNalu(NALU_TYPE_SEI, 8), nNalSize);
+    QsTestAppendNalu(nonRef, QsTestMakePPS(), nNalSize);
+    QsTestAppendNalu(nonRef, QsTestMakeSlice(false, false, H264_SLICE_P, 1, 2, 300), nNalSize);
+    QsTestAppendNalu(p, QsTestMakeSlice(false, true, H264_SLICE_P, 1, 4, 300), nNalSize);
+
+    std::vector<TTestFrame> frames;
+    CQsTestSample sample1(idr, 0);
+    CQsTestSample sample2(nonRef, 400000);
+    CQsTestSample sample3(p, 800000);
+    FeedSample(fc, &sample1, frames);
+    FeedSample(fc, &sample2, frames);
+    FeedSample(fc, &sample3, frames);
+    if (!QS_CHECK(3 == frames.size()))
+        return;
+
+    // Only the PPS is left of the dropped sample
+    std::vector<mfxU8> expected;
+    QsTestAppendNalu(expected, QsTestMakePPS());
+    QS_CHECK(expected == frames[1].data);
+    QS_CHECK(0 == frames[1].frameType);
+    QS_CHECK((MFX_FRAMETYPE_P | MFX_FRAMETYPE_REF) == frames[2].frameType);
+}
+
+// A picture with MMCO 5 restarts the POC. It and the pictures after it are displayed after the pictures
+// before it, in Annex B streams and in avc1 samples.
+QS_TEST(H264Mmco5StartsDisplayOrderPeriod)
+{
+    const mfxU32 nNalSize = 4;
+    std::vector<std::vector<mfxU8> > pictures(4);
+    QsTestAppendNalu(pictures[0], QsTestMakeSlice(true, true, H264_SLICE_I, 0, 0, 500), nNalSize);
+    QsTestAppendNalu(pictures[1], QsTestMakeSlice(false, true, H264_SLICE_P, 1, 8, 300), nNalSize);
+    QsTestAppendNalu(pictures[2], QsTestMakeSlice(false, true, H264_SLICE_P, 2, 12, 300, 0, true), nNalSize);
+    QsTestAppendNalu(pictures[3], QsTestMakeSlice(false, true, H264_SLICE_P, 1, 6, 300), nNalSize);
+
+    // Annex B - one sample with delimiters
+    {
+        CDecTimeManager timeManager;
+        CH264FrameConstructor fc(&timeManager);
+        std::vector<mfxU8> data;
+        QsTestAppendNalu(data, QsTestMakeSPS());
+        QsTestAppendNalu(data, QsTestMakePPS());
+        for (size_t i = 0; i < pictures.size(); ++i)
+        {
+            QsTestAppendNalu(data, QsTestMakeNalu(NALU_TYPE_AUD, 1));
+            QsTestAppendNalu(data, std::vector<mfxU8>(pictures[i].begin() + nNalSize, pictures[i].end()));
+        }
+
+        QsTestAppendNalu(data, QsTestMakeNalu(NALU_TYPE_AUD, 1));
+
+        std::vector<TTestFrame> frames;
+        CQsTestSample sample(data, 0);
+        QS_CHECK(MFX_ERR_NONE == FeedSample(fc, &sample, frames));
+        if (QS_CHECK(pictures.size() == frames.size()))
+        {
+            for (size_t i = 1; i < frames.size(); ++i)
+            {
+                QS_CHECK(frames[i - 1].displayOrder < frames[i].displayOrder);
+            }
+        }
+    }
+
+    // avc1 - one picture per sample
+    {
+        CDecTimeManager timeManager;
+        CAVCFrameConstructor fc(&timeManager);
+        std::vector<mfxU8> format = MakeAvcFormat(nNalSize);
+        QS_CHECK(MFX_ERR_NONE == ConstructAvcHeaders(fc, format));
+
+        std::vector<TTestFrame> frames;
+        for (size_t i = 0; i < pictures.size(); ++i)
+        {
+            CQsTestSample sample(pictures[i], i * 400000);
+            QS_CHECK(MFX_ERR_NONE == FeedSample(fc, &sample, frames));
+        }
+
+        if (QS_CHECK(pictures.size() == frames.size()))
+        {
+            for (size_t i = 1; i < frames.size(); ++i)
+            {
+                QS_CHECK(frames[i - 1].displayOrder < frames[i].displayOrder);
+            }
+        }
+    }
+}
@@ -0,0 +1,659 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "TimeManager.h"
+#include "H264Nalu.h"
+#include "H264Parser.h"
+#include "QsTest.h"
+#include "QsTestUtils.h"
+
+namespace
+{
+    // Fields of a test SPS. The defaults are a 1920x1088 main profile stream without a VUI.
+    struct TSpsParams
+    {
+        TSpsParams() :
+            profile(77), constraintFlags(0), level(40), id(0),
+            chromaFormat(1), bScalingMatrix(false),
+            log2MaxFrameNum(4), pocType(0), log2MaxPocLsb(8),
+            offsetForNonRefPic(0), offsetForTopToBottomField(0),
+            widthMbs(120), heightMapUnits(68), bFrameMbsOnly(true),
+            bVui(false), bTiming(false), bNalHrd(false),
+            bRestriction(false), maxNumReorderFrames(0), maxDecFrameBuffering(0)
+        {
+        }
+
+        mfxU32 profile;
+        mfxU32 constraintFlags;  // constraint_set0_flag is 0x80
+        mfxU32 level;
+        mfxU32 id;
+        mfxU32 chromaFormat;     // High profiles only
+        bool   bScalingMatrix;   // High profiles only
+        mfxU32 log2MaxFrameNum;
+        mfxU32 pocType;
+        mfxU32 log2MaxPocLsb;
+        mfxI32 offsetForNonRefPic;
+        mfxI32 offsetForTopToBottomField;
+        std::vector<mfxI32> offsetsForRefFrame;
+        mfxU32 widthMbs;
+        mfxU32 heightMapUnits;
+        bool   bFrameMbsOnly;
+        bool   bVui;
+        bool   bTiming;
+        bool   bNalHrd;
+        bool   bRestriction;
+        mfxU32 maxNumReorderFrames;
+        mfxU32 maxDecFrameBuffering;
+    };
+
+    // scaling_list() with its own values. The list ends early (nextScale 0) at nStop - nSize means never.
+    void PutScalingList(CQsTestBitWriter& bs, int nSize, int nStop)
+    {
+        int lastScale = 8;
+        for (int j = 0; j < nSize; ++j)
+        {
+            if (j == nStop)
+            {
+                bs.PutSE(-lastScale);
+                return;
+            }
+
+            int scale = 4 + (j * 5) % 60;
+            bs.PutSE(scale - lastScale);
+            lastScale = scale;
+        }
+    }
+
+    std::vector<mfxU8> MakeSps(const TSpsParams& params)
+    {
+        CQsTestBitWriter bs;
+        bs.PutBits(params.profile, 8);
+        bs.PutBits(params.constraintFlags, 8);
+        bs.PutBits(params.level, 8);
+        bs.PutUE(params.id);
+
+        // The tests use profiles 66, 77, 100 and 244
+        if (params.profile >= 100)
+        {
+            bs.PutUE(params.chromaFormat);
+            if (3 == params.chromaFormat)
+            {
+                bs.PutBit(false); // separate_colour_plane_flag
+            }
+
+            bs.PutUE(2);      // bit_depth_luma_minus8
+            bs.PutUE(2);      // bit_depth_chroma_minus8
+            bs.PutBit(false); // qpprime_y_zero_transform_bypass_flag
+            bs.PutBit(params.bScalingMatrix);
+            if (params.bScalingMatrix)
+            {
+                // Lists that are missing, complete and ending early
+                int count = (params.chromaFormat != 3) ? 8 : 12;
+                for (int i = 0; i < count; ++i)
+                {
+                    int nSize = (i < 6) ? 16 : 64;
+                    bs.PutBit(i % 3 != 2);
+                    if (i % 3 == 0)
+                        PutScalingList(bs, nSize, nSize);
+                    else if (i % 3 == 1)
+                        PutScalingList(bs, nSize, i % nSize);
+                }
+            }
+        }
+
+        bs.PutUE(params.log2MaxFrameNum - 4);
+        bs.PutUE(params.pocType);
+        if (0 == params.pocType)
+        {
+            bs.PutUE(params.log2MaxPocLsb - 4);
+        }
+        else if (1 == params.pocType)
+        {
+            bs.PutBit(false); // delta_pic_order_always_zero_flag
+            bs.PutSE(params.offsetForNonRefPic);
+            bs.PutSE(params.offsetForTopToBottomField);
+            bs.PutUE((mfxU32)params.offsetsForRefFrame.size());
+            for (size_t i = 0; i < params.offsetsForRefFrame.size(); ++i)
+            {
+                bs.PutSE(params.offsetsForRefFrame[i]);
+            }
+        }
+
+        bs.PutUE(4);      // max_num_ref_frames
+        bs.PutBit(false); // gaps_in_frame_num_value_allowed_flag
+        bs.PutUE(params.widthMbs - 1);
+        bs.PutUE(params.heightMapUnits - 1);
+        bs.PutBit(params.bFrameMbsOnly);
+        if (!params.bFrameMbsOnly)
+        {
+            bs.PutBit(true); // mb_adaptive_frame_field_flag
+        }
+
+        bs.PutBit(true);  // direct_8x8_inference_flag
+        bs.PutBit(true);  // frame_cropping_flag
+        bs.PutUE(0);
+        bs.PutUE(0);
+        bs.PutUE(0);
+        bs.PutUE(4);      // frame_crop_bottom_offset - 1080 lines
+        bs.PutBit(params.bVui);
+        if (params.bVui)
+        {
+            bs.PutBit(true);    // aspect_ratio_info_present_flag
+            bs.PutBits(255, 8); // aspect_ratio_idc - Extended_SAR
+            bs.PutBits(4, 16);  // sar_width
+            bs.PutBits(3, 16);  // sar_height
+            bs.PutBit(false);   // overscan_info_present_flag
+            bs.PutBit(false);   // video_signal_type_present_flag
+            bs.PutBit(false);   // chroma_loc_info_present_flag
+            bs.PutBit(params.bTiming);
+            if (params.bTiming)
+            {
+                bs.PutBits(1001, 32);  // num_units_in_tick
+                bs.PutBits(60000, 32); // time_scale
+                bs.PutBit(true);       // fixed_frame_rate_flag
+            }
+
+            bs.PutBit(params.bNalHrd);
+            if (params.bNalHrd)
+            {
+                bs.PutUE(1);        // cpb_cnt_minus1
+                bs.PutBits(0x45, 8); // bit_rate_scale, cpb_size_scale
+                for (int i = 0; i < 2; ++i)
+                {
+                    bs.PutUE(10000 * (i + 1)); // bit_rate_value_minus1
+                    bs.PutUE(20000 * (i + 1)); // cpb_size_value_minus1
+                    bs.PutBit(i != 0);         // cbr_flag
+                }
+
+                bs.PutBits(0xABCDE, 20); // Delay lengths and time_offset_length
+            }
+
+            bs.PutBit(false);   // vcl_hrd_parameters_present_flag
+            if (params.bNalHrd)
+            {
+                bs.PutBit(false); // low_delay_hrd_flag
+            }
+
+            bs.PutBit(true);    // pic_struct_present_flag
+            bs.PutBit(params.bRestriction);
+            if (params.bRestriction)
+            {
+                bs.PutBit(true); // motion_vectors_over_pic_boundaries_flag
+                bs.PutUE(2);     // max_bytes_per_pic_denom
+                bs.PutUE(1);     // max_bits_per_mb_denom
+                bs.PutUE(16);    // log2_max_mv_length_horizontal
+                bs.PutUE(16);    // log2_max_mv_length_vertical
+                bs.PutUE(params.maxNumReorderFrames);
+                bs.PutUE(params.maxDecFrameBuffering);
+            }
+        }
+
+        bs.PutTrailingBits();
+        return QsTestMakeNalu((mfxU8)(0x60 | NALU_TYPE_SPS), bs);
+    }
+
+    bool ParseSps(CH264Parser& parser, const std::vector<mfxU8>& nalu, size_t nSize = 0)
+    {
+        return parser.ParseSPS(&nalu[1], ((nSize) ? nSize : nalu.size()) - 1);
+    }
+
+    // Fields following the scaling lists and the POC syntax are read from their own positions
+    bool CheckSpsTail(const H264_SPS* pSPS, const TSpsParams& params)
+    {
+        return NULL != pSPS &&
+            pSPS->log2_max_frame_num == params.log2MaxFrameNum &&
+            pSPS->pic_order_cnt_type == params.pocType &&
+            pSPS->max_num_ref_frames == 4 &&
+            pSPS->pic_width_in_mbs == params.widthMbs &&
+            pSPS->pic_height_in_map_units == params.heightMapUnits &&
+            pSPS->frame_mbs_only_flag == params.bFrameMbsOnly &&
+            pSPS->vui_parameters_present_flag == params.bVui;
+    }
+
+    // Slice header fields used by DecodePOC of a frame
+    H264_SliceHeader MakeSliceHeader(bool bIDR, bool bRef, mfxU32 frameNum, mfxU32 pocLsb = 0, mfxI32 deltaPoc = 0)
+    {
+        H264_SliceHeader header;
+        MSDK_ZERO_VAR(header);
+        header.nal_unit_type = (bIDR) ? NALU_TYPE_IDR : NALU_TYPE_SLICE;
+        header.nal_ref_idc = (bRef) ? 2 : 0;
+        header.has_picture_info = true;
+        header.frame_num = frameNum;
+        header.pic_order_cnt_lsb = pocLsb;
+        header.delta_pic_order_cnt[0] = deltaPoc;
+        return header;
+    }
+
+    bool CheckPoc(CH264Parser& parser, const H264_SliceHeader& header, int32_t expected)
+    {
+        int32_t poc;
+        return parser.DecodePOC(header, poc) && poc == expected;
+    }
+}
+
+// Scaling lists that are missing, complete and ending early are skipped - 8 lists for 4:2:0 and
+// 12 for 4:4:4. An SPS cut inside the lists fails.
+QS_TEST(H264SpsScalingLists)
+{
+    static const mfxU32 s_ChromaFormats[] = { 1, 3 };
+    for (size_t i = 0; i < MSDK_ARRAY_LEN(s_ChromaFormats); ++i)
+    {
+        TSpsParams params;
+        params.profile = (3 == s_ChromaFormats[i]) ? 244 : 100;
+        params.chromaFormat = s_ChromaFormats[i];
+        params.bScalingMatrix = true;
+        params.bVui = params.bRestriction = true;
+        params.maxNumReorderFrames = 2;
+        params.maxDecFrameBuffering = 3;
+        std::vector<mfxU8> sps = MakeSps(params);
+
+        CH264Parser parser;
+        if (!QS_CHECK(ParseSps(parser, sps)))
+            continue;
+
+        const H264_SPS* pSPS = parser.GetSPS(0);
+        QS_CHECK(CheckSpsTail(pSPS, params));
+        QS_CHECK(pSPS->chroma_format_idc == params.chromaFormat);
+        QS_CHECK(2 == pSPS->max_num_reorder_frames && 3 == pSPS->max_dec_frame_buffering);
+
+        CH264Parser truncatedParser;
+        QS_CHECK(!ParseSps(truncatedParser, sps, 12));
+        QS_CHECK(NULL == truncatedParser.GetLatestSPS());
+    }
+}
+
+// The fields of the three picture order count types, and the POC of a few frames of each
+QS_TEST(H264SpsPocTypes)
+{
+    std::vector<mfxU8> pps = QsTestMakePPS();
+
+    // Type 0 - pic_order_cnt_lsb wraps around, non-reference pictures don't move prevPicOrderCnt
+    {
+        TSpsParams params;
+        params.log2MaxPocLsb = 4;
+        CH264Parser parser;
+        QS_CHECK(ParseSps(parser, MakeSps(params)) && parser.ParsePPS(&pps[1], pps.size() - 1));
+        const H264_SPS* pSPS = parser.GetSPS(0);
+        if (!QS_CHECK(CheckSpsTail(pSPS, params) && 4 == pSPS->log2_max_pic_order_cnt_lsb))
+            return;
+
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(true, true, 0, 0), 0));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 1, 8), 8));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 2, 14), 14));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 3, 2), 18));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, false, 4, 0), 16));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 4, 6), 22));
+    }
+
+    // Type 1 - expected POC from the cycle of reference frame offsets
+    {
+        TSpsParams params;
+        params.pocType = 1;
+        params.log2MaxFrameNum = 5;
+        params.offsetForNonRefPic = -3;
+        params.offsetForTopToBottomField = 0;
+        params.offsetsForRefFrame.push_back(4);
+        params.offsetsForRefFrame.push_back(2);
+        CH264Parser parser;
+        QS_CHECK(ParseSps(parser, MakeSps(params)) && parser.ParsePPS(&pps[1], pps.size() - 1));
+        const H264_SPS* pSPS = parser.GetSPS(0);
+        if (!QS_CHECK(CheckSpsTail(pSPS, params)))
+            return;
+
+        QS_CHECK(!pSPS->delta_pic_order_always_zero_flag);
+        QS_CHECK(-3 == pSPS->offset_for_non_ref_pic && 0 == pSPS->offset_for_top_to_bottom_field);
+        QS_CHECK(2 == pSPS->num_ref_frames_in_pic_order_cnt_cycle);
+        QS_CHECK(4 == pSPS->offset_for_ref_frame[0] && 2 == pSPS->offset_for_ref_frame[1]);
+
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(true, true, 0), 0));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 1), 4));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 2), 6));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, false, 3), 3));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 3, 0, 1), 11));
+    }
+
+    // Type 2 - twice the frame number, minus one for non-reference pictures. frame_num wraps around.
+    {
+        TSpsParams params;
+        params.pocType = 2;
+        CH264Parser parser;
+        QS_CHECK(ParseSps(parser, MakeSps(params)) && parser.ParsePPS(&pps[1], pps.size() - 1));
+        if (!QS_CHECK(CheckSpsTail(parser.GetSPS(0), params)))
+            return;
+
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(true, true, 0), 0));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 1), 2));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, false, 2), 3));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 15), 30));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 0), 32));
+    }
+}
+
+// The slice header is skipped up to dec_ref_pic_marking: redundant_pic_cnt, the reference list counts,
+// ref_pic_list_modification and pred_weight_table of P and B slices. Only MMCO 5 is reported.
+// The PPS has slice groups and the flags that add these fields.
+QS_TEST(H264SliceHeaderMmco5)
+{
+    CQsTestBitWriter ppsBits;
+    ppsBits.PutUE(0);       // pic_parameter_set_id
+    ppsBits.PutUE(0);       // seq_parameter_set_id
+    ppsBits.PutBit(false);  // entropy_coding_mode_flag
+    ppsBits.PutBit(false);  // bottom_field_pic_order_in_frame_present_flag
+    ppsBits.PutUE(2);       // num_slice_groups_minus1
+    ppsBits.PutUE(6);       // slice_group_map_type
+    ppsBits.PutUE(4);       // pic_size_in_map_units_minus1
+    for (mfxU32 i = 0; i < 5; ++i)
+    {
+        ppsBits.PutBits(i % 3, 2); // slice_group_id
+    }
+
+    ppsBits.PutUE(2);       // num_ref_idx_l0_default_active_minus1
+    ppsBits.PutUE(1);       // num_ref_idx_l1_default_active_minus1
+    ppsBits.PutBit(true);   // weighted_pred_flag
+    ppsBits.PutBits(1, 2);  // weighted_bipred_idc
+    ppsBits.PutSE(-3);      // pic_init_qp_minus26
+    ppsBits.PutSE(0);       // pic_init_qs_minus26
+    ppsBits.PutSE(2);       // chroma_qp_index_offset
+    ppsBits.PutBit(true);   // deblocking_filter_control_present_flag
+    ppsBits.PutBit(false);  // constrained_intra_pred_flag
+    ppsBits.PutBit(true);   // redundant_pic_cnt_present_flag
+    ppsBits.PutTrailingBits();
+    std::vector<mfxU8> pps = QsTestMakeNalu((mfxU8)(0x60 | NALU_TYPE_PPS), ppsBits);
+
+    CH264Parser parser;
+    QS_CHECK(ParseSps(parser, MakeSps(TSpsParams())) && parser.ParsePPS(&pps[1], pps.size() - 1));
+    const H264_PPS* pPPS = parser.GetPPS(0);
+    if (!QS_CHECK(NULL != pPPS))
+        return;
+
+    QS_CHECK(2 == pPPS->num_ref_idx_l0_default_active_minus1 && 1 == pPPS->num_ref_idx_l1_default_active_minus1);
+    QS_CHECK(pPPS->weighted_pred_flag && 1 == pPPS->weighted_bipred_idc && pPPS->redundant_pic_cnt_present_flag);
+
+    for (mfxU32 sliceType = H264_SLICE_P; sliceType <= H264_SLICE_I; ++sliceType)
+    {
+        for (int bMmco5 = 0; bMmco5 < 2; ++bMmco5)
+        {
+            const bool bB = (H264_SLICE_B == sliceType);
+            const int nRefLists = (bB) ? 2 : ((H264_SLICE_P == sliceType) ? 1 : 0);
+            CQsTestBitWriter bs;
+            bs.PutUE(0);             // first_mb_in_slice
+            bs.PutUE(sliceType);     // slice_type
+            bs.PutUE(0);             // pic_parameter_set_id
+            bs.PutBits(9, 4);        // frame_num
+            bs.PutBits(42, 8);       // pic_order_cnt_lsb
+            bs.PutUE(1);             // redundant_pic_cnt
+            if (bB)
+            {
+                bs.PutBit(false);    // direct_spatial_mv_pred_flag
+            }
+
+            // P slices use the default of 3 references, B slices override theirs with 4 and 2
+            if (nRefLists > 0)
+            {
+                bs.PutBit(bB);       // num_ref_idx_active_override_flag
+                if (bB)
+                {
+                    bs.PutUE(3);
+                    bs.PutUE(1);
+                }
+            }
+
+            for (int list = 0; list < nRefLists; ++list)
+            {
+                bs.PutBit(true);     // ref_pic_list_modification_flag
+                bs.PutUE(0);         // modification_of_pic_nums_idc
+                bs.PutUE(5);         // abs_diff_pic_num_minus1
+                bs.PutUE(2);
+                bs.PutUE(1);         // long_term_pic_num
+                bs.PutUE(3);
+            }
+
+            if (nRefLists > 0)
+            {
+                bs.PutUE(5);         // luma_log2_weight_denom
+                bs.PutUE(4);         // chroma_log2_weight_denom
+                for (int list = 0; list < nRefLists; ++list)
+                {
+                    const int nRefs = (bB) ? 4 - 2 * list : 3;
+                    for (int i = 0; i < nRefs; ++i)
+                    {
+                        bs.PutBit(i != 1);   // luma_weight_flag
+                        if (i != 1)
+                        {
+                            bs.PutSE(-20 + i);
+                            bs.PutSE(7);
+                        }
+
+                        bs.PutBit(i != 0);   // chroma_weight_flag
+                        if (i != 0)
+                        {
+                            for (int j = 0; j < 4; ++j)
+                            {
+                                bs.PutSE(j - 2);
+                            }
+                        }
+                    }
+                }
+            }
+
+            // Every operation with its arguments. MMCO 5 comes before the last one.
+            bs.PutBit(true);         // adaptive_ref_pic_marking_mode_flag
+            static const mfxU32 s_Operations[][2] = { { 1, 1 }, { 2, 1 }, { 3, 2 }, { 4, 1 }, { 6, 1 } };
+            for (size_t i = 0; i < MSDK_ARRAY_LEN(s_Operations); ++i)
+            {
+                if (bMmco5 && i == MSDK_ARRAY_LEN(s_Operations) - 1)
+                {
+                    bs.PutUE(5);
+                }
+
+                bs.PutUE(s_Operations[i][0]);
+                for (mfxU32 j = 0; j < s_Operations[i][1]; ++j)
+                {
+                    bs.PutUE(12 + j);
+                }
+            }
+
+            bs.PutUE(0);
+            bs.PutTrailingBits();
+            std::vector<mfxU8> slice = QsTestMakeNalu((mfxU8)(0x40 | NALU_TYPE_SLICE), bs);
+
+            H264_SliceHeader header;
+            QS_CHECK(parser.ParseSliceHeader(slice[0], &slice[1], slice.size() - 1, header));
+            QS_CHECK(header.has_picture_info && (bMmco5 != 0) == header.has_mmco5);
+            QS_CHECK(9 == header.frame_num && 42 == header.pic_order_cnt_lsb);
+
+            // Truncated within the operations
+            QS_CHECK(!parser.ParseSliceHeader(slice[0], &slice[1], slice.size() - 3, header));
+
+            // Without the marking syntax of reference pictures the operations are slice data
+            QS_CHECK(parser.ParseSliceHeader(0x1F & slice[0], &slice[1], slice.size() - 1, header));
+            QS_CHECK(header.has_picture_info && !header.has_mmco5);
+        }
+    }
+}
+
+// MMCO 5 restarts the POC like an IDR (8.2.1). The picture itself gets its POC relative to tempPicOrderCnt.
+QS_TEST(H264PocAfterMmco5)
+{
+    std::vector<mfxU8> pps = QsTestMakePPS();
+
+    // Type 0 - prevPicOrderCntMsb is 0 and prevPicOrderCntLsb the top field POC after the reset
+    {
+        TSpsParams params;
+        params.log2MaxPocLsb = 4;
+        CH264Parser parser;
+        if (!QS_CHECK(ParseSps(parser, MakeSps(params)) && parser.ParsePPS(&pps[1], pps.size() - 1)))
+            return;
+
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(true, true, 0, 0), 0));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 1, 8), 8));
+        H264_SliceHeader header = MakeSliceHeader(false, true, 2, 12);
+        header.has_mmco5 = true;
+        QS_CHECK(CheckPoc(parser, header, 0));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 1, 4), 4));
+
+        // Bottom field first: tempPicOrderCnt is the bottom POC 6, prevPicOrderCntLsb the top POC 12 - 6
+        header = MakeSliceHeader(false, true, 2, 12);
+        header.delta_pic_order_cnt_bottom = -6;
+        header.has_mmco5 = true;
+        QS_CHECK(CheckPoc(parser, header, 0));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 1, 14), 14));
+    }
+
+    // Type 1 - prevFrameNumOffset and frame_num are 0
+    {
+        TSpsParams params;
+        params.pocType = 1;
+        params.log2MaxFrameNum = 5;
+        params.offsetsForRefFrame.push_back(4);
+        params.offsetsForRefFrame.push_back(2);
+        CH264Parser parser;
+        if (!QS_CHECK(ParseSps(parser, MakeSps(params)) && parser.ParsePPS(&pps[1], pps.size() - 1)))
+            return;
+
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(true, true, 0), 0));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 1), 4));
+        H264_SliceHeader header = MakeSliceHeader(false, true, 2);
+        header.has_mmco5 = true;
+        QS_CHECK(CheckPoc(parser, header, 0));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 1), 4));
+    }
+
+    // Type 2
+    {
+        TSpsParams params;
+        params.pocType = 2;
+        CH264Parser parser;
+        if (!QS_CHECK(ParseSps(parser, MakeSps(params)) && parser.ParsePPS(&pps[1], pps.size() - 1)))
+            return;
+
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(true, true, 0), 0));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 5), 10));
+        H264_SliceHeader header = MakeSliceHeader(false, true, 6);
+        header.has_mmco5 = true;
+        QS_CHECK(CheckPoc(parser, header, 0));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, false, 1), 1));
+        QS_CHECK(CheckPoc(parser, MakeSliceHeader(false, true, 1), 2));
+    }
+}
+
+// bitstream_restriction gives the reordering parameters. Timing info and HRD parameters before it
+// are skipped. Values beyond the DPB size are rejected.
+QS_TEST(H264SpsBitstreamRestriction)
+{
+    TSpsParams params;
+    params.bVui = params.bTiming = params.bNalHrd = params.bRestriction = true;
+    params.maxNumReorderFrames = 1;
+    params.maxDecFrameBuffering = 2;
+
+    CH264Parser parser;
+    QS_CHECK(ParseSps(parser, MakeSps(params)));
+    const H264_SPS* pSPS = parser.GetSPS(0);
+    if (QS_CHECK(CheckSpsTail(pSPS, params)))
+    {
+        QS_CHECK(pSPS->timing_info_present_flag && 1001 == pSPS->num_units_in_tick && 60000 == pSPS->time_scale);
+        QS_CHECK(pSPS->fixed_frame_rate_flag && pSPS->pic_struct_present_flag);
+        QS_CHECK(pSPS->bitstream_restriction_flag);
+    }
+
+    uint32_t nNumReorderFrames = 0, nMaxDecFrameBuffering = 0;
+    QS_CHECK(parser.GetReorderInfo(nNumReorderFrames, nMaxDecFrameBuffering));
+    QS_CHECK(1 == nNumReorderFrames && 2 == nMaxDecFrameBuffering);
+
+    // An SPS with another id becomes the latest one
+    params.id = 3;
+    params.maxNumReorderFrames = 0;
+    params.maxDecFrameBuffering = 0;
+    QS_CHECK(ParseSps(parser, MakeSps(params)));
+    QS_CHECK(parser.GetReorderInfo(nNumReorderFrames, nMaxDecFrameBuffering));
+    QS_CHECK(0 == nNumReorderFrames && 0 == nMaxDecFrameBuffering);
+
+    // max_num_reorder_frames > max_dec_frame_buffering, max_dec_frame_buffering > 16
+    params.id = 4;
+    params.maxNumReorderFrames = 3;
+    params.maxDecFrameBuffering = 2;
+    QS_CHECK(!ParseSps(parser, MakeSps(params)));
+    params.maxNumReorderFrames = 2;
+    params.maxDecFrameBuffering = 17;
+    QS_CHECK(!ParseSps(parser, MakeSps(params)));
+    QS_CHECK(NULL == parser.GetSPS(4));
+}
+
+// Without bitstream_restriction the reordering parameters are inferred (E.2.1): MaxDpbFrames of the
+// level and the picture size, and no reordering for intra profiles
+QS_TEST(H264SpsReorderInference)
+{
+    struct TInference
+    {
+        mfxU32 profile;
+        mfxU32 constraintFlags;
+        mfxU32 level;
+        mfxU32 widthMbs;
+        mfxU32 heightMapUnits;
+        bool   bFrameMbsOnly;
+        bool   bVui;
+        mfxU32 expectedReorder;
+        mfxU32 expectedDpb;
+    };
+
+    static const TInference s_Cases[] =
+    {
+        { 77,  0,    40, 120, 68, true,  false, 4,  4  }, // 32768 / 8160 MBs
+        { 77,  0,    40, 120, 34, false, true,  4,  4  }, // Field map units - the same frame size
+        { 66,  0,    31, 80,  45, true,  false, 5,  5  }, // 720p at level 3.1
+        { 77,  0,    51, 16,  16, true,  false, 16, 16 }, // Capped at 16
+        { 77,  0,    60, 120, 68, true,  false, 16, 16 }, // Unknown level
+        { 100, 0x10, 40, 120, 68, true,  false, 0,  4  }, // High 10 Intra (constraint_set3_flag)
+        { 244, 0x10, 40, 120, 68, true,  true,  0,  4  }, // High 4:4:4 Intra
+        { 77,  0x10, 40, 120, 68, true,  false, 4,  4  }, // constraint_set3_flag doesn't mean intra for main
+    };
+
+    for (size_t i = 0; i < MSDK_ARRAY_LEN(s_Cases); ++i)
+    {
+        const TInference& test = s_Cases[i];
+        TSpsParams params;
+        params.profile = test.profile;
+        params.constraintFlags = test.constraintFlags;
+        params.level = test.level;
+        params.widthMbs = test.widthMbs;
+        params.heightMapUnits = test.heightMapUnits;
+        params.bFrameMbsOnly = test.bFrameMbsOnly;
+        params.bVui = test.bVui;
+
+        CH264Parser parser;
+        uint32_t nNumReorderFrames = 0, nMaxDecFrameBuffering = 0;
+        QS_CHECK(ParseSps(parser, MakeSps(params)));
+        QS_CHECK(parser.GetReorderInfo(nNumReorderFrames, nMaxDecFrameBuffering));
+        QS_CHECK(test.expectedReorder == nNumReorderFrames);
+        QS_CHECK(test.expectedDpb == nMaxDecFrameBuffering);
+        QS_CHECK(!parser.GetSPS(0)->bitstream_restriction_flag);
+    }
+}
@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "IQuickSyncDecoder.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "TimeManager.h"
+#include "H264Nalu.h"
+#include "H264Parser.h"
+#include "QuickSyncOffline.h"
+#include "QsTest.h"
+#include "QsTestUtils.h"
+
+namespace
+{
+    // Frame size of the stub frames (NV12)
+    const size_t STUB_FRAME_WIDTH  = 64;
+    const size_t STUB_FRAME_HEIGHT = 16;
+
+    // Shared by the stub GOP decoders of a test
+    struct TStubState
+    {
+        DWORD          nFrameCostMs;    // Simulated decoding time of a frame. The CPU is idle as with a HW decoder.
+        REFERENCE_TIME rtFail;          // A GOP whose first time stamp is this one fails
+        volatile LONG  nDecoders;       // Created
+        volatile LONG  nGopsWithoutSPS; // GOPs that don't start with an SPS
+        volatile LONG  nBadAccessUnits; // Access units without exactly one picture
+    };
+
+    // First slices of the pictures in [pData, pData + nSize)
+    size_t CountPictures(const mfxU8* pData, size_t nSize)
+    {
+        H264_NaluIterator itStartCode(pData, nSize, 0);
+        H264_NAL_RC rc;
+        size_t nPictures = 0;
+        while (NALU_EOS != (rc = itStartCode.Next()))
+        {
+            NALU_TYPE type = itStartCode.GetNaluType();
+            if (NALU_INVALID != rc && itStartCode.GetDataLength() >= 2 &&
+                type >= NALU_TYPE_SLICE && type <= NALU_TYPE_IDR && (itStartCode.GetDataBuffer()[1] & 0x80))
+            {
+                ++nPictures;
+            }
+        }
+
+        return nPictures;
+    }
+
+    // Outputs a frame for each access unit of the GOP (decoding order) after the simulated decoding time
+    class CStubGopDecoder : public CQsGopDecoder
+    {
+    public:
+        CStubGopDecoder(TStubState& state) : m_State(state)
+        {
+            InterlockedIncrement(&m_State.nDecoders);
+        }
+
+        HRESULT DecodeGop(TQsGop& gop)
+        {
+            if (!gop.timeStamps.empty() && gop.timeStamps[0] == m_State.rtFail)
+                return E_FAIL;
+
+            H264_NaluIterator itStartCode(&gop.data[0], gop.data.size(), 0);
+            if (NALU_EOS == itStartCode.Next() || NALU_TYPE_SPS != itStartCode.GetNaluType())
+            {
+                InterlockedIncrement(&m_State.nGopsWithoutSPS);
+            }
+
+            for (size_t i = 0; i < gop.pictures.size(); ++i)
+            {
+                size_t nEnd = (i + 1 < gop.pictures.size()) ? gop.pictures[i + 1].nOffset : gop.data.size();
+                if (1 != CountPictures(&gop.data[gop.pictures[i].nOffset], nEnd - gop.pictures[i].nOffset) ||
+                    (0 == i && gop.pictures[i].nOffset != 0))
+                {
+                    InterlockedIncrement(&m_State.nBadAccessUnits);
+                }
+
+                Sleep(m_State.nFrameCostMs);
+                AddFrame(gop, gop.pictures[i].frameType);
+            }
+
+            gop.rtFrameDuration = 400000;
+            return S_OK;
+        }
+
+    private:
+        void AddFrame(TQsGop& gop, mfxU16 frameType)
+        {
+            TQsOfflineFrame frame;
+            frame.pBuffer = new CQsAlignedBuffer(STUB_FRAME_WIDTH * STUB_FRAME_HEIGHT * 3 / 2);
+            QsFrameData& frameData = frame.frameData;
+            MSDK_ZERO_VAR(frameData);
+            frameData.fourCC = MFX_FOURCC_NV12;
+            if (frameType & MFX_FRAMETYPE_B)
+                frameData.frameType = QsFrameData::B;
+            else if (frameType & MFX_FRAMETYPE_P)
+                frameData.frameType = QsFrameData::P;
+            else if (frameType & MFX_FRAMETYPE_I)
+                frameData.frameType = QsFrameData::I;
+            else
+                frameData.frameType = QsFrameData::Invalid;
+
+            frameData.rcFull.right = frameData.rcClip.right = (LONG)STUB_FRAME_WIDTH - 1;
+            frameData.rcFull.bottom = frameData.rcClip.bottom = (LONG)STUB_FRAME_HEIGHT - 1;
+            frameData.dwStride = (DWORD)STUB_FRAME_WIDTH;
+            frameData.y = frame.pBuffer->GetBuffer();
+            frameData.u = frameData.y + STUB_FRAME_WIDTH * STUB_FRAME_HEIGHT;
+            gop.frames.push_back(frame);
+        }
+
+        TStubState& m_State;
+    };
+
+    class CStubGopDecoderFactory : public CQsGopDecoderFactory
+    {
+    public:
+        CStubGopDecoderFactory(DWORD nFrameCostMs, REFERENCE_TIME rtFail = INVALID_REFTIME)
+        {
+            MSDK_ZERO_VAR(m_State);
+            m_State.nFrameCostMs = nFrameCostMs;
+            m_State.rtFail = rtFail;
+        }
+
+        CQsGopDecoder* CreateGopDecoder(const CQsConfig& /* cfg */)
+        {
+            return new CStubGopDecoder(m_State);
+        }
+
+        TStubState m_State;
+    };
+
+    // Delivered frames
+    struct TFrameLog
+    {
+        std::vector<REFERENCE_TIME> timeStamps;
+        std::vector<QsFrameData::QsFrameType> frameTypes;
+        size_t nKeyFrames;
+    };
+
+    HRESULT LogFrame(void* obj, QsFrameData* pFrameData)
+    {
+        TFrameLog& log = *(TFrameLog*)obj;
+        log.timeStamps.push_back(pFrameData->rtStart);
+        log.frameTypes.push_back(pFrameData->frameType);
+        log.nKeyFrames += (QsFrameData::I == pFrameData->frameType) ? 1 : 0;
+        return S_OK;
+    }
+
+    // Adds GOPs of gopLengths[i] frames, one sample per frame. SPS and PPS are sent once at the start.
+    // Frame n has the time stamp n * 400000.
+    size_t AddGops(CQsOfflineDecoder& decoder, const size_t* gopLengths, size_t nGops)
+    {
+        std::vector<mfxU8> seqHeader;
+        QsTestAppendNalu(seqHeader, QsTestMakeSPS(4, 1));
+        QsTestAppendNalu(seqHeader, QsTestMakePPS());
+        decoder.AddSample(&seqHeader[0], seqHeader.size(), INVALID_REFTIME);
+
+        size_t nFrames = 0;
+        for (size_t i = 0; i < nGops; ++i)
+        {
+            for (size_t j = 0; j < gopLengths[i]; ++j, ++nFrames)
+            {
+                std::vector<mfxU8> sample;
+                QsTestAppendNalu(sample, QsTestMakeSlice(0 == j, true, (0 == j) ? H264_SLICE_I : H264_SLICE_P,
+                    (mfxU32)(j % 16), (mfxU32)((2 * j) % 256), 200));
+                decoder.AddSample(&sample[0], sample.size(), (REFERENCE_TIME)nFrames * 400000);
+            }
+        }
+
+        return nFrames;
+    }
+
+    bool IsIncreasing(const std::vector<REFERENCE_TIME>& timeStamps)
+    {
+        for (size_t i = 1; i < timeStamps.size(); ++i)
+        {
+            if (timeStamps[i] <= timeStamps[i - 1])
+                return false;
+        }
+
+        return true;
+    }
+}
+
+// Short GOPs after long ones finish first - frames must still come out in order
+QS_TEST(OfflineDecoderDeliversGopsInOrder)
+{
+    const size_t gopLengths[] = { 8, 1, 5, 2, 7, 1, 3 };
+    const size_t nGops = sizeof(gopLengths) / sizeof(gopLengths[0]);
+
+    for (unsigned nParallelism = 1; nParallelism <= 4; ++nParallelism)
+    {
+        CStubGopDecoderFactory factory(1);
+        CQsOfflineDecoder decoder(CQsConfig(), &factory);
+        decoder.SetParallelism(nParallelism);
+        size_t nFrames = AddGops(decoder, gopLengths, nGops);
+        QS_CHECK(decoder.GetGopCount() == nGops);
+
+        TFrameLog log;
+        log.nKeyFrames = 0;
+        QS_CHECK(S_OK == decoder.Decode(&log, &LogFrame));
+        QS_CHECK(log.timeStamps.size() == nFrames);
+        QS_CHECK(log.nKeyFrames == nGops);
+        QS_CHECK(IsIncreasing(log.timeStamps));
+        QS_CHECK(factory.m_State.nDecoders == (LONG)nParallelism);
+
+        // Parameter sets sent once are repeated in each GOP
+        QS_CHECK(0 == factory.m_State.nGopsWithoutSPS);
+        QS_CHECK(0 == factory.m_State.nBadAccessUnits);
+        QS_CHECK(0 == decoder.GetGopCount());
+    }
+}
+
+// Frame types come from the slice headers of each access unit. Access units start at their AUD or SEI,
+// end of sequence NALUs stay with the picture before them.
+QS_TEST(OfflineDecoderFrameTypes)
+{
+    struct TPicture
+    {
+        bool   bIDR;
+        bool   bRef;
+        mfxU32 sliceType;
+        mfxU32 prefix;      // AUD or SEI before the picture, 0 - none
+        mfxU32 suffix;      // End of sequence after the picture, 0 - none
+        QsFrameData::QsFrameType expected;
+    };
+
+    static const TPicture s_Pictures[] =
+    {
+        { true,  true,  H264_SLICE_I, NALU_TYPE_AUD, 0,               QsFrameData::I },
+        { false, true,  H264_SLICE_P, NALU_TYPE_AUD, 0,               QsFrameData::P },
+        { false, true,  H264_SLICE_B, 0,             0,               QsFrameData::B },
+        { false, false, H264_SLICE_B, NALU_TYPE_SEI, 0,               QsFrameData::B },
+        { false, true,  H264_SLICE_I, 0,             0,               QsFrameData::I },
+        { false, true,  H264_SLICE_P, NALU_TYPE_SEI, NALU_TYPE_EOSEQ, QsFrameData::P },
+        { true,  true,  H264_SLICE_I, 0,             0,               QsFrameData::I },
+        { false, false, H264_SLICE_P, 0,             0,               QsFrameData::P },
+    };
+
+    CStubGopDecoderFactory factory(0);
+    CQsOfflineDecoder decoder(CQsConfig(), &factory);
+    std::vector<mfxU8> sample;
+    QsTestAppendNalu(sample, QsTestMakeSPS(4, 1));
+    QsTestAppendNalu(sample, QsTestMakePPS());
+    for (size_t i = 0; i < MSDK_ARRAY_LEN(s_Pictures); ++i)
+    {
+        const TPicture& picture = s_Pictures[i];
+        if (picture.prefix)
+            QsTestAppendNalu(sample, QsTestMakeNalu(picture.prefix, 4));
+
+        QsTestAppendNalu(sample, QsTestMakeSlice(picture.bIDR, picture.bRef, picture.sliceType, (mfxU32)i, (mfxU32)(2 * i), 100));
+        if (picture.suffix)
+            QsTestAppendNalu(sample, QsTestMakeNalu(picture.suffix));
+    }
+
+    decoder.AddSample(&sample[0], sample.size(), INVALID_REFTIME);
+    QS_CHECK(2 == decoder.GetGopCount());
+
+    TFrameLog log;
+    log.nKeyFrames = 0;
+    QS_CHECK(S_OK == decoder.Decode(&log, &LogFrame));
+    if (QS_CHECK(log.frameTypes.size() == MSDK_ARRAY_LEN(s_Pictures)))
+    {
+        for (size_t i = 0; i < MSDK_ARRAY_LEN(s_Pictures); ++i)
+        {
+            QS_CHECK(s_Pictures[i].expected == log.frameTypes[i]);
+        }
+    }
+
+    QS_CHECK(0 == factory.m_State.nBadAccessUnits);
+}
+
+// A failed GOP stops the decoding - GOPs before it are delivered, the workers don't hang
+QS_TEST(OfflineDecoderGopFailure)
+{
+    const size_t gopLengths[] = { 4, 4, 4, 4, 4, 4, 4, 4 };
+    const size_t nGops = sizeof(gopLengths) / sizeof(gopLengths[0]);
+
+    // The fourth GOP fails
+    CStubGopDecoderFactory factory(1, 12 * 400000);
+    CQsOfflineDecoder decoder(CQsConfig(), &factory);
+    decoder.SetParallelism(3);
+    AddGops(decoder, gopLengths, nGops);
+
+    TFrameLog log;
+    log.nKeyFrames = 0;
+    QS_CHECK(E_FAIL == decoder.Decode(&log, &LogFrame));
+    QS_CHECK(log.timeStamps.size() == 12);
+    QS_CHECK(IsIncreasing(log.timeStamps));
+
+    // The decoder can be used again
+    AddGops(decoder, gopLengths, 2);
+    log.timeStamps.clear();
+    QS_CHECK(S_OK == decoder.Decode(&log, &LogFrame));
+    QS_CHECK(log.timeStamps.size() == 8);
+}
+
+// Throughput of the GOP scheduling with 1..8 GOP decoders. Each stub frame takes 4 ms,
+// so a single decoder does at most 250 fps.
+QS_BENCHMARK(OfflineDecoderThroughput)
+{
+    const size_t nGops = 32;
+    std::vector<size_t> gopLengths(nGops, 15);
+
+    for (unsigned nParallelism = 1; nParallelism <= 8; nParallelism *= 2)
+    {
+        CStubGopDecoderFactory factory(4);
+        CQsOfflineDecoder decoder(CQsConfig(), &factory);
+        decoder.SetParallelism(nParallelism);
+        size_t nFrames = AddGops(decoder, &gopLengths[0], nGops);
+
+        TFrameLog log;
+        log.nKeyFrames = 0;
+        CQsTimer timer;
+        timer.Start();
+        HRESULT hr = decoder.Decode(&log, &LogFrame);
+        timer.Stop();
+
+        double ms = timer.GetDuration() / 1000.0;
+        printf("  %u decoder(s): %u frames in %.0f ms, %.0f fps\n", nParallelism, (unsigned)nFrames, ms,
+            (ms > 0) ? (double)nFrames * 1000.0 / ms : 0.0);
+        QS_CHECK(S_OK == hr && log.timeStamps.size() == nFrames);
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Minimal test framework of the QsTests console application.
+// Checks don't depend on ASSERT so the tests run against release builds as well.
+
+typedef void (*TQsTestFunc)();
+
+class CQsTestRegistrar
+{
+public:
+    CQsTestRegistrar(const char* name, TQsTestFunc func, bool bBenchmark);
+};
+
+// Defines a test case. Test cases run in the order they are defined in (per source file).
+#define QS_TEST(name) \
+    static void name(); \
+    static CQsTestRegistrar s_##name##Registrar(#name, name, false); \
+    static void name()
+
+// Defines a benchmark. Benchmarks only print measurements and run only when "-bench" is on the command line.
+#define QS_BENCHMARK(name) \
+    static void name(); \
+    static CQsTestRegistrar s_##name##Registrar(#name, name, true); \
+    static void name()
+
+// Reports a failed check - the test case goes on. Returns the result of the check.
+#define QS_CHECK(expr) QsTestCheck(!!(expr), #expr, __FILE__, __LINE__)
+
+bool QsTestCheck(bool bPassed, const char* expression, const char* file, int line);
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QsTest.h"
+
+namespace
+{
+    struct TQsTestCase
+    {
+        const char* name;
+        TQsTestFunc func;
+        bool bBenchmark;
+    };
+
+    // Function local - test cases register themselves during static initialization
+    std::vector<TQsTestCase>& GetTestCases()
+    {
+        static std::vector<TQsTestCase> s_TestCases;
+        return s_TestCases;
+    }
+
+    int s_nFailedChecks = 0;
+}
+
+CQsTestRegistrar::CQsTestRegistrar(const char* name, TQsTestFunc func, bool bBenchmark)
+{
+    TQsTestCase testCase = { name, func, bBenchmark };
+    GetTestCases().push_back(testCase);
+}
+
+bool QsTestCheck(bool bPassed, const char* expression, const char* file, int line)
+{
+    if (!bPassed)
+    {
+        ++s_nFailedChecks;
+        printf("%s(%d): check failed: %s\n", file, line, expression);
+    }
+
+    return bPassed;
+}
+
+// Usage: QsTests [-bench] [name]
+// Runs all test cases (or the benchmarks) whose name contains "name".
+// Returns the number of failed test cases.
+int main(int argc, char* argv[])
+{
+    bool bBenchmarks = false;
+    const char* filter = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (0 == strcmp(argv[i], "-bench"))
+            bBenchmarks = true;
+        else
+            filter = argv[i];
+    }
+
+    int nRun = 0;
+    int nFailed = 0;
+    const std::vector<TQsTestCase>& testCases = GetTestCases();
+    for (size_t i = 0; i < testCases.size(); ++i)
+    {
+        const TQsTestCase& testCase = testCases[i];
+        if (testCase.bBenchmark != bBenchmarks || (filter && NULL == strstr(testCase.name, filter)))
+            continue;
+
+        printf("[ RUN    ] %s\n", testCase.name);
+        int nFailedChecks = s_nFailedChecks;
+        testCase.func();
+        ++nRun;
+
+        bool bPassed = (nFailedChecks == s_nFailedChecks);
+        nFailed += (bPassed) ? 0 : 1;
+        printf("[ %s ] %s\n", (bPassed) ? "    OK" : "FAILED", testCase.name);
+    }
+
+    printf("%d test case(s) run, %d failed\n", nRun, nFailed);
+    return nFailed;
+}
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "TimeManager.h"
+#include "H264Nalu.h"
+#include "H264Parser.h"
+#include "QsTestUtils.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      CQsTestSample
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+CQsTestSample::CQsTestSample(const mfxU8* pData, size_t nSize, REFERENCE_TIME rtStart) :
+    m_Data(pData, pData + nSize),
+    m_rtStart(rtStart),
+    m_bSyncPoint(false),
+    m_bDiscontinuity(false)
+{
+}
+
+CQsTestSample::CQsTestSample(const std::vector<mfxU8>& data, REFERENCE_TIME rtStart) :
+    m_Data(data),
+    m_rtStart(rtStart),
+    m_bSyncPoint(false),
+    m_bDiscontinuity(false)
+{
+}
+
+STDMETHODIMP CQsTestSample::QueryInterface(REFIID /* riid */, void** ppv)
+{
+    MSDK_CHECK_POINTER(ppv, E_POINTER);
+    *ppv = NULL;
+    return E_NOINTERFACE;
+}
+
+STDMETHODIMP CQsTestSample::GetPointer(BYTE** ppBuffer)
+{
+    MSDK_CHECK_POINTER(ppBuffer, E_POINTER);
+    *ppBuffer = (m_Data.empty()) ? NULL : &m_Data.front();
+    return S_OK;
+}
+
+STDMETHODIMP CQsTestSample::GetTime(REFERENCE_TIME* pTimeStart, REFERENCE_TIME* pTimeEnd)
+{
+    MSDK_CHECK_POINTER(pTimeStart, E_POINTER);
+    MSDK_CHECK_POINTER(pTimeEnd, E_POINTER);
+    if (INVALID_REFTIME == m_rtStart)
+        return VFW_E_SAMPLE_TIME_NOT_SET;
+
+    *pTimeStart = m_rtStart;
+    return VFW_S_NO_STOP_TIME;
+}
+
+STDMETHODIMP CQsTestSample::SetTime(REFERENCE_TIME* pTimeStart, REFERENCE_TIME* /* pTimeEnd */)
+{
+    m_rtStart = (pTimeStart) ? *pTimeStart : INVALID_REFTIME;
+    return S_OK;
+}
+
+STDMETHODIMP CQsTestSample::GetMediaType(AM_MEDIA_TYPE** ppMediaType)
+{
+    MSDK_CHECK_POINTER(ppMediaType, E_POINTER);
+    *ppMediaType = NULL;
+    return S_FALSE;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      CQsTestBitWriter
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+void CQsTestBitWriter::PutBits(mfxU32 value, int nBits)
+{
+    for (int i = nBits - 1; i >= 0; --i)
+    {
+        if (0 == m_nBitPos)
+        {
+            m_Data.push_back(0);
+        }
+
+        m_Data.back() |= (mfxU8)(((value >> i) & 1) << (7 - m_nBitPos));
+        m_nBitPos = (m_nBitPos + 1) & 7;
+    }
+}
+
+void CQsTestBitWriter::PutUE(mfxU32 value)
+{
+    // Exp-Golomb: leading zeros followed by value + 1
+    mfxU64 codeNum = (mfxU64)value + 1;
+    int nBits = 0;
+    while ((codeNum >> nBits) > 1)
+    {
+        ++nBits;
+    }
+
+    PutBits(0, nBits);
+    PutBits((mfxU32)codeNum, nBits + 1);
+}
+
+void CQsTestBitWriter::PutSE(mfxI32 value)
+{
+    PutUE((value > 0) ? (mfxU32)(2 * value - 1) : (mfxU32)(-2 * value));
+}
+
+void CQsTestBitWriter::PutTrailingBits()
+{
+    PutBit(true);
+    if (m_nBitPos)
+    {
+        PutBits(0, 8 - m_nBitPos);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      H264 streams
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// NALU header followed by the RBSP with emulation prevention bytes inserted
+static std::vector<mfxU8> MakeNalu(mfxU8 nalHeader, const std::vector<mfxU8>& rbsp)
+{
+    std::vector<mfxU8> nalu(1, nalHeader);
+    int nZeros = 0;
+    for (size_t i = 0; i < rbsp.size(); ++i)
+    {
+        if (nZeros >= 2 && rbsp[i] <= 3)
+        {
+            nalu.push_back(3);
+            nZeros = 0;
+        }
+
+        nalu.push_back(rbsp[i]);
+        nZeros = (0 == rbsp[i]) ? nZeros + 1 : 0;
+    }
+
+    return nalu;
+}
+
+// Filler that doesn't look like start codes
+static void PutFiller(CQsTestBitWriter& bs, size_t nSize)
+{
+    for (size_t i = 0; i < nSize; ++i)
+    {
+        bs.PutBits((mfxU32)(0x40 + (i * 7) % 0xB0), 8);
+    }
+}
+
+std::vector<mfxU8> QsTestMakeSPS(mfxU32 nWidthMbs, mfxU32 nHeightMbs, bool bVideoSignal)
+{
+    CQsTestBitWriter bs;
+    bs.PutBits(77, 8); // profile_idc (main)
+    bs.PutBits(0, 8);  // constraint_set_flags
+    bs.PutBits(40, 8); // level_idc
+    bs.PutUE(0);       // seq_parameter_set_id
+    bs.PutUE(0);       // log2_max_frame_num_minus4
+    bs.PutUE(0);       // pic_order_cnt_type
+    bs.PutUE(4);       // log2_max_pic_order_cnt_lsb_minus4
+    bs.PutUE(4);       // max_num_ref_frames
+    bs.PutBit(false);  // gaps_in_frame_num_value_allowed_flag
+    bs.PutUE(nWidthMbs - 1);
+    bs.PutUE(nHeightMbs - 1);
+    bs.PutBit(true);   // frame_mbs_only_flag
+    bs.PutBit(true);   // direct_8x8_inference_flag
+    bs.PutBit(false);  // frame_cropping_flag
+    bs.PutBit(bVideoSignal); // vui_parameters_present_flag
+    if (bVideoSignal)
+    {
+        bs.PutBit(false);   // aspect_ratio_info_present_flag
+        bs.PutBit(false);   // overscan_info_present_flag
+        bs.PutBit(true);    // video_signal_type_present_flag
+        bs.PutBits(5, 3);   // video_format
+        bs.PutBit(true);    // video_full_range_flag
+        bs.PutBit(true);    // colour_description_present_flag
+        bs.PutBits(1, 8);   // colour_primaries
+        bs.PutBits(1, 8);   // transfer_characteristics
+        bs.PutBits(1, 8);   // matrix_coefficients
+        bs.PutBit(false);   // chroma_loc_info_present_flag
+        bs.PutBit(false);   // timing_info_present_flag
+        bs.PutBit(false);   // nal_hrd_parameters_present_flag
+        bs.PutBit(false);   // vcl_hrd_parameters_present_flag
+        bs.PutBit(false);   // pic_struct_present_flag
+        bs.PutBit(false);   // bitstream_restriction_flag
+    }
+
+    bs.PutTrailingBits();
+    return MakeNalu(0x60 | NALU_TYPE_SPS, bs.GetData());
+}
+
+std::vector<mfxU8> QsTestMakePPS()
+{
+    CQsTestBitWriter bs;
+    bs.PutUE(0);      // pic_parameter_set_id
+    bs.PutUE(0);      // seq_parameter_set_id
+    bs.PutBit(false); // entropy_coding_mode_flag
+    bs.PutBit(false); // bottom_field_pic_order_in_frame_present_flag
+    bs.PutUE(0);      // num_slice_groups_minus1
+    bs.PutUE(0);      // num_ref_idx_l0_default_active_minus1
+    bs.PutUE(0);      // num_ref_idx_l1_default_active_minus1
+    bs.PutBit(false); // weighted_pred_flag
+    bs.PutBits(0, 2); // weighted_bipred_idc
+    bs.PutSE(0);      // pic_init_qp_minus26
+    bs.PutSE(0);      // pic_init_qs_minus26
+    bs.PutSE(0);      // chroma_qp_index_offset
+    bs.PutBit(true);  // deblocking_filter_control_present_flag
+    bs.PutBit(false); // constrained_intra_pred_flag
+    bs.PutBit(false); // redundant_pic_cnt_present_flag
+    bs.PutTrailingBits();
+    return MakeNalu(0x60 | NALU_TYPE_PPS, bs.GetData());
+}
+
+std::vector<mfxU8> QsTestMakeSlice(bool bIDR, bool bRef, mfxU32 sliceType, mfxU32 frameNum, mfxU32 pocLsb,
+    size_t nSliceDataSize, mfxU32 firstMb, bool bMmco5)
+{
+    CQsTestBitWriter bs;
+    bs.PutUE(firstMb);        // first_mb_in_slice
+    bs.PutUE(sliceType + 5);  // slice_type (all slices of the picture have the same type)
+    bs.PutUE(0);              // pic_parameter_set_id
+    bs.PutBits(frameNum, 4);  // frame_num
+    if (bIDR)
+    {
+        bs.PutUE(0);          // idr_pic_id
+    }
+
+    bs.PutBits(pocLsb, 8);    // pic_order_cnt_lsb
+    if (H264_SLICE_B == sliceType)
+    {
+        bs.PutBit(true);      // direct_spatial_mv_pred_flag
+    }
+
+    if (H264_SLICE_I != sliceType)
+    {
+        bs.PutBit(false);     // num_ref_idx_active_override_flag
+        bs.PutBit(false);     // ref_pic_list_modification_flag_l0
+        if (H264_SLICE_B == sliceType)
+        {
+            bs.PutBit(false); // ref_pic_list_modification_flag_l1
+        }
+    }
+
+    if (bIDR)
+    {
+        bs.PutBits(0, 2);     // no_output_of_prior_pics_flag, long_term_reference_flag
+    }
+    else if (bRef)
+    {
+        bs.PutBit(bMmco5);    // adaptive_ref_pic_marking_mode_flag
+        if (bMmco5)
+        {
+            bs.PutUE(5);      // memory_management_control_operation
+            bs.PutUE(0);
+        }
+    }
+
+    PutFiller(bs, nSliceDataSize);
+    bs.PutTrailingBits();
+
+    mfxU8 nalHeader = (mfxU8)(((bRef) ? 0x40 : 0) | ((bIDR) ? NALU_TYPE_IDR : NALU_TYPE_SLICE));
+    return MakeNalu(nalHeader, bs.GetData());
+}
+
+std::vector<mfxU8> QsTestMakeNalu(mfxU32 nalUnitType, size_t nPayloadSize)
+{
+    CQsTestBitWriter bs;
+    PutFiller(bs, nPayloadSize);
+    bs.PutTrailingBits();
+    return MakeNalu((mfxU8)nalUnitType, bs.GetData());
+}
+
+std::vector<mfxU8> QsTestMakeNalu(mfxU8 nalHeader, const CQsTestBitWriter& bs)
+{
+    return MakeNalu(nalHeader, bs.GetData());
+}
+
+void QsTestAppendNalu(std::vector<mfxU8>& stream, const std::vector<mfxU8>& nalu, mfxU32 nNalSize)
+{
+    if (0 == nNalSize)
+    {
+        static const mfxU8 startCode[] = { 0, 0, 0, 1 };
+        stream.insert(stream.end(), startCode, startCode + sizeof(startCode));
+    }
+    else
+    {
+        for (int i = (int)nNalSize - 1; i >= 0; --i)
+        {
+            stream.push_back((mfxU8)(nalu.size() >> (8 * i)));
+        }
+    }
+
+    stream.insert(stream.end(), nalu.begin(), nalu.end());
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Media sample holding a copy of the data. Reference counting is a no-op - samples live on the stack.
+class CQsTestSample : public IMediaSample
+{
+public:
+    CQsTestSample(const mfxU8* pData, size_t nSize, REFERENCE_TIME rtStart = INVALID_REFTIME);
+    CQsTestSample(const std::vector<mfxU8>& data, REFERENCE_TIME rtStart = INVALID_REFTIME);
+    virtual ~CQsTestSample() {}
+
+    // IUnknown
+    STDMETHODIMP QueryInterface(REFIID riid, void** ppv);
+    STDMETHODIMP_(ULONG) AddRef() { return 1; }
+    STDMETHODIMP_(ULONG) Release() { return 1; }
+
+    // IMediaSample
+    STDMETHODIMP GetPointer(BYTE** ppBuffer);
+    STDMETHODIMP_(long) GetSize() { return (long)m_Data.size(); }
+    STDMETHODIMP GetTime(REFERENCE_TIME* pTimeStart, REFERENCE_TIME* pTimeEnd);
+    STDMETHODIMP SetTime(REFERENCE_TIME* pTimeStart, REFERENCE_TIME* pTimeEnd);
+    STDMETHODIMP IsSyncPoint() { return (m_bSyncPoint) ? S_OK : S_FALSE; }
+    STDMETHODIMP SetSyncPoint(BOOL bIsSyncPoint) { m_bSyncPoint = !!bIsSyncPoint; return S_OK; }
+    STDMETHODIMP IsPreroll() { return S_FALSE; }
+    STDMETHODIMP SetPreroll(BOOL /* bIsPreroll */) { return E_NOTIMPL; }
+    STDMETHODIMP_(long) GetActualDataLength() { return (long)m_Data.size(); }
+    STDMETHODIMP SetActualDataLength(long /* nLength */) { return E_NOTIMPL; }
+    STDMETHODIMP GetMediaType(AM_MEDIA_TYPE** ppMediaType);
+    STDMETHODIMP SetMediaType(AM_MEDIA_TYPE* /* pMediaType */) { return E_NOTIMPL; }
+    STDMETHODIMP IsDiscontinuity() { return (m_bDiscontinuity) ? S_OK : S_FALSE; }
+    STDMETHODIMP SetDiscontinuity(BOOL bDiscontinuity) { m_bDiscontinuity = !!bDiscontinuity; return S_OK; }
+    STDMETHODIMP GetMediaTime(LONGLONG* /* pTimeStart */, LONGLONG* /* pTimeEnd */) { return VFW_E_MEDIA_TIME_NOT_SET; }
+    STDMETHODIMP SetMediaTime(LONGLONG* /* pTimeStart */, LONGLONG* /* pTimeEnd */) { return E_NOTIMPL; }
+
+private:
+    std::vector<BYTE> m_Data;
+    REFERENCE_TIME m_rtStart;
+    bool m_bSyncPoint;
+    bool m_bDiscontinuity;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Small LCG - the test data is the same on every run
+class CQsTestRandom
+{
+public:
+    CQsTestRandom() : m_State(12345) {}
+    mfxU32 Next(mfxU32 nRange)
+    {
+        m_State = m_State * 1103515245 + 12345;
+        return (m_State >> 16) % nRange;
+    }
+
+private:
+    mfxU32 m_State;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Writes RBSP bits MSB first
+class CQsTestBitWriter
+{
+public:
+    CQsTestBitWriter() : m_nBitPos(0) {}
+
+    void PutBits(mfxU32 value, int nBits);
+    void PutBit(bool bit) { PutBits((bit) ? 1 : 0, 1); }
+    void PutUE(mfxU32 value);
+    void PutSE(mfxI32 value);
+
+    // rbsp_trailing_bits (stop bit + byte alignment)
+    void PutTrailingBits();
+
+    const std::vector<mfxU8>& GetData() const { return m_Data; }
+
+private:
+    std::vector<mfxU8> m_Data;
+    int m_nBitPos; // Bits used in the last byte (0 - byte aligned)
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// H264 streams. NALUs are built without start codes or size fields (NALU header first).
+
+// SPS with pic_order_cnt_type 0, 4 bit frame_num, 8 bit pic_order_cnt_lsb and frame_mbs_only_flag set.
+// The SPS has no VUI unless bVideoSignal is true (full range BT.709 then).
+std::vector<mfxU8> QsTestMakeSPS(mfxU32 nWidthMbs = 120, mfxU32 nHeightMbs = 68, bool bVideoSignal = false);
+std::vector<mfxU8> QsTestMakePPS();
+
+// Slice NALU. sliceType is H264_SLICE_P/B/I. The slice header is followed by nSliceDataSize bytes of filler.
+// bMmco5 adds memory_management_control_operation 5 to a non-IDR reference slice.
+std::vector<mfxU8> QsTestMakeSlice(bool bIDR, bool bRef, mfxU32 sliceType, mfxU32 frameNum, mfxU32 pocLsb,
+    size_t nSliceDataSize, mfxU32 firstMb = 0, bool bMmco5 = false);
+
+// Other NALUs (AUD, SEI, end of sequence...) with nPayloadSize bytes of filler
+std::vector<mfxU8> QsTestMakeNalu(mfxU32 nalUnitType, size_t nPayloadSize = 0);
+
+// NALU with the RBSP written by bs. The trailing bits are written by the caller.
+std::vector<mfxU8> QsTestMakeNalu(mfxU8 nalHeader, const CQsTestBitWriter& bs);
+
+// Appends a NALU with a start code (nNalSize == 0) or with a big endian size field of nNalSize bytes
+void QsTestAppendNalu(std::vector<mfxU8>& stream, const std::vector<mfxU8>& nalu, mfxU32 nNalSize = 0);
@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "TimeManager.h"
+#include "H264Nalu.h"
+#include "H264Parser.h"
+#include "MPEG2PsDemux.h"
+#include "H264RtpDepacketizer.h"
+#include "QsTest.h"
+#include "QsTestUtils.h"
+
+namespace
+{
+    typedef std::vector<mfxU8> TBytes;
+
+    // RTP packet with an H264 payload (dynamic payload type 96)
+    struct TRtpPacket
+    {
+        mfxU16 nSeq;
+        mfxU32 TimeStamp;
+        TBytes payload;
+    };
+
+    TBytes MakeRtpPacket(const TRtpPacket& packet)
+    {
+        TBytes data(12, 0);
+        data[0] = 0x80;
+        data[1] = 96;
+        data[2] = (mfxU8)(packet.nSeq >> 8);
+        data[3] = (mfxU8)packet.nSeq;
+        for (int i = 0; i < 4; ++i)
+        {
+            data[4 + i] = (mfxU8)(packet.TimeStamp >> (24 - 8 * i));
+        }
+
+        data.insert(data.end(), packet.payload.begin(), packet.payload.end());
+        return data;
+    }
+
+    // Builds the packets of a stream in sending order - sequence numbers follow each other
+    class CRtpPacketizer
+    {
+    public:
+        CRtpPacketizer(mfxU16 nFirstSeq, mfxU32 firstTimeStamp) : m_nSeq(nFirstSeq), m_TimeStamp(firstTimeStamp) {}
+
+        // Following packets belong to the next picture
+        void NextPicture(mfxU32 nDuration) { m_TimeStamp += nDuration; }
+
+        void AddSingle(const TBytes& nalu)
+        {
+            AddPacket(nalu);
+        }
+
+        // STAP-A - the NRI is the highest of the aggregated NALUs
+        void AddStapA(const TBytes* pNalus, size_t nNalus)
+        {
+            TBytes payload(1, 24);
+            for (size_t i = 0; i < nNalus; ++i)
+            {
+                const TBytes& nalu = pNalus[i];
+                payload[0] = (mfxU8)max(payload[0], (nalu[0] & 0x60) | 24);
+                payload.push_back((mfxU8)(nalu.size() >> 8));
+                payload.push_back((mfxU8)nalu.size());
+                payload.insert(payload.end(), nalu.begin(), nalu.end());
+            }
+
+            AddPacket(payload);
+        }
+
+        // FU-A fragments of about the same size
+        void AddFuA(const TBytes& nalu, size_t nFragments)
+        {
+            size_t nDataSize = nalu.size() - 1;
+            for (size_t i = 0; i < nFragments; ++i)
+            {
+                size_t nStart = 1 + nDataSize * i / nFragments;
+                size_t nEnd = 1 + nDataSize * (i + 1) / nFragments;
+                TBytes payload;
+                payload.push_back((mfxU8)((nalu[0] & 0xe0) | 28));
+                payload.push_back((mfxU8)(((0 == i) ? 0x80 : 0) | ((nFragments - 1 == i) ? 0x40 : 0) | (nalu[0] & 0x1f)));
+                payload.insert(payload.end(), nalu.begin() + nStart, nalu.begin() + nEnd);
+                AddPacket(payload);
+            }
+        }
+
+        std::vector<TRtpPacket>& GetPackets() { return m_Packets; }
+
+    private:
+        void AddPacket(const TBytes& payload)
+        {
+            TRtpPacket packet = { m_nSeq++, m_TimeStamp, payload };
+            m_Packets.push_back(packet);
+        }
+
+        mfxU16                  m_nSeq;
+        mfxU32                  m_TimeStamp;
+        std::vector<TRtpPacket> m_Packets;
+    };
+
+    // Output of the depacketizer
+    struct TOutput
+    {
+        TBytes               stream;
+        std::vector<int64_t> timeStamps; // Time stamps returned with pieces
+        std::vector<size_t>  offsets;    // Stream offsets of the pieces with time stamps
+    };
+
+    // Sends the packets in the order given by pOrder (indices into packets, NULL - in order)
+    void Depacketize(CH264RtpDepacketizer& depacketizer, const std::vector<TRtpPacket>& packets,
+        const size_t* pOrder, TOutput& output)
+    {
+        for (size_t i = 0; i < packets.size(); ++i)
+        {
+            TBytes data = MakeRtpPacket(packets[(pOrder) ? pOrder[i] : i]);
+            depacketizer.SetData(&data[0], data.size());
+
+            const uint8_t* pPayload;
+            size_t nSize;
+            int64_t pts;
+            while (depacketizer.GetNextPayload(pPayload, nSize, pts))
+            {
+                if (pts >= 0)
+                {
+                    output.timeStamps.push_back(pts);
+                    output.offsets.push_back(output.stream.size());
+                }
+
+                output.stream.insert(output.stream.end(), pPayload, pPayload + nSize);
+            }
+        }
+    }
+
+    // Access units of a test stream: SPS + PPS (STAP-A), a fragmented IDR slice, then P slices
+    // that are alternately single packets and fragmented. Pictures are 3000 ticks (30 fps) apart.
+    // expected gets the AnnexB stream, auOffsets the stream offset of each access unit.
+    void MakeStream(CRtpPacketizer& packetizer, size_t nPictures, TBytes& expected, std::vector<size_t>& auOffsets)
+    {
+        TBytes parameterSets[] = { QsTestMakeSPS(), QsTestMakePPS() };
+        auOffsets.push_back(expected.size());
+        packetizer.AddStapA(parameterSets, 2);
+        QsTestAppendNalu(expected, parameterSets[0]);
+        QsTestAppendNalu(expected, parameterSets[1]);
+
+        for (size_t i = 0; i < nPictures; ++i)
+        {
+            if (i > 0)
+            {
+                packetizer.NextPicture(3000);
+                auOffsets.push_back(expected.size());
+            }
+
+            TBytes slice = QsTestMakeSlice(0 == i, true, (0 == i) ? H264_SLICE_I : H264_SLICE_P,
+                (mfxU32)(i % 16), (mfxU32)((2 * i) % 256), (0 == i) ? 3000 : 300 + 100 * i);
+            if (i & 1)
+            {
+                packetizer.AddSingle(slice);
+            }
+            else
+            {
+                packetizer.AddFuA(slice, 3);
+            }
+
+            QsTestAppendNalu(expected, slice);
+        }
+    }
+
+    // Each access unit starts with a new time stamp, 3000 ticks after the previous one
+    bool CheckTimeStamps(const TOutput& output, const std::vector<size_t>& auOffsets)
+    {
+        if (output.offsets != auOffsets)
+            return false;
+
+        for (size_t i = 1; i < output.timeStamps.size(); ++i)
+        {
+            if (output.timeStamps[i] != output.timeStamps[i - 1] + 3000)
+                return false;
+        }
+
+        return true;
+    }
+}
+
+// Single NALU, STAP-A and FU-A packets in order
+QS_TEST(RtpPacketTypes)
+{
+    CRtpPacketizer packetizer(1000, 90000);
+    TBytes expected;
+    std::vector<size_t> auOffsets;
+    MakeStream(packetizer, 6, expected, auOffsets);
+
+    CH264RtpDepacketizer depacketizer;
+    TOutput output;
+    Depacketize(depacketizer, packetizer.GetPackets(), NULL, output);
+    QS_CHECK(output.stream == expected);
+    QS_CHECK(CheckTimeStamps(output, auOffsets));
+
+    // Unwrapped time stamps start one wrap around above 0
+    QS_CHECK(!output.timeStamps.empty() && output.timeStamps[0] == (1LL << 32) + 90000);
+}
+
+// Packets arriving out of order within the jitter window - FU-A fragments are reassembled in sequence order
+QS_TEST(RtpReordering)
+{
+    CRtpPacketizer packetizer(1000, 90000);
+    TBytes expected;
+    std::vector<size_t> auOffsets;
+    MakeStream(packetizer, 6, expected, auOffsets);
+
+    // Packets: STAP-A, FU-A x3, single, FU-A x3, single, FU-A x3, single
+    const size_t order[] = { 0, 2, 1, 3, 5, 4, 7, 6, 8, 12, 11, 10, 9 };
+    QS_CHECK(MSDK_ARRAY_LEN(order) == packetizer.GetPackets().size());
+
+    CH264RtpDepacketizer depacketizer;
+    TOutput output;
+    Depacketize(depacketizer, packetizer.GetPackets(), order, output);
+    QS_CHECK(output.stream == expected);
+    QS_CHECK(CheckTimeStamps(output, auOffsets));
+}
+
+// Sequence numbers and RTP time stamps wrap around in the middle of a fragmented NALU, packets around
+// the wrap arrive out of order
+QS_TEST(RtpSequenceNumberWrap)
+{
+    CRtpPacketizer packetizer(65530, 0xffffffff - 4000);
+    TBytes expected;
+    std::vector<size_t> auOffsets;
+    MakeStream(packetizer, 6, expected, auOffsets);
+
+    // Sequence numbers 65530 - 65535, 0 - 6. The wrap is between the first two fragments of the third picture.
+    const size_t order[] = { 0, 1, 2, 3, 4, 7, 6, 5, 8, 10, 9, 11, 12 };
+    QS_CHECK(MSDK_ARRAY_LEN(order) == packetizer.GetPackets().size());
+
+    CH264RtpDepacketizer depacketizer;
+    TOutput output;
+    Depacketize(depacketizer, packetizer.GetPackets(), order, output);
+    QS_CHECK(output.stream == expected);
+    QS_CHECK(CheckTimeStamps(output, auOffsets));
+}
+
+// A packet missing for longer than the jitter window is lost. The fragmented NALU it belongs to is truncated,
+// the following NALUs are complete. Late and duplicate packets are dropped.
+QS_TEST(RtpLostPacket)
+{
+    CRtpPacketizer packetizer(100, 0);
+    TBytes idr = QsTestMakeSlice(true, true, H264_SLICE_I, 0, 0, 3000);
+    packetizer.AddFuA(idr, 3);
+
+    TBytes expected;
+    std::vector<TBytes> slices;
+    for (mfxU32 i = 1; i <= 20; ++i)
+    {
+        packetizer.NextPicture(3000);
+        slices.push_back(QsTestMakeSlice(false, true, H264_SLICE_P, i % 16, (2 * i) % 256, 200));
+        packetizer.AddSingle(slices.back());
+        QsTestAppendNalu(expected, slices.back());
+    }
+
+    // The middle fragment (101) comes too late, then the first packet is sent again
+    std::vector<TRtpPacket> packets = packetizer.GetPackets();
+    TRtpPacket lost = packets[1];
+    packets.erase(packets.begin() + 1);
+    packets.push_back(lost);
+    packets.push_back(packets[0]);
+
+    CH264RtpDepacketizer depacketizer;
+    TOutput output;
+    Depacketize(depacketizer, packets, NULL, output);
+
+    // Start code, NALU header and the data of the first fragment
+    size_t nFirstFragment = 5 + (idr.size() - 1) / 3;
+    QS_CHECK(output.stream.size() == nFirstFragment + expected.size());
+    QS_CHECK(output.stream.size() >= nFirstFragment &&
+        std::equal(output.stream.begin() + nFirstFragment, output.stream.end(), expected.begin()));
+    QS_CHECK(output.timeStamps.size() == slices.size() + 1);
+}
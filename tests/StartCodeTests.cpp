@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "TimeManager.h"
+#include "H264Nalu.h"
+#include "QsTest.h"
+#include "QsTestUtils.h"
+
+namespace
+{
+    // Scanners may read 2 bytes past the end of the range
+    const size_t SCAN_PADDING = 2;
+
+    // Compares the SIMD scanners with the scalar one on [pStart, pEnd).
+    // Every start code is checked by resuming the search after it.
+    bool CheckScanners(const mfxU8* pStart, const mfxU8* pEnd)
+    {
+        bool bAvx2 = IsAVX2Enabled();
+        const mfxU8* p = pStart;
+        for (;;)
+        {
+            const mfxU8* pExpected = FindStartCodeC(p, pEnd);
+            if (pExpected != FindStartCodeSSE2(p, pEnd))
+                return false;
+
+#if _MSC_VER >= 1700
+            if (bAvx2 && pExpected != FindStartCodeAVX2(p, pEnd))
+                return false;
+#endif
+
+            if (pExpected == pEnd)
+                return true;
+
+            p = pExpected + 1;
+        }
+    }
+}
+
+// Random data dense with zeros and ones so start codes and near misses (00 00 00, 00 01) are frequent.
+// Ranges of every length up to a few SIMD blocks start at every alignment.
+QS_TEST(StartCodeScannersRandomData)
+{
+    CQsTestRandom random;
+    std::vector<mfxU8> buffer(4096 + 64 + SCAN_PADDING);
+    for (int n = 0; n < 20; ++n)
+    {
+        for (size_t i = 0; i < buffer.size(); ++i)
+        {
+            mfxU32 r = random.Next(8);
+            buffer[i] = (r < 4) ? 0 : (r < 6) ? 1 : (mfxU8)random.Next(256);
+        }
+
+        for (size_t nOffset = 0; nOffset < 64; ++nOffset)
+        {
+            for (size_t nSize = 0; nSize <= 100; ++nSize)
+            {
+                const mfxU8* pStart = &buffer[nOffset];
+                QS_CHECK(CheckScanners(pStart, pStart + nSize));
+            }
+        }
+
+        QS_CHECK(CheckScanners(&buffer[n], &buffer[0] + buffer.size() - SCAN_PADDING));
+    }
+}
+
+// A single start code at every position of a range, including one that ends past the range.
+// The rest of the data is zeros (near misses) or ones.
+QS_TEST(StartCodeScannersEdgeCases)
+{
+    static const mfxU8 fillers[] = { 0, 1, 0xFF };
+    for (size_t nFiller = 0; nFiller < MSDK_ARRAY_LEN(fillers); ++nFiller)
+    {
+        for (size_t nSize = 0; nSize <= 80; ++nSize)
+        {
+            for (size_t nPos = 0; nPos < nSize + SCAN_PADDING; ++nPos)
+            {
+                std::vector<mfxU8> buffer(nSize + 3 + SCAN_PADDING, fillers[nFiller]);
+                buffer[nPos] = 0;
+                buffer[nPos + 1] = 0;
+                buffer[nPos + 2] = 1;
+
+                // Odd start addresses
+                const mfxU8* pStart = &buffer[0] + (nSize & 1);
+                const mfxU8* pEnd = pStart + nSize - (nSize & 1);
+                QS_CHECK(CheckScanners(pStart, pEnd));
+                QS_CHECK(CheckScanners(&buffer[0], &buffer[0] + nSize));
+
+                // Leading zeros of a 4 byte start code
+                if (nPos > 0)
+                {
+                    buffer[nPos - 1] = 0;
+                    QS_CHECK(CheckScanners(&buffer[0], &buffer[0] + nSize));
+                }
+            }
+        }
+    }
+
+    // Start codes found in every position of a block
+    std::vector<mfxU8> zeros(64 + SCAN_PADDING, 0);
+    QS_CHECK(CheckScanners(&zeros[0], &zeros[0] + 64));
+    QS_CHECK(FindStartCodeSSE2(&zeros[0], &zeros[0] + 64) == &zeros[0] + 64);
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "QsTest.h"
+
+// The high-water mark counts the surfaces the application holds, the surfaces MSDK holds that
+// the search passed over and the surface being returned
+QS_TEST(SurfacePoolHighWaterMark)
+{
+    mfxFrameSurface1 surfaces[8];
+    MSDK_ZERO_MEMORY(surfaces, sizeof(surfaces));
+    CQsSurfacePool pool;
+    pool.Init(surfaces, MSDK_ARRAY_LEN(surfaces));
+    QS_CHECK(!pool.HasLockedSurfaces());
+
+    // Application locks - locking a surface twice counts once
+    pool.LockSurface(&surfaces[0]);
+    pool.LockSurface(&surfaces[0]);
+    pool.LockSurface(&surfaces[1]);
+    QS_CHECK(pool.HasLockedSurfaces());
+
+    // Reference frame held by MSDK
+    surfaces[2].Data.Locked = 1;
+    QS_CHECK(&surfaces[3] == pool.FindFreeSurface(0));
+    QS_CHECK(4 == pool.GetHighWaterMark());
+
+    // Released surfaces lower the count, the high-water mark stays
+    pool.UnlockSurface(&surfaces[0]);
+    QS_CHECK(pool.HasLockedSurfaces());
+    pool.UnlockSurface(&surfaces[0]);
+    pool.UnlockSurface(&surfaces[1]);
+    QS_CHECK(!pool.HasLockedSurfaces());
+    QS_CHECK(&surfaces[0] == pool.FindFreeSurface(0));
+    QS_CHECK(4 == pool.GetHighWaterMark());
+
+    pool.ResetHighWaterMark();
+    QS_CHECK(&surfaces[0] == pool.FindFreeSurface(0));
+    QS_CHECK(1 == pool.GetHighWaterMark());
+
+    // UnlockAll drops the application locks
+    pool.LockSurface(&surfaces[4]);
+    pool.UnlockAll();
+    QS_CHECK(!pool.HasLockedSurfaces());
+}
+
+// Without a free surface the search times out and the high-water mark is the whole pool
+QS_TEST(SurfacePoolExhausted)
+{
+    mfxFrameSurface1 surfaces[3];
+    MSDK_ZERO_MEMORY(surfaces, sizeof(surfaces));
+    CQsSurfacePool pool;
+    pool.Init(surfaces, MSDK_ARRAY_LEN(surfaces));
+    for (size_t i = 0; i < MSDK_ARRAY_LEN(surfaces); ++i)
+    {
+        pool.LockSurface(&surfaces[i]);
+    }
+
+    QS_CHECK(NULL == pool.FindFreeSurface(0));
+    QS_CHECK(1 == pool.GetWaitCount());
+    QS_CHECK(3 == pool.GetHighWaterMark());
+
+    pool.UnlockSurface(&surfaces[1]);
+    QS_CHECK(&surfaces[1] == pool.FindFreeSurface(0));
+}
+
+namespace
+{
+    // How a surface becomes free while FindFreeSurface waits
+    enum
+    {
+        RELEASE_UNLOCK_SURFACE,
+        RELEASE_UNLOCK_ALL,
+        RELEASE_MSDK_SIGNALED,  // MSDK drops Data.Locked and the operation's completion is signaled
+        RELEASE_MSDK,           // MSDK drops Data.Locked on its own
+        RELEASE_COUNT
+    };
+
+    struct TPoolReleaser
+    {
+        CQsSurfacePool*   pPool;
+        mfxFrameSurface1* pSurface;
+        int               nRelease;
+    };
+
+    unsigned __stdcall PoolReleaserProc(void* pContext)
+    {
+        TPoolReleaser& releaser = *(TPoolReleaser*)pContext;
+        while (0 == releaser.pPool->GetWaitCount())
+        {
+            SwitchToThread();
+        }
+
+        switch (releaser.nRelease)
+        {
+        case RELEASE_UNLOCK_SURFACE:
+            releaser.pPool->UnlockSurface(releaser.pSurface);
+            break;
+        case RELEASE_UNLOCK_ALL:
+            releaser.pPool->UnlockAll();
+            break;
+        case RELEASE_MSDK_SIGNALED:
+            releaser.pSurface->Data.Locked = 0;
+            releaser.pPool->SignalRelease();
+            break;
+        default:
+            releaser.pSurface->Data.Locked = 0;
+        }
+
+        return 0;
+    }
+}
+
+// A waiting search ends when a surface is released on another thread - by the application, by UnlockAll
+// or by MSDK. Surfaces MSDK releases without a signal are found by the periodic search.
+QS_TEST(SurfacePoolReleaseEndsWait)
+{
+    for (int nRelease = 0; nRelease < RELEASE_COUNT; ++nRelease)
+    {
+        mfxFrameSurface1 surfaces[2];
+        MSDK_ZERO_MEMORY(surfaces, sizeof(surfaces));
+        CQsSurfacePool pool;
+        pool.Init(surfaces, MSDK_ARRAY_LEN(surfaces));
+        pool.LockSurface(&surfaces[0]);
+        if (nRelease >= RELEASE_MSDK_SIGNALED)
+        {
+            surfaces[1].Data.Locked = 1;
+        }
+        else
+        {
+            pool.LockSurface(&surfaces[1]);
+        }
+
+        TPoolReleaser releaser = { &pool, &surfaces[1], nRelease };
+        HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, PoolReleaserProc, &releaser, 0, NULL);
+        if (!QS_CHECK(hThread != NULL))
+            return;
+
+        // UnlockAll frees both surfaces
+        mfxFrameSurface1* pExpected = (RELEASE_UNLOCK_ALL == nRelease) ? &surfaces[0] : &surfaces[1];
+        DWORD dwStart = GetTickCount();
+        QS_CHECK(pExpected == pool.FindFreeSurface(10000));
+        QS_CHECK(GetTickCount() - dwStart < 5000);
+        QS_CHECK(1 == pool.GetWaitCount());
+
+        WaitForSingleObject(hThread, INFINITE);
+        CloseHandle(hThread);
+    }
+}
+
+// The capacity is rounded up to a power of 2. A full ring refuses surfaces, an empty one returns none.
+QS_TEST(SurfaceRingFullAndEmpty)
+{
+    mfxFrameSurface1 surfaces[9];
+    CQsSurfaceRing ring;
+    ring.Init(5);
+    QS_CHECK(ring.Empty());
+    QS_CHECK(NULL == ring.PopSurface());
+    QS_CHECK(NULL == ring.FrontSurface());
+    QS_CHECK(ring.GetSnapshot().empty());
+
+    for (size_t i = 0; i < 8; ++i)
+    {
+        QS_CHECK(ring.PushSurface(&surfaces[i]));
+    }
+
+    QS_CHECK(!ring.PushSurface(&surfaces[8]));
+    QS_CHECK(8 == ring.Size());
+    QS_CHECK(&surfaces[0] == ring.FrontSurface());
+
+    CQsSurfaceRing::CSnapshot snapshot = ring.GetSnapshot();
+    if (QS_CHECK(8 == snapshot.size()))
+    {
+        for (size_t i = 0; i < snapshot.size(); ++i)
+        {
+            QS_CHECK(&surfaces[i] == snapshot[i]);
+        }
+    }
+
+    // A popped slot takes the next surface
+    QS_CHECK(&surfaces[0] == ring.PopSurface());
+    QS_CHECK(ring.PushSurface(&surfaces[8]));
+    QS_CHECK(!ring.PushSurface(&surfaces[0]));
+    for (size_t i = 1; i < 9; ++i)
+    {
+        QS_CHECK(&surfaces[i] == ring.PopSurface());
+    }
+
+    QS_CHECK(ring.Empty());
+    QS_CHECK(NULL == ring.PopSurface());
+
+    // Init empties the ring. The capacity is at least 1 and at most MSDK_MAX_SURFACES.
+    QS_CHECK(ring.PushSurface(&surfaces[0]));
+    ring.Init(0);
+    QS_CHECK(ring.Empty());
+    QS_CHECK(ring.PushSurface(&surfaces[0]));
+    QS_CHECK(!ring.PushSurface(&surfaces[1]));
+
+    ring.Init(MSDK_MAX_SURFACES + 10);
+    size_t nPushed = 0;
+    while (nPushed <= MSDK_MAX_SURFACES && ring.PushSurface(&surfaces[0]))
+    {
+        ++nPushed;
+    }
+
+    QS_CHECK(MSDK_MAX_SURFACES == nPushed);
+}
+
+// The indices keep growing - slots are reused after the ring wraps around and snapshots span the wrap
+QS_TEST(SurfaceRingWrapAround)
+{
+    mfxFrameSurface1 surfaces[16];
+    CQsSurfaceRing ring;
+    ring.Init(4);
+
+    size_t nPushed = 0, nPopped = 0;
+    for (size_t round = 0; round < 1000; ++round)
+    {
+        // Fill levels from 1 to 4 - the oldest surface moves around the ring
+        size_t nCount = 1 + round % 4;
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            QS_CHECK(ring.PushSurface(&surfaces[nPushed++ % 16]));
+        }
+
+        CQsSurfaceRing::CSnapshot snapshot = ring.GetSnapshot();
+        if (!QS_CHECK(nCount == snapshot.size()))
+            return;
+
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            if (!QS_CHECK(&surfaces[(nPopped + i) % 16] == snapshot[i]))
+                return;
+        }
+
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            if (!QS_CHECK(&surfaces[nPopped++ % 16] == ring.PopSurface()))
+                return;
+        }
+
+        QS_CHECK(ring.Empty());
+    }
+}
+
+namespace
+{
+    struct TRingProducer
+    {
+        CQsSurfaceRing*   pRing;
+        mfxFrameSurface1* pSurfaces;
+        size_t            nSurfaces;
+        size_t            nCount;
+    };
+
+    unsigned __stdcall RingProducerProc(void* pContext)
+    {
+        TRingProducer& producer = *(TRingProducer*)pContext;
+        for (size_t i = 0; i < producer.nCount; ++i)
+        {
+            while (!producer.pRing->PushSurface(&producer.pSurfaces[i % producer.nSurfaces]))
+            {
+                SwitchToThread();
+            }
+        }
+
+        return 0;
+    }
+}
+
+// A producer thread fills the ring while the consumer empties it - surfaces come out in order
+QS_TEST(SurfaceRingProducerConsumer)
+{
+    mfxFrameSurface1 surfaces[13];
+    CQsSurfaceRing ring;
+    ring.Init(8);
+
+    TRingProducer producer = { &ring, surfaces, MSDK_ARRAY_LEN(surfaces), 200000 };
+    HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, RingProducerProc, &producer, 0, NULL);
+    if (!QS_CHECK(hThread != NULL))
+        return;
+
+    // Pop every pushed surface so the producer always finishes
+    size_t nOutOfOrder = 0;
+    for (size_t i = 0; i < producer.nCount; )
+    {
+        mfxFrameSurface1* pSurface = ring.PopSurface();
+        if (NULL == pSurface)
+        {
+            SwitchToThread();
+            continue;
+        }
+
+        if (&surfaces[i % producer.nSurfaces] != pSurface)
+        {
+            ++nOutOfOrder;
+        }
+
+        ++i;
+    }
+
+    QS_CHECK(0 == nOutOfOrder);
+    WaitForSingleObject(hThread, INFINITE);
+    CloseHandle(hThread);
+    QS_CHECK(ring.Empty());
+}
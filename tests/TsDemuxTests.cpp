@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2013, INTEL CORPORATION
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ * Neither the name of INTEL CORPORATION nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without specific
+ * prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stdafx.h"
+#include "QuickSync_defs.h"
+#include "QuickSyncUtils.h"
+#include "TimeManager.h"
+#include "MPEG2PsDemux.h"
+#include "MPEG2TsDemux.h"
+#include "QsTest.h"
+#include "QsTestUtils.h"
+
+namespace
+{
+    typedef std::vector<mfxU8> TBytes;
+
+    const size_t TS_PACKET_SIZE = 188;
+    const size_t TS_PAYLOAD_SIZE = TS_PACKET_SIZE - 4;
+    const int PMT_PID = 0x100;
+    const int VIDEO_PID = 0x101;
+
+    // Builds the packets of a program with one H264 stream. Continuity counters are kept per PID.
+    class CTsMuxer
+    {
+    public:
+        CTsMuxer() : m_nPatCounter(0), m_nPmtCounter(0), m_nVideoCounter(0) {}
+
+        // The demuxer doesn't check the CRC - it's left 0
+        TBytes MakePat()
+        {
+            const mfxU8 section[] = { 0, 0xB0, 13, 0, 1, 0xC1, 0, 0,
+                0, 1, (mfxU8)(0xE0 | (PMT_PID >> 8)), (mfxU8)PMT_PID,
+                0, 0, 0, 0 };
+            return MakeSectionPacket(0, m_nPatCounter, section, sizeof(section));
+        }
+
+        TBytes MakePmt()
+        {
+            const mfxU8 section[] = { 2, 0xB0, 18, 0, 1, 0xC1, 0, 0,
+                (mfxU8)(0xE0 | (VIDEO_PID >> 8)), (mfxU8)VIDEO_PID, 0xF0, 0,
+                0x1B, (mfxU8)(0xE0 | (VIDEO_PID >> 8)), (mfxU8)VIDEO_PID, 0xF0, 0,
+                0, 0, 0, 0 };
+            return MakeSectionPacket(PMT_PID, m_nPmtCounter, section, sizeof(section));
+        }
+
+        // Splits a PES packet into video packets. The first packets carry the given number of bytes,
+        // the following ones are full. The last one is padded with adaptation field stuffing.
+        std::vector<TBytes> MakeVideoPackets(const TBytes& pes, const size_t* pFirstSizes = NULL, size_t nFirstSizes = 0)
+        {
+            std::vector<TBytes> packets;
+            for (size_t nOffset = 0, i = 0; nOffset < pes.size(); ++i)
+            {
+                size_t nSize = (i < nFirstSizes) ? pFirstSizes[i] : TS_PAYLOAD_SIZE;
+                nSize = min(nSize, pes.size() - nOffset);
+                packets.push_back(MakePacket(VIDEO_PID, 0 == nOffset, m_nVideoCounter, &pes[nOffset], nSize));
+                nOffset += nSize;
+            }
+
+            return packets;
+        }
+
+        // Packet with up to 184 payload bytes - shorter payloads are preceded by an adaptation field
+        static TBytes MakePacket(int pid, bool bUnitStart, int& nCounter, const mfxU8* pPayload, size_t nSize, bool bDiscontinuity = false)
+        {
+            TBytes packet(4, 0);
+            const bool bAdaptation = nSize < TS_PAYLOAD_SIZE || bDiscontinuity;
+            packet[0] = 0x47;
+            packet[1] = (mfxU8)((bUnitStart ? 0x40 : 0) | (pid >> 8));
+            packet[2] = (mfxU8)pid;
+            packet[3] = (mfxU8)((bAdaptation ? 0x30 : 0x10) | nCounter);
+            nCounter = (nCounter + 1) & 0x0F;
+            if (bAdaptation)
+            {
+                size_t nLength = TS_PAYLOAD_SIZE - 1 - nSize;
+                packet.push_back((mfxU8)nLength);
+                if (nLength > 0)
+                {
+                    packet.push_back(bDiscontinuity ? 0x80 : 0);
+                    packet.resize(packet.size() + nLength - 1, 0xFF);
+                }
+            }
+
+            packet.insert(packet.end(), pPayload, pPayload + nSize);
+            return packet;
+        }
+
+    private:
+        static TBytes MakeSectionPacket(int pid, int& nCounter, const mfxU8* pSection, size_t nSize)
+        {
+            // pointer_field 0, the rest of the packet is stuffed
+            TBytes payload(1, 0);
+            payload.insert(payload.end(), pSection, pSection + nSize);
+            payload.resize(TS_PAYLOAD_SIZE, 0xFF);
+            return MakePacket(pid, true, nCounter, &payload[0], payload.size());
+        }
+
+        int m_nPatCounter;
+        int m_nPmtCounter;
+        int m_nVideoCounter;
+    };
+
+    // Video PES packet with an optional PTS (90KHz, -1 - none). Payload bytes are never a sync byte.
+    TBytes MakeVideoPes(int64_t pts, size_t nPayloadSize, mfxU8 seed)
+    {
+        const size_t nHeaderDataSize = (pts >= 0) ? 5 : 0;
+        const mfxU8 header[] = { 0, 0, 1, 0xE0, 0, 0, 0x81, (mfxU8)((pts >= 0) ? 0x80 : 0), (mfxU8)nHeaderDataSize };
+        TBytes pes(header, header + sizeof(header));
+        if (pts >= 0)
+        {
+            pes.push_back((mfxU8)(0x21 | ((pts >> 29) & 0x0E)));
+            pes.push_back((mfxU8)(pts >> 22));
+            pes.push_back((mfxU8)(0x01 | ((pts >> 14) & 0xFE)));
+            pes.push_back((mfxU8)(pts >> 7));
+            pes.push_back((mfxU8)(0x01 | ((pts << 1) & 0xFE)));
+        }
+
+        for (size_t i = 0; i < nPayloadSize; ++i)
+        {
+            pes.push_back((mfxU8)(0x80 | ((seed + i) & 0x3F)));
+        }
+
+        return pes;
+    }
+
+    // Payload of a PES packet made by MakeVideoPes
+    TBytes GetPesPayload(const TBytes& pes)
+    {
+        return TBytes(pes.begin() + 9 + pes[8], pes.end());
+    }
+
+    void Append(TBytes& stream, const TBytes& data)
+    {
+        stream.insert(stream.end(), data.begin(), data.end());
+    }
+
+    void Append(TBytes& stream, const std::vector<TBytes>& packets)
+    {
+        for (size_t i = 0; i < packets.size(); ++i)
+        {
+            Append(stream, packets[i]);
+        }
+    }
+
+    // Concatenated payloads and the PTS values returned with them
+    struct TDemuxOutput
+    {
+        TBytes data;
+        std::vector<int64_t> pts;
+    };
+
+    // Feeds the stream in samples of nSampleSize bytes (0 - a single sample)
+    TDemuxOutput Demux(CMPEG2TsDemuxer& demuxer, const TBytes& stream, size_t nSampleSize = 0)
+    {
+        TDemuxOutput output;
+        if (0 == nSampleSize)
+        {
+            nSampleSize = stream.size();
+        }
+
+        for (size_t nOffset = 0; nOffset < stream.size(); nOffset += nSampleSize)
+        {
+            demuxer.SetData(&stream[nOffset], min(nSampleSize, stream.size() - nOffset));
+            const uint8_t* pPayload;
+            size_t nSize;
+            int64_t pts;
+            while (demuxer.GetNextPayload(pPayload, nSize, pts))
+            {
+                output.data.insert(output.data.end(), pPayload, pPayload + nSize);
+                if (pts >= 0)
+                {
+                    output.pts.push_back(pts);
+                }
+            }
+        }
+
+        return output;
+    }
+
+    // Random bytes without a sync byte
+    TBytes MakeGarbage(CQsTestRandom& random, size_t nSize)
+    {
+        TBytes garbage(nSize);
+        for (size_t i = 0; i < nSize; ++i)
+        {
+            garbage[i] = (mfxU8)random.Next(256);
+            if (0x47 == garbage[i])
+                garbage[i] = 0x48;
+        }
+
+        return garbage;
+    }
+}
+
+// Garbage before the tables and between video packets. The demuxer finds the packets again and
+// no video data is lost. A sync byte in the garbage isn't taken for a packet - after a loss of sync
+// a packet must be followed by two more.
+QS_TEST(TsDemuxResyncAfterGarbage)
+{
+    CQsTestRandom random;
+    CTsMuxer muxer;
+    TBytes pes1 = MakeVideoPes(90000, 3000, 1);
+    TBytes pes2 = MakeVideoPes(93600, 2000, 2);
+    std::vector<TBytes> packets1 = muxer.MakeVideoPackets(pes1);
+    std::vector<TBytes> packets2 = muxer.MakeVideoPackets(pes2);
+
+    TBytes garbage = MakeGarbage(random, 150);
+    garbage[10] = garbage[100] = 0x47;
+
+    TBytes stream = garbage;
+    Append(stream, muxer.MakePat());
+    Append(stream, muxer.MakePmt());
+    for (size_t i = 0; i < packets1.size(); ++i)
+    {
+        Append(stream, packets1[i]);
+        if (5 == i)
+            Append(stream, garbage);
+    }
+
+    Append(stream, MakeGarbage(random, 3 * TS_PACKET_SIZE + 7));
+    Append(stream, packets2);
+
+    TBytes expected = GetPesPayload(pes1);
+    Append(expected, GetPesPayload(pes2));
+
+    CMPEG2TsDemuxer demuxer;
+    TDemuxOutput output = Demux(demuxer, stream);
+    QS_CHECK(expected == output.data);
+    if (QS_CHECK(2 == output.pts.size()))
+    {
+        QS_CHECK(90000 == output.pts[0]);
+        QS_CHECK(93600 == output.pts[1]);
+    }
+
+    // Samples end inside the garbage and inside packets. The garbage has no sync bytes here -
+    // near the end of a sample the following packets can't be checked.
+    stream = MakeGarbage(random, 100);
+    Append(stream, muxer.MakePat());
+    Append(stream, muxer.MakePmt());
+    Append(stream, muxer.MakeVideoPackets(pes1));
+    Append(stream, MakeGarbage(random, 300));
+    Append(stream, muxer.MakeVideoPackets(pes2));
+
+    static const size_t s_SampleSizes[] = { 1, 50, 187, 189, 500 };
+    for (size_t i = 0; i < MSDK_ARRAY_LEN(s_SampleSizes); ++i)
+    {
+        CMPEG2TsDemuxer splitDemuxer;
+        output = Demux(splitDemuxer, stream, s_SampleSizes[i]);
+        QS_CHECK(expected == output.data);
+        QS_CHECK(2 == output.pts.size());
+    }
+}
+
+// PES headers split between packets at every offset, and over three packets. The PTS is read
+// from the reassembled header and none of the header bytes are returned as payload.
+QS_TEST(TsDemuxPesHeaderSplitAcrossPackets)
+{
+    TBytes pes = MakeVideoPes(123456789, 500, 3);
+    const size_t nHeaderSize = pes.size() - GetPesPayload(pes).size();
+
+    for (size_t nSplit = 1; nSplit <= nHeaderSize; ++nSplit)
+    {
+        CTsMuxer muxer;
+        TBytes stream = muxer.MakePat();
+        Append(stream, muxer.MakePmt());
+        Append(stream, muxer.MakeVideoPackets(pes, &nSplit, 1));
+
+        CMPEG2TsDemuxer demuxer;
+        TDemuxOutput output = Demux(demuxer, stream);
+        if (!QS_CHECK(GetPesPayload(pes) == output.data))
+            return;
+
+        if (!QS_CHECK(1 == output.pts.size() && 123456789 == output.pts[0]))
+            return;
+    }
+
+    // Start code prefix, then up to PES_header_data_length, then the rest
+    const size_t firstSizes[] = { 2, 6, 3 };
+    CTsMuxer muxer;
+    TBytes stream = muxer.MakePat();
+    Append(stream, muxer.MakePmt());
+    Append(stream, muxer.MakeVideoPackets(pes, firstSizes, MSDK_ARRAY_LEN(firstSizes)));
+
+    CMPEG2TsDemuxer demuxer;
+    TDemuxOutput output = Demux(demuxer, stream);
+    QS_CHECK(GetPesPayload(pes) == output.data);
+    QS_CHECK(1 == output.pts.size() && 123456789 == output.pts[0]);
+}
+
+// Duplicate packets are dropped. A lost packet drops the rest of its PES packet and the next PES
+// packet is returned whole. A discontinuity_indicator allows a jump of the counter.
+QS_TEST(TsDemuxContinuityCounter)
+{
+    // 3000 bytes - the counter wraps around inside the PES packet
+    TBytes pes1 = MakeVideoPes(90000, 3000, 4);
+    TBytes pes2 = MakeVideoPes(93600, 1000, 5);
+    TBytes pes3 = MakeVideoPes(97200, 1000, 6);
+
+    CTsMuxer muxer;
+    TBytes stream = muxer.MakePat();
+    Append(stream, muxer.MakePmt());
+    std::vector<TBytes> packets1 = muxer.MakeVideoPackets(pes1);
+    for (size_t i = 0; i < packets1.size(); ++i)
+    {
+        Append(stream, packets1[i]);
+        if (1 == i || 16 == i)
+            Append(stream, packets1[i]);
+    }
+
+    CMPEG2TsDemuxer demuxer;
+    TDemuxOutput output = Demux(demuxer, stream);
+    QS_CHECK(GetPesPayload(pes1) == output.data);
+    QS_CHECK(1 == output.pts.size());
+
+    // Packet 3 of the second PES packet is lost
+    std::vector<TBytes> packets2 = muxer.MakeVideoPackets(pes2);
+    std::vector<TBytes> packets3 = muxer.MakeVideoPackets(pes3);
+    packets2.erase(packets2.begin() + 3);
+    stream.clear();
+    Append(stream, packets2);
+    Append(stream, packets3);
+
+    TBytes expected = GetPesPayload(pes2);
+    expected.resize(3 * TS_PAYLOAD_SIZE - (pes2.size() - GetPesPayload(pes2).size()));
+    Append(expected, GetPesPayload(pes3));
+
+    output = Demux(demuxer, stream);
+    QS_CHECK(expected == output.data);
+    if (QS_CHECK(2 == output.pts.size()))
+    {
+        QS_CHECK(93600 == output.pts[0]);
+        QS_CHECK(97200 == output.pts[1]);
+    }
+
+    // A jump of the counter signalled by the discontinuity_indicator keeps the PES packet
+    TBytes pes4 = MakeVideoPes(100800, 1000, 7);
+    std::vector<TBytes> packets4 = muxer.MakeVideoPackets(pes4);
+    int nCounter = 9;
+    const size_t nHeaderSize = pes4.size() - GetPesPayload(pes4).size();
+    packets4[2] = CTsMuxer::MakePacket(VIDEO_PID, false, nCounter, &pes4[2 * TS_PAYLOAD_SIZE], TS_PAYLOAD_SIZE - 10, true);
+    stream.clear();
+    Append(stream, packets4[0]);
+    Append(stream, packets4[1]);
+    Append(stream, packets4[2]);
+
+    expected.assign(pes4.begin() + nHeaderSize, pes4.begin() + 3 * TS_PAYLOAD_SIZE - 10);
+    output = Demux(demuxer, stream);
+    QS_CHECK(expected == output.data);
+}